@@ -13,6 +13,26 @@
 #include <string.h>
 #include <stdio.h>
 
+/*	SSE2 is part of every x86-64 CPU; the AVX encoder is compiled in as
+	well and only used when the CPU running it has AVX	*/
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+	#define DXT_HAVE_SSE2 1
+	#include <emmintrin.h>
+	#if defined(__GNUC__) || defined(_MSC_VER)
+		#define DXT_HAVE_AVX 1
+		#include <immintrin.h>
+		#ifdef _MSC_VER
+			#include <intrin.h>
+		#endif
+	#endif
+#endif
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <pthread.h>
+	#include <unistd.h>
+#endif
+
 /*	set this =1 if you want to use the covarince matrix method...
 	which is better than my method of using standard deviations
 	overall, except on the infintesimal chance that the power
@@ -37,6 +57,430 @@ void compress_DDS_color_block(
 void compress_DDS_alpha_block(
 				const unsigned char *const uncompressed,
 				unsigned char compressed[8] );
+/*
+	Takes 16 single channel values, 'stride' bytes apart, and
+	compresses them into an 8 byte BC4 (RGTC1) block.  Unlike the
+	DXT5 alpha block above, every value is rounded to the nearest of
+	the 8 interpolated levels.
+*/
+void compress_BC4_block(
+				const unsigned char *const uncompressed,
+				int stride,
+				unsigned char compressed[8] );
+
+int rgb_to_565( int r, int g, int b );
+void rgb_888_from_565( unsigned int c, int *r, int *g, int *b );
+
+/********* Vectorized Block Encoders *********/
+/*
+	Both encode the color part of several blocks at once, bit-identical
+	to compress_DDS_color_block (see image_DXT_simd.h).  No fused
+	multiply-add is enabled for them: FMA would round differently from
+	the scalar encoder.  The vectorized encoders only implement the
+	covariance matrix method, USE_COV_MAT = 0 always uses the scalar one.
+*/
+#if DXT_HAVE_SSE2 && USE_COV_MAT
+	#define DXT_LANES		4
+	#define DXT_SIMD_NAME(name)	name##_SSE2
+	#define DXT_SIMD_TARGET
+	#define DXT_VF			__m128
+	#define DXT_VSET1		_mm_set1_ps
+	#define DXT_VLOAD		_mm_loadu_ps
+	#define DXT_VSTORE		_mm_storeu_ps
+	#define DXT_VADD		_mm_add_ps
+	#define DXT_VSUB		_mm_sub_ps
+	#define DXT_VMUL		_mm_mul_ps
+	#define DXT_VDIV		_mm_div_ps
+	#define DXT_VMIN		_mm_min_ps
+	#define DXT_VMAX		_mm_max_ps
+	#define DXT_VGREATER	_mm_cmpgt_ps
+	#define DXT_VSELECT(mask,a,b)	_mm_or_ps( _mm_and_ps( mask, a ), _mm_andnot_ps( mask, b ) )
+	#define DXT_VTRUNC(a)	_mm_cvtepi32_ps( _mm_cvttps_epi32( a ) )
+	#define DXT_VTRUNCI		_mm_cvttps_epi32
+	#define DXT_VSTOREI(p,a)	_mm_storeu_si128( (__m128i*)(p), a )
+	#include "image_DXT_simd.h"
+	#undef DXT_LANES
+	#undef DXT_SIMD_NAME
+	#undef DXT_SIMD_TARGET
+	#undef DXT_VF
+	#undef DXT_VSET1
+	#undef DXT_VLOAD
+	#undef DXT_VSTORE
+	#undef DXT_VADD
+	#undef DXT_VSUB
+	#undef DXT_VMUL
+	#undef DXT_VDIV
+	#undef DXT_VMIN
+	#undef DXT_VMAX
+	#undef DXT_VGREATER
+	#undef DXT_VSELECT
+	#undef DXT_VTRUNC
+	#undef DXT_VTRUNCI
+	#undef DXT_VSTOREI
+#endif
+#if DXT_HAVE_AVX && USE_COV_MAT
+	#define DXT_LANES		8
+	#define DXT_SIMD_NAME(name)	name##_AVX
+	#ifdef _MSC_VER
+		#define DXT_SIMD_TARGET
+	#else
+		#define DXT_SIMD_TARGET	__attribute__((target("avx")))
+	#endif
+	#define DXT_VF			__m256
+	#define DXT_VSET1		_mm256_set1_ps
+	#define DXT_VLOAD		_mm256_loadu_ps
+	#define DXT_VSTORE		_mm256_storeu_ps
+	#define DXT_VADD		_mm256_add_ps
+	#define DXT_VSUB		_mm256_sub_ps
+	#define DXT_VMUL		_mm256_mul_ps
+	#define DXT_VDIV		_mm256_div_ps
+	#define DXT_VMIN		_mm256_min_ps
+	#define DXT_VMAX		_mm256_max_ps
+	#define DXT_VGREATER(a,b)	_mm256_cmp_ps( a, b, _CMP_GT_OS )
+	#define DXT_VSELECT(mask,a,b)	_mm256_blendv_ps( b, a, mask )
+	#define DXT_VTRUNC(a)	_mm256_cvtepi32_ps( _mm256_cvttps_epi32( a ) )
+	#define DXT_VTRUNCI		_mm256_cvttps_epi32
+	#define DXT_VSTOREI(p,a)	_mm256_storeu_si256( (__m256i*)(p), a )
+	#include "image_DXT_simd.h"
+	#undef DXT_LANES
+	#undef DXT_SIMD_NAME
+	#undef DXT_SIMD_TARGET
+	#undef DXT_VF
+	#undef DXT_VSET1
+	#undef DXT_VLOAD
+	#undef DXT_VSTORE
+	#undef DXT_VADD
+	#undef DXT_VSUB
+	#undef DXT_VMUL
+	#undef DXT_VDIV
+	#undef DXT_VMIN
+	#undef DXT_VMAX
+	#undef DXT_VGREATER
+	#undef DXT_VSELECT
+	#undef DXT_VTRUNC
+	#undef DXT_VTRUNCI
+	#undef DXT_VSTOREI
+
+static int cpu_has_AVX( void )
+{
+	#ifdef _MSC_VER
+	/*	AVX, and an OS that saves the YMM registers (OSXSAVE and XCR0)	*/
+	int info[4];
+	__cpuid( info, 1 );
+	return ((info[2] & (1 << 28)) != 0) && ((info[2] & (1 << 27)) != 0) &&
+		((_xgetbv( 0 ) & 6) == 6);
+	#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports( "avx" );
+	#endif
+}
+#endif
+
+/********* Threaded Block Row Encoding *********/
+/*	set by set_DXT_encoder / set_DXT_threads	*/
+static int DXT_encoder = DXT_ENCODER_AUTO;
+static int DXT_threads = 0;
+/*	smaller images are not split over threads, starting one would cost more	*/
+#define DXT_BLOCKS_PER_THREAD	1024
+#define DXT_MAX_THREADS			64
+
+/*	the block formats convert_image_to_DXT can produce	*/
+enum
+{
+	DXT_FORMAT_DXT1,
+	DXT_FORMAT_DXT5,
+	DXT_FORMAT_BC4,
+	DXT_FORMAT_BC5
+};
+
+/*	one thread's share of an image: a range of block rows	*/
+typedef struct
+{
+	const unsigned char *uncompressed;
+	int width, height, channels;
+	int format, encoder;
+	int first_row, end_row;
+	unsigned char *compressed;
+} DXT_rows;
+
+static int best_DXT_encoder( void )
+{
+	int best = DXT_ENCODER_SCALAR;
+	#if DXT_HAVE_SSE2 && USE_COV_MAT
+	best = DXT_ENCODER_SSE2;
+	#endif
+	#if DXT_HAVE_AVX && USE_COV_MAT
+	if( cpu_has_AVX() )
+	{
+		best = DXT_ENCODER_AVX;
+	}
+	#endif
+	return best;
+}
+
+static int DXT_cpu_count( void )
+{
+	#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo( &info );
+	return (int)info.dwNumberOfProcessors;
+	#else
+	long count = sysconf( _SC_NPROCESSORS_ONLN );
+	return count > 0 ? (int)count : 1;
+	#endif
+}
+
+/*
+	Copies the 4x4 block with its top left pixel at (i,j) into ublock,
+	as 3 (DXT1) or 4 (DXT5) channel pixels.  Where the block hangs over
+	the edge of the image, its first pixel is repeated.
+*/
+static void gather_DXT_block(
+		const unsigned char *const uncompressed,
+		int width, int height, int channels,
+		int i, int j, int out_channels,
+		unsigned char *ublock )
+{
+	int x, y, c, idx = 0;
+	int mx = 4, my = 4;
+	/*	for channels == 1 or 2, I do not step forward for R,G,B values	*/
+	int chan_step = channels < 3 ? 0 : 1;
+	/*	# channels = 1 or 3 have no alpha, 2 & 4 do have alpha	*/
+	int has_alpha = 1 - (channels & 1);
+	if( j+4 >= height )
+	{
+		my = height - j;
+	}
+	if( i+4 >= width )
+	{
+		mx = width - i;
+	}
+	for( y = 0; y < my; ++y )
+	{
+		for( x = 0; x < mx; ++x )
+		{
+			const unsigned char *pixel = uncompressed + (j+y)*width*channels + (i+x)*channels;
+			ublock[idx++] = pixel[0];
+			ublock[idx++] = pixel[chan_step];
+			ublock[idx++] = pixel[chan_step+chan_step];
+			if( out_channels == 4 )
+			{
+				ublock[idx++] = has_alpha * pixel[channels-1] + (1-has_alpha)*255;
+			}
+		}
+		for( x = mx; x < 4; ++x )
+		{
+			for( c = 0; c < out_channels; ++c )
+			{
+				ublock[idx++] = ublock[c];
+			}
+		}
+	}
+	for( y = my; y < 4; ++y )
+	{
+		for( x = 0; x < 4*out_channels; ++x )
+		{
+			ublock[idx++] = ublock[x % out_channels];
+		}
+	}
+}
+
+static void compress_DXT_rows( const DXT_rows *job )
+{
+	int block_bytes = (job->format == DXT_FORMAT_DXT1 || job->format == DXT_FORMAT_BC4) ? 8 : 16;
+	int out_channels = job->format == DXT_FORMAT_DXT1 ? 3 : 4;
+	int blocks_x = (job->width + 3) >> 2;
+	int lanes = 1, row, bi, n;
+	unsigned char ublocks[8][16*4];
+	unsigned char spare[8][8];
+	const unsigned char *blocks[8];
+	unsigned char *cblocks[8];
+	if( (job->format == DXT_FORMAT_BC4) || (job->format == DXT_FORMAT_BC5) )
+	{
+		/*	no color blocks, nothing to vectorize	*/
+		for( row = job->first_row; row < job->end_row; ++row )
+		{
+			unsigned char *out = job->compressed + (size_t)row * blocks_x * block_bytes;
+			for( bi = 0; bi < blocks_x; ++bi )
+			{
+				gather_DXT_block( job->uncompressed, job->width, job->height, job->channels,
+						bi*4, row*4, 4, ublocks[0] );
+				/*	red, then green for BC5; gathering puts the 2nd channel
+					of a 2 channel image into alpha	*/
+				compress_BC4_block( ublocks[0] + 0, 4, out + bi * block_bytes );
+				if( job->format == DXT_FORMAT_BC5 )
+				{
+					compress_BC4_block( ublocks[0] + (job->channels == 2 ? 3 : 1), 4,
+							out + bi * block_bytes + 8 );
+				}
+			}
+		}
+		return;
+	}
+	if( job->encoder == DXT_ENCODER_AVX )
+	{
+		lanes = 8;
+	} else if( job->encoder == DXT_ENCODER_SSE2 )
+	{
+		lanes = 4;
+	}
+	for( row = job->first_row; row < job->end_row; ++row )
+	{
+		unsigned char *out = job->compressed + (size_t)row * blocks_x * block_bytes;
+		for( bi = 0; bi < blocks_x; bi += lanes )
+		{
+			/*	gather up to 'lanes' blocks of the row; the lanes past the
+				end of the row encode a copy of the first block into 'spare'	*/
+			for( n = 0; n < lanes; ++n )
+			{
+				unsigned char *cblock = out + (bi+n) * block_bytes;
+				if( bi+n >= blocks_x )
+				{
+					blocks[n] = ublocks[0];
+					cblocks[n] = spare[n];
+					continue;
+				}
+				gather_DXT_block( job->uncompressed, job->width, job->height, job->channels,
+						(bi+n)*4, row*4, out_channels, ublocks[n] );
+				if( job->format == DXT_FORMAT_DXT5 )
+				{
+					/*	the alpha block comes first, it stays scalar	*/
+					compress_DDS_alpha_block( ublocks[n], cblock );
+					cblock += 8;
+				}
+				blocks[n] = ublocks[n];
+				cblocks[n] = cblock;
+			}
+			switch( job->encoder )
+			{
+			#if DXT_HAVE_AVX && USE_COV_MAT
+			case DXT_ENCODER_AVX:
+				compress_DDS_color_blocks_AVX( out_channels, blocks, cblocks );
+				break;
+			#endif
+			#if DXT_HAVE_SSE2 && USE_COV_MAT
+			case DXT_ENCODER_SSE2:
+				compress_DDS_color_blocks_SSE2( out_channels, blocks, cblocks );
+				break;
+			#endif
+			default:
+				compress_DDS_color_block( out_channels, blocks[0], cblocks[0] );
+				break;
+			}
+		}
+	}
+}
+
+#ifdef _WIN32
+static DWORD WINAPI DXT_thread( LPVOID job )
+{
+	compress_DXT_rows( (const DXT_rows*)job );
+	return 0;
+}
+#else
+static void* DXT_thread( void *job )
+{
+	compress_DXT_rows( (const DXT_rows*)job );
+	return NULL;
+}
+#endif
+
+/*
+	Compresses to one of the DXT_FORMATs, with the block rows spread
+	evenly over the threads.  The calling thread encodes the first
+	share itself.
+*/
+static unsigned char* convert_image_to_DXT(
+		const unsigned char *const uncompressed,
+		int width, int height, int channels,
+		int format, int *out_size )
+{
+	DXT_rows jobs[DXT_MAX_THREADS];
+	#ifdef _WIN32
+	HANDLE handles[DXT_MAX_THREADS];
+	#else
+	pthread_t handles[DXT_MAX_THREADS];
+	#endif
+	int started[DXT_MAX_THREADS];
+	unsigned char *compressed;
+	int rows, blocks, block_bytes, threads, encoder, t;
+	/*	error check	*/
+	*out_size = 0;
+	if( (width < 1) || (height < 1) ||
+		(NULL == uncompressed) ||
+		(channels < 1) || (channels > 4) )
+	{
+		return NULL;
+	}
+	/*	get the RAM for the compressed image
+		(8 or 16 bytes per 4x4 pixel block)	*/
+	rows = (height+3) >> 2;
+	blocks = rows * ((width+3) >> 2);
+	block_bytes = (format == DXT_FORMAT_DXT1 || format == DXT_FORMAT_BC4) ? 8 : 16;
+	compressed = (unsigned char*)malloc( blocks * block_bytes );
+	if( NULL == compressed )
+	{
+		return NULL;
+	}
+	*out_size = blocks * block_bytes;
+	/*	how many threads are worth it	*/
+	threads = DXT_threads > 0 ? DXT_threads : DXT_cpu_count();
+	if( threads > blocks / DXT_BLOCKS_PER_THREAD )
+	{
+		threads = blocks / DXT_BLOCKS_PER_THREAD;
+	}
+	if( threads > rows )
+	{
+		threads = rows;
+	}
+	if( threads > DXT_MAX_THREADS )
+	{
+		threads = DXT_MAX_THREADS;
+	}
+	if( threads < 1 )
+	{
+		threads = 1;
+	}
+	encoder = DXT_encoder == DXT_ENCODER_AUTO ? best_DXT_encoder() : DXT_encoder;
+	for( t = 0; t < threads; ++t )
+	{
+		jobs[t].uncompressed = uncompressed;
+		jobs[t].width = width;
+		jobs[t].height = height;
+		jobs[t].channels = channels;
+		jobs[t].format = format;
+		jobs[t].encoder = encoder;
+		jobs[t].first_row = rows * t / threads;
+		jobs[t].end_row = rows * (t+1) / threads;
+		jobs[t].compressed = compressed;
+	}
+	for( t = 1; t < threads; ++t )
+	{
+		#ifdef _WIN32
+		handles[t] = CreateThread( NULL, 0, DXT_thread, &jobs[t], 0, NULL );
+		started[t] = handles[t] != NULL;
+		#else
+		started[t] = pthread_create( &handles[t], NULL, DXT_thread, &jobs[t] ) == 0;
+		#endif
+	}
+	compress_DXT_rows( &jobs[0] );
+	for( t = 1; t < threads; ++t )
+	{
+		if( !started[t] )
+		{
+			/*	no thread for this share, do it here	*/
+			compress_DXT_rows( &jobs[t] );
+			continue;
+		}
+		#ifdef _WIN32
+		WaitForSingleObject( handles[t], INFINITE );
+		CloseHandle( handles[t] );
+		#else
+		pthread_join( handles[t], NULL );
+		#endif
+	}
+	return compressed;
+}
 
 /********* Actual Exposed Functions *********/
 int
@@ -103,80 +547,7 @@ unsigned char* convert_image_to_DXT1(
 		int width, int height, int channels,
 		int *out_size )
 {
-	unsigned char *compressed;
-	int i, j, x, y;
-	unsigned char ublock[16*3];
-	unsigned char cblock[8];
-	int index = 0, chan_step = 1;
-	int block_count = 0;
-	/*	error check	*/
-	*out_size = 0;
-	if( (width < 1) || (height < 1) ||
-		(NULL == uncompressed) ||
-		(channels < 1) || (channels > 4) )
-	{
-		return NULL;
-	}
-	/*	for channels == 1 or 2, I do not step forward for R,G,B values	*/
-	if( channels < 3 )
-	{
-		chan_step = 0;
-	}
-	/*	get the RAM for the compressed image
-		(8 bytes per 4x4 pixel block)	*/
-	*out_size = ((width+3) >> 2) * ((height+3) >> 2) * 8;
-	compressed = (unsigned char*)malloc( *out_size );
-	/*	go through each block	*/
-	for( j = 0; j < height; j += 4 )
-	{
-		for( i = 0; i < width; i += 4 )
-		{
-			/*	copy this block into a new one	*/
-			int idx = 0;
-			int mx = 4, my = 4;
-			if( j+4 >= height )
-			{
-				my = height - j;
-			}
-			if( i+4 >= width )
-			{
-				mx = width - i;
-			}
-			for( y = 0; y < my; ++y )
-			{
-				for( x = 0; x < mx; ++x )
-				{
-					ublock[idx++] = uncompressed[(j+y)*width*channels+(i+x)*channels];
-					ublock[idx++] = uncompressed[(j+y)*width*channels+(i+x)*channels+chan_step];
-					ublock[idx++] = uncompressed[(j+y)*width*channels+(i+x)*channels+chan_step+chan_step];
-				}
-				for( x = mx; x < 4; ++x )
-				{
-					ublock[idx++] = ublock[0];
-					ublock[idx++] = ublock[1];
-					ublock[idx++] = ublock[2];
-				}
-			}
-			for( y = my; y < 4; ++y )
-			{
-				for( x = 0; x < 4; ++x )
-				{
-					ublock[idx++] = ublock[0];
-					ublock[idx++] = ublock[1];
-					ublock[idx++] = ublock[2];
-				}
-			}
-			/*	compress the block	*/
-			++block_count;
-			compress_DDS_color_block( 3, ublock, cblock );
-			/*	copy the data from the block into the main block	*/
-			for( x = 0; x < 8; ++x )
-			{
-				compressed[index++] = cblock[x];
-			}
-		}
-	}
-	return compressed;
+	return convert_image_to_DXT( uncompressed, width, height, channels, DXT_FORMAT_DXT1, out_size );
 }
 
 unsigned char* convert_image_to_DXT5(
@@ -184,94 +555,38 @@ unsigned char* convert_image_to_DXT5(
 		int width, int height, int channels,
 		int *out_size )
 {
-	unsigned char *compressed;
-	int i, j, x, y;
-	unsigned char ublock[16*4];
-	unsigned char cblock[8];
-	int index = 0, chan_step = 1;
-	int block_count = 0, has_alpha;
-	/*	error check	*/
-	*out_size = 0;
-	if( (width < 1) || (height < 1) ||
-		(NULL == uncompressed) ||
-		(channels < 1) || ( channels > 4) )
-	{
-		return NULL;
-	}
-	/*	for channels == 1 or 2, I do not step forward for R,G,B vales	*/
-	if( channels < 3 )
+	return convert_image_to_DXT( uncompressed, width, height, channels, DXT_FORMAT_DXT5, out_size );
+}
+
+unsigned char* convert_image_to_BC4(
+		const unsigned char *const uncompressed,
+		int width, int height, int channels,
+		int *out_size )
+{
+	return convert_image_to_DXT( uncompressed, width, height, channels, DXT_FORMAT_BC4, out_size );
+}
+
+unsigned char* convert_image_to_BC5(
+		const unsigned char *const uncompressed,
+		int width, int height, int channels,
+		int *out_size )
+{
+	return convert_image_to_DXT( uncompressed, width, height, channels, DXT_FORMAT_BC5, out_size );
+}
+
+int set_DXT_encoder( int encoder )
+{
+	if( (encoder == DXT_ENCODER_AUTO) || (encoder > best_DXT_encoder()) )
 	{
-		chan_step = 0;
+		encoder = best_DXT_encoder();
 	}
-	/*	# channels = 1 or 3 have no alpha, 2 & 4 do have alpha	*/
-	has_alpha = 1 - (channels & 1);
-	/*	get the RAM for the compressed image
-		(16 bytes per 4x4 pixel block)	*/
-	*out_size = ((width+3) >> 2) * ((height+3) >> 2) * 16;
-	compressed = (unsigned char*)malloc( *out_size );
-	/*	go through each block	*/
-	for( j = 0; j < height; j += 4 )
-	{
-		for( i = 0; i < width; i += 4 )
-		{
-			/*	local variables, and my block counter	*/
-			int idx = 0;
-			int mx = 4, my = 4;
-			if( j+4 >= height )
-			{
-				my = height - j;
-			}
-			if( i+4 >= width )
-			{
-				mx = width - i;
-			}
-			for( y = 0; y < my; ++y )
-			{
-				for( x = 0; x < mx; ++x )
-				{
-					ublock[idx++] = uncompressed[(j+y)*width*channels+(i+x)*channels];
-					ublock[idx++] = uncompressed[(j+y)*width*channels+(i+x)*channels+chan_step];
-					ublock[idx++] = uncompressed[(j+y)*width*channels+(i+x)*channels+chan_step+chan_step];
-					ublock[idx++] =
-						has_alpha * uncompressed[(j+y)*width*channels+(i+x)*channels+channels-1]
-						+ (1-has_alpha)*255;
-				}
-				for( x = mx; x < 4; ++x )
-				{
-					ublock[idx++] = ublock[0];
-					ublock[idx++] = ublock[1];
-					ublock[idx++] = ublock[2];
-					ublock[idx++] = ublock[3];
-				}
-			}
-			for( y = my; y < 4; ++y )
-			{
-				for( x = 0; x < 4; ++x )
-				{
-					ublock[idx++] = ublock[0];
-					ublock[idx++] = ublock[1];
-					ublock[idx++] = ublock[2];
-					ublock[idx++] = ublock[3];
-				}
-			}
-			/*	now compress the alpha block	*/
-			compress_DDS_alpha_block( ublock, cblock );
-			/*	copy the data from the compressed alpha block into the main buffer	*/
-			for( x = 0; x < 8; ++x )
-			{
-				compressed[index++] = cblock[x];
-			}
-			/*	then compress the color block	*/
-			++block_count;
-			compress_DDS_color_block( 4, ublock, cblock );
-			/*	copy the data from the compressed color block into the main buffer	*/
-			for( x = 0; x < 8; ++x )
-			{
-				compressed[index++] = cblock[x];
-			}
-		}
-	}
-	return compressed;
+	DXT_encoder = encoder;
+	return encoder;
+}
+
+void set_DXT_threads( int threads )
+{
+	DXT_threads = threads < 0 ? 0 : threads;
 }
 
 /********* Helper Functions *********/
@@ -630,3 +945,60 @@ void
 	}
 	/*	done compressing to DXT1	*/
 }
+
+void
+	compress_BC4_block
+	(
+		const unsigned char *const uncompressed,
+		int stride,
+		unsigned char compressed[8]
+	)
+{
+	/*	variables	*/
+	int i;
+	int next_bit;
+	int a0, a1, range;
+	/*	stupid order (the same as for DXT5 alpha)	*/
+	int swizzle8[] = { 1, 7, 6, 5, 4, 3, 2, 0 };
+	/*	get the limits (a0 >= a1, which selects the 8 level mode
+		unless they are equal, where every index decodes to a0)	*/
+	a0 = a1 = uncompressed[0];
+	for( i = 1; i < 16; ++i )
+	{
+		if( uncompressed[i*stride] > a0 )
+		{
+			a0 = uncompressed[i*stride];
+		} else if( uncompressed[i*stride] < a1 )
+		{
+			a1 = uncompressed[i*stride];
+		}
+	}
+	compressed[0] = a0;
+	compressed[1] = a1;
+	compressed[2] = 0;
+	compressed[3] = 0;
+	compressed[4] = 0;
+	compressed[5] = 0;
+	compressed[6] = 0;
+	compressed[7] = 0;
+	range = a0 - a1;
+	if( range == 0 )
+	{
+		return;
+	}
+	/*	the levels are evenly spaced from a1 (0) to a0 (7), so the
+		nearest one is the rounded position along the range	*/
+	next_bit = 8*2;
+	for( i = 0; i < 16; ++i )
+	{
+		int value = ((uncompressed[i*stride] - a1) * 14 + range) / (2 * range);
+		int svalue = swizzle8[ value ];
+		compressed[next_bit >> 3] |= svalue << (next_bit & 7);
+		if( (next_bit & 7) > 5 )
+		{
+			/*	spans 2 bytes, fill in the start of the 2nd byte	*/
+			compressed[1 + (next_bit >> 3)] |= svalue >> (8 - (next_bit & 7) );
+		}
+		next_bit += 3;
+	}
+}
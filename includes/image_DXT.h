@@ -10,6 +10,10 @@
 #ifndef HEADER_IMAGE_DXT
 #define HEADER_IMAGE_DXT
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /**
 	Converts an image from an array of unsigned chars (RGB or RGBA) to
 	DXT1 or DXT5, then saves the converted image to disk.
@@ -45,6 +49,64 @@ convert_image_to_DXT5
     int *out_size
 );
 
+/**
+	take an image and convert its first channel to BC4 (RGTC1, one channel)
+**/
+unsigned char*
+convert_image_to_BC4
+(
+    const unsigned char *const uncompressed,
+    int width, int height, int channels,
+    int *out_size
+);
+
+/**
+	take an image and convert its first two channels to BC5 (RGTC2, two
+	channels), e.g. the X and Y of a tangent space normal map
+**/
+unsigned char*
+convert_image_to_BC5
+(
+    const unsigned char *const uncompressed,
+    int width, int height, int channels,
+    int *out_size
+);
+
+/**
+	The block encoder used by convert_image_to_DXT1 / DXT5.  All of them
+	produce the same bytes, the vectorized ones just do it 4 (SSE2) or 8
+	(AVX) blocks at a time.  AUTO picks the fastest one the CPU supports.
+**/
+enum
+{
+    DXT_ENCODER_AUTO = 0,
+    DXT_ENCODER_SCALAR = 1,
+    DXT_ENCODER_SSE2 = 2,
+    DXT_ENCODER_AVX = 3
+};
+
+/**
+	Selects the block encoder; one the CPU can't run falls back to the
+	fastest one it can.  Not thread safe, set it before compressing.
+	\return the encoder that will be used
+**/
+int
+set_DXT_encoder
+(
+    int encoder
+);
+
+/**
+	Sets how many threads convert_image_to_DXT1 / DXT5 split an image's
+	block rows over; 0 (the default) uses one per CPU core.  Small images
+	are always compressed on fewer threads.  Not thread safe either.
+**/
+void
+set_DXT_threads
+(
+    int threads
+);
+
 /**	A bunch of DirectDraw Surface structures and flags **/
 typedef struct
 {
@@ -120,4 +182,8 @@ DDS_header ;
 #define DDSCAPS2_CUBEMAP_NEGATIVEZ	0x00008000
 #define DDSCAPS2_VOLUME	0x00200000
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* HEADER_IMAGE_DXT	*/
@@ -0,0 +1,174 @@
+/*
+	vectorized DXT color block encoder
+
+	Included by image_DXT.c once per instruction set, with the DXT_V*
+	macros defined for it: DXT_LANES blocks are encoded at once, lane n
+	of every vector working on block n.  Each lane performs the very
+	same single precision operations, in the same order, as the scalar
+	compute_color_line_STDEV / LSE_master_colors_max_min /
+	compress_DDS_color_block, so the output is bit-identical to theirs.
+	Only the integer steps (565 conversion, bit packing) stay scalar.
+
+	public domain
+*/
+
+static DXT_SIMD_TARGET void DXT_SIMD_NAME(compress_DDS_color_blocks)
+	(
+		int channels,
+		const unsigned char *const uncompressed[DXT_LANES],
+		unsigned char *const compressed[DXT_LANES]
+	)
+{
+	/*	the blocks, channel by channel, pixel by pixel, lane by lane	*/
+	float pixels[3][16][DXT_LANES];
+	/*	per lane results moving between the vector and the scalar steps	*/
+	float master[2][3][DXT_LANES];
+	float line[3][DXT_LANES];
+	int ints[16][DXT_LANES];
+	/*	stupid order	*/
+	int swizzle4[] = { 0, 2, 3, 1 };
+	const DXT_VF zero = DXT_VSET1( 0.0f );
+	const DXT_VF one = DXT_VSET1( 1.0f );
+	const DXT_VF half = DXT_VSET1( 0.5f );
+	const DXT_VF three = DXT_VSET1( 3.0f );
+	const DXT_VF max_color = DXT_VSET1( 255.0f );
+	DXT_VF sum_r = zero, sum_g = zero, sum_b = zero;
+	DXT_VF sum_rr = zero, sum_gg = zero, sum_bb = zero;
+	DXT_VF sum_rg = zero, sum_rb = zero, sum_gb = zero;
+	DXT_VF dir_r, dir_g, dir_b, next_r, next_g, next_b;
+	DXT_VF r, g, b, dot, dot_min, dot_max, vec_len2;
+	int i, k, n;
+	for( i = 0; i < 16; ++i )
+	{
+		for( n = 0; n < DXT_LANES; ++n )
+		{
+			pixels[0][i][n] = uncompressed[n][i*channels+0];
+			pixels[1][i][n] = uncompressed[n][i*channels+1];
+			pixels[2][i][n] = uncompressed[n][i*channels+2];
+		}
+	}
+	/*	compute_color_line_STDEV: the sums are of integers below 2^24,
+		so they are exact whatever the order they are added in	*/
+	for( i = 0; i < 16; ++i )
+	{
+		r = DXT_VLOAD( pixels[0][i] );
+		g = DXT_VLOAD( pixels[1][i] );
+		b = DXT_VLOAD( pixels[2][i] );
+		sum_r = DXT_VADD( sum_r, r );
+		sum_rr = DXT_VADD( sum_rr, DXT_VMUL( r, r ) );
+		sum_g = DXT_VADD( sum_g, g );
+		sum_gg = DXT_VADD( sum_gg, DXT_VMUL( g, g ) );
+		sum_b = DXT_VADD( sum_b, b );
+		sum_bb = DXT_VADD( sum_bb, DXT_VMUL( b, b ) );
+		sum_rg = DXT_VADD( sum_rg, DXT_VMUL( r, g ) );
+		sum_rb = DXT_VADD( sum_rb, DXT_VMUL( r, b ) );
+		sum_gb = DXT_VADD( sum_gb, DXT_VMUL( g, b ) );
+	}
+	sum_r = DXT_VMUL( sum_r, DXT_VSET1( 1.0f / 16.0f ) );
+	sum_g = DXT_VMUL( sum_g, DXT_VSET1( 1.0f / 16.0f ) );
+	sum_b = DXT_VMUL( sum_b, DXT_VSET1( 1.0f / 16.0f ) );
+	sum_rr = DXT_VSUB( sum_rr, DXT_VMUL( DXT_VMUL( DXT_VSET1( 16.0f ), sum_r ), sum_r ) );
+	sum_gg = DXT_VSUB( sum_gg, DXT_VMUL( DXT_VMUL( DXT_VSET1( 16.0f ), sum_g ), sum_g ) );
+	sum_bb = DXT_VSUB( sum_bb, DXT_VMUL( DXT_VMUL( DXT_VSET1( 16.0f ), sum_b ), sum_b ) );
+	sum_rg = DXT_VSUB( sum_rg, DXT_VMUL( DXT_VMUL( DXT_VSET1( 16.0f ), sum_r ), sum_g ) );
+	sum_rb = DXT_VSUB( sum_rb, DXT_VMUL( DXT_VMUL( DXT_VSET1( 16.0f ), sum_r ), sum_b ) );
+	sum_gb = DXT_VSUB( sum_gb, DXT_VMUL( DXT_VMUL( DXT_VSET1( 16.0f ), sum_g ), sum_b ) );
+	/*	three power iterations on the covariance matrix	*/
+	dir_r = one;
+	dir_g = DXT_VSET1( 2.718281828f );
+	dir_b = DXT_VSET1( 3.141592654f );
+	for( k = 0; k < 3; ++k )
+	{
+		next_r = DXT_VADD( DXT_VADD( DXT_VMUL( dir_r, sum_rr ), DXT_VMUL( dir_g, sum_rg ) ), DXT_VMUL( dir_b, sum_rb ) );
+		next_g = DXT_VADD( DXT_VADD( DXT_VMUL( dir_r, sum_rg ), DXT_VMUL( dir_g, sum_gg ) ), DXT_VMUL( dir_b, sum_gb ) );
+		next_b = DXT_VADD( DXT_VADD( DXT_VMUL( dir_r, sum_rb ), DXT_VMUL( dir_g, sum_gb ) ), DXT_VMUL( dir_b, sum_bb ) );
+		dir_r = next_r;
+		dir_g = next_g;
+		dir_b = next_b;
+	}
+	/*	LSE_master_colors_max_min	*/
+	vec_len2 = DXT_VDIV( one, DXT_VADD( DXT_VADD( DXT_VADD( DXT_VSET1( 0.00001f ),
+			DXT_VMUL( dir_r, dir_r ) ), DXT_VMUL( dir_g, dir_g ) ), DXT_VMUL( dir_b, dir_b ) ) );
+	#define DXT_DOT_PIXEL(i) \
+		DXT_VADD( DXT_VADD( \
+			DXT_VMUL( dir_r, DXT_VLOAD( pixels[0][i] ) ), \
+			DXT_VMUL( dir_g, DXT_VLOAD( pixels[1][i] ) ) ), \
+			DXT_VMUL( dir_b, DXT_VLOAD( pixels[2][i] ) ) )
+	dot_min = dot_max = DXT_DOT_PIXEL( 0 );
+	for( i = 1; i < 16; ++i )
+	{
+		dot = DXT_DOT_PIXEL( i );
+		/*	min/max pick their 1st operand only if the comparison holds,
+			just like the "if( dot < dot_min )" of the scalar code	*/
+		dot_min = DXT_VMIN( dot, dot_min );
+		dot_max = DXT_VMAX( dot, dot_max );
+	}
+	dot = DXT_VADD( DXT_VADD( DXT_VMUL( dir_r, sum_r ), DXT_VMUL( dir_g, sum_g ) ), DXT_VMUL( dir_b, sum_b ) );
+	dot_min = DXT_VMUL( DXT_VSUB( dot_min, dot ), vec_len2 );
+	dot_max = DXT_VMUL( DXT_VSUB( dot_max, dot ), vec_len2 );
+	/*	(int) and clamping to [0,255] is the same as clamping first, then truncating	*/
+	#define DXT_MASTER_COLOR(avg,dir,d) \
+		DXT_VMIN( DXT_VMAX( DXT_VADD( DXT_VADD( half, avg ), DXT_VMUL( d, dir ) ), zero ), max_color )
+	DXT_VSTORE( master[0][0], DXT_VTRUNC( DXT_MASTER_COLOR( sum_r, dir_r, dot_max ) ) );
+	DXT_VSTORE( master[0][1], DXT_VTRUNC( DXT_MASTER_COLOR( sum_g, dir_g, dot_max ) ) );
+	DXT_VSTORE( master[0][2], DXT_VTRUNC( DXT_MASTER_COLOR( sum_b, dir_b, dot_max ) ) );
+	DXT_VSTORE( master[1][0], DXT_VTRUNC( DXT_MASTER_COLOR( sum_r, dir_r, dot_min ) ) );
+	DXT_VSTORE( master[1][1], DXT_VTRUNC( DXT_MASTER_COLOR( sum_g, dir_g, dot_min ) ) );
+	DXT_VSTORE( master[1][2], DXT_VTRUNC( DXT_MASTER_COLOR( sum_b, dir_b, dot_min ) ) );
+	#undef DXT_MASTER_COLOR
+	/*	down sample to 565, order and store the master colors,
+		then reconstitute them (scalar integer work)	*/
+	for( n = 0; n < DXT_LANES; ++n )
+	{
+		int enc_c0, enc_c1, c0[3], c1[3];
+		i = rgb_to_565( (int)master[0][0][n], (int)master[0][1][n], (int)master[0][2][n] );
+		k = rgb_to_565( (int)master[1][0][n], (int)master[1][1][n], (int)master[1][2][n] );
+		enc_c0 = i > k ? i : k;
+		enc_c1 = i > k ? k : i;
+		compressed[n][0] = (enc_c0 >> 0) & 255;
+		compressed[n][1] = (enc_c0 >> 8) & 255;
+		compressed[n][2] = (enc_c1 >> 0) & 255;
+		compressed[n][3] = (enc_c1 >> 8) & 255;
+		rgb_888_from_565( enc_c0, &c0[0], &c0[1], &c0[2] );
+		rgb_888_from_565( enc_c1, &c1[0], &c1[1], &c1[2] );
+		for( k = 0; k < 3; ++k )
+		{
+			master[0][k][n] = (float)c0[k];
+			line[k][n] = (float)(c1[k] - c0[k]);
+		}
+	}
+	/*	compress_DDS_color_block: the line between the master colors	*/
+	dir_r = DXT_VLOAD( line[0] );
+	dir_g = DXT_VLOAD( line[1] );
+	dir_b = DXT_VLOAD( line[2] );
+	vec_len2 = DXT_VADD( DXT_VADD( DXT_VADD( zero, DXT_VMUL( dir_r, dir_r ) ), DXT_VMUL( dir_g, dir_g ) ), DXT_VMUL( dir_b, dir_b ) );
+	vec_len2 = DXT_VSELECT( DXT_VGREATER( vec_len2, zero ), DXT_VDIV( one, vec_len2 ), vec_len2 );
+	dir_r = DXT_VMUL( dir_r, vec_len2 );
+	dir_g = DXT_VMUL( dir_g, vec_len2 );
+	dir_b = DXT_VMUL( dir_b, vec_len2 );
+	dot = DXT_VADD( DXT_VADD(
+			DXT_VMUL( dir_r, DXT_VLOAD( master[0][0] ) ),
+			DXT_VMUL( dir_g, DXT_VLOAD( master[0][1] ) ) ),
+			DXT_VMUL( dir_b, DXT_VLOAD( master[0][2] ) ) );
+	/*	place every pixel on the line, mapped to [0,3]	*/
+	for( i = 0; i < 16; ++i )
+	{
+		DXT_VF value = DXT_VSUB( DXT_DOT_PIXEL( i ), dot );
+		value = DXT_VADD( DXT_VMUL( value, three ), half );
+		DXT_VSTOREI( ints[i], DXT_VTRUNCI( DXT_VMIN( DXT_VMAX( value, zero ), three ) ) );
+	}
+	#undef DXT_DOT_PIXEL
+	/*	and pack the indices	*/
+	for( n = 0; n < DXT_LANES; ++n )
+	{
+		unsigned int bits = 0;
+		for( i = 0; i < 16; ++i )
+		{
+			bits |= (unsigned int)swizzle4[ ints[i][n] ] << (2 * i);
+		}
+		compressed[n][4] = (bits >> 0) & 255;
+		compressed[n][5] = (bits >> 8) & 255;
+		compressed[n][6] = (bits >> 16) & 255;
+		compressed[n][7] = (bits >> 24) & 255;
+	}
+}
@@ -8,7 +8,20 @@
 
 #include "image_helper.h"
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+	#define MIP_HAVE_SSE2 1
+	#include <emmintrin.h>
+#else
+	#define MIP_HAVE_SSE2 0
+#endif
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <pthread.h>
+	#include <unistd.h>
+#endif
 
 /*	Upscaling the image uses simple bilinear interpolation	*/
 int
@@ -151,6 +164,720 @@ int
 	return 1;
 }
 
+/********* Filtered Mip Chains *********/
+/*	set by set_mipmap_threads	*/
+static int mip_threads = 0;
+/*	levels smaller than this (in pixels per thread) are not split over threads	*/
+#define MIP_PIXELS_PER_THREAD	16384
+#define MIP_MAX_THREADS			64
+#define MIP_PI					3.14159265358979
+#define MIP_SRGB_CODES			4096
+#define MIP_COVERAGE_BINS		4096
+/*	colors are weighted by alpha plus this, so that fully transparent
+	areas still average their own colors instead of turning black	*/
+#define MIP_ALPHA_BIAS			(1.0f / 1024.0f)
+
+/*	the two passes every level is made in	*/
+enum
+{
+	MIP_PASS_FILTER,
+	MIP_PASS_STORE
+};
+
+/*	which source pixels (rows or columns) make up each destination one	*/
+typedef struct
+{
+	int *first;			/*	first source index of every destination index	*/
+	float *weights;		/*	'taps' weights for every destination index	*/
+	int taps;
+} mip_filter_table;
+
+/*	one thread's share of a level: a range of destination rows	*/
+typedef struct
+{
+	int pass;
+	const float *src;
+	/*	the first level reads the 8 bit top level instead of src,
+		converting the rows it needs into a ring of vertical->taps rows	*/
+	const unsigned char *top;
+	const float *to_linear;
+	float *cache;
+	int *cache_rows;			/*	the source row in each slot of the ring	*/
+	const float **taps;			/*	the vertical->taps source rows being filtered	*/
+	int src_width, src_height, channels;
+	float *dst;
+	int dst_width, dst_height;
+	const mip_filter_table *horizontal;
+	const mip_filter_table *vertical;
+	float *row;					/*	scratch, src_width * channels + 1 floats	*/
+	unsigned char *out;			/*	the 8 bit level, for MIP_PASS_STORE	*/
+	int flags;
+	float alpha_scale;
+	const float *srgb_bounds;	/*	linear values halfway between the sRGB codes	*/
+	const unsigned char *srgb_codes;	/*	MIP_SRGB_CODES sRGB codes over linear [0,1]	*/
+	int first_row, end_row;
+} mip_rows;
+
+static int mip_cpu_count( void )
+{
+	#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo( &info );
+	return (int)info.dwNumberOfProcessors;
+	#else
+	long count = sysconf( _SC_NPROCESSORS_ONLN );
+	return count > 0 ? (int)count : 1;
+	#endif
+}
+
+static float srgb_to_linear( float c )
+{
+	return c <= 0.04045f ? c / 12.92f : (float)pow( (c + 0.055) / 1.055, 2.4 );
+}
+
+static double mip_sinc( double x )
+{
+	if( fabs( x ) < 1e-6 )
+	{
+		return 1.0;
+	}
+	x *= MIP_PI;
+	return sin( x ) / x;
+}
+
+/*	modified Bessel function of the first kind, order 0	*/
+static double mip_bessel_I0( double x )
+{
+	double sum = 1.0, term = 1.0;
+	int k;
+	for( k = 1; k < 64 && term > sum * 1e-9; ++k )
+	{
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+	}
+	return sum;
+}
+
+/*	the kernels, x in destination pixels; both are 3 pixels wide,
+	Kaiser windowed with alpha = 4	*/
+static double mip_kernel( int filter, double x )
+{
+	x = fabs( x );
+	if( x >= 3.0 )
+	{
+		return 0.0;
+	}
+	if( filter == MIPMAP_FILTER_LANCZOS )
+	{
+		return mip_sinc( x ) * mip_sinc( x / 3.0 );
+	}
+	return mip_sinc( x ) * mip_bessel_I0( 4.0 * sqrt( 1.0 - (x / 3.0) * (x / 3.0) ) ) / mip_bessel_I0( 4.0 );
+}
+
+/*	drops the taps that are zero for every destination pixel	*/
+static int trim_mip_filter_table( mip_filter_table *table, int src_size, int dst_size )
+{
+	float *weights;
+	int i, k, taps = 1;
+	for( i = 0; i < dst_size; ++i )
+	{
+		const float *w = table->weights + i * table->taps;
+		int lo = 0, hi = table->taps - 1;
+		while( (lo < hi) && (w[lo] == 0.0f) ) { ++lo; }
+		while( (hi > lo) && (w[hi] == 0.0f) ) { --hi; }
+		if( hi - lo + 1 > taps )
+		{
+			taps = hi - lo + 1;
+		}
+	}
+	if( taps == table->taps )
+	{
+		return 1;
+	}
+	weights = (float*)calloc( dst_size * taps, sizeof(float) );
+	if( NULL == weights )
+	{
+		return 0;
+	}
+	for( i = 0; i < dst_size; ++i )
+	{
+		const float *w = table->weights + i * table->taps;
+		int lo = 0, first;
+		while( (lo < table->taps - 1) && (w[lo] == 0.0f) ) { ++lo; }
+		first = table->first[i] + lo;
+		if( first > src_size - taps )
+		{
+			first = src_size - taps;
+		}
+		/*	the old window shifted to start at first, zeros outside it	*/
+		for( k = 0; k < taps; ++k )
+		{
+			int old = first + k - table->first[i];
+			weights[i * taps + k] = (old >= 0) && (old < table->taps) ? w[old] : 0.0f;
+		}
+		table->first[i] = first;
+	}
+	free( table->weights );
+	table->weights = weights;
+	table->taps = taps;
+	return 1;
+}
+
+/*
+	Works out the weights that resample src_size pixels to dst_size.
+	Taps beyond the image edge are folded onto the edge pixel, and the
+	weights of every destination pixel add up to 1.
+*/
+static int make_mip_filter_table( mip_filter_table *table, int filter, int src_size, int dst_size )
+{
+	double scale = (double)src_size / dst_size;
+	double radius = (filter == MIPMAP_FILTER_BOX ? 0.5 : 3.0) * scale;
+	int i, k;
+	table->taps = (int)ceil( 2.0 * radius ) + 3;
+	if( table->taps > src_size )
+	{
+		table->taps = src_size;
+	}
+	table->first = (int*)malloc( dst_size * sizeof(int) );
+	table->weights = (float*)calloc( dst_size * table->taps, sizeof(float) );
+	if( (NULL == table->first) || (NULL == table->weights) )
+	{
+		return 0;
+	}
+	for( i = 0; i < dst_size; ++i )
+	{
+		double center = (i + 0.5) * scale;
+		int lo = (int)floor( center - radius );
+		int hi = (int)ceil( center + radius );
+		int first = lo < 0 ? 0 : lo;
+		float *weights = table->weights + i * table->taps;
+		double sum = 0.0;
+		if( first > src_size - table->taps )
+		{
+			first = src_size - table->taps;
+		}
+		table->first[i] = first;
+		for( k = lo; k <= hi; ++k )
+		{
+			double w;
+			int index = k < 0 ? 0 : (k >= src_size ? src_size - 1 : k);
+			if( filter == MIPMAP_FILTER_BOX )
+			{
+				/*	the part of source pixel k the destination pixel covers	*/
+				double a = k > center - radius ? k : center - radius;
+				double b = k + 1 < center + radius ? k + 1 : center + radius;
+				w = b > a ? b - a : 0.0;
+			} else
+			{
+				w = mip_kernel( filter, (k + 0.5 - center) / scale );
+			}
+			weights[index - first] += (float)w;
+			sum += w;
+		}
+		if( sum != 0.0 )
+		{
+			for( k = 0; k < table->taps; ++k )
+			{
+				weights[k] = (float)(weights[k] / sum);
+			}
+		}
+	}
+	return trim_mip_filter_table( table, src_size, dst_size );
+}
+
+static void free_mip_filter_table( mip_filter_table *table )
+{
+	free( table->first );
+	free( table->weights );
+}
+
+/*	a row of the top level in linear space, colors premultiplied	*/
+static void convert_mip_row( const mip_rows *job, int y, float *row )
+{
+	const int channels = job->channels;
+	const unsigned char *pixel = job->top + (size_t)y * job->src_width * channels;
+	int x, c;
+	for( x = 0; x < job->src_width; ++x, pixel += channels, row += channels )
+	{
+		if( job->flags & MIPMAP_ALPHA )
+		{
+			float weight = pixel[channels - 1] / 255.0f + MIP_ALPHA_BIAS;
+			for( c = 0; c < channels - 1; ++c )
+			{
+				row[c] = job->to_linear[pixel[c]] * weight;
+			}
+			row[channels - 1] = pixel[channels - 1] / 255.0f;
+		} else
+		{
+			for( c = 0; c < channels; ++c )
+			{
+				row[c] = job->to_linear[pixel[c]];
+			}
+		}
+	}
+}
+
+/*	filters the destination rows of a level: vertically into one
+	source wide row, then that row horizontally	*/
+static void filter_mip_rows( const mip_rows *job )
+{
+	const int row_floats = job->src_width * job->channels;
+	const int channels = job->channels;
+	const int vtaps = job->vertical->taps;
+	const int htaps = job->horizontal->taps;
+	int x, y, i, k, c;
+	for( y = job->first_row; y < job->end_row; ++y )
+	{
+		const float *wy = job->vertical->weights + y * vtaps;
+		float *dst = job->dst + (size_t)y * job->dst_width * channels;
+		for( k = 0; k < vtaps; ++k )
+		{
+			int source_row = job->vertical->first[y] + k;
+			int slot = source_row % vtaps;
+			if( NULL == job->top )
+			{
+				job->taps[k] = job->src + (size_t)source_row * row_floats;
+				continue;
+			}
+			if( job->cache_rows[slot] != source_row )
+			{
+				convert_mip_row( job, source_row, job->cache + (size_t)slot * (row_floats + 1) );
+				job->cache_rows[slot] = source_row;
+			}
+			job->taps[k] = job->cache + (size_t)slot * (row_floats + 1);
+		}
+		i = 0;
+		#if MIP_HAVE_SSE2
+		for( ; i + 4 <= row_floats; i += 4 )
+		{
+			__m128 sum = _mm_setzero_ps();
+			for( k = 0; k < vtaps; ++k )
+			{
+				sum = _mm_add_ps( sum, _mm_mul_ps( _mm_set1_ps( wy[k] ), _mm_loadu_ps( job->taps[k] + i ) ) );
+			}
+			_mm_storeu_ps( job->row + i, sum );
+		}
+		#endif
+		for( ; i < row_floats; ++i )
+		{
+			float sum = 0.0f;
+			for( k = 0; k < vtaps; ++k )
+			{
+				sum += wy[k] * job->taps[k][i];
+			}
+			job->row[i] = sum;
+		}
+		for( x = 0; x < job->dst_width; ++x )
+		{
+			const float *row = job->row + job->horizontal->first[x] * channels;
+			const float *wx = job->horizontal->weights + x * htaps;
+			#if MIP_HAVE_SSE2
+			if( channels == 4 )
+			{
+				/*	a whole RGBA pixel per vector	*/
+				__m128 sum = _mm_setzero_ps();
+				for( k = 0; k < htaps; ++k )
+				{
+					sum = _mm_add_ps( sum, _mm_mul_ps( _mm_set1_ps( wx[k] ), _mm_loadu_ps( row + k * 4 ) ) );
+				}
+				_mm_storeu_ps( dst + x * 4, sum );
+				continue;
+			}
+			if( channels == 3 )
+			{
+				/*	RGB and the next pixel's R, which is dropped
+					(the scratch row is padded for the last pixel)	*/
+				float rgbx[4];
+				__m128 sum = _mm_setzero_ps();
+				for( k = 0; k < htaps; ++k )
+				{
+					sum = _mm_add_ps( sum, _mm_mul_ps( _mm_set1_ps( wx[k] ), _mm_loadu_ps( row + k * 3 ) ) );
+				}
+				_mm_storeu_ps( rgbx, sum );
+				dst[x * 3 + 0] = rgbx[0];
+				dst[x * 3 + 1] = rgbx[1];
+				dst[x * 3 + 2] = rgbx[2];
+				continue;
+			}
+			#endif
+			for( c = 0; c < channels; ++c )
+			{
+				float sum = 0.0f;
+				for( k = 0; k < htaps; ++k )
+				{
+					sum += wx[k] * row[k * channels + c];
+				}
+				dst[x * channels + c] = sum;
+			}
+		}
+	}
+}
+
+/*	converts the destination rows of a level back to 8 bits	*/
+static void store_mip_rows( const mip_rows *job )
+{
+	const int channels = job->channels;
+	const int colors = (job->flags & MIPMAP_ALPHA) ? channels - 1 : channels;
+	int i, c;
+	for( i = job->first_row * job->dst_width; i < job->end_row * job->dst_width; ++i )
+	{
+		const float *pixel = job->dst + (size_t)i * channels;
+		unsigned char *out = job->out + (size_t)i * channels;
+		float weight = 1.0f;
+		if( job->flags & MIPMAP_ALPHA )
+		{
+			float alpha = pixel[channels - 1] * job->alpha_scale;
+			alpha = alpha < 0.0f ? 0.0f : (alpha > 1.0f ? 1.0f : alpha);
+			out[channels - 1] = (unsigned char)(alpha * 255.0f + 0.5f);
+			/*	the colors were filtered premultiplied	*/
+			weight = pixel[channels - 1] + MIP_ALPHA_BIAS;
+			if( weight < MIP_ALPHA_BIAS )
+			{
+				weight = MIP_ALPHA_BIAS;
+			}
+		}
+		for( c = 0; c < colors; ++c )
+		{
+			float value = pixel[c] / weight;
+			value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+			if( job->flags & MIPMAP_SRGB )
+			{
+				/*	the nearest sRGB code: a guess from the table,
+					then moved to the right side of the bounds	*/
+				int code = job->srgb_codes[(int)(value * (MIP_SRGB_CODES - 1))];
+				while( (code < 255) && (value >= job->srgb_bounds[code]) )
+				{
+					++code;
+				}
+				while( (code > 0) && (value < job->srgb_bounds[code - 1]) )
+				{
+					--code;
+				}
+				out[c] = (unsigned char)code;
+			} else
+			{
+				out[c] = (unsigned char)(value * 255.0f + 0.5f);
+			}
+		}
+	}
+}
+
+static void run_mip_rows( const mip_rows *job )
+{
+	if( job->pass == MIP_PASS_FILTER )
+	{
+		filter_mip_rows( job );
+	} else
+	{
+		store_mip_rows( job );
+	}
+}
+
+#ifdef _WIN32
+static DWORD WINAPI mip_thread( LPVOID job )
+{
+	run_mip_rows( (const mip_rows*)job );
+	return 0;
+}
+#else
+static void* mip_thread( void *job )
+{
+	run_mip_rows( (const mip_rows*)job );
+	return NULL;
+}
+#endif
+
+/*	runs one pass over a level, the calling thread doing the first share	*/
+static void run_mip_pass( mip_rows *jobs, int threads )
+{
+	#ifdef _WIN32
+	HANDLE handles[MIP_MAX_THREADS];
+	#else
+	pthread_t handles[MIP_MAX_THREADS];
+	#endif
+	int started[MIP_MAX_THREADS];
+	int t;
+	for( t = 1; t < threads; ++t )
+	{
+		#ifdef _WIN32
+		handles[t] = CreateThread( NULL, 0, mip_thread, &jobs[t], 0, NULL );
+		started[t] = handles[t] != NULL;
+		#else
+		started[t] = pthread_create( &handles[t], NULL, mip_thread, &jobs[t] ) == 0;
+		#endif
+	}
+	run_mip_rows( &jobs[0] );
+	for( t = 1; t < threads; ++t )
+	{
+		if( !started[t] )
+		{
+			/*	no thread for this share, do it here	*/
+			run_mip_rows( &jobs[t] );
+			continue;
+		}
+		#ifdef _WIN32
+		WaitForSingleObject( handles[t], INFINITE );
+		CloseHandle( handles[t] );
+		#else
+		pthread_join( handles[t], NULL );
+		#endif
+	}
+}
+
+/*
+	The scale for a level's alpha that brings the fraction of pixels
+	passing the alpha test back to the top level's, found on a histogram
+	of the level's alpha.  Levels that can't get closer to it than they
+	are are left alone, which keeps soft alpha that is never tested (a
+	plateau of equal alphas above the reference) untouched.
+*/
+static float mip_alpha_scale( const float *pixels, int count, int channels, float reference, float target )
+{
+	int *above;
+	int i, bin, best, reference_bin;
+	float best_error, error;
+	above = (int*)calloc( MIP_COVERAGE_BINS + 1, sizeof(int) );
+	if( NULL == above )
+	{
+		return 1.0f;
+	}
+	for( i = 0; i < count; ++i )
+	{
+		bin = (int)(pixels[i * channels + channels - 1] * MIP_COVERAGE_BINS);
+		++above[bin < 0 ? 0 : (bin >= MIP_COVERAGE_BINS ? MIP_COVERAGE_BINS - 1 : bin)];
+	}
+	/*	above[b]: pixels in bin b or higher	*/
+	for( i = MIP_COVERAGE_BINS - 1; i >= 0; --i )
+	{
+		above[i] += above[i + 1];
+	}
+	/*	testing against the top of bin b passes the pixels above it	*/
+	reference_bin = (int)(reference * MIP_COVERAGE_BINS) - 1;
+	reference_bin = reference_bin < 0 ? 0 : (reference_bin >= MIP_COVERAGE_BINS ? MIP_COVERAGE_BINS - 1 : reference_bin);
+	best = reference_bin;
+	best_error = (float)fabs( (float)above[reference_bin + 1] / count - target );
+	for( i = 0; i < MIP_COVERAGE_BINS; ++i )
+	{
+		error = (float)fabs( (float)above[i + 1] / count - target );
+		if( error < best_error )
+		{
+			best = i;
+			best_error = error;
+		}
+	}
+	free( above );
+	return best == reference_bin ? 1.0f : reference * MIP_COVERAGE_BINS / (best + 1);
+}
+
+void set_mipmap_threads( int threads )
+{
+	mip_threads = threads;
+}
+
+unsigned char*
+	mipmap_image_chain
+	(
+		const unsigned char* const orig,
+		int width, int height, int channels,
+		int filter, int flags, float alpha_reference,
+		int *levels, int *size
+	)
+{
+	mip_rows jobs[MIP_MAX_THREADS];
+	mip_filter_table horizontal, vertical;
+	float to_linear[256], srgb_bounds[256];
+	unsigned char srgb_codes[MIP_SRGB_CODES];
+	float *level, *next, *rows, *cache;
+	int *cache_rows;
+	const float **taps;
+	unsigned char *chain, *out;
+	float target = 0.0f;
+	int w, h, max_threads, total, i, c, t;
+	/*	error check	*/
+	*levels = 0;
+	*size = 0;
+	if( (width < 1) || (height < 1) ||
+		(channels < 1) || (channels > 4) ||
+		(NULL == orig) )
+	{
+		return NULL;
+	}
+	if( (channels & 1) == 1 )
+	{
+		/*	only 2 and 4 channel images have alpha	*/
+		flags &= ~(MIPMAP_ALPHA | MIPMAP_ALPHA_COVERAGE);
+	}
+	if( !(flags & MIPMAP_ALPHA) )
+	{
+		flags &= ~MIPMAP_ALPHA_COVERAGE;
+	}
+	/*	the size of the whole chain	*/
+	total = 0;
+	for( w = width, h = height; ; w = w > 1 ? w / 2 : 1, h = h > 1 ? h / 2 : 1 )
+	{
+		total += w * h * channels;
+		++*levels;
+		if( (w == 1) && (h == 1) )
+		{
+			break;
+		}
+	}
+	chain = (unsigned char*)malloc( total );
+	/*	the top level is never converted as a whole, the largest float level is the 2nd	*/
+	level = (float*)malloc( (size_t)(width > 1 ? width / 2 : 1) * (height > 1 ? height / 2 : 1) * channels * sizeof(float) );
+	next = (float*)malloc( (size_t)(width > 1 ? width / 2 : 1) * (height > 1 ? height / 2 : 1) * channels * sizeof(float) );
+	max_threads = mip_threads > 0 ? mip_threads : mip_cpu_count();
+	if( max_threads > MIP_MAX_THREADS )
+	{
+		max_threads = MIP_MAX_THREADS;
+	}
+	rows = (float*)calloc( (size_t)max_threads * (width * channels + 1), sizeof(float) );
+	if( (NULL == chain) || (NULL == level) || (NULL == next) || (NULL == rows) )
+	{
+		free( chain );
+		free( level );
+		free( next );
+		free( rows );
+		*levels = 0;
+		return NULL;
+	}
+	*size = total;
+	memcpy( chain, orig, (size_t)width * height * channels );
+	/*	the sRGB curve both ways	*/
+	for( i = 0; i < 256; ++i )
+	{
+		to_linear[i] = (flags & MIPMAP_SRGB) ? srgb_to_linear( i / 255.0f ) : i / 255.0f;
+		srgb_bounds[i] = srgb_to_linear( (i + 0.5f) / 255.0f );
+	}
+	for( i = 0, c = 0; i < MIP_SRGB_CODES; ++i )
+	{
+		while( (c < 255) && ((float)i / (MIP_SRGB_CODES - 1) >= srgb_bounds[c]) )
+		{
+			++c;
+		}
+		srgb_codes[i] = (unsigned char)c;
+	}
+	if( flags & MIPMAP_ALPHA_COVERAGE )
+	{
+		/*	the fraction of the top level passing the alpha test	*/
+		for( i = 0, c = 0; i < width * height; ++i )
+		{
+			c += orig[(size_t)i * channels + channels - 1] > alpha_reference * 255.0f;
+		}
+		target = (float)c / (width * height);
+	}
+	/*	then every level from the one before it	*/
+	out = chain + (size_t)width * height * channels;
+	for( w = width, h = height; (w > 1) || (h > 1); )
+	{
+		int nw = w > 1 ? w / 2 : 1;
+		int nh = h > 1 ? h / 2 : 1;
+		int threads = max_threads;
+		int top = (w == width) && (h == height);
+		float *swap;
+		horizontal.first = vertical.first = NULL;
+		horizontal.weights = vertical.weights = NULL;
+		taps = NULL;
+		cache = NULL;
+		cache_rows = NULL;
+		if( make_mip_filter_table( &horizontal, filter, w, nw ) &&
+			make_mip_filter_table( &vertical, filter, h, nh ) )
+		{
+			taps = (const float**)malloc( max_threads * vertical.taps * sizeof(const float*) );
+			if( top )
+			{
+				cache = (float*)calloc( (size_t)max_threads * vertical.taps * (w * channels + 1), sizeof(float) );
+				cache_rows = (int*)malloc( max_threads * vertical.taps * sizeof(int) );
+			}
+		}
+		if( (NULL == taps) || (top && ((NULL == cache) || (NULL == cache_rows))) )
+		{
+			free_mip_filter_table( &horizontal );
+			free_mip_filter_table( &vertical );
+			free( (void*)taps );
+			free( cache );
+			free( cache_rows );
+			free( chain );
+			chain = NULL;
+			*levels = 0;
+			*size = 0;
+			break;
+		}
+		for( i = 0; top && (i < max_threads * vertical.taps); ++i )
+		{
+			cache_rows[i] = -1;
+		}
+		if( threads > nw * nh / MIP_PIXELS_PER_THREAD )
+		{
+			threads = nw * nh / MIP_PIXELS_PER_THREAD;
+		}
+		if( threads > nh )
+		{
+			threads = nh;
+		}
+		if( threads < 1 )
+		{
+			threads = 1;
+		}
+		for( t = 0; t < threads; ++t )
+		{
+			jobs[t].pass = MIP_PASS_FILTER;
+			jobs[t].src = top ? NULL : level;
+			jobs[t].top = top ? orig : NULL;
+			jobs[t].to_linear = to_linear;
+			jobs[t].cache = top ? cache + (size_t)t * vertical.taps * (w * channels + 1) : NULL;
+			jobs[t].cache_rows = top ? cache_rows + t * vertical.taps : NULL;
+			jobs[t].taps = taps + t * vertical.taps;
+			jobs[t].src_width = w;
+			jobs[t].src_height = h;
+			jobs[t].channels = channels;
+			jobs[t].dst = next;
+			jobs[t].dst_width = nw;
+			jobs[t].dst_height = nh;
+			jobs[t].horizontal = &horizontal;
+			jobs[t].vertical = &vertical;
+			jobs[t].row = rows + (size_t)t * (w * channels + 1);
+			jobs[t].out = out;
+			jobs[t].flags = flags;
+			jobs[t].alpha_scale = 1.0f;
+			jobs[t].srgb_bounds = srgb_bounds;
+			jobs[t].srgb_codes = srgb_codes;
+			jobs[t].first_row = nh * t / threads;
+			jobs[t].end_row = nh * (t+1) / threads;
+		}
+		run_mip_pass( jobs, threads );
+		if( flags & MIPMAP_ALPHA_COVERAGE )
+		{
+			float alpha_scale = mip_alpha_scale( next, nw * nh, channels, alpha_reference, target );
+			for( t = 0; t < threads; ++t )
+			{
+				jobs[t].alpha_scale = alpha_scale;
+			}
+		}
+		for( t = 0; t < threads; ++t )
+		{
+			jobs[t].pass = MIP_PASS_STORE;
+		}
+		run_mip_pass( jobs, threads );
+		free_mip_filter_table( &horizontal );
+		free_mip_filter_table( &vertical );
+		free( (void*)taps );
+		free( cache );
+		free( cache_rows );
+		/*	the float level (not the 8 bit one) feeds the next	*/
+		swap = level;
+		level = next;
+		next = swap;
+		out += (size_t)nw * nh * channels;
+		w = nw;
+		h = nh;
+	}
+	free( level );
+	free( next );
+	free( rows );
+	return chain;
+}
+
 int
 	scale_image_RGB_to_NTSC_safe
 	(
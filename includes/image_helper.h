@@ -43,6 +43,63 @@ int
 		int block_size_x, int block_size_y
 	);
 
+/**
+	The filters mipmap_image_chain can use: a box the size of
+	the destination pixel, or a 3 pixel wide Kaiser windowed
+	sinc (alpha = 4) or Lanczos.
+**/
+enum
+{
+	MIPMAP_FILTER_BOX = 0,
+	MIPMAP_FILTER_KAISER = 1,
+	MIPMAP_FILTER_LANCZOS = 2
+};
+
+/**
+	Flags for mipmap_image_chain.
+	MIPMAP_SRGB: the color channels are sRGB encoded, they
+	are filtered in linear space and encoded again.
+	MIPMAP_ALPHA: the last channel (of 2 or 4) is alpha, the
+	colors are weighted by it so transparent pixels don't
+	bleed into the visible ones.
+	MIPMAP_ALPHA_COVERAGE: the alpha of every level is scaled
+	so that as many of its pixels pass an alpha test as in
+	the top level, keeping cutouts from thinning out.
+**/
+enum
+{
+	MIPMAP_SRGB = 1,
+	MIPMAP_ALPHA = 2,
+	MIPMAP_ALPHA_COVERAGE = 4
+};
+
+/**
+	This function creates the whole mip chain of an image,
+	down to 1x1, each level half the size of the one before
+	(rounded down).  The levels are filtered in floating
+	point, every one from the unrounded one before it, with
+	the rows of each level spread over the threads.
+	alpha_reference is the alpha test threshold, in [0,1],
+	for MIPMAP_ALPHA_COVERAGE.
+	eturn the levels back to back, the first being a copy
+	of orig, in one malloc'd block (NULL if failed); levels
+	and size receive their count and total bytes.
+**/
+unsigned char*
+	mipmap_image_chain
+	(
+		const unsigned char* const orig,
+		int width, int height, int channels,
+		int filter, int flags, float alpha_reference,
+		int *levels, int *size
+	);
+
+/**
+	Sets how many threads mipmap_image_chain uses.
+	0 (the default) uses one per CPU core.
+**/
+void set_mipmap_threads( int threads );
+
 /**
 	This function takes the RGB components of the image
 	and scales each channel from [0,255] to [16,235].
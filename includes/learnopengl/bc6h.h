@@ -0,0 +1,403 @@
+#ifndef BC6H_H
+#define BC6H_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/parallel.h>
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+using namespace std;
+
+// BC6H (BPTC float) is GL 4.2 / ARB_texture_compression_bptc; the GL 3.3 loader doesn't define it.
+#ifndef GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT_ARB
+#define GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT_ARB 0x8E8F
+#endif
+
+// A CPU encoder for BC6H_UF16: unsigned half float RGB in 16 byte 4x4 blocks, 1 byte per pixel against the 6 (or 8,
+// padded) of RGB16F. Every block is encoded in mode 11, one region with two 10 bit endpoints and 4 bit indices: the
+// endpoints are the extremes of the block's principal axis, refined once by least squares. Values are fitted as half
+// float bit patterns, which is how BC6H interpolates them, so errors are relative to the brightness like in the
+// source data. Negative values (and NaN) become 0, there's no sign in the unsigned format.
+
+// the nearest unsigned half float to 'value', as its bit pattern
+inline unsigned short HalfFromFloat(float value)
+{
+    if (!(value > 0.0f))
+        return 0;
+    if (value >= 65504.0f)
+        return 0x7BFF;
+    unsigned int bits;
+    memcpy(&bits, &value, sizeof(bits));
+    int exponent = (int)((bits >> 23) & 0xFF) - 127 + 15;
+    unsigned int mantissa = bits & 0x7FFFFF;
+    if (exponent <= 0)
+    {
+        // subnormal half
+        if (exponent < -10)
+            return 0;
+        mantissa |= 0x800000;
+        int shift = 14 - exponent;
+        return (unsigned short)((mantissa >> shift) + ((mantissa >> (shift - 1)) & 1));
+    }
+    unsigned int half = ((unsigned int)exponent << 10) | (mantissa >> 13);
+    half += (mantissa >> 12) & 1; // a carry rounds into the exponent, which is still right
+    return (unsigned short)min(half, 0x7BFFu);
+}
+
+inline float FloatFromHalf(unsigned short half)
+{
+    int exponent = (half >> 10) & 31, mantissa = half & 1023;
+    float value = exponent == 0 ? mantissa / 16777216.0f : ldexp((float)(mantissa | 1024), exponent - 25);
+    return (half & 0x8000) ? -value : value;
+}
+
+namespace bc6h_detail {
+    static const int Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    // a 10 bit endpoint expanded to 16 bits, as the decoder does it
+    inline int Unquantize(int value)
+    {
+        if (value == 0)
+            return 0;
+        if (value == 1023)
+            return 0xFFFF;
+        return ((value << 16) + 0x8000) >> 10;
+    }
+
+    // the half float bit pattern a 16 bit interpolated value decodes to
+    inline int Finish(int value)
+    {
+        return (value * 31) >> 6;
+    }
+
+    // the 10 bit endpoint that decodes closest to 'half'
+    inline int Quantize(float half)
+    {
+        int target = (int)min(max(half + 0.5f, 0.0f), 31743.0f);
+        int best = min(target / 31, 1023), bestError = abs(Finish(Unquantize(best)) - target);
+        for (int candidate = max(best - 1, 0); candidate <= min(best + 1, 1023); candidate++)
+        {
+            int error = abs(Finish(Unquantize(candidate)) - target);
+            if (error < bestError)
+            {
+                best = candidate;
+                bestError = error;
+            }
+        }
+        return best;
+    }
+
+    // the 16 colors two quantized endpoints decode to
+    inline void Palette(const int a[3], const int b[3], int palette[16][3])
+    {
+        for (int i = 0; i < 16; i++)
+            for (int c = 0; c < 3; c++)
+                palette[i][c] = Finish((Unquantize(a[c]) * (64 - Weights[i]) + Unquantize(b[c]) * Weights[i] + 32) >> 6);
+    }
+
+    // picks the nearest palette entry for every texel; returns the summed squared error
+    inline long long AssignIndices(const unsigned short texels[16][3], const int a[3], const int b[3], int indices[16])
+    {
+        int palette[16][3];
+        Palette(a, b, palette);
+        long long total = 0;
+        for (int t = 0; t < 16; t++)
+        {
+            long long best = -1;
+            for (int i = 0; i < 16; i++)
+            {
+                long long error = 0;
+                for (int c = 0; c < 3; c++)
+                    error += (long long)(palette[i][c] - texels[t][c]) * (palette[i][c] - texels[t][c]);
+                if (best < 0 || error < best)
+                {
+                    best = error;
+                    indices[t] = i;
+                }
+            }
+            total += best;
+        }
+        return total;
+    }
+
+    inline void PutBits(unsigned char block[16], int &position, unsigned int value, int count)
+    {
+        for (int i = 0; i < count; i++, position++)
+            if ((value >> i) & 1)
+                block[position >> 3] |= (unsigned char)(1 << (position & 7));
+    }
+
+    inline unsigned int GetBits(const unsigned char block[16], int &position, int count)
+    {
+        unsigned int value = 0;
+        for (int i = 0; i < count; i++, position++)
+            value |= (unsigned int)((block[position >> 3] >> (position & 7)) & 1) << i;
+        return value;
+    }
+}
+
+// encodes 16 texels, given as unsigned half float bit patterns in rows of 4, into one BC6H_UF16 block
+inline void EncodeBC6HBlock(const unsigned short texels[16][3], unsigned char block[16])
+{
+    using namespace bc6h_detail;
+    // the principal axis of the block, by power iteration on the covariance matrix
+    float mean[3] = { 0.0f, 0.0f, 0.0f }, low[3] = { 65535.0f, 65535.0f, 65535.0f }, high[3] = { 0.0f, 0.0f, 0.0f };
+    for (int t = 0; t < 16; t++)
+        for (int c = 0; c < 3; c++)
+        {
+            mean[c] += texels[t][c] / 16.0f;
+            low[c] = min(low[c], (float)texels[t][c]);
+            high[c] = max(high[c], (float)texels[t][c]);
+        }
+    float covariance[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f }; // xx xy xz yy yz zz
+    for (int t = 0; t < 16; t++)
+    {
+        float d[3] = { texels[t][0] - mean[0], texels[t][1] - mean[1], texels[t][2] - mean[2] };
+        covariance[0] += d[0] * d[0]; covariance[1] += d[0] * d[1]; covariance[2] += d[0] * d[2];
+        covariance[3] += d[1] * d[1]; covariance[4] += d[1] * d[2]; covariance[5] += d[2] * d[2];
+    }
+    float axis[3] = { high[0] - low[0], high[1] - low[1], high[2] - low[2] };
+    for (int iteration = 0; iteration < 4; iteration++)
+    {
+        float next[3] = {
+            covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+            covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+            covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2] };
+        float length = sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+        if (length < 1e-6f)
+            break;
+        for (int c = 0; c < 3; c++)
+            axis[c] = next[c] / length;
+    }
+    float length2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+
+    // the endpoints span the texels' projections onto the axis
+    float tMin = 0.0f, tMax = 0.0f;
+    if (length2 > 0.0f)
+    {
+        for (int t = 0; t < 16; t++)
+        {
+            float projection = ((texels[t][0] - mean[0]) * axis[0] + (texels[t][1] - mean[1]) * axis[1] + (texels[t][2] - mean[2]) * axis[2]) / length2;
+            tMin = min(tMin, projection);
+            tMax = max(tMax, projection);
+        }
+    }
+    int a[3], b[3], indices[16];
+    for (int c = 0; c < 3; c++)
+    {
+        a[c] = Quantize(mean[c] + tMin * axis[c]);
+        b[c] = Quantize(mean[c] + tMax * axis[c]);
+    }
+    long long error = AssignIndices(texels, a, b, indices);
+
+    // one least squares refit of the endpoints to the chosen indices, kept if it's better
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f, ra[3] = { 0.0f, 0.0f, 0.0f }, rb[3] = { 0.0f, 0.0f, 0.0f };
+    for (int t = 0; t < 16; t++)
+    {
+        float w = Weights[indices[t]] / 64.0f;
+        aa += (1.0f - w) * (1.0f - w);
+        ab += (1.0f - w) * w;
+        bb += w * w;
+        for (int c = 0; c < 3; c++)
+        {
+            ra[c] += (1.0f - w) * texels[t][c];
+            rb[c] += w * texels[t][c];
+        }
+    }
+    float determinant = aa * bb - ab * ab;
+    if (error > 0 && fabs(determinant) > 1e-6f)
+    {
+        int refinedA[3], refinedB[3], refinedIndices[16];
+        for (int c = 0; c < 3; c++)
+        {
+            refinedA[c] = Quantize((ra[c] * bb - rb[c] * ab) / determinant);
+            refinedB[c] = Quantize((rb[c] * aa - ra[c] * ab) / determinant);
+        }
+        long long refinedError = AssignIndices(texels, refinedA, refinedB, refinedIndices);
+        if (refinedError < error)
+        {
+            memcpy(a, refinedA, sizeof(a));
+            memcpy(b, refinedB, sizeof(b));
+            memcpy(indices, refinedIndices, sizeof(indices));
+        }
+    }
+
+    // the first index is stored without its top bit, so it must be below 8: swap the endpoints if it isn't
+    if (indices[0] >= 8)
+    {
+        for (int c = 0; c < 3; c++)
+            swap(a[c], b[c]);
+        for (int t = 0; t < 16; t++)
+            indices[t] = 15 - indices[t];
+    }
+
+    memset(block, 0, 16);
+    int position = 0;
+    PutBits(block, position, 3, 5); // mode 11
+    for (int c = 0; c < 3; c++)
+        PutBits(block, position, a[c], 10);
+    for (int c = 0; c < 3; c++)
+        PutBits(block, position, b[c], 10);
+    PutBits(block, position, indices[0], 3);
+    for (int t = 1; t < 16; t++)
+        PutBits(block, position, indices[t], 4);
+}
+
+// decodes a block written by EncodeBC6HBlock back to half float bit patterns. Only mode 11 is understood, blocks in
+// any other mode decode to black.
+inline void DecodeBC6HBlock(const unsigned char block[16], unsigned short texels[16][3])
+{
+    using namespace bc6h_detail;
+    int position = 0;
+    if (GetBits(block, position, 5) != 3)
+    {
+        memset(texels, 0, 16 * 3 * sizeof(unsigned short));
+        return;
+    }
+    int a[3], b[3], palette[16][3];
+    for (int c = 0; c < 3; c++)
+        a[c] = GetBits(block, position, 10);
+    for (int c = 0; c < 3; c++)
+        b[c] = GetBits(block, position, 10);
+    Palette(a, b, palette);
+    for (int t = 0; t < 16; t++)
+    {
+        int index = GetBits(block, position, t == 0 ? 3 : 4);
+        for (int c = 0; c < 3; c++)
+            texels[t][c] = (unsigned short)palette[index][c];
+    }
+}
+
+// compresses an RGB float image to BC6H_UF16, with the block rows spread over 'threads' threads (0 picks
+// WorkerThreadCount()). Images that aren't a multiple of 4 in size repeat their last row/column into the blocks.
+inline vector<unsigned char> CompressBC6H(const float *rgb, int width, int height, unsigned int threads = 0)
+{
+    int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    vector<unsigned char> blocks((size_t)blocksX * blocksY * 16);
+    ParallelFor(blocksY, [&](unsigned int by)
+    {
+        unsigned short texels[16][3];
+        for (int bx = 0; bx < blocksX; bx++)
+        {
+            for (int t = 0; t < 16; t++)
+            {
+                int x = min(bx * 4 + t % 4, width - 1), y = min((int)by * 4 + t / 4, height - 1);
+                const float *pixel = rgb + ((size_t)y * width + x) * 3;
+                for (int c = 0; c < 3; c++)
+                    texels[t][c] = HalfFromFloat(pixel[c]);
+            }
+            EncodeBC6HBlock(texels, &blocks[((size_t)by * blocksX + bx) * 16]);
+        }
+    }, threads);
+    return blocks;
+}
+
+// how far a compressed image is from its source: root mean square of log2(decoded / source) over all channels, in
+// stops (values below 'floor' are clamped to it first, so near black noise doesn't dominate)
+inline double BC6HErrorStops(const vector<unsigned char> &blocks, const float *rgb, int width, int height, float floor = 1e-3f)
+{
+    int blocksX = (width + 3) / 4;
+    double sum = 0.0;
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            unsigned short texels[16][3];
+            DecodeBC6HBlock(&blocks[((size_t)(y / 4) * blocksX + x / 4) * 16], texels);
+            for (int c = 0; c < 3; c++)
+            {
+                double decoded = max(FloatFromHalf(texels[(y % 4) * 4 + x % 4][c]), floor);
+                double source = max(rgb[((size_t)y * width + x) * 3 + c], floor);
+                double stops = log2(decoded / source);
+                sum += stops * stops;
+            }
+        }
+    }
+    return sqrt(sum / ((double)width * height * 3));
+}
+
+// true if the driver can sample BC6H textures
+inline bool BC6HSupported()
+{
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    if (major > 4 || (major == 4 && minor >= 2))
+        return true;
+    GLint extensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+    for (GLint i = 0; i < extensions; i++)
+        if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), "GL_ARB_texture_compression_bptc") == 0)
+            return true;
+    return false;
+}
+
+// reads a float cubemap (all faces of its first 'levels' mip levels) back from the GPU and creates a BC6H copy of
+// it with the same filtering. The source is left alone, the caller deletes it. Prints the memory saved and the error.
+inline unsigned int CompressCubemapBC6H(unsigned int cubemap, int size, int levels, const string &name)
+{
+    chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+    GLint minFilter = GL_LINEAR, magFilter = GL_LINEAR;
+    glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap);
+    glGetTexParameteriv(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, &minFilter);
+    glGetTexParameteriv(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, &magFilter);
+
+    vector<vector<float> > pixels(6 * levels);
+    for (int level = 0; level < levels; level++)
+    {
+        int levelSize = max(1, size >> level);
+        for (int face = 0; face < 6; face++)
+        {
+            pixels[level * 6 + face].resize((size_t)levelSize * levelSize * 3);
+            glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, GL_RGB, GL_FLOAT, pixels[level * 6 + face].data());
+        }
+    }
+    chrono::high_resolution_clock::time_point read = chrono::high_resolution_clock::now();
+
+    // the faces and levels are small, so the blocks of each are spread over the threads rather than the faces
+    vector<vector<unsigned char> > blocks(6 * levels);
+    for (int i = 0; i < 6 * levels; i++)
+    {
+        int levelSize = max(1, size >> (i / 6));
+        blocks[i] = CompressBC6H(pixels[i].data(), levelSize, levelSize);
+    }
+    chrono::high_resolution_clock::time_point encoded = chrono::high_resolution_clock::now();
+
+    unsigned int compressed;
+    glGenTextures(1, &compressed);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, compressed);
+    size_t floatBytes = 0, compressedBytes = 0;
+    double error = 0.0;
+    for (int i = 0; i < 6 * levels; i++)
+    {
+        int levelSize = max(1, size >> (i / 6));
+        glCompressedTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i % 6, i / 6, GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT_ARB, levelSize, levelSize, 0,
+                               (GLsizei)blocks[i].size(), blocks[i].data());
+        floatBytes += (size_t)levelSize * levelSize * 6;
+        compressedBytes += blocks[i].size();
+        // weighted by the texels, so the error of the level 0 faces dominates as it should
+        double stops = BC6HErrorStops(blocks[i], pixels[i].data(), levelSize, levelSize);
+        error += stops * stops * levelSize * levelSize;
+    }
+    size_t texels = floatBytes / 6;
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, minFilter);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, magFilter);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, levels - 1);
+
+    cout << "TEXTURE::BC6H:: " << name << " " << size << "x" << size << "x6, " << levels << " levels: " << floatBytes / 1024 << " KB as RGB16F -> "
+         << compressedBytes / 1024 << " KB (" << 100.0 * compressedBytes / floatBytes << "%), rms error " << sqrt(error / texels)
+         << " stops; " << chrono::duration<double, milli>(read - start).count() << " ms to read back, "
+         << chrono::duration<double, milli>(encoded - read).count() << " ms to encode" << endl;
+    return compressed;
+}
+
+#endif
@@ -2,9 +2,30 @@
 #define FILESYSTEM_H
 
 #include <string>
+#include <vector>
+#include <cstdio>
 #include <cstdlib>
+#include <cstddef>
+#include <atomic>
 #include "root_directory.h" // This is a configuration file generated by CMake.
 
+#ifdef _WIN32
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+	#include <io.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <dirent.h>
+#endif
+
 class FileSystem
 {
 	private:
@@ -16,6 +37,265 @@ class FileSystem
 			return (*pathBuilder)(path);
 		}
 
+		// absolute path with all symbolic links and '.'/'..' components resolved; returns the input if it can't be resolved.
+		static std::string getCanonicalPath(const std::string& path) {
+#ifdef _WIN32
+			char resolved[MAX_PATH];
+			if (_fullpath(resolved, path.c_str(), MAX_PATH) == nullptr)
+				return path;
+			std::string result(resolved);
+			for (size_t i = 0; i < result.size(); ++i)
+				if (result[i] == '\\')
+					result[i] = '/';
+			return result;
+#else
+			char* resolved = realpath(path.c_str(), nullptr);
+			if (resolved == nullptr)
+				return path;
+			std::string result(resolved);
+			free(resolved);
+			return result;
+#endif
+		}
+
+		// how a mapped file is going to be read; passed to the kernel so it can size its read-ahead.
+		enum Access {
+			ACCESS_SEQUENTIAL, // front to back, once: aggressive read-ahead, pages behind the reader can be dropped early
+			ACCESS_RANDOM,     // scattered reads: no read-ahead beyond the page that faulted
+			ACCESS_NORMAL      // the kernel's default heuristics
+		};
+
+		// read-only view of a whole file mapped into memory; data() returns nullptr if the file couldn't be mapped (or
+		// is empty, which isOpen() tells apart from a failure). With 'prefetch' the whole file is scheduled to be read in right away (MADV_WILLNEED), so decoding
+		// the first bytes overlaps with reading the rest. On Windows the hint only picks the cache mode of the file.
+		class MappedFile
+		{
+		public:
+			explicit MappedFile(const std::string& path, Access access = ACCESS_SEQUENTIAL, bool prefetch = true) : ptr(nullptr), length(0), opened(false)
+			{
+#ifdef _WIN32
+				DWORD flags = access == ACCESS_SEQUENTIAL ? FILE_FLAG_SEQUENTIAL_SCAN : access == ACCESS_RANDOM ? FILE_FLAG_RANDOM_ACCESS : FILE_ATTRIBUTE_NORMAL;
+				(void)prefetch;
+				file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, flags, NULL);
+				mapping = NULL;
+				if (file == INVALID_HANDLE_VALUE)
+					return;
+				LARGE_INTEGER fileSize;
+				if (!GetFileSizeEx(file, &fileSize))
+					return;
+				// an empty file can't be mapped, but it's open and reads as nothing
+				opened = fileSize.QuadPart == 0;
+				if (opened)
+					return;
+				mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+				if (mapping == NULL)
+					return;
+				ptr = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+				if (ptr != nullptr)
+				{
+					length = static_cast<size_t>(fileSize.QuadPart);
+					opened = true;
+				}
+#else
+				int fd = open(path.c_str(), O_RDONLY);
+				if (fd < 0)
+					return;
+				struct stat st;
+				bool found = fstat(fd, &st) == 0;
+				// an empty file can't be mapped, but it's open and reads as nothing
+				if (found && S_ISREG(st.st_mode) && st.st_size == 0)
+					opened = true;
+				else if (found && st.st_size > 0)
+				{
+					void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+					if (view != MAP_FAILED)
+					{
+						ptr = static_cast<const unsigned char*>(view);
+						length = static_cast<size_t>(st.st_size);
+						opened = true;
+						// hints only, a kernel that ignores them still maps the file correctly
+						if (access != ACCESS_NORMAL)
+							madvise(view, length, access == ACCESS_SEQUENTIAL ? MADV_SEQUENTIAL : MADV_RANDOM);
+						if (prefetch)
+							madvise(view, length, MADV_WILLNEED);
+					}
+				}
+				close(fd); // the mapping keeps its own reference to the file
+#endif
+			}
+			~MappedFile()
+			{
+#ifdef _WIN32
+				if (ptr != nullptr)
+					UnmapViewOfFile(ptr);
+				if (mapping != NULL)
+					CloseHandle(mapping);
+				if (file != INVALID_HANDLE_VALUE)
+					CloseHandle(file);
+#else
+				if (ptr != nullptr)
+					munmap(const_cast<unsigned char*>(ptr), length);
+#endif
+			}
+			MappedFile(const MappedFile&) = delete;
+			MappedFile& operator=(const MappedFile&) = delete;
+
+			const unsigned char* data() const { return ptr; }
+			size_t size() const { return length; }
+			// true for a mapped file and for an empty one
+			bool isOpen() const { return opened; }
+
+		private:
+			const unsigned char* ptr;
+			size_t length;
+			bool opened;
+#ifdef _WIN32
+			HANDLE file;
+			HANDLE mapping;
+#endif
+		};
+
+		// the size of a file and the time it was last written, in the platform's own units (only good for comparing with
+		// each other); returns false if the file doesn't exist.
+		static bool getFileStamp(const std::string& path, unsigned long long& size, unsigned long long& modified) {
+#ifdef _WIN32
+			WIN32_FILE_ATTRIBUTE_DATA attributes;
+			if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &attributes))
+				return false;
+			size = (static_cast<unsigned long long>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+			modified = (static_cast<unsigned long long>(attributes.ftLastWriteTime.dwHighDateTime) << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+			return true;
+#else
+			struct stat info;
+			if (stat(path.c_str(), &info) != 0)
+				return false;
+			size = static_cast<unsigned long long>(info.st_size);
+			// in nanoseconds: whole seconds would miss a file rewritten within the second it was stamped
+#ifdef __APPLE__
+			modified = static_cast<unsigned long long>(info.st_mtimespec.tv_sec) * 1000000000ULL + info.st_mtimespec.tv_nsec;
+#else
+			modified = static_cast<unsigned long long>(info.st_mtim.tv_sec) * 1000000000ULL + info.st_mtim.tv_nsec;
+#endif
+			return true;
+#endif
+		}
+
+		// a piece of the contents writeFileAtomically writes
+		struct FileChunk {
+			const void* data;
+			size_t size;
+		};
+
+		// writes the chunks one after the other to a temporary file next to 'path' and then moves it over 'path' in one
+		// step, so a reader (or a crash) only ever sees the old file or the complete new one. Returns false, leaving
+		// 'path' as it was, if anything fails. The temporary file is named after the process and a counter, so writers
+		// of the same file in other threads or processes don't write into each other's.
+		static bool writeFileAtomically(const std::string& path, const std::vector<FileChunk>& chunks) {
+			static std::atomic<unsigned int> writes(0);
+#ifdef _WIN32
+			unsigned long process = GetCurrentProcessId();
+#else
+			unsigned long process = static_cast<unsigned long>(getpid());
+#endif
+			std::string tempPath = path + '.' + std::to_string(process) + '.' + std::to_string(writes++) + ".tmp";
+			FILE* file = fopen(tempPath.c_str(), "wb");
+			if (!file)
+				return false;
+			bool ok = true;
+			for (size_t i = 0; i < chunks.size() && ok; i++)
+				ok = chunks[i].size == 0 || fwrite(chunks[i].data, 1, chunks[i].size, file) == chunks[i].size;
+			ok = fclose(file) == 0 && ok;
+#ifdef _WIN32
+			// rename refuses to replace an existing file on Windows
+			ok = ok && MoveFileExA(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+			ok = ok && rename(tempPath.c_str(), path.c_str()) == 0;
+#endif
+			if (!ok)
+				remove(tempPath.c_str());
+			return ok;
+		}
+
+		// appends every file below 'directory', recursively
+		static void listFiles(const std::string& directory, std::vector<std::string>& files) {
+#ifdef _WIN32
+			_finddata_t entry;
+			intptr_t handle = _findfirst((directory + "/*").c_str(), &entry);
+			if (handle == -1)
+				return;
+			do
+			{
+				std::string name = entry.name;
+				if (name == "." || name == "..")
+					continue;
+				if (entry.attrib & _A_SUBDIR)
+					listFiles(directory + '/' + name, files);
+				else
+					files.push_back(directory + '/' + name);
+			} while (_findnext(handle, &entry) == 0);
+			_findclose(handle);
+#else
+			DIR* dir = opendir(directory.c_str());
+			if (dir == nullptr)
+				return;
+			while (dirent* entry = readdir(dir))
+			{
+				std::string name = entry->d_name;
+				if (name == "." || name == "..")
+					continue;
+				std::string path = directory + '/' + name;
+				struct stat info;
+				if (stat(path.c_str(), &info) != 0)
+					continue;
+				if (S_ISDIR(info.st_mode))
+					listFiles(path, files);
+				else
+					files.push_back(path);
+			}
+			closedir(dir);
+#endif
+		}
+
+		// reads a whole file into 'contents' with a single read straight into the string; returns false if the file can't
+		// be read or is empty. Small text files like shaders are copied into a string anyway, and for them one read
+		// beats setting up and tearing down a MappedFile (about 3x, see the load_benchmark tool).
+		static bool readFile(const std::string& path, std::string& contents) {
+#ifdef _WIN32
+			HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+			if (file == INVALID_HANDLE_VALUE)
+				return false;
+			LARGE_INTEGER fileSize;
+			DWORD read = 0;
+			bool ok = GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0 && fileSize.QuadPart < 0x7FFFFFFF;
+			if (ok)
+			{
+				contents.resize(static_cast<size_t>(fileSize.QuadPart));
+				ok = ReadFile(file, &contents[0], static_cast<DWORD>(fileSize.QuadPart), &read, NULL) && read == fileSize.QuadPart;
+			}
+			CloseHandle(file);
+			return ok;
+#else
+			int fd = open(path.c_str(), O_RDONLY);
+			if (fd < 0)
+				return false;
+			struct stat st;
+			size_t done = 0;
+			if (fstat(fd, &st) == 0 && st.st_size > 0)
+			{
+				contents.resize(static_cast<size_t>(st.st_size));
+				while (done < contents.size())
+				{
+					ssize_t count = read(fd, &contents[done], contents.size() - done);
+					if (count <= 0)
+						break;
+					done += static_cast<size_t>(count);
+				}
+			}
+			close(fd);
+			return done > 0 && done == contents.size();
+#endif
+		}
+
 	private:
 		static std::string const & getRoot() {
 			static char const* envRoot = getenv("LOGL_ROOT_PATH");
@@ -0,0 +1,297 @@
+#ifndef GEOMETRY_POOL_H
+#define GEOMETRY_POOL_H
+
+#include <glad/glad.h>
+
+#include <map>
+#include <algorithm>
+#include <iostream>
+using namespace std;
+
+// Best-fit sub-allocator for ranges of a fixed capacity (in arbitrary units, e.g. vertices or indices).
+// Free blocks are kept both by offset, to merge neighbours on Free, and by size, to find the best fit quickly.
+class RangeAllocator
+{
+public:
+    static const size_t Invalid = ~(size_t)0;
+
+    explicit RangeAllocator(size_t capacity = 0) : capacity(0), used(0)
+    {
+        Grow(capacity);
+    }
+
+    // returns the offset of a free range of the given size, or Invalid if no free block is large enough.
+    size_t Allocate(size_t size)
+    {
+        if (size == 0)
+            return 0;
+        multimap<size_t, size_t>::iterator fit = freeBySize.lower_bound(size);
+        if (fit == freeBySize.end())
+            return Invalid;
+
+        size_t blockSize = fit->first;
+        size_t offset = fit->second;
+        freeBySize.erase(fit);
+        freeByOffset.erase(offset);
+        if (blockSize > size)
+            insertFree(offset + size, blockSize - size);
+        used += size;
+        return offset;
+    }
+
+    // gives a range back; it's merged with the free blocks around it.
+    void Free(size_t offset, size_t size)
+    {
+        if (size == 0)
+            return;
+        used -= size;
+
+        map<size_t, size_t>::iterator next = freeByOffset.lower_bound(offset);
+        if (next != freeByOffset.end() && offset + size == next->first)
+        {
+            size += next->second;
+            eraseFree(next);
+        }
+        map<size_t, size_t>::iterator previous = freeByOffset.lower_bound(offset);
+        if (previous != freeByOffset.begin())
+        {
+            --previous;
+            if (previous->first + previous->second == offset)
+            {
+                offset = previous->first;
+                size += previous->second;
+                eraseFree(previous);
+            }
+        }
+        insertFree(offset, size);
+    }
+
+    // extends the capacity; the new space is free.
+    void Grow(size_t newCapacity)
+    {
+        if (newCapacity <= capacity)
+            return;
+        size_t added = newCapacity - capacity;
+        size_t offset = capacity;
+        capacity = newCapacity;
+        used += added; // Free takes it off again
+        Free(offset, added);
+    }
+
+    size_t Capacity() const { return capacity; }
+    size_t Used() const { return used; }
+    size_t FreeBlocks() const { return freeByOffset.size(); }
+    size_t LargestFree() const { return freeBySize.empty() ? 0 : freeBySize.rbegin()->first; }
+
+    // 0 if all free space is in one block, close to 1 if it's scattered over many small blocks
+    float Fragmentation() const
+    {
+        size_t freeSpace = capacity - used;
+        return freeSpace == 0 ? 0.0f : 1.0f - (float)LargestFree() / freeSpace;
+    }
+
+private:
+    size_t capacity;
+    size_t used;
+    map<size_t, size_t> freeByOffset;      // offset -> size
+    multimap<size_t, size_t> freeBySize;   // size -> offset
+
+    void insertFree(size_t offset, size_t size)
+    {
+        freeByOffset[offset] = size;
+        freeBySize.insert(make_pair(size, offset));
+    }
+    void eraseFree(map<size_t, size_t>::iterator block)
+    {
+        pair<multimap<size_t, size_t>::iterator, multimap<size_t, size_t>::iterator> sizes = freeBySize.equal_range(block->second);
+        for (multimap<size_t, size_t>::iterator it = sizes.first; it != sizes.second; ++it)
+        {
+            if (it->second == block->first)
+            {
+                freeBySize.erase(it);
+                break;
+            }
+        }
+        freeByOffset.erase(block);
+    }
+};
+
+// the part of a GeometryPool a mesh occupies; drawn with glDrawElementsBaseVertex.
+struct GeometryRange {
+    unsigned int baseVertex;
+    unsigned int vertexCount;
+    unsigned int indexOffset; // in bytes, a multiple of GeometryPool::IndexAlignment
+    unsigned int indexBytes;
+};
+
+// One large vertex buffer and index buffer shared by all static meshes of a vertex format, with a single VAO.
+// Meshes become ranges in these buffers, so drawing several of them in a row needs no VAO switch. The buffers grow
+// (by copying on the GPU) when they run full; the VAO stays the same object.
+// Meshes may use different index types: the index buffer is allocated in 4 byte words, so every range starts at an
+// offset that is aligned for 8, 16 and 32 bit indices alike.
+class GeometryPool
+{
+public:
+    static const unsigned int IndexAlignment = 4;
+
+    struct Stats {
+        size_t vertexCapacity, verticesUsed;
+        size_t indexBytesCapacity, indexBytesUsed;
+        size_t freeBlocks;      // vertex and index free blocks together
+        float fragmentation;    // worst of the vertex and index buffers, see RangeAllocator::Fragmentation
+        unsigned int ranges;    // live allocations
+        unsigned int grows;
+    };
+
+    // VAO binds done and avoided while drawing pooled meshes, over all pools
+    struct BindStats {
+        unsigned long long binds;
+        unsigned long long bindsSkipped;
+    };
+
+    // setupAttributes declares the vertex format's attribute pointers for the bound buffer, e.g. &FullVertex::SetupAttributes
+    GeometryPool(GLsizei stride, void (*setupAttributes)(size_t)) : stride(stride), setupAttributes(setupAttributes), vao(0), vbo(0), ebo(0), ranges(0), grows(0) {}
+
+    // copies the data into the pool; the indices can be of any type, they're only copied. Returns false if the
+    // buffers can't be grown to fit.
+    bool Allocate(const void *vertexData, unsigned int vertexCount, const void *indexData, unsigned int indexBytes, GeometryRange &range)
+    {
+        size_t indexWords = (indexBytes + IndexAlignment - 1) / IndexAlignment;
+        size_t baseVertex = vertices.Allocate(vertexCount);
+        if (baseVertex == RangeAllocator::Invalid)
+        {
+            growBuffer(vbo, vertices, vertexCount, stride);
+            baseVertex = vertices.Allocate(vertexCount);
+        }
+        size_t firstWord = indices.Allocate(indexWords);
+        if (firstWord == RangeAllocator::Invalid)
+        {
+            growBuffer(ebo, indices, indexWords, IndexAlignment);
+            firstWord = indices.Allocate(indexWords);
+        }
+        if (baseVertex == RangeAllocator::Invalid || firstWord == RangeAllocator::Invalid)
+        {
+            cout << "ERROR::GEOMETRY_POOL:: out of buffer space" << endl;
+            if (baseVertex != RangeAllocator::Invalid)
+                vertices.Free(baseVertex, vertexCount);
+            if (firstWord != RangeAllocator::Invalid)
+                indices.Free(firstWord, indexWords);
+            return false;
+        }
+
+        // uploads go through the copy target, which unlike GL_ELEMENT_ARRAY_BUFFER isn't part of the bound VAO
+        glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, baseVertex * stride, (GLsizeiptr)vertexCount * stride, vertexData);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, ebo);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, firstWord * IndexAlignment, indexBytes, indexData);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+        range.baseVertex = (unsigned int)baseVertex;
+        range.vertexCount = vertexCount;
+        range.indexOffset = (unsigned int)(firstWord * IndexAlignment);
+        range.indexBytes = indexBytes;
+        ranges++;
+        return true;
+    }
+
+    void Free(const GeometryRange &range)
+    {
+        vertices.Free(range.baseVertex, range.vertexCount);
+        indices.Free(range.indexOffset / IndexAlignment, (range.indexBytes + IndexAlignment - 1) / IndexAlignment);
+        ranges--;
+    }
+
+    // the VAO of the pool; valid once something has been allocated
+    unsigned int VAO() const
+    {
+        return vao;
+    }
+
+    Stats GetStats() const
+    {
+        Stats stats;
+        stats.vertexCapacity = vertices.Capacity();
+        stats.verticesUsed = vertices.Used();
+        stats.indexBytesCapacity = indices.Capacity() * IndexAlignment;
+        stats.indexBytesUsed = indices.Used() * IndexAlignment;
+        stats.freeBlocks = vertices.FreeBlocks() + indices.FreeBlocks();
+        stats.fragmentation = max(vertices.Fragmentation(), indices.Fragmentation());
+        stats.ranges = ranges;
+        stats.grows = grows;
+        return stats;
+    }
+
+    void PrintStats(const string &name) const
+    {
+        Stats stats = GetStats();
+        cout << "GEOMETRY_POOL::" << name << " " << stats.ranges << " meshes, vertices " << stats.verticesUsed << "/" << stats.vertexCapacity
+             << ", index bytes " << stats.indexBytesUsed << "/" << stats.indexBytesCapacity << ", " << stats.freeBlocks << " free blocks, fragmentation "
+             << stats.fragmentation * 100.0f << "%, " << stats.grows << " grows" << endl;
+    }
+
+    static BindStats& DrawBindStats()
+    {
+        static BindStats stats = { 0, 0 };
+        return stats;
+    }
+
+    static void PrintBindStats()
+    {
+        const BindStats &stats = DrawBindStats();
+        unsigned long long total = stats.binds + stats.bindsSkipped;
+        cout << "GEOMETRY_POOL:: " << stats.binds << " VAO binds for " << total << " pooled mesh draws ("
+             << (total ? 100.0 * stats.bindsSkipped / total : 0.0) << "% saved)" << endl;
+    }
+
+private:
+    // initial capacities, in vertices and index words
+    static const size_t MinVertices = 64 * 1024;
+    static const size_t MinIndexWords = 192 * 1024;
+
+    GLsizei stride;
+    void (*setupAttributes)(size_t);
+    unsigned int vao, vbo, ebo;
+    RangeAllocator vertices, indices; // indices in units of IndexAlignment bytes
+    unsigned int ranges, grows;
+
+    GeometryPool(const GeometryPool&) = delete;
+    GeometryPool& operator=(const GeometryPool&) = delete;
+
+    // makes room for at least 'needed' more units: doubles the buffer (or more) and copies the old contents over
+    void growBuffer(unsigned int &buffer, RangeAllocator &allocator, size_t needed, size_t unitSize)
+    {
+        size_t minimum = &allocator == &vertices ? MinVertices : MinIndexWords;
+        size_t capacity = max(max(allocator.Capacity() * 2, allocator.Capacity() + needed), minimum);
+
+        unsigned int grown;
+        glGenBuffers(1, &grown);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+        glBufferData(GL_COPY_WRITE_BUFFER, capacity * unitSize, NULL, GL_STATIC_DRAW);
+        if (buffer)
+        {
+            glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, allocator.Capacity() * unitSize);
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            glDeleteBuffers(1, &buffer);
+            grows++;
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        buffer = grown;
+        allocator.Grow(capacity);
+
+        // point the VAO at the new buffers
+        if (!vao)
+            glGenVertexArrays(1, &vao);
+        glBindVertexArray(vao);
+        if (vbo)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, vbo);
+            setupAttributes(0);
+        }
+        if (ebo)
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+        glBindVertexArray(0);
+    }
+};
+
+#endif
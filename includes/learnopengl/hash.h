@@ -0,0 +1,26 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+
+// 64-bit FNV-1a, the hash behind the keys and file names of the caches (MeshCache, ProgramCache, IBLCache). Start from
+// Offset and pass the result of one call to the next to hash several buffers as if they were one.
+namespace Hash
+{
+    const uint64_t Offset = 14695981039346656037ULL;
+    const uint64_t Prime = 1099511628211ULL;
+
+    inline uint64_t FNV1a(uint64_t hash, const void *data, size_t size)
+    {
+        const unsigned char *bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= Prime;
+        }
+        return hash;
+    }
+}
+
+#endif
@@ -0,0 +1,220 @@
+#ifndef IBL_CACHE_H
+#define IBL_CACHE_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/filesystem.h>
+#include <learnopengl/hash.h>
+#include <learnopengl/shader_preprocessor.h>
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <iostream>
+#include <algorithm>
+using namespace std;
+
+// the sizes of the maps the IBL precompute renders; the defaults are the ones of the PBR demos
+struct IBLParameters {
+    int environmentSize;  // faces of the environment cubemap, with a full mip chain
+    int irradianceSize;
+    int prefilterSize;
+    int prefilterLevels;  // the levels of the prefilter map that get rendered, one per roughness step
+    int prefilterSamples; // samples per texel of the rough prefilter levels, where the precompute takes a count
+    int brdfSize;
+
+    IBLParameters() : environmentSize(512), irradianceSize(32), prefilterSize(128), prefilterLevels(5), prefilterSamples(64), brdfSize(512) {}
+
+    int environmentLevels() const
+    {
+        int levels = 1;
+        for (int size = environmentSize; size > 1; size >>= 1)
+            levels++;
+        return levels;
+    }
+};
+
+// the textures the IBL precompute produces: RGB16F cubemaps and an RG16F BRDF lookup table
+struct IBLMaps {
+    unsigned int environment;
+    unsigned int irradiance;
+    unsigned int prefilter;
+    unsigned int brdfLUT;
+
+    IBLMaps() : environment(0), irradiance(0), prefilter(0), brdfLUT(0) {}
+};
+
+// Binary cache of the precomputed IBL maps, stored next to the HDR environment map as "<file>.<id>.iblcache", where the
+// id tells apart the shader sets that precompute maps from the same file (the demos and their fragment and compute
+// paths), so they don't overwrite each other's cache. The maps are read back from the GPU as half floats, so
+// reloading them gives the exact texels the precompute rendered. A cache file is only accepted if its key matches: the
+// key covers the content of the HDR file, the map sizes and the sources of the shaders that render the maps (their
+// sample counts and deltas live there), with their includes expanded.
+class IBLCache
+{
+public:
+    // bump whenever the file layout or the formats of the maps change
+    static const uint32_t Version = 1;
+
+    // the file of a cache only depends on the shader files, so editing them overwrites it
+    static string CachePath(const string &path, const vector<string> &shaderPaths)
+    {
+        uint64_t hash = Hash::Offset;
+        for (unsigned int i = 0; i < shaderPaths.size(); i++)
+            hash = Hash::FNV1a(hash, shaderPaths[i].c_str(), shaderPaths[i].size() + 1);
+        char id[9];
+        snprintf(id, sizeof(id), "%08x", (unsigned int)(hash ^ (hash >> 32)));
+        return path + "." + id + ".iblcache";
+    }
+
+    // computes the cache key of an HDR file for the given parameters and precompute shaders; returns 0 if the file
+    // can't be read.
+    static uint64_t Key(const string &path, const IBLParameters &parameters, const vector<string> &shaderPaths)
+    {
+        FileSystem::MappedFile source(path);
+        if (!source.data())
+            return 0;
+
+        uint64_t hash = Hash::FNV1a(Hash::Offset, source.data(), source.size());
+        for (unsigned int i = 0; i < shaderPaths.size(); i++)
+        {
+            string code;
+            vector<string> files;
+            if (ShaderPreprocessor::Preprocess(shaderPaths[i], vector<string>(), code, files))
+                hash = Hash::FNV1a(hash, code.data(), code.size());
+        }
+
+        const uint64_t layout[] = { Version, (uint64_t)parameters.environmentSize, (uint64_t)parameters.irradianceSize,
+                                    (uint64_t)parameters.prefilterSize, (uint64_t)parameters.prefilterLevels, (uint64_t)parameters.prefilterSamples,
+                                    (uint64_t)parameters.brdfSize };
+        return Hash::FNV1a(hash, layout, sizeof(layout));
+    }
+
+    // creates the maps straight from a memory mapping of a cache file (see CachePath); returns false (and creates
+    // nothing) on a missing, stale or corrupt cache. Must be called on the thread owning the GL context.
+    static bool Load(const string &cachePath, uint64_t key, const IBLParameters &parameters, IBLMaps &maps)
+    {
+        FileSystem::MappedFile file(cachePath);
+        if (!file.data() || key == 0)
+            return false;
+
+        uint32_t magic;
+        uint64_t storedKey;
+        if (file.size() != HeaderSize + DataSize(parameters))
+            return false;
+        memcpy(&magic, file.data(), sizeof(magic));
+        memcpy(&storedKey, file.data() + sizeof(magic), sizeof(storedKey));
+        if (magic != Magic || storedKey != key)
+            return false;
+
+        const unsigned char *data = file.data() + HeaderSize;
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        maps.environment = createCubemap(data, parameters.environmentSize, parameters.environmentLevels(), GL_LINEAR_MIPMAP_LINEAR);
+        maps.irradiance = createCubemap(data, parameters.irradianceSize, 1, GL_LINEAR);
+        maps.prefilter = createCubemap(data, parameters.prefilterSize, parameters.prefilterLevels, GL_LINEAR_MIPMAP_LINEAR);
+
+        glGenTextures(1, &maps.brdfLUT);
+        glBindTexture(GL_TEXTURE_2D, maps.brdfLUT);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, parameters.brdfSize, parameters.brdfSize, 0, GL_RG, GL_HALF_FLOAT, data);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        return true;
+    }
+
+    // reads the maps back from the GPU and writes them to the cache (atomically, see FileSystem::writeFileAtomically).
+    // Waits for the precompute to finish.
+    static bool Store(const string &cachePath, uint64_t key, const IBLParameters &parameters, const IBLMaps &maps)
+    {
+        if (key == 0)
+            return false;
+
+        vector<unsigned char> data(DataSize(parameters));
+        unsigned char *cursor = data.data();
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        readCubemap(maps.environment, parameters.environmentSize, parameters.environmentLevels(), cursor);
+        readCubemap(maps.irradiance, parameters.irradianceSize, 1, cursor);
+        readCubemap(maps.prefilter, parameters.prefilterSize, parameters.prefilterLevels, cursor);
+        glBindTexture(GL_TEXTURE_2D, maps.brdfLUT);
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RG, GL_HALF_FLOAT, cursor);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+        const uint32_t magic = Magic;
+        FileSystem::FileChunk chunks[] = { { &magic, sizeof(magic) }, { &key, sizeof(key) }, { data.data(), data.size() } };
+        if (!FileSystem::writeFileAtomically(cachePath, vector<FileSystem::FileChunk>(chunks, chunks + 3)))
+        {
+            cout << "WARNING::IBL_CACHE:: could not write " << cachePath << endl;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    static const uint32_t Magic = 0x4C42494C; // "LIBL"
+    static const size_t HeaderSize = sizeof(uint32_t) + sizeof(uint64_t);
+
+    // bytes of all faces of the first 'levels' levels of an RGB16F cubemap
+    static size_t CubemapSize(int size, int levels)
+    {
+        size_t bytes = 0;
+        for (int level = 0; level < levels; level++)
+        {
+            size_t levelSize = max(1, size >> level);
+            bytes += levelSize * levelSize * 3 * sizeof(uint16_t) * 6;
+        }
+        return bytes;
+    }
+
+    // the maps follow the header in the order of IBLMaps, every cubemap level by level and face by face
+    static size_t DataSize(const IBLParameters &parameters)
+    {
+        return CubemapSize(parameters.environmentSize, parameters.environmentLevels()) + CubemapSize(parameters.irradianceSize, 1)
+               + CubemapSize(parameters.prefilterSize, parameters.prefilterLevels)
+               + (size_t)parameters.brdfSize * parameters.brdfSize * 2 * sizeof(uint16_t);
+    }
+
+    // creates a cubemap from the texels at 'data' and advances it past them
+    static unsigned int createCubemap(const unsigned char *&data, int size, int levels, GLint minFilter)
+    {
+        unsigned int id;
+        glGenTextures(1, &id);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, id);
+        for (int level = 0; level < levels; level++)
+        {
+            int levelSize = max(1, size >> level);
+            for (unsigned int face = 0; face < 6; face++)
+            {
+                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, GL_RGB16F, levelSize, levelSize, 0, GL_RGB, GL_HALF_FLOAT, data);
+                data += (size_t)levelSize * levelSize * 3 * sizeof(uint16_t);
+            }
+        }
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, minFilter);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        // only the levels that were stored exist, so the chain ends there
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        return id;
+    }
+
+    static void readCubemap(unsigned int cubemap, int size, int levels, unsigned char *&data)
+    {
+        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap);
+        for (int level = 0; level < levels; level++)
+        {
+            int levelSize = max(1, size >> level);
+            for (unsigned int face = 0; face < 6; face++)
+            {
+                glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, GL_RGB, GL_HALF_FLOAT, data);
+                data += (size_t)levelSize * levelSize * 3 * sizeof(uint16_t);
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,229 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/shader_preprocessor.h>
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+using namespace std;
+
+// texture of a mesh: its GL id, the sampler type it's meant for (texture_diffuse, texture_specular, ...) and its file.
+struct Texture {
+    unsigned int id;
+    string type;
+    string path;
+};
+
+// where a texture packed by TextureArrayPacker (texture_array.h) lives: its GL_TEXTURE_2D_ARRAY, its layer, and the
+// scale of its texture coordinates within the layer (below 1 for textures padded to the array's size).
+struct TextureLayer {
+    unsigned int array;
+    float layer;
+    float scale[2];
+
+    TextureLayer() : array(0), layer(0.0f)
+    {
+        scale[0] = scale[1] = 1.0f;
+    }
+};
+
+// The textures of a mesh, bound to fixed texture units: every sampler name of the model convention has its own unit
+// (texture_diffuseN -> N-1, texture_specularN -> 3+N, texture_normalN -> 7+N, texture_heightN -> 11+N, N = 1..4).
+// Because the units never change, a program's sampler uniforms only have to be set once (Resolve), instead of
+// building the names and calling glGetUniformLocation/glUniform1i on every draw. Binding a material compares it with
+// the previously bound one and only rebinds the units that differ, with a single glBindTextures on GL 4.4.
+// Materials of packed textures bind texture arrays to the same units instead (the shaders declare sampler2DArray), so
+// meshes whose textures share arrays don't rebind anything. They pass the layer of the first texture of every type
+// to the shader as 'uniform vec3 textureLayers[4]': (layer, scale s, scale t), see 1.model_loading_arrays.fs.
+class Material
+{
+public:
+    static const unsigned int SlotsPerType = 4;
+    static const unsigned int UnitCount = 16;
+
+    // uniform locations of a program that meshes set per draw; looked up once per program
+    struct ProgramBindings {
+        GLint texCoordTransform;
+        GLint textureLayers;
+    };
+
+    struct Stats {
+        unsigned long long materialBinds;  // Bind calls
+        unsigned long long unitBinds;      // texture units actually rebound
+        unsigned long long unitsSkipped;   // units left alone because they already had the right texture
+        unsigned long long bindCalls;      // GL calls issued for the binds (glBindTextures, or glActiveTexture + glBindTexture)
+    };
+
+    GLuint units[UnitCount]; // texture per unit, 0 if unused
+    unsigned int unitEnd;    // one past the highest used unit
+    GLenum target;           // GL_TEXTURE_2D, or GL_TEXTURE_2D_ARRAY for packed textures
+    GLfloat layers[4][3];    // packed textures: layer and texture coordinate scale of the first texture of each type
+
+    Material() : unitEnd(0), target(GL_TEXTURE_2D)
+    {
+        memset(units, 0, sizeof(units));
+        memset(layers, 0, sizeof(layers));
+    }
+
+    // a material of packed textures: textures[i] is in layers[i].array, whose id the texture already carries
+    Material(const vector<Texture> &textures, const vector<TextureLayer> &textureLayers) : Material(textures)
+    {
+        target = GL_TEXTURE_2D_ARRAY;
+        bool seen[4] = { false, false, false, false };
+        for (unsigned int i = 0; i < textures.size() && i < textureLayers.size(); i++)
+        {
+            int type = typeIndex(textures[i].type);
+            if (type < 0)
+                continue;
+            if (seen[type])
+            {
+                cout << "WARNING::MATERIAL:: only the first " << textures[i].type << " of a packed material has its layer passed" << endl;
+                continue;
+            }
+            seen[type] = true;
+            layers[type][0] = textureLayers[i].layer;
+            layers[type][1] = textureLayers[i].scale[0];
+            layers[type][2] = textureLayers[i].scale[1];
+        }
+    }
+
+    explicit Material(const vector<Texture> &textures) : unitEnd(0), target(GL_TEXTURE_2D)
+    {
+        memset(units, 0, sizeof(units));
+        memset(layers, 0, sizeof(layers));
+        unsigned int used[4] = { 0, 0, 0, 0 };
+        for (unsigned int i = 0; i < textures.size(); i++)
+        {
+            int type = typeIndex(textures[i].type);
+            if (type < 0 || used[type] == SlotsPerType)
+            {
+                cout << "WARNING::MATERIAL:: no texture unit left for " << textures[i].type << " " << textures[i].path << endl;
+                continue;
+            }
+            unsigned int unit = type * SlotsPerType + used[type]++;
+            units[unit] = textures[i].id;
+            unitEnd = max(unitEnd, unit + 1);
+        }
+    }
+
+    // points the sampler uniforms of a program at their fixed units (the first time a program is seen) and returns
+    // its per-draw uniform locations. The program must be the current one.
+    static const ProgramBindings& Resolve(GLuint program)
+    {
+        unordered_map<GLuint, ProgramBindings> &programs = resolvedPrograms();
+        unordered_map<GLuint, ProgramBindings>::iterator it = programs.find(program);
+        if (it != programs.end())
+            return it->second;
+
+        const char *types[4] = { "texture_diffuse", "texture_specular", "texture_normal", "texture_height" };
+        for (unsigned int type = 0; type < 4; type++)
+        {
+            for (unsigned int slot = 0; slot < SlotsPerType; slot++)
+            {
+                GLint location = glGetUniformLocation(program, (types[type] + to_string(slot + 1)).c_str());
+                if (location >= 0)
+                    glUniform1i(location, type * SlotsPerType + slot);
+            }
+        }
+        ProgramBindings bindings;
+        bindings.texCoordTransform = glGetUniformLocation(program, "texCoordTransform");
+        bindings.textureLayers = glGetUniformLocation(program, "textureLayers");
+        return programs[program] = bindings;
+    }
+
+    // drops what Resolve knows about a program, so a new program that gets its id is set up again. Programs deleted
+    // through ShaderPermutations::Release are forgotten by themselves; call this for programs deleted otherwise.
+    static void ForgetProgram(GLuint program)
+    {
+        resolvedPrograms().erase(program);
+    }
+
+    // binds the material's textures; units that already hold the same texture in 'previous' (the material bound
+    // right before, or NULL if unknown) are skipped. Leaves an arbitrary texture unit active.
+    void Bind(const Material *previous) const
+    {
+        Stats &stats = GetStats();
+        stats.materialBinds++;
+
+        unsigned int first = UnitCount, last = 0;
+        for (unsigned int unit = 0; unit < unitEnd; unit++)
+        {
+            if (units[unit] == 0 || (previous && previous->units[unit] == units[unit]))
+            {
+                if (units[unit] != 0)
+                    stats.unitsSkipped++;
+                continue;
+            }
+            first = min(first, unit);
+            last = unit;
+            stats.unitBinds++;
+        }
+        if (first == UnitCount)
+            return;
+
+        if (multiBind())
+        {
+            // units in the range that didn't change are passed again, which is cheaper than splitting the call;
+            // unused units keep their binding, so a 0 is replaced by what's there according to 'previous'
+            GLuint range[UnitCount];
+            for (unsigned int unit = first; unit <= last; unit++)
+                range[unit - first] = units[unit] != 0 || !previous ? units[unit] : previous->units[unit];
+            glBindTextures(first, last - first + 1, range);
+            stats.bindCalls++;
+            return;
+        }
+        for (unsigned int unit = first; unit <= last; unit++)
+        {
+            if (units[unit] == 0 || (previous && previous->units[unit] == units[unit]))
+                continue;
+            glActiveTexture(GL_TEXTURE0 + unit);
+            glBindTexture(target, units[unit]);
+            stats.bindCalls += 2;
+        }
+    }
+
+    static Stats& GetStats()
+    {
+        static Stats stats = { 0, 0, 0, 0 };
+        return stats;
+    }
+
+    static void PrintStats()
+    {
+        const Stats &stats = GetStats();
+        cout << "MATERIAL:: " << stats.materialBinds << " material binds, " << stats.unitBinds << " texture units bound, "
+             << stats.unitsSkipped << " skipped as redundant, " << stats.bindCalls << " GL calls"
+             << (multiBind() ? " (glBindTextures)" : " (glActiveTexture + glBindTexture)") << endl;
+    }
+
+private:
+    static int typeIndex(const string &type)
+    {
+        if (type == "texture_diffuse")  return 0;
+        if (type == "texture_specular") return 1;
+        if (type == "texture_normal")   return 2;
+        if (type == "texture_height")   return 3;
+        return -1;
+    }
+
+    // glBindTextures is GL 4.4; older contexts bind unit by unit
+    static bool multiBind()
+    {
+        return GLAD_GL_VERSION_4_4 && glBindTextures;
+    }
+
+    static unordered_map<GLuint, ProgramBindings>& resolvedPrograms()
+    {
+        static unordered_map<GLuint, ProgramBindings> programs;
+        static bool forgetsReleased = (ShaderPermutations::Get().AddReleaseCallback(&Material::ForgetProgram), true);
+        (void)forgetsReleased;
+        return programs;
+    }
+};
+
+#endif
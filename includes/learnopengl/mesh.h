@@ -7,99 +7,255 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <learnopengl/shader.h>
+#include <learnopengl/vertex_format.h>
+#include <learnopengl/geometry_pool.h>
+#include <learnopengl/material.h>
 
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <vector>
+#include <cstring>
+#include <cmath>
 using namespace std;
 
-struct Vertex {
-    // position
-    glm::vec3 Position;
-    // normal
-    glm::vec3 Normal;
-    // texCoords
-    glm::vec2 TexCoords;
-    // tangent
-    glm::vec3 Tangent;
-    // bitangent
-    glm::vec3 Bitangent;
+// the layout the vertices are uploaded in, see vertex_format.h
+enum MeshVertexFormat {
+    MESH_VERTEX_FULL,    // FullVertex: 56 bytes, float attributes
+    MESH_VERTEX_COMPACT  // CompactVertex: 24 bytes, shaders need octDecode for normals/tangents and 'texCoordTransform'
 };
 
-struct Texture {
-    unsigned int id;
-    string type;
-    string path;
+// a level of detail: a range of the mesh's index buffer and how far it deviates from the full mesh (in model units)
+struct MeshLod {
+    unsigned int firstIndex;
+    unsigned int indexCount;
+    float error;
 };
 
+// the vertices, indices and LOD levels a mesh is created from, wherever they are stored: in the vectors of an import
+// or straight in a mapped mesh cache
+struct MeshGeometry {
+    const Vertex *vertices;
+    const unsigned int *indices;
+    const MeshLod *lods;
+    unsigned int vertexCount, indexCount, lodCount;
+
+    MeshGeometry() : vertices(nullptr), indices(nullptr), lods(nullptr), vertexCount(0), indexCount(0), lodCount(0) {}
+    MeshGeometry(const vector<Vertex> &vertices, const vector<unsigned int> &indices, const vector<MeshLod> &lods)
+        : vertices(vertices.data()), indices(indices.data()), lods(lods.data()),
+          vertexCount((unsigned int)vertices.size()), indexCount((unsigned int)indices.size()), lodCount((unsigned int)lods.size()) {}
+};
+
+// picks LOD levels by the screen-space size of their error
+struct LodSelection {
+    float pixelsPerUnit;  // projected size in pixels of one unit at distance 1
+    float maxPixelError;  // the largest error that is allowed to show on screen
+
+    LodSelection(float fovy, float viewportHeight, float maxPixelError = 1.0f)
+        : pixelsPerUnit(viewportHeight / (2.0f * tan(fovy * 0.5f))), maxPixelError(maxPixelError) {}
+
+    // projected size in pixels of an error at the given distance (both in the same units)
+    float ScreenError(float error, float distance) const
+    {
+        return error * pixelsPerUnit / max(distance, 1e-4f);
+    }
+};
+
+// meshes with up to this many vertices are drawn with 16 bit indices; Model splits larger ones at load
+const unsigned int MaxShortIndexVertices = 65536;
+
+// the smallest index type that can address a mesh's vertices. 8 bit indices are opt-in: many GPUs don't fetch them
+// natively and the driver converts them on every draw, which costs more than the few bytes saved.
+inline GLenum IndexTypeFor(size_t vertexCount, bool allowByteIndices = false)
+{
+    if(allowByteIndices && vertexCount <= 256)
+        return GL_UNSIGNED_BYTE;
+    if(vertexCount <= MaxShortIndexVertices)
+        return GL_UNSIGNED_SHORT;
+    return GL_UNSIGNED_INT;
+}
+
+// bytes per index of an index type
+inline unsigned int IndexTypeSize(GLenum type)
+{
+    return type == GL_UNSIGNED_BYTE ? 1 : type == GL_UNSIGNED_SHORT ? 2 : 4;
+}
+
+// the indices stored as 'type', as bytes for the index buffer. 32 bit indices are returned as they are, the smaller
+// types are packed into 'storage'.
+inline const void* PackIndices(const unsigned int *indices, size_t count, GLenum type, vector<unsigned char> &storage)
+{
+    if(type == GL_UNSIGNED_INT)
+        return indices;
+    storage.resize(count * IndexTypeSize(type));
+    if(type == GL_UNSIGNED_BYTE)
+        for(size_t i = 0; i < count; i++)
+            storage[i] = (unsigned char)indices[i];
+    else
+        for(size_t i = 0; i < count; i++)
+            reinterpret_cast<unsigned short*>(storage.data())[i] = (unsigned short)indices[i];
+    return storage.data();
+}
+
 class Mesh {
 public:
     /*  Mesh Data  */
-    vector<Vertex> vertices;
-    vector<unsigned int> indices;
+    vector<Vertex> vertices;      // the CPU copy of the geometry, empty unless the mesh was asked to keep it
+    vector<unsigned int> indices; // all LOD levels, each level is a range in here; uploaded as indexType
     vector<Texture> textures;
+    Material material;            // the textures on their fixed units, created once the texture ids are known
+    vector<MeshLod> lods;         // from full detail to coarsest; always has at least one level
     unsigned int VAO;
+    MeshVertexFormat vertexFormat;
+    GLenum indexType;            // GL_UNSIGNED_BYTE/SHORT/INT, the smallest that fits the vertex count, see IndexTypeFor
+    glm::vec4 texCoordTransform; // maps quantized texture coordinates back to the mesh's range (scale xy, offset zw)
+    bool pooled;                 // the geometry lives in the shared GeometryPool of its vertex format; VAO is the pool's
+    GeometryRange range;         // where, if pooled
+    float texCoordDensity;       // texture coordinate units per model unit, averaged over the full detail triangles
 
     /*  Functions  */
     // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, MeshVertexFormat vertexFormat = MESH_VERTEX_FULL,
+         vector<MeshLod> lods = vector<MeshLod>(), bool pooled = false, bool allowByteIndices = false)
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
-
-        // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        init(MeshGeometry(vertices, indices, lods), textures, vertexFormat, pooled, allowByteIndices);
+        this->vertices.swap(vertices);
+        this->indices.swap(indices);
     }
 
-    // render the mesh
-    void Draw(Shader shader) 
+    // uploads the geometry from wherever it is stored; it only has to stay valid during the call. The vertices and
+    // indices are only copied into the mesh with 'keepGeometry'.
+    Mesh(const MeshGeometry &geometry, vector<Texture> textures, MeshVertexFormat vertexFormat, bool pooled, bool allowByteIndices,
+         bool keepGeometry)
     {
-        // bind appropriate textures
-        unsigned int diffuseNr  = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr   = 1;
-        unsigned int heightNr   = 1;
-        for(unsigned int i = 0; i < textures.size(); i++)
+        init(geometry, textures, vertexFormat, pooled, allowByteIndices);
+        if(keepGeometry)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if(name == "texture_diffuse")
-				number = std::to_string(diffuseNr++);
-			else if(name == "texture_specular")
-				number = std::to_string(specularNr++); // transfer unsigned int to stream
-            else if(name == "texture_normal")
-				number = std::to_string(normalNr++); // transfer unsigned int to stream
-             else if(name == "texture_height")
-			    number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-													 // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            this->vertices.assign(geometry.vertices, geometry.vertices + geometry.vertexCount);
+            this->indices.assign(geometry.indices, geometry.indices + geometry.indexCount);
         }
-        
+    }
+
+    // render the mesh, optionally at a coarser level of detail
+    void Draw(const Shader &shader, unsigned int lod = 0) 
+    {
+        bindMaterial(shader, NULL);
+
         // draw mesh
         glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+        drawElements(lod);
         glBindVertexArray(0);
 
         // always good practice to set everything back to defaults once configured.
         glActiveTexture(GL_TEXTURE0);
     }
 
+    // render the mesh with its VAO already bound by the caller; lets pooled meshes share one VAO bind.
+    // 'previous' is the material of the mesh drawn right before (NULL if unknown), its textures aren't bound again.
+    // Leaves an arbitrary texture unit active.
+    void DrawBatched(const Shader &shader, unsigned int lod, const Material *previous)
+    {
+        bindMaterial(shader, previous);
+        drawElements(lod);
+    }
+
+    // gives the mesh's range in the geometry pool back; for the owner of the mesh to call once it's done with it.
+    void ReleaseGeometry()
+    {
+        if(pooled)
+            Pool(vertexFormat).Free(range);
+        pooled = false;
+    }
+
+    // the pool shared by all pooled meshes of a vertex format
+    static GeometryPool& Pool(MeshVertexFormat format)
+    {
+        static GeometryPool full(sizeof(FullVertex), &FullVertex::SetupAttributes);
+        static GeometryPool compact(sizeof(CompactVertex), &CompactVertex::SetupAttributes);
+        return format == MESH_VERTEX_COMPACT ? compact : full;
+    }
+
+    // the coarsest level whose error stays below the selection's pixel threshold at the given distance (in model units)
+    unsigned int SelectLod(float distance, const LodSelection &selection) const
+    {
+        unsigned int lod = 0;
+        while(lod + 1 < lods.size() && selection.ScreenError(lods[lod + 1].error, distance) <= selection.maxPixelError)
+            lod++;
+        return lod;
+    }
+
+    // bytes per vertex in the vertex buffer
+    unsigned int VertexStride() const
+    {
+        return vertexFormat == MESH_VERTEX_COMPACT ? sizeof(CompactVertex) : sizeof(FullVertex);
+    }
+
+    // bytes per index in the index buffer
+    unsigned int IndexSize() const
+    {
+        return IndexTypeSize(indexType);
+    }
+
+    // byte offset of a level's first index in the bound element buffer, as glDrawElements* expects it
+    const void* IndexOffset(unsigned int lod) const
+    {
+        return (const void*)((size_t)(pooled ? range.indexOffset : 0) + (size_t)lods[lod].firstIndex * IndexSize());
+    }
+
 private:
     /*  Render data  */
     unsigned int VBO, EBO;
 
     /*  Functions    */
+    void init(const MeshGeometry &geometry, const vector<Texture> &textures, MeshVertexFormat vertexFormat, bool pooled, bool allowByteIndices)
+    {
+        this->textures = textures;
+        this->material = Material(textures);
+        this->lods.assign(geometry.lods, geometry.lods + geometry.lodCount);
+        if(this->lods.empty())
+        {
+            MeshLod full = { 0, geometry.indexCount, 0.0f };
+            this->lods.push_back(full);
+        }
+        this->vertexFormat = vertexFormat;
+        this->indexType = IndexTypeFor(geometry.vertexCount, allowByteIndices);
+        this->texCoordTransform = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+        this->pooled = pooled;
+        this->texCoordDensity = computeTexCoordDensity(geometry);
+
+        // now that we have all the required data, set the vertex buffers and its attribute pointers.
+        setupMesh(geometry);
+    }
+
     // initializes all the buffer objects/arrays
-    void setupMesh()
+    void setupMesh(const MeshGeometry &geometry)
     {
+        VertexQuantization quantization;
+        if(vertexFormat == MESH_VERTEX_COMPACT)
+        {
+            quantization = VertexQuantization::FromVertices(geometry.vertices, geometry.vertexCount);
+            texCoordTransform = quantization.TexCoordTransform();
+        }
+        VBO = EBO = 0;
+        // an empty mesh has nothing to upload; its VAO only keeps Draw working, which draws nothing
+        if(geometry.vertexCount == 0 || geometry.indexCount == 0)
+        {
+            pooled = false;
+            glGenVertexArrays(1, &VAO);
+            return;
+        }
+        if(pooled)
+        {
+            // the data goes into the shared buffers of the vertex format instead
+            if(vertexFormat == MESH_VERTEX_COMPACT)
+                pooled = allocatePooled<CompactVertex>(geometry, quantization);
+            else
+                pooled = allocatePooled<FullVertex>(geometry, quantization);
+            if(pooled)
+                return;
+        }
+
         // create buffers/arrays
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
@@ -108,32 +264,86 @@ private:
         glBindVertexArray(VAO);
         // load data into vertex buffers
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);  
+        // the vertex format generates both the packed vertex struct and the matching attribute pointers.
+        if(vertexFormat == MESH_VERTEX_COMPACT)
+            uploadVertices<CompactVertex>(geometry, quantization);
+        else
+            uploadVertices<FullVertex>(geometry, quantization);
 
+        vector<unsigned char> packedIndices;
+        const void *indexData = PackIndices(geometry.indices, geometry.indexCount, indexType, packedIndices);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);	
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);	
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);	
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, (size_t)geometry.indexCount * IndexSize(), indexData, GL_STATIC_DRAW);
 
         glBindVertexArray(0);
     }
+
+    // square root of the texture coordinate area over the model space area of the full detail triangles: how far the
+    // texture coordinates move along a unit of the surface, on average. Used to estimate how much texture detail a mesh
+    // shows on screen.
+    float computeTexCoordDensity(const MeshGeometry &geometry) const
+    {
+        const Vertex *vertices = geometry.vertices;
+        const unsigned int *indices = geometry.indices;
+        double uvArea = 0.0, area = 0.0;
+        for(unsigned int i = 0; i + 2 < lods[0].indexCount; i += 3)
+        {
+            const Vertex &a = vertices[indices[lods[0].firstIndex + i]];
+            const Vertex &b = vertices[indices[lods[0].firstIndex + i + 1]];
+            const Vertex &c = vertices[indices[lods[0].firstIndex + i + 2]];
+            glm::vec2 uv1 = b.TexCoords - a.TexCoords, uv2 = c.TexCoords - a.TexCoords;
+            uvArea += 0.5 * fabs(uv1.x * uv2.y - uv1.y * uv2.x);
+            area += 0.5 * glm::length(glm::cross(b.Position - a.Position, c.Position - a.Position));
+        }
+        return area > 0.0 ? (float)sqrt(uvArea / area) : 0.0f;
+    }
+
+    // binds the material's textures and sets the per-mesh uniforms, with the locations resolved once per program
+    void bindMaterial(const Shader &shader, const Material *previous)
+    {
+        const Material::ProgramBindings &program = Material::Resolve(shader.ID);
+        material.Bind(previous);
+        // identity for full float vertices, so shaders shared between both formats read the right coordinates
+        if(program.texCoordTransform >= 0)
+            glUniform4fv(program.texCoordTransform, 1, &texCoordTransform[0]);
+        if(material.target == GL_TEXTURE_2D_ARRAY && program.textureLayers >= 0)
+            glUniform3fv(program.textureLayers, 4, &material.layers[0][0]);
+    }
+
+    // draws the level's index range from the bound VAO
+    void drawElements(unsigned int lod)
+    {
+        if(lods[lod].indexCount == 0)
+            return;
+        if(pooled)
+            glDrawElementsBaseVertex(GL_TRIANGLES, lods[lod].indexCount, indexType, IndexOffset(lod), range.baseVertex);
+        else
+            glDrawElements(GL_TRIANGLES, lods[lod].indexCount, indexType, IndexOffset(lod));
+    }
+
+    // encodes the vertices, uploads them to the bound VBO and declares the attribute pointers
+    template<typename Format>
+    void uploadVertices(const MeshGeometry &geometry, const VertexQuantization &quantization)
+    {
+        vector<Format> packed;
+        const void *vertexData = EncodeVertices<Format>(geometry.vertices, geometry.vertexCount, quantization, packed);
+        glBufferData(GL_ARRAY_BUFFER, (size_t)geometry.vertexCount * sizeof(Format), vertexData, GL_STATIC_DRAW);
+        Format::SetupAttributes();
+    }
+
+    // encodes the vertices and places them and the indices in the format's pool
+    template<typename Format>
+    bool allocatePooled(const MeshGeometry &geometry, const VertexQuantization &quantization)
+    {
+        vector<Format> packed;
+        vector<unsigned char> packedIndices;
+        const void *vertexData = EncodeVertices<Format>(geometry.vertices, geometry.vertexCount, quantization, packed);
+        const void *indexData = PackIndices(geometry.indices, geometry.indexCount, indexType, packedIndices);
+        GeometryPool &pool = Pool(vertexFormat);
+        if(!pool.Allocate(vertexData, geometry.vertexCount, indexData, geometry.indexCount * IndexSize(), range))
+            return false;
+        VAO = pool.VAO();
+        return true;
+    }
 };
 #endif
@@ -0,0 +1,367 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/filesystem.h>
+#include <learnopengl/hash.h>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+using namespace std;
+
+// CPU-side result of importing a single mesh, before any GL objects exist.
+// The textures only carry their type and path at this point; the ids are filled in by the Model on upload.
+struct MeshData {
+    vector<Vertex> vertices;
+    vector<unsigned int> indices;
+    vector<Texture> textures;
+    vector<MeshLod> lods; // empty if no LOD chain was generated
+    // meshes read by MeshCache::Load leave the vectors above empty and point into the mapped cache file instead,
+    // which stays open as long as one of its meshes holds on to it
+    MeshGeometry mapped;
+    shared_ptr<FileSystem::MappedFile> mapping;
+
+    // the geometry to create the Mesh from, wherever it is stored
+    MeshGeometry Geometry() const
+    {
+        return mapping ? mapped : MeshGeometry(vertices, indices, lods);
+    }
+};
+
+// Versioned binary cache of processed model data, stored next to the source file as "<file>.meshcache".
+// A cache file is only accepted if its key matches: the key covers the content of the model file (and the
+// material libraries it references), the importer options and the in-memory Vertex layout. The cache also records
+// the size and modification time of those files, so as long as none of them changed, the key is computed from the
+// content hash stored with them instead of hashing the files again.
+class MeshCache
+{
+public:
+    // bump whenever the file layout or the meaning of the cached data changes
+    static const uint32_t Version = 4;
+
+    // size and modification time of a file the key was computed from
+    struct SourceStamp {
+        string path;
+        unsigned long long size;
+        unsigned long long modified;
+    };
+
+    // what a key was computed from: the hash of the model file and its material libraries, and their stamps
+    struct Sources {
+        uint64_t hash;
+        vector<SourceStamp> stamps;
+
+        Sources() : hash(0) {}
+    };
+
+    static string CachePath(const string &path)
+    {
+        return path + ".meshcache";
+    }
+
+    // computes the cache key of a model file for the given importer options; returns 0 if the file can't be read.
+    // The files are only hashed if the cache is missing or one of them changed since it was written. Pass 'sources'
+    // on to Store so the cache records what the key was computed from.
+    static uint64_t Key(const string &path, uint64_t options, Sources *sources = nullptr)
+    {
+        Sources current;
+        if (!storedSources(path, current) && !hashSources(path, current))
+            return 0;
+        if (sources)
+            *sources = current;
+
+        const uint64_t layout[] = { options, Version, sizeof(Vertex), sizeof(unsigned int) };
+        return Hash::FNV1a(current.hash, layout, sizeof(layout));
+    }
+
+    // reads the cache belonging to 'path' straight from a memory mapping; returns false on a missing, stale or corrupt cache.
+    static bool Load(const string &path, uint64_t key, vector<MeshData> &meshes)
+    {
+        if (key == 0)
+            return false;
+        shared_ptr<FileSystem::MappedFile> file = make_shared<FileSystem::MappedFile>(CachePath(path));
+        if (!file->data())
+            return false;
+
+        Reader reader(file->data(), file->size());
+        uint32_t magic;
+        uint64_t storedKey;
+        uint32_t meshCount;
+        if (!reader.read(&magic, sizeof(magic)) || magic != Magic)
+            return false;
+        if (!reader.read(&storedKey, sizeof(storedKey)) || storedKey != key)
+            return false;
+        Sources sources;
+        if (!readSources(reader, sources) || !reader.read(&meshCount, sizeof(meshCount)))
+            return false;
+
+        vector<MeshData> result(meshCount);
+        for (unsigned int i = 0; i < meshCount; i++)
+        {
+            MeshData &mesh = result[i];
+            uint32_t vertexCount, indexCount, textureCount, lodCount;
+            if (!reader.read(&vertexCount, sizeof(vertexCount)) || !reader.read(&indexCount, sizeof(indexCount)) || !reader.read(&textureCount, sizeof(textureCount))
+                || !reader.read(&lodCount, sizeof(lodCount)))
+                return false;
+
+            mesh.textures.resize(textureCount);
+            for (unsigned int j = 0; j < textureCount; j++)
+            {
+                mesh.textures[j].id = 0;
+                if (!reader.readString(mesh.textures[j].type) || !reader.readString(mesh.textures[j].path))
+                    return false;
+            }
+
+            const Vertex *vertices = static_cast<const Vertex*>(reader.view(vertexCount * sizeof(Vertex), alignof(Vertex)));
+            const unsigned int *indices = static_cast<const unsigned int*>(reader.view(indexCount * sizeof(unsigned int), alignof(unsigned int)));
+            const MeshLod *lods = static_cast<const MeshLod*>(reader.view(lodCount * sizeof(MeshLod), alignof(MeshLod)));
+            if (!vertices || !indices || !lods)
+                return false;
+            for (unsigned int j = 0; j < lodCount; j++)
+                if (lods[j].firstIndex > indexCount || lods[j].indexCount > indexCount - lods[j].firstIndex)
+                    return false;
+            mesh.mapped.vertices = vertices;
+            mesh.mapped.indices = indices;
+            mesh.mapped.lods = lods;
+            mesh.mapped.vertexCount = vertexCount;
+            mesh.mapped.indexCount = indexCount;
+            mesh.mapped.lodCount = lodCount;
+            mesh.mapping = file;
+        }
+
+        meshes.swap(result);
+        return true;
+    }
+
+    // writes the processed meshes to the cache, atomically (see FileSystem::writeFileAtomically).
+    // Without the 'sources' of the key, the next Key call hashes the files again.
+    static bool Store(const string &path, uint64_t key, const vector<MeshData> &meshes, const Sources *sources = nullptr)
+    {
+        if (key == 0)
+            return false;
+
+        Writer writer;
+        uint32_t meshCount = (uint32_t)meshes.size();
+        const uint32_t magic = Magic;
+        writer.write(&magic, sizeof(magic));
+        writer.write(&key, sizeof(key));
+        const uint64_t sourceHash = sources ? sources->hash : 0;
+        const uint32_t stampCount = sources ? (uint32_t)sources->stamps.size() : 0;
+        writer.write(&sourceHash, sizeof(sourceHash));
+        writer.write(&stampCount, sizeof(stampCount));
+        for (unsigned int i = 0; i < stampCount; i++)
+        {
+            writer.writeString(sources->stamps[i].path);
+            writer.write(&sources->stamps[i].size, sizeof(sources->stamps[i].size));
+            writer.write(&sources->stamps[i].modified, sizeof(sources->stamps[i].modified));
+        }
+        writer.write(&meshCount, sizeof(meshCount));
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            const MeshData &mesh = meshes[i];
+            MeshGeometry geometry = mesh.Geometry();
+            uint32_t vertexCount = geometry.vertexCount;
+            uint32_t indexCount = geometry.indexCount;
+            uint32_t textureCount = (uint32_t)mesh.textures.size();
+            uint32_t lodCount = geometry.lodCount;
+            writer.write(&vertexCount, sizeof(vertexCount));
+            writer.write(&indexCount, sizeof(indexCount));
+            writer.write(&textureCount, sizeof(textureCount));
+            writer.write(&lodCount, sizeof(lodCount));
+            for (unsigned int j = 0; j < textureCount; j++)
+            {
+                writer.writeString(mesh.textures[j].type);
+                writer.writeString(mesh.textures[j].path);
+            }
+            // keep the bulk arrays aligned so they can be used in-place from the mapping
+            writer.align(alignof(Vertex));
+            writer.write(geometry.vertices, vertexCount * sizeof(Vertex));
+            writer.align(alignof(unsigned int));
+            writer.write(geometry.indices, indexCount * sizeof(unsigned int));
+            writer.align(alignof(MeshLod));
+            writer.write(geometry.lods, lodCount * sizeof(MeshLod));
+        }
+        string cachePath = CachePath(path);
+        FileSystem::FileChunk chunk = { writer.bytes.data(), writer.bytes.size() };
+        if (!FileSystem::writeFileAtomically(cachePath, vector<FileSystem::FileChunk>(1, chunk)))
+        {
+            cout << "WARNING::MESH_CACHE:: could not write " << cachePath << endl;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    static const uint32_t Magic = 0x48534D4C; // "LMSH"
+
+    // hashes the model file and the material libraries it references, stamping each file before it's read so a change
+    // made while hashing shows up as a changed stamp next time
+    static bool hashSources(const string &path, Sources &sources)
+    {
+        sources.stamps.clear();
+        if (!addStamp(path, sources))
+            return false;
+        FileSystem::MappedFile source(path);
+        if (!source.data())
+            return false;
+
+        uint64_t hash = Hash::FNV1a(Hash::Offset, source.data(), source.size());
+        // OBJ files keep their materials in separate libraries, so changes to those have to invalidate the cache too
+        string directory = path.substr(0, path.find_last_of('/'));
+        vector<string> libraries = findMaterialLibraries(source.data(), source.size());
+        for (unsigned int i = 0; i < libraries.size(); i++)
+        {
+            string libraryPath = directory + '/' + libraries[i];
+            // a missing library keeps a stamp that never matches, so its appearance is noticed
+            if (!addStamp(libraryPath, sources))
+                continue;
+            FileSystem::MappedFile library(libraryPath);
+            if (library.data())
+                hash = Hash::FNV1a(hash, library.data(), library.size());
+        }
+        sources.hash = hash;
+        return true;
+    }
+
+    static bool addStamp(const string &path, Sources &sources)
+    {
+        SourceStamp stamp;
+        stamp.path = path;
+        bool found = FileSystem::getFileStamp(path, stamp.size, stamp.modified);
+        if (!found)
+            stamp.size = stamp.modified = ~0ULL;
+        sources.stamps.push_back(stamp);
+        return found;
+    }
+
+    // the sources recorded in the cache of 'path', if every file still has the size and modification time it had
+    static bool storedSources(const string &path, Sources &sources)
+    {
+        FileSystem::MappedFile file(CachePath(path));
+        if (!file.data())
+            return false;
+        Reader reader(file.data(), file.size());
+        uint32_t magic;
+        uint64_t storedKey;
+        if (!reader.read(&magic, sizeof(magic)) || magic != Magic || !reader.read(&storedKey, sizeof(storedKey)))
+            return false;
+        if (!readSources(reader, sources) || sources.stamps.empty() || sources.stamps[0].path != path)
+            return false;
+        for (unsigned int i = 0; i < sources.stamps.size(); i++)
+        {
+            unsigned long long size, modified;
+            if (!FileSystem::getFileStamp(sources.stamps[i].path, size, modified)
+                || size != sources.stamps[i].size || modified != sources.stamps[i].modified)
+                return false;
+        }
+        return true;
+    }
+
+    static vector<string> findMaterialLibraries(const unsigned char *data, size_t size)
+    {
+        vector<string> libraries;
+        const char *text = reinterpret_cast<const char*>(data);
+        size_t lineStart = 0;
+        while (lineStart < size)
+        {
+            size_t lineEnd = lineStart;
+            while (lineEnd < size && text[lineEnd] != '\n')
+                lineEnd++;
+            if (lineEnd - lineStart > 7 && strncmp(text + lineStart, "mtllib ", 7) == 0)
+            {
+                string name(text + lineStart + 7, lineEnd - lineStart - 7);
+                while (!name.empty() && (name.back() == '\r' || name.back() == ' '))
+                    name.pop_back();
+                libraries.push_back(name);
+            }
+            lineStart = lineEnd + 1;
+        }
+        return libraries;
+    }
+
+    // bounds-checked cursor over the mapped cache file
+    struct Reader
+    {
+        const unsigned char *data;
+        size_t size;
+        size_t offset;
+
+        Reader(const unsigned char *data, size_t size) : data(data), size(size), offset(0) {}
+
+        const void* view(size_t bytes, size_t alignment)
+        {
+            offset = (offset + alignment - 1) & ~(alignment - 1);
+            if (offset > size || bytes > size - offset)
+                return nullptr;
+            const void *result = data + offset;
+            offset += bytes;
+            return result;
+        }
+        bool read(void *dst, size_t bytes)
+        {
+            if (offset > size || bytes > size - offset)
+                return false;
+            memcpy(dst, data + offset, bytes);
+            offset += bytes;
+            return true;
+        }
+        bool readString(string &str)
+        {
+            uint32_t length;
+            if (!read(&length, sizeof(length)) || offset > size || length > size - offset)
+                return false;
+            str.assign(reinterpret_cast<const char*>(data + offset), length);
+            offset += length;
+            return true;
+        }
+    };
+
+    // the content hash and file stamps that follow the key in a cache file
+    static bool readSources(Reader &reader, Sources &sources)
+    {
+        uint32_t stampCount;
+        if (!reader.read(&sources.hash, sizeof(sources.hash)) || !reader.read(&stampCount, sizeof(stampCount)))
+            return false;
+        sources.stamps.clear();
+        for (unsigned int i = 0; i < stampCount; i++)
+        {
+            SourceStamp stamp;
+            if (!reader.readString(stamp.path) || !reader.read(&stamp.size, sizeof(stamp.size))
+                || !reader.read(&stamp.modified, sizeof(stamp.modified)))
+                return false;
+            sources.stamps.push_back(stamp);
+        }
+        return true;
+    }
+
+    // collects the cache file in memory, so it can be written in one go
+    struct Writer
+    {
+        vector<unsigned char> bytes;
+
+        void write(const void *src, size_t size)
+        {
+            const unsigned char *data = static_cast<const unsigned char*>(src);
+            bytes.insert(bytes.end(), data, data + size);
+        }
+        void writeString(const string &str)
+        {
+            uint32_t length = (uint32_t)str.size();
+            write(&length, sizeof(length));
+            write(str.data(), length);
+        }
+        void align(size_t alignment)
+        {
+            static const unsigned char zeros[16] = { 0 };
+            size_t padding = ((bytes.size() + alignment - 1) & ~(alignment - 1)) - bytes.size();
+            write(zeros, padding);
+        }
+    };
+};
+
+#endif
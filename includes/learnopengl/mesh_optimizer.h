@@ -0,0 +1,387 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <iostream>
+using namespace std;
+
+// Post-import optimizations for indexed triangle meshes: vertex welding, Forsyth-style triangle ordering for the
+// post-transform vertex cache, cluster ordering to reduce overdraw and vertex reordering for linear fetches.
+// All steps keep the rendered result identical; they only change the order (and number of copies) of the data.
+namespace MeshOptimizer
+{
+    // size of the FIFO cache used to measure the results. Real hardware differs, but a 16-32 entry FIFO is a fair model.
+    const unsigned int StatsCacheSize = 16;
+
+    struct CacheStats {
+        float acmr; // average cache miss ratio: transformed vertices per triangle, 0.5 is ideal and 3.0 is worst case
+        float atvr; // average transform to vertex ratio: transformed vertices per unique vertex, 1.0 is ideal
+    };
+
+    // simulates a FIFO post-transform cache over the index buffer
+    inline CacheStats AnalyzeVertexCache(const vector<unsigned int> &indices, unsigned int vertexCount, unsigned int cacheSize = StatsCacheSize)
+    {
+        CacheStats stats = { 0.0f, 0.0f };
+        if (indices.empty() || vertexCount == 0)
+            return stats;
+
+        vector<unsigned int> timestamps(vertexCount, 0);
+        vector<bool> used(vertexCount, false);
+        unsigned int time = cacheSize + 1;
+        unsigned int misses = 0;
+        unsigned int unique = 0;
+        for (unsigned int i = 0; i < indices.size(); i++)
+        {
+            unsigned int v = indices[i];
+            if (time - timestamps[v] > cacheSize)
+            {
+                timestamps[v] = time++;
+                misses++;
+            }
+            if (!used[v])
+            {
+                used[v] = true;
+                unique++;
+            }
+        }
+        stats.acmr = (float)misses / (indices.size() / 3);
+        stats.atvr = (float)misses / unique;
+        return stats;
+    }
+
+    // merges vertices with identical attributes and rewrites the indices; returns the new vertex count.
+    inline unsigned int WeldVertices(vector<Vertex> &vertices, vector<unsigned int> &indices)
+    {
+        struct VertexHash {
+            size_t operator()(const Vertex &v) const
+            {
+                const unsigned char *bytes = reinterpret_cast<const unsigned char*>(&v);
+                size_t hash = 2166136261u;
+                for (unsigned int i = 0; i < sizeof(Vertex); i++)
+                    hash = (hash ^ bytes[i]) * 16777619u;
+                return hash;
+            }
+        };
+        struct VertexEqual {
+            bool operator()(const Vertex &a, const Vertex &b) const
+            {
+                return memcmp(&a, &b, sizeof(Vertex)) == 0;
+            }
+        };
+
+        unordered_map<Vertex, unsigned int, VertexHash, VertexEqual> unique(vertices.size());
+        vector<Vertex> welded;
+        welded.reserve(vertices.size());
+        vector<unsigned int> remap(vertices.size());
+        for (unsigned int i = 0; i < vertices.size(); i++)
+        {
+            unordered_map<Vertex, unsigned int, VertexHash, VertexEqual>::iterator it = unique.find(vertices[i]);
+            if (it == unique.end())
+            {
+                remap[i] = (unsigned int)welded.size();
+                unique[vertices[i]] = remap[i];
+                welded.push_back(vertices[i]);
+            }
+            else
+                remap[i] = it->second;
+        }
+        for (unsigned int i = 0; i < indices.size(); i++)
+            indices[i] = remap[indices[i]];
+        vertices.swap(welded);
+        return (unsigned int)vertices.size();
+    }
+
+    // reorders the triangles for the post-transform vertex cache, following Tom Forsyth's
+    // "Linear-Speed Vertex Cache Optimisation": vertices are scored on their position in a simulated LRU cache and on
+    // the number of triangles still using them, and the highest scoring triangle is emitted next.
+    inline void OptimizeVertexCache(vector<unsigned int> &indices, unsigned int vertexCount)
+    {
+        const int CacheSize = 32;
+        const float CacheDecayPower = 1.5f;
+        const float LastTriScore = 0.75f;
+        const float ValenceBoostScale = 2.0f;
+        const float ValenceBoostPower = 0.5f;
+
+        unsigned int triangleCount = (unsigned int)indices.size() / 3;
+        if (triangleCount == 0)
+            return;
+
+        auto vertexScore = [&](int cachePosition, unsigned int remainingTriangles) -> float
+        {
+            if (remainingTriangles == 0)
+                return -1.0f; // no triangles left, never pick this vertex again
+            float score = 0.0f;
+            if (cachePosition >= 0)
+            {
+                if (cachePosition < 3)
+                    score = LastTriScore; // the vertices of the last triangle get a fixed score so strips don't always win
+                else
+                    score = powf(1.0f - (float)(cachePosition - 3) / (CacheSize - 3), CacheDecayPower);
+            }
+            // boost vertices with few triangles left, so lone triangles get cleaned up instead of left behind
+            return score + ValenceBoostScale * powf((float)remainingTriangles, -ValenceBoostPower);
+        };
+
+        // adjacency: the triangles using each vertex
+        vector<unsigned int> remaining(vertexCount, 0);
+        for (unsigned int i = 0; i < indices.size(); i++)
+            remaining[indices[i]]++;
+        vector<unsigned int> offsets(vertexCount + 1, 0);
+        for (unsigned int v = 0; v < vertexCount; v++)
+            offsets[v + 1] = offsets[v] + remaining[v];
+        vector<unsigned int> adjacency(indices.size());
+        vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+        for (unsigned int t = 0; t < triangleCount; t++)
+            for (unsigned int k = 0; k < 3; k++)
+                adjacency[fill[indices[t * 3 + k]]++] = t;
+
+        vector<int> cachePosition(vertexCount, -1);
+        vector<float> score(vertexCount);
+        for (unsigned int v = 0; v < vertexCount; v++)
+            score[v] = vertexScore(-1, remaining[v]);
+        vector<float> triangleScore(triangleCount);
+        for (unsigned int t = 0; t < triangleCount; t++)
+            triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+        vector<bool> emitted(triangleCount, false);
+
+        vector<unsigned int> cache, nextCache;
+        vector<unsigned int> result;
+        result.reserve(indices.size());
+        unsigned int scanStart = 0;
+        int best = (int)(max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin());
+
+        for (unsigned int emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+        {
+            if (best < 0)
+            {
+                // nothing adjacent to the cache is left, continue with the first triangle not emitted yet
+                while (emitted[scanStart])
+                    scanStart++;
+                best = (int)scanStart;
+            }
+
+            emitted[best] = true;
+            const unsigned int *tri = &indices[best * 3];
+            // emit the triangle and take it out of its vertices' adjacency lists
+            nextCache.assign(tri, tri + 3);
+            for (unsigned int k = 0; k < 3; k++)
+            {
+                unsigned int v = tri[k];
+                result.push_back(v);
+                unsigned int *begin = &adjacency[offsets[v]];
+                unsigned int *end = begin + remaining[v];
+                *find(begin, end, (unsigned int)best) = *(end - 1);
+                remaining[v]--;
+            }
+            // move the triangle's vertices to the front of the LRU cache
+            for (unsigned int i = 0; i < cache.size(); i++)
+                if (cache[i] != tri[0] && cache[i] != tri[1] && cache[i] != tri[2])
+                    nextCache.push_back(cache[i]);
+            for (unsigned int i = 0; i < nextCache.size(); i++)
+                cachePosition[nextCache[i]] = i < (unsigned int)CacheSize ? (int)i : -1;
+
+            // rescore the vertices that were (or still are) in the cache and their triangles
+            for (unsigned int i = 0; i < nextCache.size(); i++)
+            {
+                unsigned int v = nextCache[i];
+                float newScore = vertexScore(cachePosition[v], remaining[v]);
+                float delta = newScore - score[v];
+                score[v] = newScore;
+                for (unsigned int j = 0; j < remaining[v]; j++)
+                    triangleScore[adjacency[offsets[v] + j]] += delta;
+            }
+            // then pick the best next triangle among them; a triangle can share several of those vertices, so its score
+            // is only final once all of them are rescored
+            best = -1;
+            float bestScore = -1.0f;
+            for (unsigned int i = 0; i < nextCache.size(); i++)
+            {
+                unsigned int v = nextCache[i];
+                for (unsigned int j = 0; j < remaining[v]; j++)
+                {
+                    unsigned int t = adjacency[offsets[v] + j];
+                    if (triangleScore[t] > bestScore)
+                    {
+                        bestScore = triangleScore[t];
+                        best = (int)t;
+                    }
+                }
+            }
+            if (nextCache.size() > (unsigned int)CacheSize)
+                nextCache.resize(CacheSize);
+            cache.swap(nextCache);
+        }
+        indices.swap(result);
+    }
+
+    // reorders the cache-optimized triangles to draw front-most surfaces first, which lets early depth testing reject
+    // more of the hidden fragments. The triangle order is cut into clusters wherever the simulated cache starts over
+    // (a triangle with three misses), and the clusters are sorted on how far they face away from the mesh center.
+    // Clusters themselves keep their order, so the cache efficiency only drops slightly at the new cluster seams.
+    inline void OptimizeOverdraw(vector<unsigned int> &indices, const vector<Vertex> &vertices)
+    {
+        unsigned int triangleCount = (unsigned int)indices.size() / 3;
+        if (triangleCount < 2)
+            return;
+
+        // 1. cut the triangle sequence into clusters
+        vector<unsigned int> clusterStarts;
+        vector<unsigned int> timestamps(vertices.size(), 0);
+        unsigned int time = StatsCacheSize + 1;
+        for (unsigned int t = 0; t < triangleCount; t++)
+        {
+            unsigned int misses = 0;
+            for (unsigned int k = 0; k < 3; k++)
+            {
+                unsigned int v = indices[t * 3 + k];
+                if (time - timestamps[v] > StatsCacheSize)
+                {
+                    timestamps[v] = time++;
+                    misses++;
+                }
+            }
+            if (t == 0 || misses == 3)
+                clusterStarts.push_back(t);
+        }
+        clusterStarts.push_back(triangleCount);
+        unsigned int clusterCount = (unsigned int)clusterStarts.size() - 1;
+        if (clusterCount < 2)
+            return;
+
+        // 2. area weighted centroid and normal of the mesh and of every cluster
+        glm::vec3 meshCentroid(0.0f);
+        float meshArea = 0.0f;
+        vector<glm::vec3> clusterCentroid(clusterCount, glm::vec3(0.0f));
+        vector<glm::vec3> clusterNormal(clusterCount, glm::vec3(0.0f));
+        for (unsigned int c = 0; c < clusterCount; c++)
+        {
+            float clusterArea = 0.0f;
+            for (unsigned int t = clusterStarts[c]; t < clusterStarts[c + 1]; t++)
+            {
+                const glm::vec3 &p0 = vertices[indices[t * 3]].Position;
+                const glm::vec3 &p1 = vertices[indices[t * 3 + 1]].Position;
+                const glm::vec3 &p2 = vertices[indices[t * 3 + 2]].Position;
+                glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+                float area = glm::length(normal);
+                glm::vec3 center = (p0 + p1 + p2) / 3.0f;
+                clusterCentroid[c] += center * area;
+                clusterNormal[c] += normal;
+                clusterArea += area;
+            }
+            meshCentroid += clusterCentroid[c];
+            meshArea += clusterArea;
+            if (clusterArea > 0.0f)
+                clusterCentroid[c] /= clusterArea;
+            float normalLength = glm::length(clusterNormal[c]);
+            if (normalLength > 0.0f)
+                clusterNormal[c] /= normalLength;
+        }
+        if (meshArea > 0.0f)
+            meshCentroid /= meshArea;
+
+        // 3. clusters facing outwards from far out are the most likely to occlude the rest, so they're drawn first
+        vector<float> sortKey(clusterCount);
+        vector<unsigned int> order(clusterCount);
+        for (unsigned int c = 0; c < clusterCount; c++)
+        {
+            sortKey[c] = glm::dot(clusterCentroid[c] - meshCentroid, clusterNormal[c]);
+            order[c] = c;
+        }
+        stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) { return sortKey[a] > sortKey[b]; });
+
+        vector<unsigned int> result;
+        result.reserve(indices.size());
+        for (unsigned int i = 0; i < clusterCount; i++)
+        {
+            unsigned int c = order[i];
+            result.insert(result.end(), indices.begin() + clusterStarts[c] * 3, indices.begin() + clusterStarts[c + 1] * 3);
+        }
+        indices.swap(result);
+    }
+
+    // reorders the vertices in the order the index buffer first references them, so vertex fetches walk through
+    // memory linearly. Vertices no index refers to are dropped.
+    inline void OptimizeVertexFetch(vector<Vertex> &vertices, vector<unsigned int> &indices)
+    {
+        const unsigned int Unused = ~0u;
+        vector<unsigned int> remap(vertices.size(), Unused);
+        vector<Vertex> result;
+        result.reserve(vertices.size());
+        for (unsigned int i = 0; i < indices.size(); i++)
+        {
+            unsigned int &newIndex = remap[indices[i]];
+            if (newIndex == Unused)
+            {
+                newIndex = (unsigned int)result.size();
+                result.push_back(vertices[indices[i]]);
+            }
+            indices[i] = newIndex;
+        }
+        vertices.swap(result);
+    }
+
+    // cuts a mesh into parts of at most maxVertices vertices, e.g. so every part can be drawn with 16 bit indices.
+    // Triangles keep their order and go into the current part until one doesn't fit anymore; with a cache optimized
+    // order the triangles of a part are close together, so only few vertices are duplicated along the cuts.
+    inline void SplitMesh(const vector<Vertex> &vertices, const vector<unsigned int> &indices, unsigned int maxVertices,
+                          vector<vector<Vertex> > &partVertices, vector<vector<unsigned int> > &partIndices)
+    {
+        const unsigned int Unused = ~0u;
+        vector<unsigned int> remap(vertices.size(), Unused);
+        vector<unsigned int> partSources; // the original vertices of the current part, to reset remap for the next one
+        partVertices.assign(1, vector<Vertex>());
+        partIndices.assign(1, vector<unsigned int>());
+        for (unsigned int t = 0; t + 2 < indices.size(); t += 3)
+        {
+            unsigned int missing = 0;
+            for (unsigned int k = 0; k < 3; k++)
+                if (remap[indices[t + k]] == Unused)
+                    missing++;
+            if (partVertices.back().size() + missing > maxVertices)
+            {
+                for (unsigned int i = 0; i < partSources.size(); i++)
+                    remap[partSources[i]] = Unused;
+                partSources.clear();
+                partVertices.push_back(vector<Vertex>());
+                partIndices.push_back(vector<unsigned int>());
+            }
+            for (unsigned int k = 0; k < 3; k++)
+            {
+                unsigned int v = indices[t + k];
+                if (remap[v] == Unused)
+                {
+                    remap[v] = (unsigned int)partVertices.back().size();
+                    partVertices.back().push_back(vertices[v]);
+                    partSources.push_back(v);
+                }
+                partIndices.back().push_back(remap[v]);
+            }
+        }
+    }
+
+    // runs all steps on a mesh and prints the vertex cache statistics before and after.
+    inline void Optimize(vector<Vertex> &vertices, vector<unsigned int> &indices, const string &name)
+    {
+        unsigned int vertexCount = (unsigned int)vertices.size();
+        CacheStats before = AnalyzeVertexCache(indices, vertexCount);
+
+        WeldVertices(vertices, indices);
+        OptimizeVertexCache(indices, (unsigned int)vertices.size());
+        OptimizeOverdraw(indices, vertices);
+        OptimizeVertexFetch(vertices, indices);
+
+        CacheStats after = AnalyzeVertexCache(indices, (unsigned int)vertices.size());
+        cout << "MESH_OPTIMIZER:: " << name << ": " << indices.size() / 3 << " triangles, vertices " << vertexCount << " -> " << vertices.size()
+             << ", ACMR " << before.acmr << " -> " << after.acmr << ", ATVR " << before.atvr << " -> " << after.atvr << endl;
+    }
+}
+
+#endif
@@ -0,0 +1,416 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/mesh_optimizer.h>
+
+#include <vector>
+#include <queue>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <iostream>
+using namespace std;
+
+// Mesh simplification with quadric error metrics (Garland & Heckbert, "Surface Simplification Using Quadric Error
+// Metrics"), used to build level of detail chains at import time.
+// Edges are collapsed into one of their existing end points, so every level reuses the vertex buffer of the full
+// mesh and only needs its own index range. To keep textures and shading intact, vertices on attribute seams (one
+// position with several normal/texture coordinate combinations) are never moved, and vertices on open borders only
+// slide along the border.
+namespace MeshSimplifier
+{
+    // symmetric 4x4 error quadric of a set of planes, plus the total weight (area) of those planes.
+    struct Quadric {
+        double a00, a01, a02, a11, a12, a22;
+        double b0, b1, b2;
+        double c;
+        double weight;
+
+        Quadric() : a00(0), a01(0), a02(0), a11(0), a12(0), a22(0), b0(0), b1(0), b2(0), c(0), weight(0) {}
+
+        // the quadric of the plane n.p + d = 0 (n normalized), weighted by w
+        static Quadric FromPlane(const glm::dvec3 &n, double d, double w)
+        {
+            Quadric q;
+            q.a00 = w * n.x * n.x; q.a01 = w * n.x * n.y; q.a02 = w * n.x * n.z;
+            q.a11 = w * n.y * n.y; q.a12 = w * n.y * n.z; q.a22 = w * n.z * n.z;
+            q.b0 = w * n.x * d; q.b1 = w * n.y * d; q.b2 = w * n.z * d;
+            q.c = w * d * d;
+            q.weight = w;
+            return q;
+        }
+
+        void Add(const Quadric &q)
+        {
+            a00 += q.a00; a01 += q.a01; a02 += q.a02; a11 += q.a11; a12 += q.a12; a22 += q.a22;
+            b0 += q.b0; b1 += q.b1; b2 += q.b2;
+            c += q.c;
+            weight += q.weight;
+        }
+
+        // weighted mean squared distance of p to the planes
+        double Error(const glm::vec3 &p) const
+        {
+            double x = p.x, y = p.y, z = p.z;
+            double e = a00 * x * x + a11 * y * y + a22 * z * z + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+                     + 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+            return weight > 0.0 ? fabs(e) / weight : 0.0;
+        }
+    };
+
+    // border edges get a plane perpendicular to their face, weighted up so the outline is preserved
+    const double BorderWeight = 10.0;
+
+    // Simplifies the triangles in indices until at most targetTriangles remain or the next collapse would move the
+    // surface further than maxError (in model units). Returns the new index list; error receives the largest
+    // distance introduced.
+    inline vector<unsigned int> Simplify(const vector<Vertex> &vertices, const vector<unsigned int> &indices, unsigned int targetTriangles,
+                                         float maxError, float &error)
+    {
+        const unsigned int None = ~0u;
+        error = 0.0f;
+        unsigned int vertexCount = (unsigned int)vertices.size();
+
+        // 1. canonical vertices: 'wedge' merges vertices that only differ in their (derived) tangent frame,
+        //    'position' merges vertices at the same location
+        struct KeyHash {
+            size_t operator()(const vector<float> &key) const
+            {
+                size_t hash = 2166136261u;
+                const unsigned char *bytes = reinterpret_cast<const unsigned char*>(key.data());
+                for (unsigned int i = 0; i < key.size() * sizeof(float); i++)
+                    hash = (hash ^ bytes[i]) * 16777619u;
+                return hash;
+            }
+        };
+        vector<unsigned int> wedgeOf(vertexCount), positionOf(vertexCount);
+        {
+            unordered_map<vector<float>, unsigned int, KeyHash> wedges(vertexCount), positions(vertexCount);
+            for (unsigned int i = 0; i < vertexCount; i++)
+            {
+                const Vertex &v = vertices[i];
+                vector<float> key(8);
+                memcpy(&key[0], &v.Position, sizeof(glm::vec3));
+                memcpy(&key[3], &v.Normal, sizeof(glm::vec3));
+                memcpy(&key[6], &v.TexCoords, sizeof(glm::vec2));
+                wedgeOf[i] = wedges.insert(make_pair(key, i)).first->second;
+                key.resize(3);
+                positionOf[i] = positions.insert(make_pair(key, i)).first->second;
+            }
+        }
+
+        // 2. triangles on canonical wedges; triangles without area in position space are dropped right away
+        vector<unsigned int> triangles;
+        for (unsigned int i = 0; i + 2 < indices.size(); i += 3)
+        {
+            unsigned int a = wedgeOf[indices[i]], b = wedgeOf[indices[i + 1]], c = wedgeOf[indices[i + 2]];
+            if (positionOf[a] == positionOf[b] || positionOf[b] == positionOf[c] || positionOf[a] == positionOf[c])
+                continue;
+            triangles.push_back(a); triangles.push_back(b); triangles.push_back(c);
+        }
+        unsigned int triangleCount = (unsigned int)triangles.size() / 3;
+        unsigned int aliveTriangles = triangleCount;
+        vector<bool> triangleAlive(triangleCount, true);
+
+        // positions are the collapse units: they own the quadric and the triangle fan; seams have several wedges
+        vector<Quadric> quadrics(vertexCount);
+        vector<vector<unsigned int> > fans(vertexCount);
+        vector<unsigned int> wedgeCount(vertexCount, 0), positionWedge(vertexCount, None);
+        for (unsigned int i = 0; i < vertexCount; i++)
+        {
+            if (wedgeOf[i] != i)
+                continue;
+            unsigned int p = positionOf[i];
+            wedgeCount[p]++;
+            positionWedge[p] = i;
+        }
+        // the position each wedge currently lives at; follows the collapses
+        vector<unsigned int> wedgePosition(positionOf);
+
+        unordered_map<uint64_t, unsigned int> edgeUse;
+        auto edgeKey = [](unsigned int a, unsigned int b) -> uint64_t
+        {
+            return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+        };
+        for (unsigned int t = 0; t < triangleCount; t++)
+        {
+            unsigned int p[3];
+            for (unsigned int k = 0; k < 3; k++)
+            {
+                p[k] = positionOf[triangles[t * 3 + k]];
+                fans[p[k]].push_back(t);
+            }
+            glm::dvec3 p0(vertices[p[0]].Position), p1(vertices[p[1]].Position), p2(vertices[p[2]].Position);
+            glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+            double area = glm::length(normal);
+            if (area > 0.0)
+            {
+                normal /= area;
+                Quadric q = Quadric::FromPlane(normal, -glm::dot(normal, p0), area * 0.5);
+                for (unsigned int k = 0; k < 3; k++)
+                    quadrics[p[k]].Add(q);
+            }
+            for (unsigned int k = 0; k < 3; k++)
+                edgeUse[edgeKey(p[k], p[(k + 1) % 3])]++;
+        }
+
+        // border edges are used by a single triangle
+        vector<bool> border(vertexCount, false);
+        for (unsigned int t = 0; t < triangleCount; t++)
+        {
+            for (unsigned int k = 0; k < 3; k++)
+            {
+                unsigned int a = positionOf[triangles[t * 3 + k]], b = positionOf[triangles[t * 3 + (k + 1) % 3]];
+                unsigned int c = positionOf[triangles[t * 3 + (k + 2) % 3]];
+                if (edgeUse[edgeKey(a, b)] != 1)
+                    continue;
+                border[a] = border[b] = true;
+                glm::dvec3 pa(vertices[a].Position), pb(vertices[b].Position), pc(vertices[c].Position);
+                glm::dvec3 edge = pb - pa;
+                glm::dvec3 perpendicular = glm::cross(edge, glm::cross(edge, pc - pa));
+                double length = glm::length(perpendicular);
+                if (length == 0.0)
+                    continue;
+                perpendicular /= length;
+                Quadric q = Quadric::FromPlane(perpendicular, -glm::dot(perpendicular, pa), glm::dot(edge, edge) * BorderWeight);
+                quadrics[a].Add(q);
+                quadrics[b].Add(q);
+            }
+        }
+
+        // 3. collapse rules. u is moved onto v; returns the wedge at v that replaces u's wedge, or None if not allowed
+        auto collapseTarget = [&](unsigned int u, unsigned int v) -> unsigned int
+        {
+            if (wedgeCount[u] != 1)
+                return None; // seam vertices stay where they are
+            if (border[u] && edgeUse[edgeKey(u, v)] != 1)
+                return None; // border vertices only move along the border
+            unsigned int target = None;
+            for (unsigned int i = 0; i < fans[u].size(); i++)
+            {
+                unsigned int t = fans[u][i];
+                if (!triangleAlive[t])
+                    continue;
+                for (unsigned int k = 0; k < 3; k++)
+                {
+                    unsigned int w = triangles[t * 3 + k];
+                    if (wedgePosition[w] != v)
+                        continue;
+                    if (target != None && target != w)
+                        return None; // the edge runs into a seam from both sides
+                    target = w;
+                }
+            }
+            return target;
+        };
+        // rejects collapses that would flip a triangle around u
+        auto flips = [&](unsigned int u, unsigned int v) -> bool
+        {
+            glm::vec3 target = vertices[v].Position;
+            for (unsigned int i = 0; i < fans[u].size(); i++)
+            {
+                unsigned int t = fans[u][i];
+                if (!triangleAlive[t])
+                    continue;
+                glm::vec3 p[3], q[3];
+                bool touchesV = false;
+                for (unsigned int k = 0; k < 3; k++)
+                {
+                    unsigned int position = wedgePosition[triangles[t * 3 + k]];
+                    touchesV |= position == v;
+                    p[k] = vertices[position].Position;
+                    q[k] = position == u ? target : p[k];
+                }
+                if (touchesV)
+                    continue; // collapses to nothing
+                glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+                if (glm::dot(before, after) <= 0.0f)
+                    return true;
+            }
+            return false;
+        };
+
+        struct Candidate {
+            double cost;
+            unsigned int u, v;
+            unsigned int stampU, stampV;
+            bool operator<(const Candidate &other) const { return cost > other.cost; } // min-heap
+        };
+        vector<unsigned int> stamps(vertexCount, 0);
+        vector<bool> removed(vertexCount, false);
+        priority_queue<Candidate> heap;
+        auto push = [&](unsigned int u, unsigned int v)
+        {
+            if (collapseTarget(u, v) == None)
+                return;
+            Quadric q = quadrics[u];
+            q.Add(quadrics[v]);
+            Candidate candidate = { q.Error(vertices[v].Position), u, v, stamps[u], stamps[v] };
+            heap.push(candidate);
+        };
+        // the distinct positions sharing a triangle with p
+        auto neighbours = [&](unsigned int p) -> vector<unsigned int>
+        {
+            vector<unsigned int> result;
+            for (unsigned int i = 0; i < fans[p].size(); i++)
+            {
+                unsigned int t = fans[p][i];
+                if (!triangleAlive[t])
+                    continue;
+                for (unsigned int k = 0; k < 3; k++)
+                {
+                    unsigned int n = wedgePosition[triangles[t * 3 + k]];
+                    if (n != p)
+                        result.push_back(n);
+                }
+            }
+            sort(result.begin(), result.end());
+            result.erase(unique(result.begin(), result.end()), result.end());
+            return result;
+        };
+        for (unsigned int i = 0; i < vertexCount; i++)
+        {
+            if (positionOf[i] != i)
+                continue;
+            vector<unsigned int> around = neighbours(i);
+            for (unsigned int n = 0; n < around.size(); n++)
+                push(i, around[n]);
+        }
+
+        // 4. collapse the cheapest edges first
+        double maxCost = (double)maxError * maxError;
+        double largestCost = 0.0;
+        while (aliveTriangles > targetTriangles && !heap.empty())
+        {
+            Candidate candidate = heap.top();
+            heap.pop();
+            unsigned int u = candidate.u, v = candidate.v;
+            if (removed[u] || removed[v] || candidate.stampU != stamps[u] || candidate.stampV != stamps[v])
+                continue; // outdated
+            if (candidate.cost > maxCost)
+                break;
+            unsigned int targetWedge = collapseTarget(u, v);
+            if (targetWedge == None || flips(u, v))
+                continue;
+
+            unsigned int wedge = positionWedge[u];
+            largestCost = max(largestCost, candidate.cost);
+            removed[u] = true;
+            quadrics[v].Add(quadrics[u]);
+            border[v] = border[v] || border[u];
+            for (unsigned int i = 0; i < fans[u].size(); i++)
+            {
+                unsigned int t = fans[u][i];
+                if (!triangleAlive[t])
+                    continue;
+                bool touchesV = false;
+                for (unsigned int k = 0; k < 3; k++)
+                    touchesV |= wedgePosition[triangles[t * 3 + k]] == v;
+                if (touchesV)
+                {
+                    // the triangle's edge from v to its third vertex loses a user; its edge from u merges into it
+                    triangleAlive[t] = false;
+                    aliveTriangles--;
+                    for (unsigned int k = 0; k < 3; k++)
+                    {
+                        unsigned int n = wedgePosition[triangles[t * 3 + k]];
+                        if (n != u && n != v)
+                            edgeUse[edgeKey(v, n)]--;
+                    }
+                    continue;
+                }
+                for (unsigned int k = 0; k < 3; k++)
+                    if (triangles[t * 3 + k] == wedge)
+                        triangles[t * 3 + k] = targetWedge;
+                fans[v].push_back(t);
+                // the edges of the moved triangles now end at v
+                for (unsigned int k = 0; k < 3; k++)
+                {
+                    unsigned int a = wedgePosition[triangles[t * 3 + k]], b = wedgePosition[triangles[t * 3 + (k + 1) % 3]];
+                    if ((a == v) != (b == v))
+                        edgeUse[edgeKey(a, b)]++;
+                }
+            }
+            wedgePosition[wedge] = v;
+            for (unsigned int i = 0; i < fans[u].size(); i++)
+            {
+                // edges to u are gone
+                unsigned int t = fans[u][i];
+                for (unsigned int k = 0; k < 3; k++)
+                {
+                    unsigned int n = wedgePosition[triangles[t * 3 + k]];
+                    if (n != v && !removed[n])
+                        edgeUse.erase(edgeKey(u, n));
+                }
+            }
+            fans[u].clear();
+
+            // new candidates around v
+            stamps[v]++;
+            vector<unsigned int> &fan = fans[v];
+            fan.erase(remove_if(fan.begin(), fan.end(), [&](unsigned int t) { return !triangleAlive[t]; }), fan.end());
+            vector<unsigned int> around = neighbours(v);
+            for (unsigned int n = 0; n < around.size(); n++)
+            {
+                push(around[n], v);
+                push(v, around[n]);
+            }
+        }
+        error = (float)sqrt(largestCost);
+
+        vector<unsigned int> result;
+        result.reserve(aliveTriangles * 3);
+        for (unsigned int t = 0; t < triangleCount; t++)
+            if (triangleAlive[t])
+                result.insert(result.end(), triangles.begin() + t * 3, triangles.begin() + t * 3 + 3);
+        return result;
+    }
+
+    // Builds the LOD chain of a mesh: every level halves the triangle count of the previous one, until the mesh
+    // can't be reduced by at least a quarter anymore, the error grows beyond a tenth of the mesh's size or
+    // maxLevels is reached. The coarser levels are appended to indices; lods receives one range per level, starting
+    // with the full mesh. Errors accumulate over the levels since each one is simplified from the previous.
+    inline void BuildLodChain(const vector<Vertex> &vertices, vector<unsigned int> &indices, vector<MeshLod> &lods,
+                              bool optimizeVertexCache, unsigned int maxLevels = 5)
+    {
+        lods.clear();
+        MeshLod full = { 0, (unsigned int)indices.size(), 0.0f };
+        lods.push_back(full);
+        if (vertices.empty())
+            return;
+
+        glm::vec3 minimum = vertices[0].Position, maximum = vertices[0].Position;
+        for (unsigned int i = 1; i < vertices.size(); i++)
+        {
+            minimum = glm::min(minimum, vertices[i].Position);
+            maximum = glm::max(maximum, vertices[i].Position);
+        }
+        float maxError = glm::length(maximum - minimum) * 0.1f;
+
+        vector<unsigned int> previous(indices);
+        float totalError = 0.0f;
+        while (lods.size() < maxLevels)
+        {
+            unsigned int previousTriangles = (unsigned int)previous.size() / 3;
+            float levelError = 0.0f;
+            vector<unsigned int> level = Simplify(vertices, previous, previousTriangles / 2, maxError - totalError, levelError);
+            if (level.empty() || level.size() / 3 > previousTriangles * 3 / 4)
+                break;
+            if (optimizeVertexCache)
+                MeshOptimizer::OptimizeVertexCache(level, (unsigned int)vertices.size());
+
+            totalError += levelError;
+            MeshLod lod = { (unsigned int)indices.size(), (unsigned int)level.size(), totalError };
+            lods.push_back(lod);
+            indices.insert(indices.end(), level.begin(), level.end());
+            previous.swap(level);
+        }
+    }
+}
+
+#endif
@@ -5,70 +5,394 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
-#include <stb_image.h>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
 
 #include <learnopengl/mesh.h>
+#include <learnopengl/mesh_cache.h>
+#include <learnopengl/mesh_optimizer.h>
+#include <learnopengl/mesh_simplifier.h>
+#include <learnopengl/texture_cache.h>
+#include <learnopengl/texture_upload.h>
+#include <learnopengl/texture_streamer.h>
+#include <learnopengl/texture_array.h>
+#include <learnopengl/parallel.h>
 #include <learnopengl/shader.h>
 
 #include <string>
+#include <cstring>
+#include <cstdio>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <unordered_map>
 #include <vector>
+#include <chrono>
 using namespace std;
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
+// a file opened by ASSIMP, read out of a memory mapping instead of through buffered stdio reads
+class MappedIOStream : public Assimp::IOStream
+{
+public:
+    explicit MappedIOStream(const char *path) : file(path), position(0) {}
+
+    // empty files are open too, they just have nothing to read
+    bool IsOpen() const { return file.isOpen(); }
+
+    size_t Read(void *buffer, size_t size, size_t count)
+    {
+        if(size == 0)
+            return 0;
+        count = min(count, (file.size() - position) / size);
+        if(count == 0)
+            return 0;
+        memcpy(buffer, file.data() + position, size * count);
+        position += size * count;
+        return count;
+    }
+    size_t Write(const void*, size_t, size_t) { return 0; }
+    aiReturn Seek(size_t offset, aiOrigin origin)
+    {
+        size_t target = origin == aiOrigin_SET ? offset : origin == aiOrigin_CUR ? position + offset : file.size() + offset;
+        if(target > file.size())
+            return aiReturn_FAILURE;
+        position = target;
+        return aiReturn_SUCCESS;
+    }
+    size_t Tell() const { return position; }
+    size_t FileSize() const { return file.size(); }
+    void Flush() {}
+
+private:
+    FileSystem::MappedFile file;
+    size_t position;
+};
+
+// hands ASSIMP every file it opens, the model and e.g. the material libraries of OBJ files, as a MappedIOStream.
+// Importer::ReadFileFromMemory would only cover the model file itself. Read only: opening for writing fails.
+class MappedIOSystem : public Assimp::IOSystem
+{
+public:
+    bool Exists(const char *path) const
+    {
+        FILE *file = fopen(path, "rb");
+        if(!file)
+            return false;
+        fclose(file);
+        return true;
+    }
+    char getOsSeparator() const { return '/'; }
+    Assimp::IOStream* Open(const char *path, const char *mode = "rb")
+    {
+        if(strchr(mode, 'w') || strchr(mode, 'a'))
+            return nullptr;
+        MappedIOStream *stream = new MappedIOStream(path);
+        if(!stream->IsOpen())
+        {
+            delete stream;
+            return nullptr;
+        }
+        return stream;
+    }
+    void Close(Assimp::IOStream *stream) { delete stream; }
+};
+
+// optional steps and strategies used while loading a model
+struct ModelOptions
+{
+    bool parallelTextureDecode; // decode the material textures on worker threads, only the uploads run on the calling thread
+    bool optimizeMeshes;        // weld vertices and reorder triangles/vertices for the vertex cache, overdraw and fetches
+    bool compactVertices;       // upload the meshes in the 24 byte CompactVertex format, see vertex_format.h for the shader side
+    bool generateLods;          // build a chain of simplified LOD levels per mesh, drawn with Model::Draw(shader, distance, selection)
+    bool pooledGeometry;        // place the meshes in the shared GeometryPool of their vertex format, so they're drawn without VAO switches
+    bool byteIndices;           // allow 8 bit indices for meshes of up to 256 vertices; otherwise the smallest is 16 bit, see IndexTypeFor
+    bool streamTextures;        // keep only the texture mips resident that RequestTextureDetail asks for, see texture_streamer.h
+    bool packTextureArrays;     // pack the textures into texture arrays owned by the model, for shaders with sampler2DArray
+                                // samplers; bypasses the TextureCache and streaming. See texture_array.h
+    TextureArrayOptions textureArrays; // how, with packTextureArrays
+    bool keepGeometry;          // keep each mesh's vertices and indices in Mesh::vertices/indices after the upload, for code that reads them
+
+    ModelOptions() : parallelTextureDecode(true), optimizeMeshes(false), compactVertices(false), generateLods(false), pooledGeometry(false),
+                     byteIndices(false), streamTextures(false), packTextureArrays(false), keepGeometry(false) {}
+
+    // the options that change the imported mesh data, as part of the mesh cache key
+    uint64_t meshCacheBits() const
+    {
+        return (optimizeMeshes ? 1 : 0) | (generateLods ? 2 : 0);
+    }
+};
 
 class Model 
 {
 public:
     /*  Model Data */
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+    vector<Texture> textures_loaded;	// stores all the textures used by this model, each holds a reference in the TextureCache.
     vector<Mesh> meshes;
+    vector<unsigned int> textureArrays; // with packTextureArrays: the arrays holding the textures, owned by the model
     string directory;
     bool gammaCorrection;
+    ModelOptions options;
+    bool loadedFromCache;   // true if the meshes came from the binary mesh cache instead of Assimp
+    double loadTime;        // total load time in milliseconds
 
     /*  Functions   */
     // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    Model(string const &path, bool gamma = false, ModelOptions options = ModelOptions()) : gammaCorrection(gamma), options(options), loadedFromCache(false), loadTime(0.0)
     {
         loadModel(path);
     }
 
+    // gives the model's texture references back to the TextureCache; the textures themselves stay resident until evicted.
+    ~Model()
+    {
+        for(unsigned int i = staging.nextTexture; i < staging.images.size(); i++)
+            FreeTextureImage(staging.images[i]);
+        for(unsigned int i = 0; i < textures_loaded.size(); i++)
+            TextureCache::Get().Release(textures_loaded[i].id);
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].ReleaseGeometry();
+        if(!textureArrays.empty())
+            glDeleteTextures((GLsizei)textureArrays.size(), textureArrays.data());
+    }
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+
     // draws the model, and thus all its meshes
-    void Draw(Shader shader)
+    void Draw(const Shader &shader)
+    {
+        drawMeshes(shader, 0.0f, NULL);
+    }
+
+    // draws every mesh at the coarsest level of detail that looks the same at this distance (in model units, so
+    // divide world distances by the model's scale); returns the number of triangles drawn.
+    unsigned int Draw(const Shader &shader, float distance, const LodSelection &selection)
+    {
+        return drawMeshes(shader, distance, &selection);
+    }
+
+    // asks the TextureStreamer for the texture detail the meshes need at this distance (in model units, like for Draw),
+    // from the density of their texture coordinates; for models loaded with streamTextures, once per frame they're drawn.
+    void RequestTextureDetail(float distance, const LodSelection &selection) const
+    {
+        float pixelsPerUnit = selection.pixelsPerUnit / max(distance, 1e-4f);
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            if(meshes[i].texCoordDensity <= 0.0f)
+                continue;
+            for(unsigned int j = 0; j < meshes[i].textures.size(); j++)
+                TextureStreamer::Get().Request(meshes[i].textures[j].id, pixelsPerUnit / meshes[i].texCoordDensity);
+        }
+    }
+
+    // number of triangles of the whole model at a level of detail; meshes with fewer levels use their coarsest one.
+    unsigned int TriangleCount(unsigned int lod = 0) const
     {
+        unsigned int triangles = 0;
         for(unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
+            triangles += meshes[i].lods[min(lod, (unsigned int)meshes[i].lods.size() - 1)].indexCount / 3;
+        return triangles;
     }
     
 private:
+    /*  Model Data */
+    // post-processing steps requested from ASSIMP; part of the mesh cache key.
+    static const unsigned int importFlags = aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+    // draws all meshes at full detail, or at the selected LOD if there's a selection. Consecutive pooled meshes of the
+    // same vertex format share their VAO, so it's only bound once for all of them, and textures that are already bound
+    // from the previous mesh's material are skipped, whether the meshes are pooled or not.
+    unsigned int drawMeshes(const Shader &shader, float distance, const LodSelection *selection)
+    {
+        GeometryPool::BindStats &bindStats = GeometryPool::DrawBindStats();
+        unsigned int boundVAO = 0;
+        const Material *previous = NULL;
+        unsigned int triangles = 0;
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            Mesh &mesh = meshes[i];
+            unsigned int lod = selection ? mesh.SelectLod(distance, *selection) : 0;
+            // a VAO of its own for unpooled meshes, shared by the consecutive pooled meshes of a vertex format
+            if(mesh.VAO != boundVAO)
+            {
+                glBindVertexArray(mesh.VAO);
+                boundVAO = mesh.VAO;
+                bindStats.binds++;
+            }
+            else
+                bindStats.bindsSkipped++;
+            mesh.DrawBatched(shader, lod, previous);
+            previous = &mesh.material;
+            triangles += mesh.lods[lod].indexCount / 3;
+        }
+        if(boundVAO != 0)
+            glBindVertexArray(0);
+        // always good practice to set everything back to defaults once configured.
+        glActiveTexture(GL_TEXTURE0);
+        return triangles;
+    }
+
+    // texture path -> index into textures_loaded, replaces a linear search per material texture.
+    unordered_map<string, int> loadedIndex;
+    // with packTextureArrays: texture path -> where the texture was packed
+    unordered_map<string, TextureLayer> textureLayers;
+
+    // data passed from the import phase to the GL upload phase; emptied once the upload is done
+    struct Staging {
+        vector<MeshData> meshData;
+        vector<Texture> textures;      // textures decoded ahead of the upload by decodeTextures, with their images
+        vector<TextureImage> images;
+        unsigned int nextTexture, nextMesh;
+        size_t vertexCount, indexCount, indexBytes;
+
+        Staging() : nextTexture(0), nextMesh(0), vertexCount(0), indexCount(0), indexBytes(0) {}
+    };
+    Staging staging;
+
+    // used by ModelLoader, which runs the load phases itself
+    friend class ModelLoader;
+    Model(const ModelOptions &options, bool gamma) : gammaCorrection(gamma), options(options), loadedFromCache(false), loadTime(0.0) {}
+
     /*  Functions   */
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
+    // the processed mesh data is kept in a binary cache next to the model file, so ASSIMP is only run when the cache is missing or stale.
     void loadModel(string const &path)
     {
-        // read file via ASSIMP
-        Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
-        // check for errors
-        if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
-        {
-            cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+        chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+
+        if(!importMeshes(path))
             return;
-        }
+        // load the textures referenced by the meshes, then create the GL objects for every mesh
+        loadTextures(staging.meshData);
+        while(uploadNext())
+            ;
+        TextureUploadQueue::Get().Flush();
+
+        loadTime = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+        cout << "MODEL::LOAD::" << (loadedFromCache ? "WARM " : "COLD ") << path << " in " << loadTime << " ms" << endl;
+    }
+
+    // the CPU side of loading: reads the meshes from the mesh cache or through ASSIMP into the staging data.
+    // Doesn't touch GL, so it can run on any thread.
+    bool importMeshes(string const &path)
+    {
         // retrieve the directory path of the filepath
         directory = path.substr(0, path.find_last_of('/'));
 
-        // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        vector<MeshData> &meshData = staging.meshData;
+        MeshCache::Sources cacheSources;
+        uint64_t cacheKey = MeshCache::Key(path, importFlags | (options.meshCacheBits() << 32), &cacheSources);
+        loadedFromCache = MeshCache::Load(path, cacheKey, meshData);
+        if(!loadedFromCache)
+        {
+            // read file via ASSIMP, which takes ownership of the IO handler
+            Assimp::Importer importer;
+            importer.SetIOHandler(new MappedIOSystem());
+            const aiScene* scene = importer.ReadFile(path, importFlags);
+            // check for errors
+            if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
+            {
+                cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+                return false;
+            }
+
+            // process ASSIMP's root node recursively
+            processNode(scene->mRootNode, scene, meshData);
+            MeshCache::Store(path, cacheKey, meshData, &cacheSources);
+        }
+        return true;
+    }
+
+    // the GL side of loading, one step per call: uploads one staged texture or creates one mesh. Returns false once
+    // everything is uploaded. Must run on the thread owning the GL context.
+    bool uploadNext()
+    {
+        if(options.packTextureArrays && staging.nextTexture < staging.textures.size())
+        {
+            packTextures();
+            return true;
+        }
+        if(staging.nextTexture < staging.textures.size())
+        {
+            Texture &texture = staging.textures[staging.nextTexture];
+            TextureImage &image = staging.images[staging.nextTexture];
+            // another model may have loaded the same file since the image was decoded
+            texture.id = TextureCache::Get().Lookup(directory + '/' + texture.path, textureOptions(texture));
+            if(texture.id == 0)
+            {
+                if(!image.data)
+                    std::cout << "Texture failed to load at path: " << texture.path << std::endl;
+                texture.id = TextureCache::Get().Insert(directory + '/' + texture.path, textureOptions(texture), image);
+            }
+            FreeTextureImage(image);
+            addLoadedTexture(texture);
+            if(++staging.nextTexture == staging.textures.size())
+                assignTextureIds(staging.meshData);
+            return true;
+        }
+
+        if(staging.nextMesh < staging.meshData.size())
+        {
+            MeshData &data = staging.meshData[staging.nextMesh++];
+            MeshVertexFormat vertexFormat = options.compactVertices ? MESH_VERTEX_COMPACT : MESH_VERTEX_FULL;
+            MeshGeometry geometry = data.Geometry();
+            meshes.push_back(Mesh(geometry, data.textures, vertexFormat, options.pooledGeometry, options.byteIndices, options.keepGeometry));
+            if(options.packTextureArrays)
+            {
+                vector<TextureLayer> layers;
+                for(unsigned int i = 0; i < data.textures.size(); i++)
+                    layers.push_back(textureLayers[data.textures[i].path]);
+                meshes.back().material = Material(data.textures, layers);
+            }
+            staging.vertexCount += geometry.vertexCount;
+            staging.indexCount += geometry.indexCount;
+            staging.indexBytes += (size_t)geometry.indexCount * meshes.back().IndexSize();
+            data = MeshData(); // the geometry is on the GPU now; the last mesh of a cache file closes its mapping
+            return true;
+        }
+
+        if(!staging.meshData.empty())
+        {
+            size_t vertexCount = staging.vertexCount, indexCount = staging.indexCount, indexBytes = staging.indexBytes;
+            cout << "MODEL::INDICES " << indexCount << " indices: " << indexBytes / 1024.0 << " KB, " << indexCount * sizeof(unsigned int) / 1024.0
+                 << " KB as 32 bit (" << (indexCount ? 100.0 - 100.0 * indexBytes / (indexCount * sizeof(unsigned int)) : 0.0) << "% saved)" << endl;
+            if(options.compactVertices)
+                cout << "MODEL::VERTICES " << vertexCount << " vertices: " << vertexCount * sizeof(CompactVertex) / 1024.0 << " KB compact ("
+                     << sizeof(CompactVertex) << " bytes/vertex), " << vertexCount * sizeof(FullVertex) / 1024.0 << " KB as full floats ("
+                     << sizeof(FullVertex) << " bytes/vertex)" << endl;
+            if(options.packTextureArrays)
+            {
+                unsigned int separate = 0, packed = 0;
+                countTextureBinds(separate, packed);
+                cout << "MODEL::TEXTURE_ARRAYS texture binds per draw of the model: " << separate << " as separate textures, " << packed
+                     << " with texture arrays" << endl;
+            }
+            staging = Staging();
+        }
+        return false;
+    }
+
+    // the number of uploadNext steps left
+    unsigned int uploadStepsLeft() const
+    {
+        return (unsigned int)(staging.textures.size() - staging.nextTexture + staging.meshData.size() - staging.nextMesh);
+    }
+
+    // whether some of the model's textures still have pixels in the TextureUploadQueue
+    bool texturesPending() const
+    {
+        for(unsigned int i = 0; i < textures_loaded.size(); i++)
+        {
+            if(TextureUploadQueue::Get().Pending(textures_loaded[i].id))
+                return true;
+        }
+        return false;
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    void processNode(aiNode *node, const aiScene *scene, vector<MeshData> &meshData)
     {
         // process each mesh located at the current node
         for(unsigned int i = 0; i < node->mNumMeshes; i++)
@@ -76,22 +400,24 @@ private:
             // the node object only contains indices to index the actual objects in the scene. 
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            processMesh(mesh, scene, meshData);
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, meshData);
         }
 
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    // extracts a mesh; meshes with too many vertices for 16 bit indices are added as several parts.
+    void processMesh(aiMesh *mesh, const aiScene *scene, vector<MeshData> &meshData)
     {
         // data to fill
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
+        MeshData data;
+        vector<Vertex> &vertices = data.vertices;
+        vector<unsigned int> &indices = data.indices;
+        vector<Texture> &textures = data.textures;
 
         // Walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
@@ -162,12 +488,45 @@ private:
         std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
         textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
         
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        if(options.optimizeMeshes)
+            MeshOptimizer::Optimize(vertices, indices, mesh->mName.C_Str());
+
+        // split before building the LODs, so every part gets its own chain
+        vector<MeshData> parts(1);
+        if(vertices.size() > MaxShortIndexVertices)
+        {
+            vector<vector<Vertex> > partVertices;
+            vector<vector<unsigned int> > partIndices;
+            MeshOptimizer::SplitMesh(vertices, indices, MaxShortIndexVertices, partVertices, partIndices);
+            parts.resize(partVertices.size());
+            for(unsigned int i = 0; i < parts.size(); i++)
+            {
+                parts[i].vertices.swap(partVertices[i]);
+                parts[i].indices.swap(partIndices[i]);
+                parts[i].textures = textures;
+            }
+            cout << "MODEL::SPLIT " << mesh->mName.C_Str() << ": " << vertices.size() << " vertices into " << parts.size() << " meshes" << endl;
+        }
+        else
+            swap(parts[0], data);
+
+        for(unsigned int p = 0; p < parts.size(); p++)
+        {
+            if(options.generateLods)
+            {
+                MeshSimplifier::BuildLodChain(parts[p].vertices, parts[p].indices, parts[p].lods, options.optimizeMeshes);
+                cout << "MODEL::LOD " << mesh->mName.C_Str() << ":";
+                for(unsigned int i = 0; i < parts[p].lods.size(); i++)
+                    cout << " " << parts[p].lods[i].indexCount / 3 << (i == 0 ? "" : " (error " + to_string(parts[p].lods[i].error) + ")");
+                cout << " triangles" << endl;
+            }
+            // the GL objects are created once all meshes are processed
+            meshData.push_back(parts[p]);
+        }
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
+    // collects all material textures of a given type. Only type and path are filled in here,
+    // the textures themselves are loaded by loadTextures once every mesh is processed.
     vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
     {
         vector<Texture> textures;
@@ -175,69 +534,175 @@ private:
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
+            Texture texture;
+            texture.id = 0;
+            texture.type = typeName;
+            texture.path = str.C_Str();
+            textures.push_back(texture);
+        }
+        return textures;
+    }
+
+    // options used for a material texture; only color data is stored as sRGB when the model is gamma corrected.
+    TextureOptions textureOptions(const Texture &texture) const
+    {
+        TextureOptions textureOptions(gammaCorrection && texture.type == "texture_diffuse");
+        textureOptions.streamed = options.streamTextures;
+        return textureOptions;
+    }
+
+    // loads every texture referenced by the meshes and fills in the texture ids. Textures come from the process-wide
+    // TextureCache, so files already loaded by another model (or this one) are shared. Decoding the missing images is the
+    // expensive part, so with parallelTextureDecode all of them are decoded on worker threads first. The uploads always
+    // run on this thread and in the same order, so both modes give identical textures.
+    void loadTextures(vector<MeshData> &meshData)
+    {
+        chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+        if(options.packTextureArrays)
+        {
+            // every texture of the model goes into its arrays, cached or not
+            decodeTextures();
+            unsigned int count = (unsigned int)staging.textures.size();
+            packTextures();
+            double elapsed = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+            cout << "MODEL::TEXTURES " << count << " loaded into texture arrays in " << elapsed << " ms" << endl;
+            return;
+        }
+
+        // gather each texture path once, picking up the ones that are already in the cache
+        vector<Texture> pending;
+        for(unsigned int i = 0; i < meshData.size(); i++)
+        {
+            for(unsigned int j = 0; j < meshData[i].textures.size(); j++)
             {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
+                Texture texture = meshData[i].textures[j];
+                if(loadedIndex.count(texture.path))
+                    continue;
+                texture.id = TextureCache::Get().Lookup(directory + '/' + texture.path, textureOptions(texture));
+                if(texture.id != 0)
+                    addLoadedTexture(texture);
+                else
                 {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
+                    loadedIndex[texture.path] = -1; // queued for loading
+                    pending.push_back(texture);
                 }
             }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-            }
         }
-        return textures;
-    }
-};
 
+        vector<TextureImage> images(pending.size());
+        if(options.parallelTextureDecode)
+        {
+            ParallelFor((unsigned int)pending.size(), [&](unsigned int i)
+            {
+                images[i] = DecodeTextureImage(directory + '/' + pending[i].path, textureOptions(pending[i]));
+            });
+        }
+        for(unsigned int i = 0; i < pending.size(); i++)
+        {
+            if(!options.parallelTextureDecode)
+                images[i] = DecodeTextureImage(directory + '/' + pending[i].path, textureOptions(pending[i]));
+            if(!images[i].data)
+                std::cout << "Texture failed to load at path: " << pending[i].path << std::endl;
+            pending[i].id = TextureCache::Get().Insert(directory + '/' + pending[i].path, textureOptions(pending[i]), images[i]);
+            FreeTextureImage(images[i]);
+            addLoadedTexture(pending[i]);
+        }
+        TextureUploadQueue::Get().Flush();
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
-{
-    string filename = string(path);
-    filename = directory + '/' + filename;
+        assignTextureIds(meshData);
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
+        double elapsed = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+        cout << "MODEL::TEXTURES " << pending.size() << " loaded (" << (options.parallelTextureDecode ? "parallel" : "serial") << " decode) in " << elapsed << " ms" << endl;
+    }
 
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
+    // the CPU half of loadTextures, for loads that upload later: decodes every texture the staged meshes reference into
+    // the staging data. The TextureCache can't be asked from here (it may run on any thread), so images of textures
+    // that turn out to be cached already are decoded anyway and dropped by uploadNext.
+    void decodeTextures()
     {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
+        unordered_map<string, bool> seen;
+        for(unsigned int i = 0; i < staging.meshData.size(); i++)
+        {
+            for(unsigned int j = 0; j < staging.meshData[i].textures.size(); j++)
+            {
+                const Texture &texture = staging.meshData[i].textures[j];
+                if(seen[texture.path])
+                    continue;
+                seen[texture.path] = true;
+                staging.textures.push_back(texture);
+            }
+        }
+        staging.images.resize(staging.textures.size());
+        ParallelFor((unsigned int)staging.textures.size(), [&](unsigned int i)
+        {
+            staging.images[i] = DecodeTextureImage(directory + '/' + staging.textures[i].path, textureOptions(staging.textures[i]));
+        }, options.parallelTextureDecode ? 0 : 1);
+    }
 
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+    // packs all staged textures into the model's texture arrays at once, see TextureArrayPacker
+    void packTextures()
+    {
+        vector<TextureOptions> imageOptions;
+        for(unsigned int i = 0; i < staging.textures.size(); i++)
+        {
+            imageOptions.push_back(textureOptions(staging.textures[i]));
+            if(!staging.images[i].data)
+                std::cout << "Texture failed to load at path: " << staging.textures[i].path << std::endl;
+        }
+        vector<TextureLayer> layers;
+        TextureArrayReport report = TextureArrayPacker::Pack(staging.images, imageOptions, options.textureArrays, layers);
+        TextureArrayPacker::PrintReport(report);
+        textureArrays.insert(textureArrays.end(), report.arrays.begin(), report.arrays.end());
+        for(unsigned int i = 0; i < staging.textures.size(); i++)
+        {
+            Texture &texture = staging.textures[i];
+            texture.id = layers[i].array;
+            textureLayers[texture.path] = layers[i];
+            addLoadedTexture(texture);
+        }
+        staging.nextTexture = (unsigned int)staging.textures.size();
+        assignTextureIds(staging.meshData);
+    }
 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // the texture units drawing all meshes in order rebinds, counted like Material::Bind skips the units that keep
+    // their texture: with every texture on its own ('separate'), and with the textures in the model's arrays ('packed')
+    void countTextureBinds(unsigned int &separate, unsigned int &packed) const
+    {
+        unordered_map<string, string> lastPath;
+        unordered_map<string, unsigned int> lastId;
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            unordered_map<string, unsigned int> slots;
+            for(unsigned int j = 0; j < meshes[i].textures.size(); j++)
+            {
+                const Texture &texture = meshes[i].textures[j];
+                string slot = texture.type + to_string(slots[texture.type]++);
+                if(lastPath[slot] != texture.path)
+                    separate++;
+                if(lastId[slot] != texture.id)
+                    packed++;
+                lastPath[slot] = texture.path;
+                lastId[slot] = texture.id;
+            }
+        }
+    }
 
-        stbi_image_free(data);
+    // hands out the texture ids to every mesh that references them
+    void assignTextureIds(vector<MeshData> &meshData)
+    {
+        for(unsigned int i = 0; i < meshData.size(); i++)
+        {
+            for(unsigned int j = 0; j < meshData[i].textures.size(); j++)
+                meshData[i].textures[j].id = textures_loaded[loadedIndex[meshData[i].textures[j].path]].id;
+        }
     }
-    else
+
+    // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+    void addLoadedTexture(const Texture &texture)
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        loadedIndex[texture.path] = (int)textures_loaded.size();
+        textures_loaded.push_back(texture);
     }
+};
 
-    return textureID;
-}
 #endif
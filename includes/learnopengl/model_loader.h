@@ -0,0 +1,244 @@
+#ifndef MODEL_LOADER_H
+#define MODEL_LOADER_H
+
+#include <learnopengl/model.h>
+#include <learnopengl/parallel.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+using namespace std;
+
+// Loads models in two phases, without stalling the thread that renders:
+// 1. the import (mesh cache or ASSIMP, mesh processing, texture decoding) runs on the loader's worker threads, so
+//    several models are imported at the same time;
+// 2. Update, called once per frame on the GL thread, creates the textures and meshes of finished imports, step by step
+//    until the frame's time budget is spent, and has the TextureUploadQueue copy up to a byte budget of texture pixels.
+// A model can be drawn as soon as its handle is Ready. Handles and the loader must be destroyed on the GL thread.
+class ModelLoader
+{
+public:
+    class Handle
+    {
+    public:
+        enum State { QUEUED, IMPORTING, UPLOADING, READY, FAILED };
+
+        State GetState() const { return (State)state.load(); }
+        bool Ready() const { return state.load() == READY; }
+        bool Failed() const { return state.load() == FAILED; }
+        // rough fraction of the work done, from 0 to 1; the import counts as the first half
+        float Progress() const { return progress.load(); }
+        // the model, or NULL while it's not ready
+        Model* Get() const { return Ready() ? model.get() : NULL; }
+        const string& Path() const { return path; }
+
+    private:
+        friend class ModelLoader;
+        string path;
+        unique_ptr<Model> model;
+        future<bool> imported;
+        atomic<int> state;
+        atomic<float> progress;
+        unsigned int uploadSteps;   // total uploadNext steps, known once the import is done
+        unsigned int uploadFrames;  // Update calls that uploaded something of this model
+        double uploadTime;          // time spent in uploadNext, in milliseconds
+        chrono::high_resolution_clock::time_point start;
+
+        Handle() : state(QUEUED), progress(0.0f), uploadSteps(0), uploadFrames(0), uploadTime(0.0) {}
+    };
+
+    // threads == 0 picks WorkerThreadCount()
+    explicit ModelLoader(unsigned int threads = 0) : stopping(false)
+    {
+        if(threads == 0)
+            threads = WorkerThreadCount();
+        for(unsigned int i = 0; i < threads; i++)
+            workers.emplace_back([this]() { workerLoop(); });
+    }
+
+    // imports that haven't started are dropped and their handles fail, running ones are waited for
+    ~ModelLoader()
+    {
+        {
+            lock_guard<mutex> lock(queueMutex);
+            stopping = true;
+            for(; !tasks.empty(); tasks.pop_front())
+                if(shared_ptr<Handle> handle = tasks.front().handle.lock())
+                    handle->state = Handle::FAILED;
+        }
+        queueReady.notify_all();
+        for(unsigned int i = 0; i < workers.size(); i++)
+            workers[i].join();
+    }
+    ModelLoader(const ModelLoader&) = delete;
+    ModelLoader& operator=(const ModelLoader&) = delete;
+
+    // queues a model for loading and returns right away
+    shared_ptr<Handle> Load(const string &path, bool gamma = false, ModelOptions options = ModelOptions())
+    {
+        shared_ptr<Handle> handle(new Handle());
+        handle->path = path;
+        handle->model.reset(new Model(options, gamma));
+        handle->start = chrono::high_resolution_clock::now();
+
+        // the task only holds on to the handle while it runs: the reference is gone before 'imported' is ready, so
+        // the handle (and the GL objects of its model) is never destroyed on a worker
+        Task task;
+        task.handle = handle;
+        weak_ptr<Handle> weak = handle;
+        task.import = packaged_task<bool()>([weak]()
+        {
+            shared_ptr<Handle> h = weak.lock();
+            if(!h)
+                return false;
+            h->state = Handle::IMPORTING;
+            if(!h->model->importMeshes(h->path))
+                return false;
+            h->progress = 0.25f;
+            h->model->decodeTextures();
+            h->progress = 0.5f;
+            return true;
+        });
+        handle->imported = task.import.get_future();
+        {
+            lock_guard<mutex> lock(queueMutex);
+            tasks.push_back(move(task));
+        }
+        queueReady.notify_one();
+        loading.push_back(handle);
+        return handle;
+    }
+
+    // uploads finished imports until budgetMs milliseconds are spent; at least one step is done per call, so loading
+    // always moves forward. Texture pixels queued by earlier calls are copied first, up to uploadBytes; a model is ready
+    // once all of its pixels are copied. Returns the number of models that became ready. Call once per frame on the GL thread.
+    unsigned int Update(double budgetMs, size_t uploadBytes = TextureUploadQueue::DefaultFrameBudget)
+    {
+        chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+        TextureUploadQueue::Get().Update(uploadBytes);
+        unsigned int ready = 0;
+        bool stepped = false;
+        for(unsigned int i = 0; i < loading.size(); i++)
+        {
+            Handle &handle = *loading[i];
+            if(handle.GetState() == Handle::QUEUED || handle.GetState() == Handle::IMPORTING)
+            {
+                if(handle.imported.wait_for(chrono::seconds(0)) != future_status::ready)
+                    continue;
+                if(!handle.imported.get())
+                {
+                    handle.state = Handle::FAILED;
+                    cout << "ERROR::MODEL_LOADER:: failed to load " << handle.path << endl;
+                    continue;
+                }
+                handle.uploadSteps = handle.model->uploadStepsLeft();
+                handle.state = Handle::UPLOADING;
+            }
+
+            bool uploaded = false;
+            while(handle.GetState() == Handle::UPLOADING)
+            {
+                chrono::high_resolution_clock::time_point now = chrono::high_resolution_clock::now();
+                if(stepped && chrono::duration<double, milli>(now - start).count() >= budgetMs)
+                    break;
+                bool more = handle.model->uploadNext();
+                handle.uploadTime += chrono::duration<double, milli>(chrono::high_resolution_clock::now() - now).count();
+                stepped = uploaded = true;
+                if(more)
+                {
+                    unsigned int done = handle.uploadSteps - handle.model->uploadStepsLeft();
+                    handle.progress = 0.5f + 0.5f * done / max(handle.uploadSteps, 1u);
+                    continue;
+                }
+                // the queue copies the rest of the pixels over the next frames
+                if(handle.model->texturesPending())
+                    break;
+                handle.model->loadTime = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - handle.start).count();
+                handle.progress = 1.0f;
+                handle.state = Handle::READY;
+                ready++;
+                cout << "MODEL::LOAD::ASYNC " << (handle.model->loadedFromCache ? "WARM " : "COLD ") << handle.path << " in "
+                     << handle.model->loadTime << " ms (" << handle.uploadTime << " ms uploading over " << handle.uploadFrames + 1 << " frames)" << endl;
+            }
+            if(uploaded)
+                handle.uploadFrames++;
+        }
+
+        // forget the handles that are done, the callers hold their own references
+        for(unsigned int i = 0; i < loading.size();)
+        {
+            if(loading[i]->Ready() || loading[i]->Failed())
+                loading.erase(loading.begin() + i);
+            else
+                i++;
+        }
+        return ready;
+    }
+
+    // number of models that are still loading
+    unsigned int Pending() const
+    {
+        return (unsigned int)loading.size();
+    }
+
+    // progress of everything that is still loading, from 0 to 1
+    float Progress() const
+    {
+        if(loading.empty())
+            return 1.0f;
+        float progress = 0.0f;
+        for(unsigned int i = 0; i < loading.size(); i++)
+            progress += loading[i]->Progress();
+        return progress / loading.size();
+    }
+
+    // blocks until every queued model is loaded, e.g. behind a loading screen
+    void Finish()
+    {
+        while(!loading.empty())
+        {
+            if(Update(1000.0, TextureUploadQueue::RingSize) == 0 && !loading.empty())
+                this_thread::sleep_for(chrono::milliseconds(1));
+        }
+    }
+
+private:
+    struct Task {
+        weak_ptr<Handle> handle;
+        packaged_task<bool()> import;
+    };
+
+    vector<thread> workers;
+    deque<Task> tasks;
+    mutex queueMutex;
+    condition_variable queueReady;
+    bool stopping;
+    vector<shared_ptr<Handle> > loading; // only touched on the GL thread
+
+    void workerLoop()
+    {
+        for(;;)
+        {
+            Task task;
+            {
+                unique_lock<mutex> lock(queueMutex);
+                queueReady.wait(lock, [this]() { return stopping || !tasks.empty(); });
+                if(stopping)
+                    return;
+                task = move(tasks.front());
+                tasks.pop_front();
+            }
+            task.import();
+        }
+    }
+};
+
+#endif
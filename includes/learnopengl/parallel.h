@@ -0,0 +1,47 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+// number of worker threads to use for CPU-side loading work; never less than one.
+inline unsigned int WorkerThreadCount()
+{
+    unsigned int threads = std::thread::hardware_concurrency();
+    return threads > 0 ? threads : 1;
+}
+
+// calls func(i) for every i in [0, count), spread over up to 'threads' threads (0 picks WorkerThreadCount()).
+// Items are handed out one at a time, so uneven work (e.g. images of different sizes) still balances.
+// The calling thread takes part in the work and the function returns once every item is done.
+template<typename Func>
+void ParallelFor(unsigned int count, Func func, unsigned int threads = 0)
+{
+    if (threads == 0)
+        threads = WorkerThreadCount();
+    threads = std::min(threads, count);
+    if (threads <= 1)
+    {
+        for (unsigned int i = 0; i < count; i++)
+            func(i);
+        return;
+    }
+
+    std::atomic<unsigned int> next(0);
+    auto worker = [&]()
+    {
+        for (unsigned int i = next++; i < count; i = next++)
+            func(i);
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned int t = 1; t < threads; t++)
+        workers.emplace_back(worker);
+    worker();
+    for (unsigned int t = 0; t < workers.size(); t++)
+        workers[t].join();
+}
+
+#endif
@@ -0,0 +1,209 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/filesystem.h>
+#include <learnopengl/hash.h>
+#include <learnopengl/shader_preprocessor.h>
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <iostream>
+#include <algorithm>
+
+// Process-wide cache of linked program binaries (glGetProgramBinary), shared by all Shader classes. Each program is
+// stored next to its first shader as "<file>.<id>.programcache", where the id tells apart the programs built from
+// that file; a binary is only accepted if its key matches, which covers the preprocessed sources of all stages (so
+// edits to included files count) and the GL vendor, renderer and version. Binaries in a format the driver no longer
+// lists, or that it refuses to load, fall back to compiling from source, after which the cache is written again. Needs
+// GL 4.1; setting LOGL_PROGRAM_CACHE=0 turns it off. Every program logs whether it was loaded or compiled and how long
+// that took.
+// All functions must be called from the thread owning the GL context.
+class ProgramCache
+{
+public:
+    struct Stats {
+        unsigned int hits;
+        unsigned int misses;
+        unsigned int rejected; // binaries that were found but couldn't be loaded; counted as misses as well
+        double loadTime;       // ms spent on programs loaded from the cache
+        double compileTime;    // ms spent on programs compiled from source
+    };
+
+    static ProgramCache& Get()
+    {
+        static ProgramCache cache;
+        return cache;
+    }
+
+    // tries to load the program from its cached binary; if this returns false, the caller compiles and links the
+    // program as usual and hands it to Store afterwards.
+    bool Load(ProgramSource &source, GLuint program)
+    {
+        source.start = std::chrono::high_resolution_clock::now();
+        if (!enabled())
+            return false;
+
+        FileSystem::MappedFile file(cachePath(source));
+        uint32_t magic, format;
+        uint64_t key;
+        if (!file.data() || file.size() <= HeaderSize)
+        {
+            stats.misses++;
+            return false;
+        }
+        memcpy(&magic, file.data(), sizeof(magic));
+        memcpy(&key, file.data() + sizeof(magic), sizeof(key));
+        memcpy(&format, file.data() + sizeof(magic) + sizeof(key), sizeof(format));
+        if (magic != Magic || key != makeKey(source))
+        {
+            stats.misses++;
+            return false;
+        }
+
+        GLint linked = GL_FALSE;
+        if (std::find(formats.begin(), formats.end(), (GLint)format) != formats.end())
+        {
+            glProgramBinary(program, format, file.data() + HeaderSize, (GLsizei)(file.size() - HeaderSize));
+            glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        }
+        if (!linked)
+        {
+            stats.rejected++;
+            stats.misses++;
+            return false;
+        }
+
+        double time = elapsed(source);
+        stats.hits++;
+        stats.loadTime += time;
+        std::cout << "PROGRAM_CACHE:: loaded " << source.name() << " in " << time << " ms (" << stats.hits << " hits, "
+                  << stats.misses << " misses)" << std::endl;
+        return true;
+    }
+
+    // call before linking a program that will be stored, so the driver keeps its binary retrievable
+    void PrepareLink(GLuint program)
+    {
+        if (enabled())
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    // logs the compile time of a program that Load didn't find and writes its binary to the cache (atomically, see
+    // FileSystem::writeFileAtomically). Programs that failed to link aren't stored.
+    void Store(const ProgramSource &source, GLuint program)
+    {
+        double time = elapsed(source);
+        stats.compileTime += time;
+        std::cout << "PROGRAM_CACHE:: compiled " << source.name() << " in " << time << " ms";
+        if (enabled())
+            std::cout << " (" << stats.hits << " hits, " << stats.misses << " misses)";
+        std::cout << std::endl;
+
+        GLint linked = GL_FALSE, length = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!enabled() || !linked)
+            return;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return;
+        std::vector<unsigned char> binary(length);
+        GLenum format = 0;
+        glGetProgramBinary(program, length, &length, &format, binary.data());
+
+        std::string path = cachePath(source);
+        const uint32_t magic = Magic, binaryFormat = format;
+        const uint64_t key = makeKey(source);
+        FileSystem::FileChunk chunks[] = {
+            { &magic, sizeof(magic) }, { &key, sizeof(key) }, { &binaryFormat, sizeof(binaryFormat) }, { binary.data(), (size_t)length }
+        };
+        if (!FileSystem::writeFileAtomically(path, std::vector<FileSystem::FileChunk>(chunks, chunks + 4)))
+            std::cout << "WARNING::PROGRAM_CACHE:: could not write " << path << std::endl;
+    }
+
+    const Stats& GetStats() const
+    {
+        return stats;
+    }
+
+private:
+    // bump whenever the file layout changes
+    static const uint32_t Version = 1;
+    static const uint32_t Magic = 0x47525043; // "CPRG"
+    static const size_t HeaderSize = sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint32_t);
+
+    Stats stats;
+    int state;                  // -1 until the first program asks, then 0 (off) or 1 (on)
+    std::vector<GLint> formats; // the binary formats the driver accepts
+    uint64_t driverHash;        // of the GL vendor, renderer and version strings
+
+    ProgramCache() : state(-1), driverHash(Hash::Offset)
+    {
+        stats.hits = stats.misses = stats.rejected = 0;
+        stats.loadTime = stats.compileTime = 0.0;
+    }
+    ProgramCache(const ProgramCache&) = delete;
+    ProgramCache& operator=(const ProgramCache&) = delete;
+
+    // decided on first use, as it needs a current GL context
+    bool enabled()
+    {
+        if (state < 0)
+        {
+            const char *setting = getenv("LOGL_PROGRAM_CACHE");
+            GLint count = 0;
+            if (GLAD_GL_VERSION_4_1 && !(setting && std::string(setting) == "0"))
+                glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &count);
+            formats.resize(count);
+            if (count > 0)
+                glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, formats.data());
+            const GLenum strings[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+            for (unsigned int i = 0; i < 3 && count > 0; i++)
+            {
+                const char *value = reinterpret_cast<const char*>(glGetString(strings[i]));
+                if (value)
+                    driverHash = Hash::FNV1a(driverHash, value, strlen(value) + 1);
+            }
+            state = count > 0 ? 1 : 0;
+        }
+        return state == 1;
+    }
+
+    uint64_t makeKey(const ProgramSource &source) const
+    {
+        const uint32_t version = Version;
+        uint64_t hash = Hash::FNV1a(driverHash, &version, sizeof(version));
+        for (unsigned int i = 0; i < source.codes.size(); i++)
+        {
+            uint32_t stage = source.stages[i];
+            hash = Hash::FNV1a(hash, &stage, sizeof(stage));
+            hash = Hash::FNV1a(hash, source.codes[i].c_str(), source.codes[i].size() + 1);
+        }
+        return hash;
+    }
+
+    // the file of a program only depends on its files and definitions, so editing a shader overwrites its binary
+    static std::string cachePath(const ProgramSource &source)
+    {
+        std::string variant = source.variant();
+        uint64_t hash = Hash::FNV1a(Hash::Offset, variant.c_str(), variant.size() + 1);
+        for (unsigned int i = 0; i < source.paths.size(); i++)
+            hash = Hash::FNV1a(hash, source.paths[i].c_str(), source.paths[i].size() + 1);
+        char id[9];
+        snprintf(id, sizeof(id), "%08x", (unsigned int)(hash ^ (hash >> 32)));
+        return source.paths[0] + "." + id + ".programcache";
+    }
+
+    static double elapsed(const ProgramSource &source)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - source.start).count();
+    }
+};
+
+#endif
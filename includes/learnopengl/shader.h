@@ -4,102 +4,52 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include <learnopengl/filesystem.h>
+#include <learnopengl/shader_preprocessor.h>
+#include <learnopengl/program_cache.h>
+#include <learnopengl/shader_compiler.h>
+
 #include <string>
-#include <fstream>
-#include <sstream>
+#include <vector>
 #include <iostream>
 
 class Shader
 {
 public:
     unsigned int ID;
-    // constructor generates the shader on the fly
+    // constructor generates the shader on the fly. The definitions (e.g. "#define USE_NORMAL_MAP") are put after the
+    // #version line of every stage; each set of definitions is its own program variant.
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr,
+           const std::vector<std::string>& definitions = std::vector<std::string>())
     {
-        // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::string geometryCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        std::ifstream gShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        gShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        try 
-        {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();		
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();			
-            // if geometry shader path is present, also load a geometry shader
-            if(geometryPath != nullptr)
-            {
-                gShaderFile.open(geometryPath);
-                std::stringstream gShaderStream;
-                gShaderStream << gShaderFile.rdbuf();
-                gShaderFile.close();
-                geometryCode = gShaderStream.str();
-            }
-        }
-        catch (std::ifstream::failure e)
-        {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
-        }
-        const char* vShaderCode = vertexCode.c_str();
-        const char * fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment;
-        // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
-        // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
-        // if geometry shader is given, compile geometry shader
-        unsigned int geometry;
-        if(geometryPath != nullptr)
-        {
-            const char * gShaderCode = geometryCode.c_str();
-            geometry = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(geometry, 1, &gShaderCode, NULL);
-            glCompileShader(geometry);
-            checkCompileErrors(geometry, "GEOMETRY");
-        }
-        // shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        if(geometryPath != nullptr)
-            glAttachShader(ID, geometry);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
-        // delete the shaders as they're linked into our program now and no longer necessery
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
+        ProgramSource source;
+        source.add(vertexPath, GL_VERTEX_SHADER, definitions);
+        source.add(fragmentPath, GL_FRAGMENT_SHADER, definitions);
+        // if geometry shader path is present, also load a geometry shader
         if(geometryPath != nullptr)
-            glDeleteShader(geometry);
-
+            source.add(geometryPath, GL_GEOMETRY_SHADER, definitions);
+        build(source);
+    }
+    // compute constructor: like the compute path of shader_s.h, definitions starting with a #version line (compute
+    // shaders need "#version 430 core") go in front of the source, otherwise after the file's own #version line
+    // ------------------------------------------------------------------------
+    Shader(const char* computePath, const std::vector<std::string>& definitions)
+    {
+        ProgramSource source;
+        source.add(computePath, GL_COMPUTE_SHADER, definitions);
+        build(source);
     }
-    // activate the shader
+    // activate the shader; the first time, this checks how compiling and linking went if that was left to it (see
+    // ShaderCompiler)
     // ------------------------------------------------------------------------
     void use() 
     { 
+        if(!checked)
+        {
+            ShaderCompiler::Get().Resolve(ID);
+            checked = true;
+        }
         glUseProgram(ID); 
     }
     // utility uniform functions
@@ -162,30 +112,40 @@ public:
     }
 
 private:
-    // utility function for checking shader compilation/linking errors.
+    bool checked; // whether use() has had the ShaderCompiler check the program yet
+
+    // shares the program if this process built the same variant before, otherwise loads it from the program cache or
+    // compiles it
     // ------------------------------------------------------------------------
-    void checkCompileErrors(GLuint shader, std::string type)
+    void build(ProgramSource& source)
     {
-        GLint success;
-        GLchar infoLog[1024];
-        if(type != "PROGRAM")
-        {
-            glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-            if(!success)
-            {
-                glGetShaderInfoLog(shader, 1024, NULL, infoLog);
-                std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
-            }
-        }
-        else
+        checked = false;
+        ID = ShaderPermutations::Get().Find(source);
+        if(ID != 0)
+            return;
+        // 1. retrieve the source code of every stage, with its #includes expanded
+        if(!ShaderPreprocessor::Load(source))
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+        ID = glCreateProgram();
+        if(!ProgramCache::Get().Load(source, ID))
         {
-            glGetProgramiv(shader, GL_LINK_STATUS, &success);
-            if(!success)
+            // 2. compile shaders; their status is checked by the ShaderCompiler, right away or on first use in a batch
+            std::vector<unsigned int> shaders;
+            for(unsigned int i = 0; i < source.codes.size(); i++)
             {
-                glGetProgramInfoLog(shader, 1024, NULL, infoLog);
-                std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+                const char* code = source.codes[i].c_str();
+                unsigned int shader = glCreateShader(source.stages[i]);
+                glShaderSource(shader, 1, &code, NULL);
+                glCompileShader(shader);
+                glAttachShader(ID, shader);
+                shaders.push_back(shader);
             }
+            // shader Program
+            ProgramCache::Get().PrepareLink(ID);
+            glLinkProgram(ID);
+            ShaderCompiler::Get().Submit(source, ID, shaders);
         }
+        ShaderPermutations::Get().Insert(source, ID);
     }
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,254 @@
+#ifndef SHADER_COMPILER_H
+#define SHADER_COMPILER_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/shader_preprocessor.h>
+#include <learnopengl/program_cache.h>
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+
+// Compiles and links the programs of the Shader classes and checks how that went. Outside a batch every program is
+// checked right after linking, as before. Between BeginBatch and EndBatch, programs are only submitted: their stages
+// are compiled and linked without asking for any status, so the driver can work on all of them at once instead of
+// being waited on stage by stage, and the status of a program is only queried when it's first used (Shader::use) or
+// when Poll finds it done. With GL_KHR_parallel_shader_compile (or the ARB version), EnableParallelCompile hands the
+// driver as many compiler threads as it likes, and Poll can tell finished programs apart without blocking; other
+// drivers may still compile on a thread of their own as long as nobody asks. Once every program of a batch was
+// checked, the time from its start until then is logged, which is the startup cost of its shaders; running with
+// LOGL_SHADER_BATCH=0 checks every program right away again, for comparison (with LOGL_PROGRAM_CACHE=0, as cached
+// programs don't compile). For batched programs the program cache logs the time from submitting to first use.
+// All functions must be called from the thread owning the GL context.
+class ShaderCompiler
+{
+public:
+    static ShaderCompiler& Get()
+    {
+        static ShaderCompiler compiler;
+        return compiler;
+    }
+
+    // looks for GL_KHR_parallel_shader_compile and, if there, lets the driver pick the number of compiler threads;
+    // glad doesn't know the extension, so its function is loaded with the loader given to gladLoadGLLoader
+    void EnableParallelCompile(GLADloadproc load)
+    {
+        if (!GLAD_GL_VERSION_3_0)
+            return;
+        const char *functions[] = { "glMaxShaderCompilerThreadsKHR", "glMaxShaderCompilerThreadsARB" };
+        const char *extensions[] = { "GL_KHR_parallel_shader_compile", "GL_ARB_parallel_shader_compile" };
+        for (unsigned int i = 0; i < 2 && !parallel; i++)
+        {
+            if (!hasExtension(extensions[i]))
+                continue;
+            MaxShaderCompilerThreadsProc maxThreads = (MaxShaderCompilerThreadsProc)load(functions[i]);
+            if (!maxThreads)
+                continue;
+            maxThreads(0xFFFFFFFF);
+            parallel = true;
+        }
+    }
+
+    // programs built from now until EndBatch are checked when they're first used; nested batches join the outer one
+    void BeginBatch()
+    {
+        if (batch.depth++ > 0)
+            return;
+        batch.start = std::chrono::high_resolution_clock::now();
+        batch.programs = batch.pending = 0;
+    }
+
+    // doesn't wait for anything; the batch is reported once its last program has been checked
+    void EndBatch()
+    {
+        if (batch.depth == 0 || --batch.depth > 0)
+            return;
+        report();
+    }
+
+    // takes a program whose stages were compiled and attached and that was just linked, and checks it right away
+    // unless a batch is open
+    void Submit(const ProgramSource &source, GLuint program, const std::vector<GLuint> &shaders)
+    {
+        Pending &entry = pending[program];
+        entry.source = source;
+        entry.shaders = shaders;
+        entry.batched = batch.depth > 0 && deferred();
+        if (batch.depth > 0)
+            batch.programs++;
+        if (entry.batched)
+            batch.pending++;
+        else
+            Resolve(program);
+    }
+
+    // checks the compile and link status of a submitted program, blocking until the driver is done with it, and
+    // stores it in the program cache; does nothing for programs that were checked already. Returns false if it failed.
+    bool Resolve(GLuint program)
+    {
+        std::unordered_map<GLuint, Pending>::iterator it = pending.find(program);
+        if (it == pending.end())
+            return true;
+        Pending &entry = it->second;
+        for (unsigned int i = 0; i < entry.shaders.size(); i++)
+        {
+            checkCompileErrors(entry.shaders[i], stageName(entry.source.stages[i]), &entry.source.files[i]);
+            // delete the shaders as they're linked into our program now and no longer necessery
+            glDeleteShader(entry.shaders[i]);
+        }
+        bool linked = checkCompileErrors(program, "PROGRAM");
+        ProgramCache::Get().Store(entry.source, program);
+        bool batched = entry.batched;
+        pending.erase(it);
+        if (batched)
+        {
+            batch.pending--;
+            report();
+        }
+        return linked;
+    }
+
+    // checks the batched programs the driver has finished, without blocking; needs the parallel compile extension.
+    // Returns the number of programs still waiting to be checked.
+    unsigned int Poll()
+    {
+        if (parallel)
+        {
+            std::vector<GLuint> done;
+            for (std::unordered_map<GLuint, Pending>::const_iterator it = pending.begin(); it != pending.end(); ++it)
+            {
+                GLint complete = GL_FALSE;
+                glGetProgramiv(it->first, COMPLETION_STATUS, &complete);
+                if (complete)
+                    done.push_back(it->first);
+            }
+            for (unsigned int i = 0; i < done.size(); i++)
+                Resolve(done[i]);
+        }
+        return (unsigned int)pending.size();
+    }
+
+    // checks all submitted programs, blocking until the driver is done with them
+    void Finish()
+    {
+        while (!pending.empty())
+            Resolve(pending.begin()->first);
+    }
+
+    bool ParallelCompile() const
+    {
+        return parallel;
+    }
+
+    static std::string stageName(GLenum stage)
+    {
+        switch (stage)
+        {
+            case GL_VERTEX_SHADER: return "VERTEX";
+            case GL_FRAGMENT_SHADER: return "FRAGMENT";
+            case GL_GEOMETRY_SHADER: return "GEOMETRY";
+            case GL_TESS_CONTROL_SHADER: return "TESS_CONTROL";
+            case GL_TESS_EVALUATION_SHADER: return "TESS_EVALUATION";
+            case GL_COMPUTE_SHADER: return "COMPUTE";
+            default: return "UNKNOWN";
+        }
+    }
+
+    // utility function for checking shader compilation/linking errors; the files are the ones behind the source
+    // string numbers of a stage, see ShaderPreprocessor. Returns false if it failed.
+    static bool checkCompileErrors(GLuint shader, const std::string &type, const std::vector<std::string> *files = nullptr)
+    {
+        GLint success;
+        GLchar infoLog[1024];
+        if (type != "PROGRAM")
+        {
+            glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+            if (!success)
+            {
+                glGetShaderInfoLog(shader, 1024, NULL, infoLog);
+                std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n" << (files ? ShaderPreprocessor::ResolveLog(infoLog, *files) : std::string(infoLog)) << "\n -- --------------------------------------------------- -- " << std::endl;
+            }
+        }
+        else
+        {
+            glGetProgramiv(shader, GL_LINK_STATUS, &success);
+            if (!success)
+            {
+                glGetProgramInfoLog(shader, 1024, NULL, infoLog);
+                std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+            }
+        }
+        return success != 0;
+    }
+
+private:
+    typedef void (APIENTRYP MaxShaderCompilerThreadsProc)(GLuint count);
+    // GL_COMPLETION_STATUS_KHR, the same value as the ARB version
+    static const GLenum COMPLETION_STATUS = 0x91B1;
+
+    struct Pending {
+        ProgramSource source;
+        std::vector<GLuint> shaders;
+        bool batched;
+    };
+
+    struct Batch {
+        unsigned int depth;
+        unsigned int programs; // submitted while the batch was open
+        unsigned int pending;  // ... and not checked yet
+        std::chrono::high_resolution_clock::time_point start;
+    };
+
+    std::unordered_map<GLuint, Pending> pending;
+    Batch batch;
+    bool parallel;
+    int state; // -1 until the first batch asks, then 0 (check right away) or 1 (defer)
+
+    ShaderCompiler() : parallel(false), state(-1)
+    {
+        batch.depth = batch.programs = batch.pending = 0;
+    }
+    ShaderCompiler(const ShaderCompiler&) = delete;
+    ShaderCompiler& operator=(const ShaderCompiler&) = delete;
+
+    bool deferred()
+    {
+        if (state < 0)
+        {
+            const char *setting = getenv("LOGL_SHADER_BATCH");
+            state = setting && std::string(setting) == "0" ? 0 : 1;
+        }
+        return state == 1;
+    }
+
+    static bool hasExtension(const char *name)
+    {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++)
+        {
+            const char *extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+            if (extension && strcmp(extension, name) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    // logs a closed batch once all its programs are checked
+    void report()
+    {
+        if (batch.depth > 0 || batch.pending > 0 || batch.programs == 0)
+            return;
+        double time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - batch.start).count();
+        std::cout << "SHADER_COMPILER:: " << batch.programs << " programs ready " << time << " ms after the batch started ("
+                  << (!deferred() ? "checked one at a time" : parallel ? "deferred checks, parallel compile" : "deferred checks") << ")" << std::endl;
+        batch.programs = 0;
+    }
+};
+
+#endif
@@ -4,9 +4,13 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include <learnopengl/filesystem.h>
+#include <learnopengl/shader_preprocessor.h>
+#include <learnopengl/program_cache.h>
+#include <learnopengl/shader_compiler.h>
+
 #include <string>
-#include <fstream>
-#include <sstream>
+#include <vector>
 #include <iostream>
 
 class Shader
@@ -15,65 +19,58 @@ public:
     unsigned int ID;
     // constructor generates the shader on the fly
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath)
+    Shader(const char* vertexPath, const char* fragmentPath) : checked(false)
     {
-        // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        try 
-        {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();		
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();			
-        }
-        catch (std::ifstream::failure e)
-        {
+        // programs this process built before from the same files are shared
+        ProgramSource source;
+        source.add(vertexPath, GL_VERTEX_SHADER);
+        source.add(fragmentPath, GL_FRAGMENT_SHADER);
+        ID = ShaderPermutations::Get().Find(source);
+        if(ID != 0)
+            return;
+        // 1. retrieve the vertex/fragment source code from filePath, with their #includes expanded
+        if(!ShaderPreprocessor::Load(source))
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+        // programs built from these sources in an earlier run are loaded from the program cache instead
+        ID = glCreateProgram();
+        if(ProgramCache::Get().Load(source, ID))
+        {
+            ShaderPermutations::Get().Insert(source, ID);
+            return;
         }
-        const char* vShaderCode = vertexCode.c_str();
-        const char * fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
+        const char* vShaderCode = source.codes[0].c_str();
+        const char * fShaderCode = source.codes[1].c_str();
+        // 2. compile shaders; the ShaderCompiler checks them, right away or on first use in a batch
         unsigned int vertex, fragment;
         // vertex shader
         vertex = glCreateShader(GL_VERTEX_SHADER);
         glShaderSource(vertex, 1, &vShaderCode, NULL);
         glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
         // fragment Shader
         fragment = glCreateShader(GL_FRAGMENT_SHADER);
         glShaderSource(fragment, 1, &fShaderCode, NULL);
         glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
         // shader Program
-        ID = glCreateProgram();
         glAttachShader(ID, vertex);
         glAttachShader(ID, fragment);
+        ProgramCache::Get().PrepareLink(ID);
         glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
-        // delete the shaders as they're linked into our program now and no longer necessery
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
+        std::vector<unsigned int> shaders;
+        shaders.push_back(vertex);
+        shaders.push_back(fragment);
+        ShaderCompiler::Get().Submit(source, ID, shaders);
+        ShaderPermutations::Get().Insert(source, ID);
 
     }
     // activate the shader
     // ------------------------------------------------------------------------
     void use() const
     { 
+        if(!checked)
+        {
+            ShaderCompiler::Get().Resolve(ID);
+            checked = true;
+        }
         glUseProgram(ID); 
     }
     // utility uniform functions
@@ -136,30 +133,6 @@ public:
     }
 
 private:
-    // utility function for checking shader compilation/linking errors.
-    // ------------------------------------------------------------------------
-    void checkCompileErrors(GLuint shader, std::string type)
-    {
-        GLint success;
-        GLchar infoLog[1024];
-        if (type != "PROGRAM")
-        {
-            glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-            if (!success)
-            {
-                glGetShaderInfoLog(shader, 1024, NULL, infoLog);
-                std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
-            }
-        }
-        else
-        {
-            glGetProgramiv(shader, GL_LINK_STATUS, &success);
-            if (!success)
-            {
-                glGetProgramInfoLog(shader, 1024, NULL, infoLog);
-                std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
-            }
-        }
-    }
+    mutable bool checked; // whether use() has had the ShaderCompiler check the program yet
 };
 #endif
\ No newline at end of file
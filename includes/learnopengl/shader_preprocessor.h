@@ -0,0 +1,317 @@
+#ifndef SHADER_PREPROCESSOR_H
+#define SHADER_PREPROCESSOR_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/filesystem.h>
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <regex>
+#include <cctype>
+#include <cstdlib>
+#include <iostream>
+#include <algorithm>
+#include <unordered_map>
+
+// the stages of a program and the definitions they're built with. ShaderPreprocessor::Load fills in the code of every
+// stage as glShaderSource gets it, which is also what a cached program binary is keyed on.
+struct ProgramSource {
+    std::vector<std::string> paths;
+    std::vector<GLenum> stages;
+    std::vector<std::vector<std::string> > definitions;
+    std::vector<std::string> codes;
+    std::vector<std::vector<std::string> > files; // per stage, the file behind every #line source string number
+    std::chrono::high_resolution_clock::time_point start;
+
+    void add(const char *path, GLenum stage, const std::vector<std::string> &stageDefinitions = std::vector<std::string>())
+    {
+        paths.push_back(path);
+        stages.push_back(stage);
+        definitions.push_back(stageDefinitions);
+    }
+
+    std::string name() const
+    {
+        std::string joined;
+        for (unsigned int i = 0; i < paths.size(); i++)
+            joined += (i > 0 ? " + " : "") + paths[i];
+        return joined;
+    }
+
+    // the definitions of all stages, which tell apart the variants of the same files
+    std::string variant() const
+    {
+        std::string joined;
+        for (unsigned int i = 0; i < definitions.size(); i++)
+        {
+            for (unsigned int j = 0; j < definitions[i].size(); j++)
+                joined += definitions[i][j] + '\n';
+            joined += '|';
+        }
+        return joined;
+    }
+};
+
+// The front end all Shader classes read their sources through. Lines of the form
+//
+//     #include "file"
+//
+// are replaced by the file, found relative to the one including it; like #pragma once, every file is only included
+// once per stage, later includes of it are dropped. Each file gets its own GLSL source string number, set with #line
+// directives around every include, so compile errors point at the right line of the right file; ResolveLog puts the
+// file names back into a driver's log. The definitions of a stage are put after the #version line of its file, or in
+// front of everything if they bring their own #version line (as the compute shaders do).
+namespace ShaderPreprocessor
+{
+    inline std::string Directory(const std::string &path)
+    {
+        size_t slash = path.find_last_of("/\\");
+        return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+    }
+
+    // the first token of a preprocessor line, e.g. "include" for "  #  include ...", or "" if it isn't one
+    inline std::string Directive(const std::string &line)
+    {
+        size_t hash = line.find_first_not_of(" \t");
+        if (hash == std::string::npos || line[hash] != '#')
+            return std::string();
+        size_t begin = line.find_first_not_of(" \t", hash + 1);
+        if (begin == std::string::npos)
+            return std::string();
+        size_t end = begin;
+        while (end < line.size() && (isalnum((unsigned char)line[end]) || line[end] == '_'))
+            end++;
+        return line.substr(begin, end - begin);
+    }
+
+    // appends the lines of 'path' to 'code', expanding its includes; the #version line, if asked for, goes to 'version'
+    // and leaves an empty line behind so the numbering stays the same. Returns false if the file can't be read; 'ok'
+    // is cleared if one of its includes can't.
+    inline bool Expand(const std::string &path, std::string &code, std::vector<std::string> &files, std::string *version, bool &ok)
+    {
+        if (std::find(files.begin(), files.end(), path) != files.end())
+            return true;
+        std::string source;
+        if (!FileSystem::readFile(path, source))
+            return false;
+        std::string index = std::to_string(files.size());
+        files.push_back(path);
+
+        code += "#line 1 " + index + "\n";
+        size_t begin = 0;
+        for (unsigned int number = 1; begin < source.size(); number++)
+        {
+            size_t end = source.find('\n', begin);
+            if (end == std::string::npos)
+                end = source.size();
+            std::string line = source.substr(begin, end - begin);
+            begin = end + 1;
+
+            std::string directive = Directive(line);
+            if (directive == "version" && version && version->empty())
+            {
+                *version = line + "\n";
+                code += "\n";
+            }
+            else if (directive == "include")
+            {
+                size_t open = line.find('"'), close = line.find('"', open + 1);
+                std::string name = open != std::string::npos && close != std::string::npos ? line.substr(open + 1, close - open - 1) : std::string();
+                if (name.empty() || !Expand(Directory(path) + name, code, files, nullptr, ok))
+                {
+                    std::cout << "ERROR::SHADER::INCLUDE_NOT_FOUND: " << (name.empty() ? line : name) << " in " << path << "(" << number << ")" << std::endl;
+                    ok = false;
+                }
+                code += "#line " + std::to_string(number + 1) + " " + index + "\n";
+            }
+            else
+                code += line + "\n";
+        }
+        return true;
+    }
+
+    // the code of one stage as glShaderSource takes it, and the files behind its source string numbers
+    inline bool Preprocess(const std::string &path, const std::vector<std::string> &definitions, std::string &code, std::vector<std::string> &files)
+    {
+        std::string version, body;
+        files.clear();
+        bool ok = true;
+        ok = Expand(path, body, files, &version, ok) && ok;
+
+        std::string prefix;
+        for (unsigned int i = 0; i < definitions.size(); i++)
+            prefix += definitions[i] + '\n';
+        if (!prefix.empty() && Directive(definitions[0]) == "version")
+            code = prefix + version + body;
+        else
+            code = version + prefix + body;
+        return ok;
+    }
+
+    // preprocesses all stages of a program; returns false if a file or one of its includes couldn't be read
+    inline bool Load(ProgramSource &source)
+    {
+        bool ok = true;
+        source.codes.resize(source.paths.size());
+        source.files.resize(source.paths.size());
+        for (unsigned int i = 0; i < source.paths.size(); i++)
+            ok = Preprocess(source.paths[i], source.definitions[i], source.codes[i], source.files[i]) && ok;
+        return ok;
+    }
+
+    // replaces the source string numbers in a compile log by the file names, e.g. "0(12)" (NVIDIA) or "0:12" (AMD,
+    // Intel, Mesa) by "2.2.2.pbr.fs(12)" or "2.2.2.pbr.fs:12"
+    inline std::string ResolveLog(const std::string &log, const std::vector<std::string> &files)
+    {
+        static const std::regex location("(^|\\n|ERROR: |WARNING: )(\\d+)([(:]\\d+)");
+        std::string resolved;
+        std::sregex_iterator it(log.begin(), log.end(), location), end;
+        size_t copied = 0;
+        for (; it != end; ++it)
+        {
+            const std::smatch &match = *it;
+            unsigned long index = std::strtoul(match[2].str().c_str(), nullptr, 10);
+            if (index >= files.size())
+                continue;
+            resolved += log.substr(copied, match.position(0) - copied) + match[1].str() + files[index] + match[3].str();
+            copied = match.position(0) + match.length(0);
+        }
+        return resolved + log.substr(copied);
+    }
+}
+
+// Process-wide cache of linked programs, keyed on their files and definitions (the permutation). Every variant is
+// compiled once per process; later Shader objects asking for the same one share its program, so each of them gives its
+// reference back through Release rather than glDeleteProgram, and the program is deleted with the last one. Counts how
+// often each variant was asked for, which PrintStats reports.
+// All functions must be called from the thread owning the GL context.
+class ShaderPermutations
+{
+public:
+    struct Variant {
+        std::string name;
+        std::string definitions; // the distinct definitions of its stages, for printing
+        unsigned int program;
+        unsigned int requests;
+        unsigned int references; // requests not given back with Release yet
+    };
+
+    static ShaderPermutations& Get()
+    {
+        static ShaderPermutations permutations;
+        return permutations;
+    }
+
+    // the program built earlier for the same stages and definitions, or 0; a hit counts as a request and adds a
+    // reference to the program
+    unsigned int Find(const ProgramSource &source)
+    {
+        std::unordered_map<std::string, Variant>::iterator it = variants.find(makeKey(source));
+        if (it == variants.end())
+            return 0;
+        it->second.requests++;
+        it->second.references++;
+        return it->second.program;
+    }
+
+    // adds a newly built program with one reference, held by the request that built it
+
+    void Insert(const ProgramSource &source, unsigned int program)
+    {
+        Variant &variant = variants[makeKey(source)];
+        variant.name = source.name();
+        variant.definitions.clear();
+        std::vector<std::string> distinct;
+        for (unsigned int i = 0; i < source.definitions.size(); i++)
+        {
+            for (unsigned int j = 0; j < source.definitions[i].size(); j++)
+            {
+                if (std::find(distinct.begin(), distinct.end(), source.definitions[i][j]) != distinct.end())
+                    continue;
+                variant.definitions += (distinct.empty() ? "" : ", ") + source.definitions[i][j];
+                distinct.push_back(source.definitions[i][j]);
+            }
+        }
+        variant.program = program;
+        variant.requests = 1;
+        variant.references = 1;
+    }
+
+    // called with every program Release deletes, right before it's deleted
+    typedef void (*ReleaseCallback)(unsigned int program);
+
+    // lets caches keyed on program ids (e.g. Material::Resolve) forget a program before its id can be reused
+    void AddReleaseCallback(ReleaseCallback callback)
+    {
+        if (std::find(releaseCallbacks.begin(), releaseCallbacks.end(), callback) == releaseCallbacks.end())
+            releaseCallbacks.push_back(callback);
+    }
+
+    // gives back the reference of one request. Once the last one is gone the program is deleted and its variant
+    // forgotten, so the next request builds it again; programs that aren't in here are deleted right away.
+    void Release(unsigned int program)
+    {
+        for (std::unordered_map<std::string, Variant>::iterator it = variants.begin(); it != variants.end(); ++it)
+        {
+            if (it->second.program == program)
+            {
+                if (--it->second.references > 0)
+                    return;
+                variants.erase(it);
+                break;
+            }
+        }
+        for (unsigned int i = 0; i < releaseCallbacks.size(); i++)
+            releaseCallbacks[i](program);
+        glDeleteProgram(program);
+    }
+
+    unsigned int VariantCount() const
+    {
+        return (unsigned int)variants.size();
+    }
+
+    // prints how many variants of how many stage sets exist, and the ones asked for most
+    void PrintStats(unsigned int top = 5) const
+    {
+        std::vector<const Variant*> sorted;
+        std::vector<std::string> names;
+        unsigned int requests = 0;
+        for (std::unordered_map<std::string, Variant>::const_iterator it = variants.begin(); it != variants.end(); ++it)
+        {
+            sorted.push_back(&it->second);
+            if (std::find(names.begin(), names.end(), it->second.name) == names.end())
+                names.push_back(it->second.name);
+            requests += it->second.requests;
+        }
+        std::sort(sorted.begin(), sorted.end(), [](const Variant *a, const Variant *b) { return a->requests > b->requests; });
+
+        std::cout << "SHADER_PERMUTATIONS:: " << sorted.size() << " variants of " << names.size() << " programs, "
+                  << requests - sorted.size() << " of " << requests << " requests shared" << std::endl;
+        for (unsigned int i = 0; i < sorted.size() && i < top; i++)
+        {
+            std::cout << "SHADER_PERMUTATIONS::   " << sorted[i]->requests << "x " << sorted[i]->name
+                      << (sorted[i]->definitions.empty() ? std::string() : " [" + sorted[i]->definitions + "]") << std::endl;
+        }
+    }
+
+private:
+    std::unordered_map<std::string, Variant> variants;
+    std::vector<ReleaseCallback> releaseCallbacks;
+
+    ShaderPermutations() {}
+    ShaderPermutations(const ShaderPermutations&) = delete;
+    ShaderPermutations& operator=(const ShaderPermutations&) = delete;
+
+    static std::string makeKey(const ProgramSource &source)
+    {
+        std::string key;
+        for (unsigned int i = 0; i < source.paths.size(); i++)
+            key += std::to_string(source.stages[i]) + ':' + source.paths[i] + '\n';
+        return key + source.variant();
+    }
+};
+
+#endif
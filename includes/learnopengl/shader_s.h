@@ -3,9 +3,11 @@
 
 #include <glad/glad.h>
 
+#include <learnopengl/filesystem.h>
+#include <learnopengl/shader_preprocessor.h>
+#include <learnopengl/program_cache.h>
+
 #include <string>
-#include <fstream>
-#include <sstream>
 #include <iostream>
 
 #include <unordered_map>
@@ -94,56 +96,52 @@ public:
 private:
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
-	GLuint LoadAndCompile(const ShaderArgsValue& shArg) {
-		// 1. retrieve the source code from cpath
-		std::string code;
-		std::ifstream shaderFile;
-		// ensure ifstream objects can throw exceptions:
-		shaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-		try
-		{
-			// open file
-			shaderFile.open(shArg.path);
-			std::stringstream shaderStream;
-			for (const auto& def : shArg.definitions) {
-				shaderStream << def << std::endl;
-			}
-			// read file's buffer contents into stream
-			shaderStream << shaderFile.rdbuf();
-			// close file handler
-			shaderFile.close();
-			// convert stream into string
-			code = shaderStream.str();
-		}
-		catch (std::ifstream::failure e)
-		{
-			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
-		}
-
-		// 2. compile shaders
+	// 2. compile shaders
+	GLuint Compile(const std::string& code, GLenum stage, const std::vector<std::string>& files) {
 		unsigned int shader;
 
-		shader = glCreateShader(shArg.stage);
+		shader = glCreateShader(stage);
 		const char* ccode = code.c_str();
 		glShaderSource(shader, 1, &ccode, NULL);
 		glCompileShader(shader);
-		checkCompileErrors(shader, shArg.stage);
+		checkCompileErrors(shader, stage, &files);
 		return shader;
 	}
 
 	void initShader(const ShaderArguments& shaderArgs) {
+		// programs this process built before with the same definitions are shared
+		ProgramSource source;
+		for (const auto& shArg : shaderArgs) {
+			source.add(shArg.path, shArg.stage, shArg.definitions);
+		}
+		programId = ShaderPermutations::Get().Find(source);
+		if (programId != 0)
+			return;
+
+		// 1. retrieve the source code from cpath, with its #includes expanded, around the definitions
+		if (!ShaderPreprocessor::Load(source))
+			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+
+		// programs built from these sources in an earlier run are loaded from the program cache instead
 		programId = glCreateProgram();
+		if (ProgramCache::Get().Load(source, programId)) {
+			ShaderPermutations::Get().Insert(source, programId);
+			return;
+		}
 		
 		std::vector<GLuint> shaderObjs;
 
-		for (const auto& shArg : shaderArgs) {
-			GLuint shaderObj = LoadAndCompile(shArg);
+		for (unsigned int i = 0; i < source.codes.size(); i++) {
+			GLuint shaderObj = Compile(source.codes[i], source.stages[i], source.files[i]);
 			glAttachShader(programId, shaderObj);
 			shaderObjs.emplace_back(shaderObj);
 		}
 		
+		ProgramCache::Get().PrepareLink(programId);
 		glLinkProgram(programId);
 		checkCompileErrors(programId, 0);
+		ProgramCache::Get().Store(source, programId);
+		ShaderPermutations::Get().Insert(source, programId);
 
 		// delete the shaders as they're linked into our program now and no longer necessary
 		for (const auto& shaderObj : shaderObjs) {
@@ -161,7 +159,8 @@ private:
 		{ GL_COMPUTE_SHADER, "GL_COMPUTE_SHADER" }
 	};
 
-    void checkCompileErrors(unsigned int shader, const GLenum checkType) {
+    // the files are the ones behind the source string numbers of a stage, see ShaderPreprocessor
+    void checkCompileErrors(unsigned int shader, const GLenum checkType, const std::vector<std::string>* files = nullptr) {
         int success;        
         if (checkType != 0)
         {
@@ -174,7 +173,7 @@ private:
 				if (len > 0) {
 					infoLog = static_cast<char*>(std::malloc(len * sizeof(char)));
 					glGetShaderInfoLog(shader, len, NULL, infoLog);
-					std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << typeToString.at(checkType) << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+					std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << typeToString.at(checkType) << "\n" << (files ? ShaderPreprocessor::ResolveLog(infoLog, *files) : std::string(infoLog)) << "\n -- --------------------------------------------------- -- " << std::endl;
 					std::free(infoLog);
 				}
             }
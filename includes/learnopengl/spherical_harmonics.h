@@ -0,0 +1,198 @@
+#ifndef SPHERICAL_HARMONICS_H
+#define SPHERICAL_HARMONICS_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/parallel.h>
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+using namespace std;
+
+// SSE2 is part of every x86-64 CPU; elsewhere the projection runs the scalar loop
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+    #define SH_HAVE_SSE2 1
+    #include <emmintrin.h>
+#else
+    #define SH_HAVE_SSE2 0
+#endif
+
+// The diffuse irradiance of an environment as 9 L2 spherical harmonic coefficients, laid out as the std140 uniform
+// block the PBR shaders declare:
+//
+//     layout (std140) uniform IrradianceSHBlock { vec4 shCoefficients[9]; };
+//
+// The cosine lobe convolution and the constants of the basis functions are already folded in, so the shader only
+// evaluates the polynomials of the normal (1, y, z, x, xy, yz, 3z^2 - 1, xz, x^2 - y^2) and sums. Like the irradiance
+// maps of the convolution pass, the result is the irradiance divided by PI. The w components are unused.
+struct IrradianceSH {
+    float coefficients[9][4];
+};
+
+// Projects cubemaps onto the SH basis on the CPU. Every texel is weighted by the solid angle it covers; rows of the
+// faces are spread over worker threads, and within a row the three color channels of all 9 coefficients are
+// accumulated with SSE2. Each row keeps its own sums, which are added up in double afterwards, so the result doesn't
+// depend on the number of threads.
+namespace SphericalHarmonics
+{
+    // the direction through the center of a texel of a cubemap face, as the GL cubemap lookup maps it; returns the
+    // solid angle of the texel
+    inline float TexelDirection(int face, int x, int y, int size, float direction[3])
+    {
+        float s = 2.0f * (x + 0.5f) / size - 1.0f;
+        float t = 2.0f * (y + 0.5f) / size - 1.0f;
+        const float faces[6][3] = {
+            {  1.0f, -t, -s },
+            { -1.0f, -t,  s },
+            {  s,  1.0f,  t },
+            {  s, -1.0f, -t },
+            {  s, -t,  1.0f },
+            { -s, -t, -1.0f }
+        };
+        float lengthSquared = 1.0f + s * s + t * t;
+        float inverseLength = 1.0f / sqrt(lengthSquared);
+        for (int i = 0; i < 3; i++)
+            direction[i] = faces[face][i] * inverseLength;
+        float texelSize = 2.0f / size;
+        return texelSize * texelSize * inverseLength / lengthSquared;
+    }
+
+    // the 9 real SH basis functions of bands 0 to 2 at a unit direction
+    inline void Basis(const float direction[3], float basis[9])
+    {
+        float x = direction[0], y = direction[1], z = direction[2];
+        basis[0] = 0.282095f;
+        basis[1] = 0.488603f * y;
+        basis[2] = 0.488603f * z;
+        basis[3] = 0.488603f * x;
+        basis[4] = 1.092548f * x * y;
+        basis[5] = 1.092548f * y * z;
+        basis[6] = 0.315392f * (3.0f * z * z - 1.0f);
+        basis[7] = 1.092548f * x * z;
+        basis[8] = 0.546274f * (x * x - y * y);
+    }
+
+    // adds the texels of one row of a face, weighted by their solid angle, to sums; returns the row's solid angle
+    inline float ProjectRow(const float *row, int face, int y, int size, float sums[9][4])
+    {
+        float solidAngle = 0.0f;
+        float direction[3], basis[9];
+#if SH_HAVE_SSE2
+        __m128 accumulators[9];
+        for (int k = 0; k < 9; k++)
+            accumulators[k] = _mm_setzero_ps();
+        for (int x = 0; x < size; x++)
+        {
+            float weight = TexelDirection(face, x, y, size, direction);
+            solidAngle += weight;
+            Basis(direction, basis);
+            const float *texel = row + 3 * x;
+            __m128 color = _mm_mul_ps(_mm_setr_ps(texel[0], texel[1], texel[2], 0.0f), _mm_set1_ps(weight));
+            for (int k = 0; k < 9; k++)
+                accumulators[k] = _mm_add_ps(accumulators[k], _mm_mul_ps(color, _mm_set1_ps(basis[k])));
+        }
+        for (int k = 0; k < 9; k++)
+            _mm_storeu_ps(sums[k], accumulators[k]);
+#else
+        for (int k = 0; k < 9; k++)
+            sums[k][0] = sums[k][1] = sums[k][2] = sums[k][3] = 0.0f;
+        for (int x = 0; x < size; x++)
+        {
+            float weight = TexelDirection(face, x, y, size, direction);
+            solidAngle += weight;
+            Basis(direction, basis);
+            const float *texel = row + 3 * x;
+            for (int k = 0; k < 9; k++)
+            {
+                for (int c = 0; c < 3; c++)
+                    sums[k][c] += texel[c] * weight * basis[k];
+            }
+        }
+#endif
+        return solidAngle;
+    }
+
+    // projects the 6 faces of a cubemap level, given as RGB floats face by face (as glGetTexImage returns them), and
+    // convolves the result with the cosine lobe; 'threads' as ParallelFor
+    inline IrradianceSH ProjectCubemap(const float *texels, int size, unsigned int threads = 0)
+    {
+        unsigned int rows = 6 * (unsigned int)size;
+        vector<float> rowSums((size_t)rows * 9 * 4);
+        vector<float> rowSolidAngles(rows);
+        ParallelFor(rows, [&](unsigned int i)
+        {
+            int face = i / size, y = i % size;
+            const float *row = texels + (size_t)i * size * 3;
+            rowSolidAngles[i] = ProjectRow(row, face, y, size, reinterpret_cast<float(*)[4]>(&rowSums[(size_t)i * 36]));
+        }, threads);
+
+        double sums[9][3] = {};
+        double solidAngle = 0.0;
+        for (unsigned int i = 0; i < rows; i++)
+        {
+            for (int k = 0; k < 9; k++)
+            {
+                for (int c = 0; c < 3; c++)
+                    sums[k][c] += rowSums[(size_t)i * 36 + k * 4 + c];
+            }
+            solidAngle += rowSolidAngles[i];
+        }
+
+        // the texel solid angles only approximate the sphere, so they're scaled to cover exactly 4 PI. Then every band
+        // is convolved with the cosine lobe (PI, 2 PI / 3 and PI / 4, divided by PI) and the constant of its basis
+        // function is folded in.
+        const double PI = 3.14159265358979323846;
+        const double band[9] = { 1.0, 2.0 / 3.0, 2.0 / 3.0, 2.0 / 3.0, 0.25, 0.25, 0.25, 0.25, 0.25 };
+        const double constant[9] = { 0.282095, 0.488603, 0.488603, 0.488603, 1.092548, 1.092548, 0.315392, 1.092548, 0.546274 };
+        double normalization = 4.0 * PI / solidAngle;
+        IrradianceSH sh;
+        for (int k = 0; k < 9; k++)
+        {
+            for (int c = 0; c < 3; c++)
+                sh.coefficients[k][c] = (float)(sums[k][c] * normalization * band[k] * constant[k]);
+            sh.coefficients[k][3] = 0.0f;
+        }
+        return sh;
+    }
+
+    // reads a level of an RGB cubemap back as floats, in the layout ProjectCubemap takes; waits for the GPU to
+    // finish rendering it. Returns the size of the level.
+    inline int ReadCubemap(unsigned int cubemap, int size, int level, vector<float> &texels)
+    {
+        int levelSize = max(1, size >> level);
+        size_t faceFloats = (size_t)levelSize * levelSize * 3;
+        texels.resize(faceFloats * 6);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap);
+        for (unsigned int face = 0; face < 6; face++)
+            glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, GL_RGB, GL_FLOAT, &texels[face * faceFloats]);
+        return levelSize;
+    }
+
+    // the irradiance (divided by PI) the coefficients give for a unit normal, as the shaders evaluate it
+    inline void Evaluate(const IrradianceSH &sh, const float normal[3], float irradiance[3])
+    {
+        float x = normal[0], y = normal[1], z = normal[2];
+        const float polynomial[9] = { 1.0f, y, z, x, x * y, y * z, 3.0f * z * z - 1.0f, x * z, x * x - y * y };
+        for (int c = 0; c < 3; c++)
+        {
+            float sum = 0.0f;
+            for (int k = 0; k < 9; k++)
+                sum += sh.coefficients[k][c] * polynomial[k];
+            irradiance[c] = max(sum, 0.0f);
+        }
+    }
+
+    // creates a uniform buffer holding the coefficients, to be bound with glBindBufferBase(GL_UNIFORM_BUFFER, ...)
+    inline unsigned int CreateUniformBuffer(const IrradianceSH &sh)
+    {
+        unsigned int buffer;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(sh.coefficients), sh.coefficients, GL_STATIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        return buffer;
+    }
+}
+
+#endif
@@ -0,0 +1,450 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include <glad/glad.h>
+
+#include <stb_image.h>
+#include <image_DXT.h>
+#include <image_helper.h>
+
+#include <learnopengl/filesystem.h>
+
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+using namespace std;
+
+// S3TC formats (EXT_texture_compression_s3tc, EXT_texture_sRGB); every desktop driver has them, but they aren't core,
+// so the GL 3.3 loader doesn't define them.
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+// the FourCC codes of the cooked formats in a DDS header
+inline unsigned int DDSFourCC(char a, char b, char c, char d)
+{
+    return (unsigned int)a | ((unsigned int)b << 8) | ((unsigned int)c << 16) | ((unsigned int)d << 24);
+}
+
+// how a texture is created from its image; the texture cache uses these as part of its key.
+struct TextureOptions {
+    bool gammaCorrection;   // store color data as sRGB so the sampler linearizes it
+    GLint wrap;             // wrap mode for S and T
+    GLint alphaWrap;        // wrap mode used instead for images with an alpha channel, 0 to use 'wrap'
+    bool mipmaps;
+    bool streamed;          // mip levels are made resident on demand by the TextureStreamer, see texture_streamer.h
+    bool alphaTest;         // the alpha is tested against TEXTURE_ALPHA_REFERENCE (cutouts), so the mips keep its coverage
+
+    TextureOptions(bool gammaCorrection = false, GLint wrap = GL_REPEAT, GLint alphaWrap = 0, bool mipmaps = true)
+        : gammaCorrection(gammaCorrection), wrap(wrap), alphaWrap(alphaWrap), mipmaps(mipmaps), streamed(false), alphaTest(false) {}
+};
+
+// decoded pixels of an image file, ready to be uploaded. data is nullptr if decoding failed.
+// Cooked images (see CookedTexturePath) are block compressed instead. Both carry their whole mip chain when mipmapped.
+struct TextureImage {
+    int width;
+    int height;
+    int nrComponents;
+    unsigned char *data;
+    GLenum compressedFormat; // DXT1/DXT5 (S3TC) or RGTC1/RGTC2 (BC4/BC5), 0 for plain pixels
+    int levels;              // mip levels stored in data, largest first and back to back
+    size_t size;             // bytes in data
+};
+
+// cooked textures: the texture_cooker tool stores a block compressed copy of every image, with all its mip levels, as
+// "<image>.dds" next to it. Those are loaded as-is instead of decoding the image, unless this is switched off.
+inline bool& UseCookedTextures()
+{
+    static bool use = true;
+    return use;
+}
+
+inline string CookedTexturePath(const string &filename)
+{
+    return filename + ".dds";
+}
+
+// whether the cooked version of an image exists and was written after the image, as the cooker decides what to cook
+// again; a .dds without its source image is used as it is
+inline bool CookedTextureIsCurrent(const string &filename)
+{
+    unsigned long long sourceSize, sourceTime, cookedSize, cookedTime;
+    if (!FileSystem::getFileStamp(CookedTexturePath(filename), cookedSize, cookedTime))
+        return false;
+    return !FileSystem::getFileStamp(filename, sourceSize, sourceTime) || cookedTime >= sourceTime;
+}
+
+// bytes of one mip level of a block compressed texture: 4x4 pixel blocks of 8 (DXT1, BC4) or 16 (DXT5, BC5) bytes
+inline size_t CompressedLevelSize(GLenum format, int width, int height)
+{
+    size_t blockBytes = (format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || format == GL_COMPRESSED_SRGB_S3TC_DXT1_EXT ||
+                         format == GL_COMPRESSED_RED_RGTC1) ? 8 : 16;
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes;
+}
+
+// what the texture cooker records in the reserved words of a DDS header, after its tag: the flags its mip chain was
+// built with (see TextureMipFlags) and the channels of the source image. Other DDS files have a mipFlags of -1.
+const unsigned int COOKED_TEXTURE_TAG = 0x4C474F4C; // "LOGL"
+
+struct CookedTextureInfo {
+    int mipFlags;
+    int sourceComponents;
+};
+
+// reads a DXT1/DXT5/BC4/BC5 .dds file with its mip chain; returns false (and leaves image alone) if it's missing or
+// not one. BC4 and BC5 are accepted under both their FourCCs, ATI1/BC4U and ATI2/BC5U.
+// The blocks are copied once, straight out of a mapping of the file.
+inline bool LoadDDSImage(const string &filename, TextureImage &image, CookedTextureInfo *info = nullptr)
+{
+    FileSystem::MappedFile file(filename);
+    if (!file.data() || file.size() < sizeof(DDS_header))
+        return false;
+    DDS_header header;
+    memcpy(&header, file.data(), sizeof(header));
+    bool valid = header.dwMagic == (('D' << 0) | ('D' << 8) | ('S' << 16) | (' ' << 24))
+                 && header.dwSize == 124 && (header.sPixelFormat.dwFlags & DDPF_FOURCC) && header.dwWidth > 0 && header.dwHeight > 0;
+    GLenum format = 0;
+    unsigned int fourCC = valid ? header.sPixelFormat.dwFourCC : 0;
+    if (fourCC == DDSFourCC('D', 'X', 'T', '1'))
+        format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    else if (fourCC == DDSFourCC('D', 'X', 'T', '5'))
+        format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    else if (fourCC == DDSFourCC('A', 'T', 'I', '1') || fourCC == DDSFourCC('B', 'C', '4', 'U'))
+        format = GL_COMPRESSED_RED_RGTC1;
+    else if (fourCC == DDSFourCC('A', 'T', 'I', '2') || fourCC == DDSFourCC('B', 'C', '5', 'U'))
+        format = GL_COMPRESSED_RG_RGTC2;
+    if (format == 0)
+        return false;
+
+    int levels = (header.dwFlags & DDSD_MIPMAPCOUNT) && header.dwMipMapCount > 0 ? (int)header.dwMipMapCount : 1;
+    size_t size = 0;
+    for (int level = 0; level < levels; level++)
+        size += CompressedLevelSize(format, max(1, (int)header.dwWidth >> level), max(1, (int)header.dwHeight >> level));
+    if (file.size() - sizeof(header) < size)
+    {
+        cout << "ERROR::TEXTURE:: truncated DDS file " << filename << endl;
+        return false;
+    }
+    unsigned char *data = (unsigned char*)malloc(size);
+    if (!data)
+        return false;
+    memcpy(data, file.data() + sizeof(header), size);
+
+    image.width = (int)header.dwWidth;
+    image.height = (int)header.dwHeight;
+    image.nrComponents = format == GL_COMPRESSED_RED_RGTC1 ? 1 : format == GL_COMPRESSED_RG_RGTC2 ? 2
+                       : format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? 3 : 4;
+    image.data = data;
+    image.compressedFormat = format;
+    image.levels = levels;
+    image.size = size;
+    if (info)
+    {
+        bool cooked = header.dwReserved1[0] == COOKED_TEXTURE_TAG;
+        info->mipFlags = cooked ? (int)header.dwReserved1[1] : -1;
+        info->sourceComponents = cooked ? (int)header.dwReserved1[2] : image.nrComponents;
+    }
+    return true;
+}
+
+// mip chains are built on the CPU with mipmap_image_chain, by the texture cooker and by DecodeTextureImage alike, with
+// this filter and the flags of TextureMipFlags, so cooked and uncooked textures get the same mips.
+inline int& TextureMipFilter()
+{
+    static int filter = MIPMAP_FILTER_KAISER;
+    return filter;
+}
+
+// the alpha test threshold of the cutout shaders (3.1.blending.fs); mips of RGBA images keep the coverage it gives
+const float TEXTURE_ALPHA_REFERENCE = 0.1f;
+
+inline bool IsNormalMap(const string &filename)
+{
+    string name = filename.substr(filename.find_last_of("/\\") + 1);
+    transform(name.begin(), name.end(), name.begin(), ::tolower);
+    return name.find("normal") != string::npos || name.find("_ddn") != string::npos || name.find("_nrm") != string::npos;
+}
+
+// whether an image holds data rather than colors, going by its name: normal maps, and height, specular, ambient
+// occlusion, roughness and metallic maps (e.g. "toy_box_disp.png", "container2_specular.png", "ao.png")
+inline bool IsDataMap(const string &filename)
+{
+    if (IsNormalMap(filename))
+        return true;
+    string name = filename.substr(filename.find_last_of("/\\") + 1);
+    transform(name.begin(), name.end(), name.begin(), ::tolower);
+    const char *words[] = { "disp", "displacement", "height", "bump", "spec", "specular", "ao", "roughness", "metallic", "metalness" };
+    // the words of the name, split at everything but letters, so "ao" doesn't match inside another word
+    size_t begin = 0;
+    while (begin < name.size())
+    {
+        size_t end = begin;
+        while (end < name.size() && isalpha((unsigned char)name[end]))
+            end++;
+        string word = name.substr(begin, end - begin);
+        for (unsigned int i = 0; i < sizeof(words) / sizeof(words[0]); i++)
+        {
+            if (word == words[i])
+                return true;
+        }
+        begin = end + 1;
+    }
+    return false;
+}
+
+// the mip chain flags of an image created with 'options'. Color images (gamma corrected ones, and any that aren't data
+// by their name) are filtered in linear space, RGBA ones alpha weighted; data maps and 1/2 channel images are
+// filtered as they are. Only alpha tested images get their alpha rescaled to keep the coverage of the test.
+inline int TextureMipFlags(const string &filename, const TextureOptions &options, int nrComponents)
+{
+    if (nrComponents < 3)
+        return 0;
+    bool color = options.gammaCorrection || !IsDataMap(filename);
+    int flags = color ? MIPMAP_SRGB : 0;
+    if (nrComponents == 4 && (color || options.alphaTest))
+        flags |= MIPMAP_ALPHA;
+    if (nrComponents == 4 && options.alphaTest)
+        flags |= MIPMAP_ALPHA_COVERAGE;
+    return flags;
+}
+
+// decodes an image file on the CPU, or reads its cooked version if there is one that's newer than the image and whose
+// mips were built with the flags 'options' ask for. With mipmaps, the whole mip chain is built here too (cooked images have theirs already). Doesn't
+// touch any GL state, so it's safe to call from worker threads.
+inline TextureImage DecodeTextureImage(const string &filename, const TextureOptions &options = TextureOptions())
+{
+    TextureImage image;
+    bool mipmaps = options.mipmaps;
+    CookedTextureInfo cooked;
+    if (UseCookedTextures() && CookedTextureIsCurrent(filename) && LoadDDSImage(CookedTexturePath(filename), image, &cooked))
+    {
+        // mips cooked for another use of the image (e.g. alpha tested) are rebuilt from the source
+        if (!mipmaps || cooked.mipFlags < 0 || cooked.mipFlags == TextureMipFlags(filename, options, cooked.sourceComponents))
+            return image;
+        free(image.data);
+    }
+    // stb_image decodes straight from a mapping of the file instead of through buffered stdio reads
+    FileSystem::MappedFile file(filename);
+    image.data = file.data() ? stbi_load_from_memory(file.data(), (int)file.size(), &image.width, &image.height, &image.nrComponents, 0) : nullptr;
+    image.compressedFormat = 0;
+    image.levels = 1;
+    image.size = image.data ? (size_t)image.width * image.height * image.nrComponents : 0;
+    if (image.data && mipmaps && (image.width > 1 || image.height > 1))
+    {
+        int levels = 0, size = 0;
+        unsigned char *chain = mipmap_image_chain(image.data, image.width, image.height, image.nrComponents, TextureMipFilter(),
+                                                  TextureMipFlags(filename, options, image.nrComponents), TEXTURE_ALPHA_REFERENCE, &levels, &size);
+        if (chain)
+        {
+            stbi_image_free(image.data);
+            image.data = chain;
+            image.levels = levels;
+            image.size = (size_t)size;
+        }
+    }
+    return image;
+}
+
+// decodes a Radiance .hdr (or any other image stb_image reads) to floats, straight from a mapping of the file;
+// returns nullptr on failure. Free the result with stbi_image_free.
+inline float* LoadHDRImage(const string &filename, int *width, int *height, int *nrComponents)
+{
+    FileSystem::MappedFile file(filename);
+    if (!file.data())
+        return nullptr;
+    return stbi_loadf_from_memory(file.data(), (int)file.size(), width, height, nrComponents, 0);
+}
+
+inline void FreeTextureImage(TextureImage &image)
+{
+    // cooked images and mip chains are malloc'd, single decoded images are stb_image's
+    if (image.compressedFormat || image.levels > 1)
+        free(image.data);
+    else
+        stbi_image_free(image.data);
+    image.data = nullptr;
+}
+
+// approximate GPU memory used by a texture created from 'image', including its mip chain.
+inline size_t TextureImageBytes(const TextureImage &image, const TextureOptions &options)
+{
+    if (!image.data)
+        return 0;
+    if (image.compressedFormat)
+        return options.mipmaps ? image.size : CompressedLevelSize(image.compressedFormat, image.width, image.height);
+    size_t bytes = (size_t)image.width * image.height * image.nrComponents;
+    if (image.levels > 1)
+        return options.mipmaps ? image.size : bytes;
+    return options.mipmaps ? bytes * 4 / 3 : bytes;
+}
+
+// the internal format of a texture created from 'image' and the format of its pixels. Internal formats are sized, as
+// glTexStorage2D wants them; cooked images keep their block format (made sRGB for gamma corrected DXT).
+inline void TextureImageFormats(const TextureImage &image, const TextureOptions &options, GLenum &internalFormat, GLenum &dataFormat)
+{
+    dataFormat = image.nrComponents == 1 ? GL_RED : image.nrComponents == 2 ? GL_RG : image.nrComponents == 3 ? GL_RGB : GL_RGBA;
+    if (image.compressedFormat)
+    {
+        internalFormat = image.compressedFormat;
+        bool rgtc = internalFormat == GL_COMPRESSED_RED_RGTC1 || internalFormat == GL_COMPRESSED_RG_RGTC2;
+        if (options.gammaCorrection && !rgtc)
+            internalFormat = internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT;
+    }
+    else if (image.nrComponents == 1)
+        internalFormat = GL_R8;
+    else if (image.nrComponents == 2)
+        internalFormat = GL_RG8;
+    else if (image.nrComponents == 3)
+        internalFormat = options.gammaCorrection ? GL_SRGB8 : GL_RGB8;
+    else
+        internalFormat = options.gammaCorrection ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+}
+
+// the mip levels of 'image' that are uploaded: its stored chain, or only the top level without mipmaps
+inline int TextureImageLevels(const TextureImage &image, const TextureOptions &options)
+{
+    return options.mipmaps ? image.levels : 1;
+}
+
+// whether the mips of a texture created from 'image' are left to glGenerateMipmap: images decoded without their chain
+inline bool TextureImageGeneratesMipmaps(const TextureImage &image, const TextureOptions &options)
+{
+    return options.mipmaps && !image.compressedFormat && image.levels == 1 && max(image.width, image.height) > 1;
+}
+
+// bytes of a width x height region of one level of 'image'; cooked images store whole 4x4 blocks
+inline size_t TextureLevelSize(const TextureImage &image, int width, int height)
+{
+    if (image.compressedFormat)
+        return CompressedLevelSize(image.compressedFormat, width, height);
+    return (size_t)width * height * image.nrComponents;
+}
+
+// byte offset of a mip level in image.data, behind all the larger levels
+inline size_t TextureLevelOffset(const TextureImage &image, int level)
+{
+    size_t offset = 0;
+    for (int i = 0; i < level; i++)
+        offset += TextureLevelSize(image, max(1, image.width >> i), max(1, image.height >> i));
+    return offset;
+}
+
+// allocates storage for 'levels' levels of a 2D texture or of every face of a cubemap, immutable (glTexStorage2D)
+// where the context is GL 4.2 or newer, level by level otherwise. The texture must be bound to 'target'.
+inline void AllocateTextureStorage(GLenum target, int levels, GLenum internalFormat, GLenum dataFormat, GLenum compressedFormat, int width, int height)
+{
+    if (GLAD_GL_VERSION_4_2)
+    {
+        glTexStorage2D(target, levels, internalFormat, width, height);
+        return;
+    }
+    unsigned int faces = target == GL_TEXTURE_CUBE_MAP ? 6 : 1;
+    for (unsigned int face = 0; face < faces; face++)
+    {
+        GLenum faceTarget = target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : target;
+        for (int level = 0; level < levels; level++)
+        {
+            int w = max(1, width >> level), h = max(1, height >> level);
+            if (compressedFormat)
+                glCompressedTexImage2D(faceTarget, level, internalFormat, w, h, 0, (GLsizei)CompressedLevelSize(compressedFormat, w, h), NULL);
+            else
+                glTexImage2D(faceTarget, level, internalFormat, w, h, 0, dataFormat, GL_UNSIGNED_BYTE, NULL);
+        }
+    }
+    // mutable textures would otherwise expect levels down to 1x1
+    glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, levels - 1);
+}
+
+// sets the sampling parameters of a texture created from 'image' with 'levels' mip levels, a 2D texture or an array of
+// them; the texture must be bound to 'target'.
+// BC4 images are cooked from grayscale ones, so they're swizzled to read back as gray in all of r, g and b.
+// BC5 images are normal maps that only store x and y, see the normal mapping shaders for rebuilding z.
+inline void SetTextureParameters(const TextureImage &image, const TextureOptions &options, int levels, GLenum target = GL_TEXTURE_2D)
+{
+    GLenum internalFormat, dataFormat;
+    TextureImageFormats(image, options, internalFormat, dataFormat);
+    if (options.gammaCorrection && (internalFormat == GL_COMPRESSED_RED_RGTC1 || internalFormat == GL_COMPRESSED_RG_RGTC2))
+        cout << "WARNING::TEXTURE:: there is no sRGB BC4/BC5 format, a gamma corrected texture is sampled as linear" << endl;
+    if (internalFormat == GL_COMPRESSED_RED_RGTC1)
+    {
+        GLint swizzle[4] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+        glTexParameteriv(target, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    }
+
+    GLint wrap = (dataFormat == GL_RGBA && options.alphaWrap != 0) ? options.alphaWrap : options.wrap;
+    glTexParameteri(target, GL_TEXTURE_WRAP_S, wrap);
+    glTexParameteri(target, GL_TEXTURE_WRAP_T, wrap);
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+// creates a 2D texture with storage for every mip level of 'image' and its sampling parameters, but no pixels yet.
+// Leaves the texture bound; must be called on the thread owning the GL context.
+inline unsigned int CreateTextureStorage(const TextureImage &image, const TextureOptions &options)
+{
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    if (!image.data)
+        return textureID;
+
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    GLenum internalFormat, dataFormat;
+    TextureImageFormats(image, options, internalFormat, dataFormat);
+    int levels = TextureImageLevels(image, options);
+    if (TextureImageGeneratesMipmaps(image, options))
+    {
+        int size = max(image.width, image.height);
+        for (levels = 1; size > 1; size >>= 1)
+            levels++;
+    }
+    AllocateTextureStorage(GL_TEXTURE_2D, levels, internalFormat, dataFormat, image.compressedFormat, image.width, image.height);
+    SetTextureParameters(image, options, levels);
+    return textureID;
+}
+
+// creates a 2D texture from decoded pixels straight from client memory, waiting for the driver to copy them all.
+// The texture cache streams them through TextureUploadQueue (texture_upload.h) instead.
+// Must be called on the thread owning the GL context.
+inline unsigned int UploadTextureImage(const TextureImage &image, const TextureOptions &options = TextureOptions())
+{
+    unsigned int textureID = CreateTextureStorage(image, options);
+    if (!image.data)
+        return textureID;
+
+    GLenum internalFormat, dataFormat;
+    TextureImageFormats(image, options, internalFormat, dataFormat);
+    // the rows of small mip levels (and of odd sized RGB images) aren't 4 byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    int levels = TextureImageLevels(image, options);
+    size_t offset = 0;
+    for (int level = 0; level < levels; level++)
+    {
+        int width = max(1, image.width >> level);
+        int height = max(1, image.height >> level);
+        size_t size = TextureLevelSize(image, width, height);
+        if (image.compressedFormat)
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, width, height, internalFormat, (GLsizei)size, image.data + offset);
+        else
+            glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, width, height, dataFormat, GL_UNSIGNED_BYTE, image.data + offset);
+        offset += size;
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if (TextureImageGeneratesMipmaps(image, options))
+        glGenerateMipmap(GL_TEXTURE_2D);
+    return textureID;
+}
+
+#endif
@@ -0,0 +1,265 @@
+#ifndef TEXTURE_ARRAY_H
+#define TEXTURE_ARRAY_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/texture.h>
+#include <learnopengl/material.h>
+
+#include <string>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+using namespace std;
+
+// how textures of different sizes share the layers of one array
+enum TextureArraySizing {
+    TEXTURE_ARRAY_EXACT, // only textures of the same size share an array
+    TEXTURE_ARRAY_PAD    // smaller power of two textures are repeated to fill a layer of the array's size, see below
+};
+
+struct TextureArrayOptions {
+    TextureArraySizing sizing;
+    int maxSize;         // textures larger than this on their longer side lose their top mip levels until they fit; 0 for no limit
+
+    TextureArrayOptions() : sizing(TEXTURE_ARRAY_PAD), maxSize(0) {}
+};
+
+// what packing a set of textures cost and saved
+struct TextureArrayReport {
+    vector<unsigned int> arrays; // the GL_TEXTURE_2D_ARRAY textures created, owned by the caller
+    unsigned int layers;
+    size_t bytes;                // GPU memory of all arrays
+    size_t paddingBytes;         // ... taken by the repeated copies of padded textures
+    size_t droppedBytes;         // mip levels left out to stay within maxSize
+};
+
+// Packs the material textures of a model into GL_TEXTURE_2D_ARRAY textures at load time, so meshes whose textures
+// share arrays are drawn without rebinding anything; each mesh only passes its layers, see Material.
+// Textures go into the same array when they have the same format (block format or channels, sRGB or not) and sampler
+// state. With TEXTURE_ARRAY_PAD, a power of two sized texture smaller than the array is repeated across its layer and
+// sampled with its texture coordinates scaled down by that factor (TextureLayer::scale), which keeps GL_REPEAT
+// wrapping and the filtering across the edges exact and picks the same mip levels as the texture on its own. Textures
+// that don't repeat or aren't power of two sized only share arrays with textures of their own size.
+// The images must carry their mip chains, as DecodeTextureImage builds them; layers are uploaded straight from them.
+namespace TextureArrayPacker
+{
+    // one group of images that end up in the same array
+    struct Group {
+        string format;
+        GLenum internalFormat, dataFormat;
+        int width, height, levels;
+        GLint wrap;
+        TextureOptions options;
+        vector<unsigned int> members;
+    };
+
+    inline string FormatKey(const TextureImage &image, const TextureOptions &options, GLenum &internalFormat, GLenum &dataFormat, GLint &wrap)
+    {
+        TextureImageFormats(image, options, internalFormat, dataFormat);
+        wrap = (dataFormat == GL_RGBA && options.alphaWrap != 0) ? options.alphaWrap : options.wrap;
+        return to_string(internalFormat) + '|' + to_string(dataFormat) + '|' + to_string(wrap) + '|' + to_string(options.mipmaps);
+    }
+
+    inline bool PowerOfTwo(int size)
+    {
+        return (size & (size - 1)) == 0;
+    }
+
+    // the number of levels in a full chain down to 1x1
+    inline int FullLevels(int width, int height)
+    {
+        int levels = 1;
+        for (int size = max(width, height); size > 1; size >>= 1)
+            levels++;
+        return levels;
+    }
+
+    // drops the top levels of an image larger than maxSize, keeping the rest of its chain in place
+    inline size_t FitImage(TextureImage &image, int maxSize)
+    {
+        if (maxSize <= 0 || image.levels <= 1)
+            return 0;
+        int skip = 0;
+        while (skip + 1 < image.levels && max(image.width >> skip, image.height >> skip) > maxSize)
+            skip++;
+        if (skip == 0)
+            return 0;
+        size_t offset = TextureLevelOffset(image, skip);
+        memmove(image.data, image.data + offset, image.size - offset);
+        image.width = max(1, image.width >> skip);
+        image.height = max(1, image.height >> skip);
+        image.levels -= skip;
+        image.size -= offset;
+        return offset;
+    }
+
+    // copies one level of a member into its layer, repeated to fill the layer's level if the member is smaller. Padded
+    // members and their arrays have power of two sizes, so the copies tile every level exactly.
+    inline void UploadLayerLevel(const Group &group, const TextureImage &image, int layer, int level)
+    {
+        int layerWidth = max(1, group.width >> level), layerHeight = max(1, group.height >> level);
+        // members without a full chain repeat their smallest level in the levels below it
+        int source = min(level, image.levels - 1);
+        int width = max(1, image.width >> source), height = max(1, image.height >> source);
+        const unsigned char *pixels = image.data + TextureLevelOffset(image, source);
+        // compressed levels are repeated in whole 4x4 blocks, which only differs from the exact repeat below a block
+        int stepX = image.compressedFormat ? max(width, 4) : width;
+        int stepY = image.compressedFormat ? max(height, 4) : height;
+        for (int y = 0; y < layerHeight; y += stepY)
+        {
+            for (int x = 0; x < layerWidth; x += stepX)
+            {
+                int w = min(stepX, layerWidth - x), h = min(stepY, layerHeight - y);
+                if (image.compressedFormat)
+                    glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, x, y, layer, w, h, 1, group.internalFormat,
+                                              (GLsizei)CompressedLevelSize(image.compressedFormat, w, h), pixels);
+                else
+                    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, x, y, layer, w, h, 1, group.dataFormat, GL_UNSIGNED_BYTE, pixels);
+            }
+        }
+    }
+
+    // creates the array of a group and uploads all its members
+    inline unsigned int CreateArray(const Group &group, const vector<TextureImage> &images)
+    {
+        unsigned int id;
+        glGenTextures(1, &id);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, id);
+        GLsizei layers = (GLsizei)group.members.size();
+        GLenum compressedFormat = images[group.members[0]].compressedFormat;
+        if (GLAD_GL_VERSION_4_2)
+            glTexStorage3D(GL_TEXTURE_2D_ARRAY, group.levels, group.internalFormat, group.width, group.height, layers);
+        else
+        {
+            for (int level = 0; level < group.levels; level++)
+            {
+                int w = max(1, group.width >> level), h = max(1, group.height >> level);
+                if (compressedFormat)
+                    glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, group.internalFormat, w, h, layers, 0,
+                                           (GLsizei)(CompressedLevelSize(compressedFormat, w, h) * layers), NULL);
+                else
+                    glTexImage3D(GL_TEXTURE_2D_ARRAY, level, group.internalFormat, w, h, layers, 0, group.dataFormat, GL_UNSIGNED_BYTE, NULL);
+            }
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, group.levels - 1);
+        }
+        SetTextureParameters(images[group.members[0]], group.options, group.levels, GL_TEXTURE_2D_ARRAY);
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (unsigned int i = 0; i < group.members.size(); i++)
+        {
+            for (int level = 0; level < group.levels; level++)
+                UploadLayerLevel(group, images[group.members[i]], (int)i, level);
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        return id;
+    }
+
+    // packs decoded images, created with the given options, into arrays and frees their pixels. layers[i] is where
+    // images[i] ended up; images that failed to decode get array 0. Must be called on the thread owning the GL context.
+    inline TextureArrayReport Pack(vector<TextureImage> &images, const vector<TextureOptions> &options, const TextureArrayOptions &arrayOptions,
+                                   vector<TextureLayer> &layers)
+    {
+        TextureArrayReport report;
+        report.layers = 0;
+        report.bytes = report.paddingBytes = report.droppedBytes = 0;
+        layers.assign(images.size(), TextureLayer());
+
+        GLint maxLayers = 256;
+        glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+
+        // the largest images first, so every group is created at the size of its largest member
+        vector<unsigned int> order;
+        for (unsigned int i = 0; i < images.size(); i++)
+        {
+            if (!images[i].data)
+                continue;
+            if (options[i].mipmaps && images[i].levels < FullLevels(images[i].width, images[i].height))
+                cout << "WARNING::TEXTURE_ARRAY:: an image without its mip chain is packed, its smaller levels will be wrong" << endl;
+            report.droppedBytes += FitImage(images[i], arrayOptions.maxSize);
+            order.push_back(i);
+        }
+        stable_sort(order.begin(), order.end(), [&images](unsigned int a, unsigned int b)
+        {
+            return (size_t)images[a].width * images[a].height > (size_t)images[b].width * images[b].height;
+        });
+
+        vector<Group> groups;
+        for (unsigned int i = 0; i < order.size(); i++)
+        {
+            const TextureImage &image = images[order[i]];
+            GLenum internalFormat, dataFormat;
+            GLint wrap;
+            string format = FormatKey(image, options[order[i]], internalFormat, dataFormat, wrap);
+            // block compressed textures below a block can't be repeated exactly
+            bool pad = arrayOptions.sizing == TEXTURE_ARRAY_PAD && wrap == GL_REPEAT
+                       && (!image.compressedFormat || (image.width >= 4 && image.height >= 4));
+            unsigned int g = 0;
+            for (; g < groups.size(); g++)
+            {
+                const Group &group = groups[g];
+                if (group.format != format || group.members.size() >= (size_t)maxLayers)
+                    continue;
+                if (group.width == image.width && group.height == image.height)
+                    break;
+                if (pad && PowerOfTwo(group.width) && PowerOfTwo(group.height) && PowerOfTwo(image.width) && PowerOfTwo(image.height)
+                    && group.width >= image.width && group.height >= image.height)
+                    break;
+            }
+            if (g == groups.size())
+            {
+                Group group;
+                group.format = format;
+                group.internalFormat = internalFormat;
+                group.dataFormat = dataFormat;
+                group.wrap = wrap;
+                group.options = options[order[i]];
+                group.width = image.width;
+                group.height = image.height;
+                group.levels = options[order[i]].mipmaps ? FullLevels(image.width, image.height) : 1;
+                groups.push_back(group);
+            }
+            groups[g].members.push_back(order[i]);
+        }
+
+        for (unsigned int g = 0; g < groups.size(); g++)
+        {
+            const Group &group = groups[g];
+            unsigned int id = CreateArray(group, images);
+            report.arrays.push_back(id);
+            report.layers += (unsigned int)group.members.size();
+            const TextureImage &first = images[group.members[0]];
+            for (int level = 0; level < group.levels; level++)
+            {
+                size_t layerBytes = TextureLevelSize(first, max(1, group.width >> level), max(1, group.height >> level));
+                report.bytes += layerBytes * group.members.size();
+                for (unsigned int i = 0; i < group.members.size(); i++)
+                {
+                    const TextureImage &image = images[group.members[i]];
+                    report.paddingBytes += layerBytes - min(layerBytes, TextureLevelSize(image, max(1, image.width >> level), max(1, image.height >> level)));
+                }
+            }
+            for (unsigned int i = 0; i < group.members.size(); i++)
+            {
+                TextureLayer &layer = layers[group.members[i]];
+                layer.array = id;
+                layer.layer = (float)i;
+                layer.scale[0] = (float)images[group.members[i]].width / group.width;
+                layer.scale[1] = (float)images[group.members[i]].height / group.height;
+            }
+        }
+        for (unsigned int i = 0; i < images.size(); i++)
+            FreeTextureImage(images[i]);
+        return report;
+    }
+
+    inline void PrintReport(const TextureArrayReport &report)
+    {
+        cout << "TEXTURE_ARRAY:: " << report.layers << " textures in " << report.arrays.size() << " arrays, " << report.bytes / (1024.0 * 1024.0)
+             << " MB (" << report.paddingBytes / (1024.0 * 1024.0) << " MB padding, " << report.droppedBytes / (1024.0 * 1024.0)
+             << " MB of mip levels over the size limit left out)" << endl;
+    }
+}
+
+#endif
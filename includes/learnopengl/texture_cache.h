@@ -0,0 +1,186 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/texture.h>
+#include <learnopengl/texture_upload.h>
+#include <learnopengl/texture_streamer.h>
+#include <learnopengl/filesystem.h>
+
+#include <string>
+#include <iostream>
+#include <unordered_map>
+using namespace std;
+
+// Process-wide cache of 2D textures loaded from image files.
+// Textures are keyed on the canonical path of the file and the options they were created with, so every model
+// or demo that asks for the same file with the same options shares a single GL texture. Each Acquire/Insert/Lookup
+// hit adds a reference that is given back with Release; unreferenced textures stay resident until Evict is called.
+// Pixels go to the GPU through the TextureUploadQueue: Acquire and Insert return the texture with its upload still
+// queued, so a batch of loads goes over in one Flush (or the queue's per frame updates); AcquireBlocking flushes the
+// queue if its texture is still pending, for a texture that's drawn with right away. Textures created with options.streamed are handed to the
+// TextureStreamer instead, which makes their mip levels resident on demand; bytesResident counts them in full.
+// All functions create or delete GL objects and must be called from the thread owning the GL context.
+class TextureCache
+{
+public:
+    struct Stats {
+        unsigned int hits;
+        unsigned int misses;
+        unsigned int evictions;
+        unsigned int texturesResident;
+        size_t bytesResident;
+    };
+
+    static TextureCache& Get()
+    {
+        static TextureCache cache;
+        return cache;
+    }
+
+    // returns the texture for the given file, loading it if it's not in the cache yet. The pixels of a new texture
+    // are only queued: flush the TextureUploadQueue before drawing with it.
+    unsigned int Acquire(const string &path, const TextureOptions &options = TextureOptions())
+    {
+        unsigned int id = Lookup(path, options);
+        if (id != 0)
+            return id;
+
+        TextureImage image = DecodeTextureImage(path, options);
+        if (!image.data)
+            std::cout << "Texture failed to load at path: " << path << std::endl;
+        id = Insert(path, options, image);
+        FreeTextureImage(image);
+        return id;
+    }
+
+    // like Acquire, but the texture is complete when it returns
+    unsigned int AcquireBlocking(const string &path, const TextureOptions &options = TextureOptions())
+    {
+        unsigned int id = Acquire(path, options);
+        if (TextureUploadQueue::Get().Pending(id))
+            TextureUploadQueue::Get().Flush();
+        return id;
+    }
+
+    // returns the cached texture and adds a reference to it, or 0 (counted as a miss) if it's not cached.
+    // Used by loaders that decode images themselves and hand the results to Insert afterwards.
+    unsigned int Lookup(const string &path, const TextureOptions &options)
+    {
+        unordered_map<string, Entry>::iterator it = entries.find(makeKey(path, options));
+        if (it == entries.end())
+        {
+            stats.misses++;
+            return 0;
+        }
+        stats.hits++;
+        it->second.references++;
+        return it->second.id;
+    }
+
+    // creates the texture of an already decoded image and adds it to the cache with one reference. The pixels are
+    // handed to the upload queue, which leaves image.data nullptr; the texture is complete once the queue isn't Pending
+    // for it anymore. If the texture was cached in the meantime the existing one is returned and 'image' is left alone.
+    unsigned int Insert(const string &path, const TextureOptions &options, TextureImage &image)
+    {
+        string key = makeKey(path, options);
+        unordered_map<string, Entry>::iterator it = entries.find(key);
+        if (it != entries.end())
+        {
+            it->second.references++;
+            return it->second.id;
+        }
+
+        Entry entry;
+        entry.bytes = TextureImageBytes(image, options);
+        entry.id = options.streamed ? TextureStreamer::Get().Create(image, options) : TextureUploadQueue::Get().Upload(image, options);
+        entry.references = 1;
+        entries[key] = entry;
+        keys[entry.id] = key;
+
+        stats.texturesResident++;
+        stats.bytesResident += entry.bytes;
+        return entry.id;
+    }
+
+    // gives back a reference obtained from Acquire, Lookup or Insert.
+    void Release(unsigned int id)
+    {
+        unordered_map<unsigned int, string>::iterator it = keys.find(id);
+        if (it == keys.end())
+            return;
+        Entry &entry = entries[it->second];
+        if (entry.references > 0)
+            entry.references--;
+    }
+
+    // deletes every texture that isn't referenced anymore; returns the number of textures deleted.
+    unsigned int Evict()
+    {
+        unsigned int evicted = 0;
+        for (unordered_map<string, Entry>::iterator it = entries.begin(); it != entries.end();)
+        {
+            if (it->second.references == 0)
+            {
+                TextureUploadQueue::Get().Cancel(it->second.id);
+                TextureStreamer::Get().Remove(it->second.id);
+                glDeleteTextures(1, &it->second.id);
+                keys.erase(it->second.id);
+                stats.texturesResident--;
+                stats.bytesResident -= it->second.bytes;
+                evicted++;
+                it = entries.erase(it);
+            }
+            else
+                ++it;
+        }
+        stats.evictions += evicted;
+        return evicted;
+    }
+
+    const Stats& GetStats() const
+    {
+        return stats;
+    }
+
+    void PrintStats() const
+    {
+        cout << "TEXTURE_CACHE:: " << stats.hits << " hits, " << stats.misses << " misses, " << stats.evictions << " evicted, "
+             << stats.texturesResident << " textures resident (" << stats.bytesResident / (1024.0 * 1024.0) << " MB)" << endl;
+    }
+
+private:
+    struct Entry {
+        unsigned int id;
+        unsigned int references;
+        size_t bytes;
+    };
+
+    unordered_map<string, Entry> entries;
+    unordered_map<unsigned int, string> keys; // texture id -> cache key, for Release and Evict
+    Stats stats;
+
+    TextureCache()
+    {
+        stats.hits = stats.misses = stats.evictions = stats.texturesResident = 0;
+        stats.bytesResident = 0;
+    }
+    TextureCache(const TextureCache&) = delete;
+    TextureCache& operator=(const TextureCache&) = delete;
+
+    static string makeKey(const string &path, const TextureOptions &options)
+    {
+        return FileSystem::getCanonicalPath(path) + '|' + to_string(options.gammaCorrection) + '|' + to_string(options.wrap)
+            + '|' + to_string(options.alphaWrap) + '|' + to_string(options.mipmaps) + '|' + to_string(options.streamed)
+            + '|' + to_string(options.alphaTest);
+    }
+};
+
+// loads a texture relative to a directory through the texture cache; like Acquire, its pixels are still queued.
+inline unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false)
+{
+    return TextureCache::Get().Acquire(directory + '/' + string(path), TextureOptions(gamma));
+}
+
+#endif
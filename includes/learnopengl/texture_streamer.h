@@ -0,0 +1,315 @@
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/texture.h>
+#include <learnopengl/texture_upload.h>
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <iostream>
+using namespace std;
+
+// Keeps only the mip levels of textures resident that are needed to draw them at their current on-screen size, within
+// a global GPU memory budget.
+// Create takes over a texture's whole mip chain in system memory, allocates and uploads only its small levels (at most
+// ResidentSize texels on a side, which stay resident for good) and points GL_TEXTURE_BASE_LEVEL at the largest of them.
+// Draw code then asks for detail every frame with Request, from a CPU estimate of the texture's screen-space density
+// (Model::RequestTextureDetail), or with RequestLevel, e.g. from a GPU feedback pass that read back textureQueryLod.
+// Update raises the residency of the requested textures one level at a time: a level's storage is allocated, its pixels
+// go through the TextureUploadQueue, and once they're issued BASE_LEVEL moves down to it. When the next level doesn't
+// fit in the budget, levels finer than what their textures were asked for this frame are dropped in least recently used
+// order; levels that are in use stay, so requests that don't fit wait until something else is let go.
+// The storage is mutable (glTexImage2D per level) because immutable storage can't free single levels; a dropped level
+// is redefined as 0x0 to give its memory back. Levels below BASE_LEVEL are never sampled, so the texture is complete
+// with any of its levels resident. Images without a mip chain aren't streamed and are uploaded as usual.
+// All functions must be called from the thread owning the GL context.
+class TextureStreamer
+{
+public:
+    static const size_t DefaultBudget = 64 << 20;
+    static const int ResidentSize = 64;
+
+    struct Stats {
+        unsigned int textures;            // textures being streamed
+        size_t bytesResident;             // GPU memory of their resident levels, and of the ones being uploaded
+        size_t peakBytesResident;
+        unsigned long long levelsLoaded;  // levels made resident
+        unsigned long long levelsDropped; // levels given back to make room
+        unsigned long long budgetMisses;  // Updates that couldn't load a requested level within the budget
+    };
+
+    static TextureStreamer& Get()
+    {
+        static TextureStreamer streamer;
+        return streamer;
+    }
+
+    // the GPU memory the streamed textures may use; lowering it drops levels on the next Update. The levels that always
+    // stay resident are counted, but never dropped, so they can go over a budget that's too small.
+    void SetBudget(size_t bytes)
+    {
+        budget = bytes;
+    }
+
+    size_t GetBudget() const
+    {
+        return budget;
+    }
+
+    // creates a 2D texture from 'image' whose levels are streamed in on request and takes the pixels over: image.data is
+    // nullptr afterwards. Images with a single level go to TextureUploadQueue::Upload instead.
+    unsigned int Create(TextureImage &image, const TextureOptions &options = TextureOptions())
+    {
+        if (!image.data || image.levels <= 1 || !options.mipmaps)
+            return TextureUploadQueue::Get().Upload(image, options);
+
+        Entry entry;
+        entry.image = image;
+        TextureImageFormats(image, options, entry.internalFormat, entry.dataFormat);
+        entry.tail = 0;
+        while (entry.tail + 1 < image.levels && max(image.width >> entry.tail, image.height >> entry.tail) > ResidentSize)
+            entry.tail++;
+        entry.resident = entry.tail;
+        entry.loading = -1;
+        entry.wanted = image.levels;
+        entry.lastUsed = frame;
+
+        unsigned int id;
+        glGenTextures(1, &id);
+        glBindTexture(GL_TEXTURE_2D, id);
+        for (int level = entry.tail; level < image.levels; level++)
+            defineLevel(entry, level, true);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, entry.tail);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, image.levels - 1);
+        SetTextureParameters(image, options, image.levels);
+        TextureUploadQueue::Get().UploadLevels(id, entry.image, entry.tail, image.levels - entry.tail, entry.internalFormat, entry.dataFormat);
+
+        for (int level = entry.tail; level < image.levels; level++)
+            addResident(levelBytes(entry, level));
+        entries[id] = entry;
+        stats.textures++;
+        image.data = nullptr;
+        return id;
+    }
+
+    // stops streaming a texture and frees its pixels, before the caller deletes it
+    void Remove(unsigned int id)
+    {
+        unordered_map<unsigned int, Entry>::iterator it = entries.find(id);
+        if (it == entries.end())
+            return;
+        TextureUploadQueue::Get().Cancel(id);
+        Entry &entry = it->second;
+        int finest = entry.loading >= 0 ? entry.loading : entry.resident;
+        for (int level = finest; level < entry.image.levels; level++)
+            stats.bytesResident -= levelBytes(entry, level);
+        FreeTextureImage(entry.image);
+        entries.erase(it);
+        stats.textures--;
+    }
+
+    bool Streamed(unsigned int id) const
+    {
+        return entries.find(id) != entries.end();
+    }
+
+    // the finest level that can be sampled (GL_TEXTURE_BASE_LEVEL), 0 for textures that aren't streamed
+    int ResidentLevel(unsigned int id) const
+    {
+        unordered_map<unsigned int, Entry>::const_iterator it = entries.find(id);
+        return it == entries.end() ? 0 : it->second.resident;
+    }
+
+    // asks for the detail needed to draw the texture with 'pixelsPerTexCoord' screen pixels per unit of texture
+    // coordinates: the level whose texels come closest to one per pixel, or the next finer one. Lasts for one frame.
+    void Request(unsigned int id, float pixelsPerTexCoord)
+    {
+        unordered_map<unsigned int, Entry>::iterator it = entries.find(id);
+        if (it == entries.end())
+            return;
+        float texelsPerPixel = max(it->second.image.width, it->second.image.height) / max(pixelsPerTexCoord, 1e-6f);
+        requestLevel(it->second, texelsPerPixel > 1.0f ? (int)floor(log2(texelsPerPixel)) : 0);
+    }
+
+    // asks for a level to be resident, for one frame
+    void RequestLevel(unsigned int id, int level)
+    {
+        unordered_map<unsigned int, Entry>::iterator it = entries.find(id);
+        if (it != entries.end())
+            requestLevel(it->second, level);
+    }
+
+    // once per frame, after the frame's requests: moves BASE_LEVEL down to the levels whose pixels have been issued,
+    // starts loading the next level of the textures that were asked for more detail, dropping others to stay in the
+    // budget, and has the TextureUploadQueue copy up to 'uploadBytes'. Replaces TextureUploadQueue::Update in the
+    // frame loop. Changes the texture bound to the active unit.
+    void Update(size_t uploadBytes = TextureUploadQueue::DefaultFrameBudget)
+    {
+        finishLoads();
+
+        // the most recently used first, then those missing the most levels
+        vector<unsigned int> raise;
+        for (unordered_map<unsigned int, Entry>::iterator it = entries.begin(); it != entries.end(); ++it)
+        {
+            if (it->second.loading < 0 && it->second.wanted < it->second.resident)
+                raise.push_back(it->first);
+        }
+        sort(raise.begin(), raise.end(), [this](unsigned int a, unsigned int b)
+        {
+            const Entry &ea = entries[a], &eb = entries[b];
+            if (ea.lastUsed != eb.lastUsed)
+                return ea.lastUsed > eb.lastUsed;
+            return ea.resident - ea.wanted > eb.resident - eb.wanted;
+        });
+
+        size_t scheduled = 0;
+        for (unsigned int i = 0; i < raise.size() && scheduled < uploadBytes; i++)
+        {
+            Entry &entry = entries[raise[i]];
+            int level = entry.resident - 1;
+            size_t bytes = levelBytes(entry, level);
+            while (stats.bytesResident + bytes > budget && dropLevel(raise[i]))
+                ;
+            if (stats.bytesResident + bytes > budget)
+            {
+                stats.budgetMisses++;
+                continue;
+            }
+            glBindTexture(GL_TEXTURE_2D, raise[i]);
+            defineLevel(entry, level, true);
+            TextureUploadQueue::Get().UploadLevels(raise[i], entry.image, level, 1, entry.internalFormat, entry.dataFormat);
+            entry.loading = level;
+            addResident(bytes);
+            scheduled += bytes;
+        }
+        // without requests the texture keeps what it has, until the budget needs it
+        while (stats.bytesResident > budget && dropLevel(0))
+            ;
+
+        TextureUploadQueue::Get().Update(uploadBytes);
+        finishLoads();
+        for (unordered_map<unsigned int, Entry>::iterator it = entries.begin(); it != entries.end(); ++it)
+            it->second.wanted = it->second.image.levels;
+        frame++;
+    }
+
+    const Stats& GetStats() const
+    {
+        return stats;
+    }
+
+    void PrintStats() const
+    {
+        cout << "TEXTURE_STREAMER:: " << stats.textures << " textures, " << stats.bytesResident / (1024.0 * 1024.0) << " MB resident of a "
+             << budget / (1024.0 * 1024.0) << " MB budget (peak " << stats.peakBytesResident / (1024.0 * 1024.0) << " MB), "
+             << stats.levelsLoaded << " levels loaded, " << stats.levelsDropped << " dropped, " << stats.budgetMisses << " budget misses" << endl;
+    }
+
+private:
+    struct Entry {
+        TextureImage image;    // the whole mip chain, the source of every level that's made resident
+        GLenum internalFormat, dataFormat;
+        int tail;              // the first of the levels that are always resident
+        int resident;          // the finest resident level, GL_TEXTURE_BASE_LEVEL
+        int loading;           // the level whose pixels are on their way, -1 if none
+        int wanted;            // the finest level requested this frame, image.levels if none
+        unsigned long long lastUsed; // frame of the last request
+    };
+
+    unordered_map<unsigned int, Entry> entries;
+    size_t budget;
+    unsigned long long frame;
+    Stats stats;
+
+    TextureStreamer() : budget(DefaultBudget), frame(0)
+    {
+        memset(&stats, 0, sizeof(stats));
+    }
+    // GL objects live until the process exits, like those of the texture cache: the context may already be gone here
+    ~TextureStreamer()
+    {
+        for (unordered_map<unsigned int, Entry>::iterator it = entries.begin(); it != entries.end(); ++it)
+            FreeTextureImage(it->second.image);
+    }
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    void requestLevel(Entry &entry, int level)
+    {
+        entry.wanted = min(entry.wanted, max(0, min(level, entry.image.levels - 1)));
+        entry.lastUsed = frame;
+    }
+
+    size_t levelBytes(const Entry &entry, int level) const
+    {
+        return TextureLevelSize(entry.image, max(1, entry.image.width >> level), max(1, entry.image.height >> level));
+    }
+
+    void addResident(size_t bytes)
+    {
+        stats.bytesResident += bytes;
+        stats.peakBytesResident = max(stats.peakBytesResident, stats.bytesResident);
+    }
+
+    // allocates the storage of a level of the bound texture, or frees it by making the level 0x0
+    void defineLevel(const Entry &entry, int level, bool allocate)
+    {
+        int width = allocate ? max(1, entry.image.width >> level) : 0;
+        int height = allocate ? max(1, entry.image.height >> level) : 0;
+        if (entry.image.compressedFormat)
+            glCompressedTexImage2D(GL_TEXTURE_2D, level, entry.internalFormat, width, height, 0,
+                                   allocate ? (GLsizei)levelBytes(entry, level) : 0, NULL);
+        else
+            glTexImage2D(GL_TEXTURE_2D, level, entry.internalFormat, width, height, 0, entry.dataFormat, GL_UNSIGNED_BYTE, NULL);
+    }
+
+    // the levels whose pixels are issued can be sampled: GL runs the copies before any draw that comes after them
+    void finishLoads()
+    {
+        for (unordered_map<unsigned int, Entry>::iterator it = entries.begin(); it != entries.end(); ++it)
+        {
+            Entry &entry = it->second;
+            if (entry.loading < 0 || TextureUploadQueue::Get().Pending(it->first))
+                continue;
+            glBindTexture(GL_TEXTURE_2D, it->first);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, entry.loading);
+            entry.resident = entry.loading;
+            entry.loading = -1;
+            stats.levelsLoaded++;
+        }
+    }
+
+    // frees the finest level of the least recently used texture that has more detail than it was asked for this frame,
+    // other than 'keep'; returns false if there's none
+    bool dropLevel(unsigned int keep)
+    {
+        unordered_map<unsigned int, Entry>::iterator victim = entries.end();
+        for (unordered_map<unsigned int, Entry>::iterator it = entries.begin(); it != entries.end(); ++it)
+        {
+            const Entry &entry = it->second;
+            if (it->first == keep || entry.loading >= 0 || entry.resident >= entry.tail || entry.resident >= entry.wanted)
+                continue;
+            if (victim == entries.end() || entry.lastUsed < victim->second.lastUsed
+                || (entry.lastUsed == victim->second.lastUsed && entry.resident < victim->second.resident))
+                victim = it;
+        }
+        if (victim == entries.end())
+            return false;
+
+        Entry &entry = victim->second;
+        glBindTexture(GL_TEXTURE_2D, victim->first);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, entry.resident + 1);
+        defineLevel(entry, entry.resident, false);
+        stats.bytesResident -= levelBytes(entry, entry.resident);
+        entry.resident++;
+        stats.levelsDropped++;
+        return true;
+    }
+};
+
+#endif
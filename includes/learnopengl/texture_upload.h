@@ -0,0 +1,432 @@
+#ifndef TEXTURE_UPLOAD_H
+#define TEXTURE_UPLOAD_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/texture.h>
+
+#include <cstring>
+#include <deque>
+#include <unordered_map>
+#include <iostream>
+using namespace std;
+
+// Streams texture pixels to the GPU through a ring buffer bound as GL_PIXEL_UNPACK_BUFFER, instead of glTexImage2D
+// from client memory, which blocks until the driver has copied the whole image.
+// Upload creates the texture with immutable storage right away and queues its pixels. Update, called once per frame
+// on the GL thread, copies queued pixels into the mapped ring and issues glTexSubImage2D from it until the frame's
+// byte budget is spent; levels that don't fit in the budget or in the free part of the ring go over in bands of rows.
+// The copies of each Update are fenced and ring memory is only reused once the GPU has passed the fence, so when the
+// ring is full Update stops for the frame rather than waiting. The ring is persistently mapped with glBufferStorage on
+// GL 4.4, and mapped per copy with GL_MAP_UNSYNCHRONIZED_BIT on older contexts.
+// A texture can be bound as soon as Upload returns, but its contents are undefined while it's Pending; Flush issues
+// everything that's queued for loads that need the pixels right away.
+class TextureUploadQueue
+{
+public:
+    static const size_t RingSize = 32 << 20;
+    static const size_t DefaultFrameBudget = 8 << 20;
+
+    struct Stats {
+        unsigned long long textures;    // textures queued by Upload and UploadCubemap
+        unsigned long long bytes;       // bytes copied through the ring
+        unsigned long long copies;      // glTexSubImage2D / glCompressedTexSubImage2D calls
+        unsigned long long frames;      // Update calls that copied something
+        unsigned long long budgetStops; // Update calls that left work for the next frame because of the byte budget
+        unsigned long long ringStops;   // ... or because the GPU hadn't released enough of the ring yet
+        unsigned long long waits;       // fences Flush had to wait for
+        size_t maxFrameBytes;           // most bytes copied by a single Update
+    };
+
+    static TextureUploadQueue& Get()
+    {
+        static TextureUploadQueue queue;
+        return queue;
+    }
+
+    // creates a 2D texture for 'image' and queues its pixels. The queue takes the pixels over: image.data is nullptr
+    // afterwards. Must be called on the thread owning the GL context.
+    unsigned int Upload(TextureImage &image, const TextureOptions &options = TextureOptions())
+    {
+        unsigned int id = CreateTextureStorage(image, options);
+        if (!image.data)
+            return id;
+
+        Job job;
+        job.texture = id;
+        job.bindTarget = job.target = GL_TEXTURE_2D;
+        job.image = image;
+        TextureImageFormats(image, options, job.internalFormat, job.dataFormat);
+        job.level = 0;
+        job.levels = TextureImageLevels(image, options);
+        job.generateMipmap = TextureImageGeneratesMipmaps(image, options);
+        job.ownsImage = true;
+        push(job);
+        stats.textures++;
+        image.data = nullptr;
+        return id;
+    }
+
+    // creates a cubemap without mipmaps from six faces of the same size and format in the order +X, -X, +Y, -Y, +Z, -Z
+    // (only the top level of cooked faces is used) and queues their pixels, taking them over like Upload. Faces that failed to decode are left undefined.
+    // Leaves the cubemap bound, for the caller to set its sampling parameters.
+    unsigned int UploadCubemap(TextureImage faces[6], bool gammaCorrection = false)
+    {
+        unsigned int id;
+        glGenTextures(1, &id);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, id);
+        int first = 0;
+        while (first < 6 && !faces[first].data)
+            first++;
+        if (first == 6)
+            return id;
+
+        TextureOptions options(gammaCorrection, GL_CLAMP_TO_EDGE, 0, false);
+        GLenum internalFormat, dataFormat;
+        TextureImageFormats(faces[first], options, internalFormat, dataFormat);
+        AllocateTextureStorage(GL_TEXTURE_CUBE_MAP, 1, internalFormat, dataFormat, faces[first].compressedFormat, faces[first].width, faces[first].height);
+        for (int i = 0; i < 6; i++)
+        {
+            if (!faces[i].data)
+                continue;
+            if (faces[i].width != faces[first].width || faces[i].height != faces[first].height
+                || faces[i].nrComponents != faces[first].nrComponents || faces[i].compressedFormat != faces[first].compressedFormat)
+            {
+                cout << "ERROR::TEXTURE_UPLOAD:: cubemap face " << i << " doesn't match the size and format of face " << first << endl;
+                FreeTextureImage(faces[i]);
+                continue;
+            }
+            Job job;
+            job.texture = id;
+            job.bindTarget = GL_TEXTURE_CUBE_MAP;
+            job.target = GL_TEXTURE_CUBE_MAP_POSITIVE_X + i;
+            job.image = faces[i];
+            job.internalFormat = internalFormat;
+            job.dataFormat = dataFormat;
+            job.level = 0;
+            job.levels = 1;
+            job.generateMipmap = false;
+            job.ownsImage = true;
+            push(job);
+            faces[i].data = nullptr;
+        }
+        stats.textures++;
+        return id;
+    }
+
+    // queues the pixels of levels firstLevel to firstLevel + count - 1 of 'image' for a 2D texture whose storage for them
+    // already exists, e.g. levels the TextureStreamer makes resident. The pixels are only borrowed: 'image' must stay
+    // alive and unchanged while the texture is Pending.
+    void UploadLevels(unsigned int id, const TextureImage &image, int firstLevel, int count, GLenum internalFormat, GLenum dataFormat)
+    {
+        if (!image.data || count <= 0)
+            return;
+        Job job;
+        job.texture = id;
+        job.bindTarget = job.target = GL_TEXTURE_2D;
+        job.image = image;
+        job.internalFormat = internalFormat;
+        job.dataFormat = dataFormat;
+        job.level = firstLevel;
+        job.levels = firstLevel + count;
+        job.generateMipmap = false;
+        job.ownsImage = false;
+        push(job);
+    }
+
+    // copies queued pixels until about 'byteBudget' bytes are issued; at least one band is copied per call, so uploads
+    // always move forward. Returns the bytes issued. Call once per frame on the GL thread; changes the texture bound
+    // to the active unit.
+    size_t Update(size_t byteBudget = DefaultFrameBudget)
+    {
+        retire(false);
+        bool ringFull = false;
+        size_t issued = issue(byteBudget, ringFull);
+        if (issued > 0)
+        {
+            stats.frames++;
+            stats.maxFrameBytes = max(stats.maxFrameBytes, issued);
+        }
+        if (!jobs.empty())
+        {
+            if (ringFull)
+                stats.ringStops++;
+            else
+                stats.budgetStops++;
+        }
+        return issued;
+    }
+
+    // issues every queued copy, waiting for the GPU to release ring memory when the queue holds more than the ring.
+    // The GL commands are ordered, so textures can be drawn with right after this returns.
+    void Flush()
+    {
+        retire(false);
+        while (!jobs.empty())
+        {
+            bool ringFull = false;
+            issue(RingSize, ringFull);
+            if (!jobs.empty())
+            {
+                stats.waits++;
+                retire(true);
+            }
+        }
+    }
+
+    // whether a texture still has pixels waiting in the queue
+    bool Pending(unsigned int id) const
+    {
+        return pending.find(id) != pending.end();
+    }
+
+    // number of textures with pixels waiting in the queue
+    unsigned int PendingTextures() const
+    {
+        return (unsigned int)pending.size();
+    }
+
+    // drops the queued pixels of a texture, e.g. when it's deleted before its upload finished
+    void Cancel(unsigned int id)
+    {
+        if (!Pending(id))
+            return;
+        for (deque<Job>::iterator it = jobs.begin(); it != jobs.end();)
+        {
+            if (it->texture == id)
+            {
+                if (it->ownsImage)
+                    FreeTextureImage(it->image);
+                it = jobs.erase(it);
+            }
+            else
+                ++it;
+        }
+        pending.erase(id);
+    }
+
+    const Stats& GetStats() const
+    {
+        return stats;
+    }
+
+    void PrintStats() const
+    {
+        cout << "TEXTURE_UPLOAD:: " << stats.textures << " textures, " << stats.bytes / (1024.0 * 1024.0) << " MB in " << stats.copies
+             << " copies over " << stats.frames << " updates (at most " << stats.maxFrameBytes / (1024.0 * 1024.0) << " MB per update), "
+             << stats.budgetStops << " budget stops, " << stats.ringStops << " full ring stops, " << stats.waits << " flush waits, "
+             << (mapped ? "persistently mapped" : "mapped per copy") << endl;
+    }
+
+private:
+    // the pixels of one texture image still to be copied, band after band
+    struct Job {
+        unsigned int texture;
+        GLenum bindTarget;    // GL_TEXTURE_2D or GL_TEXTURE_CUBE_MAP
+        GLenum target;        // GL_TEXTURE_2D or the cubemap face
+        TextureImage image;
+        GLenum internalFormat, dataFormat;
+        int levels;           // one past the last level of the image to copy
+        bool generateMipmap;  // once the top level is copied
+        bool ownsImage;       // the pixels are freed once copied; borrowed ones (UploadLevels) aren't
+        int level, row;       // where the next band starts; rows of 4x4 blocks for cooked images
+        size_t offset;        // of the next band in image.data
+    };
+
+    // the copies issued by one Update (or one round of Flush) end at 'end' in the ring
+    struct Batch {
+        GLsync fence;
+        size_t end;
+    };
+
+    deque<Job> jobs;
+    unordered_map<unsigned int, unsigned int> pending; // texture id -> queued jobs
+    deque<Batch> batches;
+    GLuint buffer;
+    unsigned char *mapped;
+    // ring memory in use by the GPU runs from tail to head, wrapping at RingSize; head == tail when none is.
+    // One byte is always left free so a full ring doesn't look empty.
+    size_t head, tail;
+    Stats stats;
+
+    TextureUploadQueue() : buffer(0), mapped(NULL), head(0), tail(0)
+    {
+        memset(&stats, 0, sizeof(stats));
+    }
+    // GL objects live until the process exits, like those of the texture cache: the context may already be gone here
+    ~TextureUploadQueue()
+    {
+        for (unsigned int i = 0; i < jobs.size(); i++)
+        {
+            if (jobs[i].ownsImage)
+                FreeTextureImage(jobs[i].image);
+        }
+    }
+    TextureUploadQueue(const TextureUploadQueue&) = delete;
+    TextureUploadQueue& operator=(const TextureUploadQueue&) = delete;
+
+    // queues a job starting at the top of its job.level
+    void push(Job &job)
+    {
+        job.row = 0;
+        job.offset = TextureLevelOffset(job.image, job.level);
+        jobs.push_back(job);
+        pending[job.texture]++;
+    }
+
+    void createRing()
+    {
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+        if (GLAD_GL_VERSION_4_4)
+        {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_PIXEL_UNPACK_BUFFER, RingSize, NULL, flags);
+            mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, RingSize, flags);
+            if (!mapped)
+                cout << "ERROR::TEXTURE_UPLOAD:: can't map the upload ring persistently, mapping it per copy" << endl;
+        }
+        else
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, RingSize, NULL, GL_STREAM_DRAW);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    // the largest block the next allocate can return
+    size_t ringSpace()
+    {
+        if (head == tail)
+        {
+            head = tail = 0;
+            return RingSize;
+        }
+        if (head > tail)
+            return max(RingSize - head, tail > 0 ? tail - 1 : 0);
+        return tail - head - 1;
+    }
+
+    // takes 'bytes' (at most ringSpace()) off the ring; blocks start 16 byte aligned for the copies into them
+    size_t allocate(size_t bytes)
+    {
+        if (head == tail)
+            head = tail = 0;
+        if (head >= tail && RingSize - head < bytes)
+            head = 0;
+        size_t offset = head;
+        head = min(RingSize, (offset + bytes + 15) & ~(size_t)15);
+        return offset;
+    }
+
+    // frees the ring memory of the batches the GPU is done with; with 'wait', waits for the oldest one first
+    void retire(bool wait)
+    {
+        while (!batches.empty())
+        {
+            GLenum status = glClientWaitSync(batches.front().fence, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? 1000000000ull : 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+                return;
+            tail = batches.front().end;
+            glDeleteSync(batches.front().fence);
+            batches.pop_front();
+            wait = false;
+        }
+    }
+
+    // copies bands of the queued jobs until 'budget' bytes are issued or the ring is full, then fences them
+    size_t issue(size_t budget, bool &ringFull)
+    {
+        if (jobs.empty())
+            return 0;
+        if (!buffer)
+            createRing();
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        size_t issued = 0;
+        while (!jobs.empty() && issued < budget)
+        {
+            size_t bytes = copyBand(jobs.front(), budget - issued, issued == 0, ringFull);
+            if (bytes == 0)
+                break;
+            issued += bytes;
+            Job &job = jobs.front();
+            if (job.level < job.levels)
+                continue;
+            if (job.generateMipmap)
+                glGenerateMipmap(job.bindTarget);
+            if (job.ownsImage)
+                FreeTextureImage(job.image);
+            if (--pending[job.texture] == 0)
+                pending.erase(job.texture);
+            jobs.pop_front();
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        if (issued > 0)
+        {
+            Batch batch;
+            batch.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            batch.end = head;
+            batches.push_back(batch);
+        }
+        return issued;
+    }
+
+    // copies the next band of rows of a job that fits in 'limit' bytes and in the ring; one band is copied regardless
+    // of the limit if 'force'. Returns the bytes copied, 0 (with ringFull set if the ring was the limit) if none fit.
+    size_t copyBand(Job &job, size_t limit, bool force, bool &ringFull)
+    {
+        const TextureImage &image = job.image;
+        int width = max(1, image.width >> job.level);
+        int height = max(1, image.height >> job.level);
+        bool compressed = image.compressedFormat != 0;
+        size_t rowBytes = TextureLevelSize(image, width, compressed ? 4 : 1);
+        int rows = compressed ? (height + 3) / 4 : height;
+
+        size_t space = ringSpace() & ~(size_t)15;
+        size_t count = min((size_t)(rows - job.row), min(limit, space) / rowBytes);
+        if (count == 0)
+        {
+            if (!force || space < rowBytes)
+            {
+                ringFull = space < limit;
+                return 0;
+            }
+            count = 1;
+        }
+        size_t bytes = count * rowBytes;
+        size_t offset = allocate(bytes);
+        const unsigned char *pixels = image.data + job.offset;
+        if (mapped)
+            memcpy(mapped + offset, pixels, bytes);
+        else
+        {
+            // the fences keep the GPU off this range, so the driver doesn't have to synchronize
+            void *target = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, offset, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+            if (target)
+                memcpy(target, pixels, bytes);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        }
+
+        glBindTexture(job.bindTarget, job.texture);
+        if (compressed)
+        {
+            int y = job.row * 4;
+            int h = min((int)count * 4, height - y);
+            glCompressedTexSubImage2D(job.target, job.level, 0, y, width, h, job.internalFormat, (GLsizei)bytes, (const void*)offset);
+        }
+        else
+            glTexSubImage2D(job.target, job.level, 0, job.row, width, (GLsizei)count, job.dataFormat, GL_UNSIGNED_BYTE, (const void*)offset);
+        stats.copies++;
+        stats.bytes += bytes;
+
+        job.offset += bytes;
+        job.row += (int)count;
+        if (job.row == rows)
+        {
+            job.level++;
+            job.row = 0;
+        }
+        return bytes;
+    }
+};
+
+#endif
@@ -0,0 +1,390 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+using namespace std;
+
+// Compile-time vertex layouts. A format is a list of attributes, each pairing a semantic (which is also the attribute
+// location the shaders use) with an encoding. VertexFormat<...> is the packed vertex struct itself: it encodes
+// itself from a full float source vertex and declares the matching glVertexAttribPointer calls, so the struct and
+// the attribute setup can't go out of sync.
+//
+//     typedef VertexFormat<VertexAttribute<VERTEX_POSITION, VertexEncoding::Half4>,
+//                          VertexAttribute<VERTEX_NORMAL, VertexEncoding::Oct16>> MyVertex;
+//     vector<MyVertex> packed = EncodeVertices<MyVertex>(vertices);
+//     MyVertex::SetupAttributes();  // with the VAO and VBO bound
+//
+// Quantized encodings need a little help from the shaders:
+// - Half4 positions read as a regular vec3/vec4 (w = 1.0).
+// - Oct16 normals/tangents arrive as a vec2 in [-1, 1] and are unpacked with octDecode (see OctDecodeGLSL).
+// - UNorm16 texture coordinates cover the texture coordinate range of the mesh; the shader maps them back with
+//   the 'texCoordTransform' uniform: aTexCoords * texCoordTransform.xy + texCoordTransform.zw.
+
+// the source vertex all formats are encoded from: full float attributes as imported by Assimp.
+struct Vertex {
+    // position
+    glm::vec3 Position;
+    // normal
+    glm::vec3 Normal;
+    // texCoords
+    glm::vec2 TexCoords;
+    // tangent
+    glm::vec3 Tangent;
+    // bitangent
+    glm::vec3 Bitangent;
+};
+
+// attribute semantics; the value is the attribute location used by the shaders.
+enum VertexSemantic {
+    VERTEX_POSITION  = 0,
+    VERTEX_NORMAL    = 1,
+    VERTEX_TEXCOORD  = 2,
+    VERTEX_TANGENT   = 3,
+    VERTEX_BITANGENT = 4
+};
+
+// per-mesh parameters for encodings that quantize relative to the data's range.
+struct VertexQuantization {
+    glm::vec2 texCoordMin;
+    glm::vec2 texCoordScale;
+
+    VertexQuantization() : texCoordMin(0.0f), texCoordScale(1.0f) {}
+
+    static VertexQuantization FromVertices(const vector<Vertex> &vertices)
+    {
+        return FromVertices(vertices.data(), vertices.size());
+    }
+
+    static VertexQuantization FromVertices(const Vertex *vertices, size_t count)
+    {
+        VertexQuantization quantization;
+        if (count == 0)
+            return quantization;
+        glm::vec2 minimum = vertices[0].TexCoords;
+        glm::vec2 maximum = vertices[0].TexCoords;
+        for (size_t i = 1; i < count; i++)
+        {
+            minimum = glm::min(minimum, vertices[i].TexCoords);
+            maximum = glm::max(maximum, vertices[i].TexCoords);
+        }
+        quantization.texCoordMin = minimum;
+        quantization.texCoordScale = maximum - minimum;
+        // flat ranges still need a valid scale
+        for (int c = 0; c < 2; c++)
+            if (quantization.texCoordScale[c] <= 0.0f)
+                quantization.texCoordScale[c] = 1.0f;
+        return quantization;
+    }
+
+    // value for the 'texCoordTransform' shader uniform: scale in xy, offset in zw
+    glm::vec4 TexCoordTransform() const
+    {
+        return glm::vec4(texCoordScale, texCoordMin);
+    }
+};
+
+// GLSL function matching VertexEncoding::Oct16, for shaders that read quantized normals or tangents.
+const char * const OctDecodeGLSL =
+    "vec3 octDecode(vec2 e)\n"
+    "{\n"
+    "    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));\n"
+    "    if (v.z < 0.0)\n"
+    "        v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);\n"
+    "    return normalize(v);\n"
+    "}\n";
+
+// Encodings. Each one holds its packed data and knows the GL type that reads it back.
+namespace VertexEncoding
+{
+    // 3 x 32 bit float (12 bytes)
+    struct Float3 {
+        static const GLint components = 3;
+        static const GLenum type = GL_FLOAT;
+        static const GLboolean normalized = GL_FALSE;
+        float value[3];
+
+        void Encode(const glm::vec3 &v, const VertexQuantization &)
+        {
+            value[0] = v.x; value[1] = v.y; value[2] = v.z;
+        }
+        glm::vec3 Decode(const VertexQuantization &) const
+        {
+            return glm::vec3(value[0], value[1], value[2]);
+        }
+    };
+
+    // 2 x 32 bit float (8 bytes)
+    struct Float2 {
+        static const GLint components = 2;
+        static const GLenum type = GL_FLOAT;
+        static const GLboolean normalized = GL_FALSE;
+        float value[2];
+
+        void Encode(const glm::vec2 &v, const VertexQuantization &)
+        {
+            value[0] = v.x; value[1] = v.y;
+        }
+        glm::vec2 Decode(const VertexQuantization &) const
+        {
+            return glm::vec2(value[0], value[1]);
+        }
+    };
+
+    // 4 x 16 bit half float (8 bytes); the 4th component is 1.0 and keeps the attribute 4 byte aligned.
+    // 11 bits of mantissa: a relative precision of about 1/2048 of the coordinate's magnitude.
+    struct Half4 {
+        static const GLint components = 4;
+        static const GLenum type = GL_HALF_FLOAT;
+        static const GLboolean normalized = GL_FALSE;
+        uint16_t value[4];
+
+        void Encode(const glm::vec3 &v, const VertexQuantization &)
+        {
+            value[0] = glm::packHalf1x16(v.x);
+            value[1] = glm::packHalf1x16(v.y);
+            value[2] = glm::packHalf1x16(v.z);
+            value[3] = glm::packHalf1x16(1.0f);
+        }
+        glm::vec3 Decode(const VertexQuantization &) const
+        {
+            return glm::vec3(glm::unpackHalf1x16(value[0]), glm::unpackHalf1x16(value[1]), glm::unpackHalf1x16(value[2]));
+        }
+    };
+
+    // 2 x 16 bit half float (4 bytes); for texture coordinates that don't fit a per-mesh range well.
+    struct Half2 {
+        static const GLint components = 2;
+        static const GLenum type = GL_HALF_FLOAT;
+        static const GLboolean normalized = GL_FALSE;
+        uint16_t value[2];
+
+        void Encode(const glm::vec2 &v, const VertexQuantization &)
+        {
+            value[0] = glm::packHalf1x16(v.x);
+            value[1] = glm::packHalf1x16(v.y);
+        }
+        glm::vec2 Decode(const VertexQuantization &) const
+        {
+            return glm::vec2(glm::unpackHalf1x16(value[0]), glm::unpackHalf1x16(value[1]));
+        }
+    };
+
+    // unit vector in octahedral encoding, 2 x 16 bit snorm (4 bytes). The vector is projected onto an octahedron
+    // that is unfolded into the [-1, 1] square; the worst case angular error is below 0.01 degrees.
+    struct Oct16 {
+        static const GLint components = 2;
+        static const GLenum type = GL_SHORT;
+        static const GLboolean normalized = GL_TRUE;
+        int16_t value[2];
+
+        static glm::vec3 decode(glm::vec2 e)
+        {
+            glm::vec3 v(e.x, e.y, 1.0f - fabs(e.x) - fabs(e.y));
+            if (v.z < 0.0f)
+            {
+                float x = v.x;
+                v.x = (1.0f - fabs(v.y)) * (x >= 0.0f ? 1.0f : -1.0f);
+                v.y = (1.0f - fabs(x)) * (v.y >= 0.0f ? 1.0f : -1.0f);
+            }
+            return glm::normalize(v);
+        }
+
+        void Encode(const glm::vec3 &v, const VertexQuantization &)
+        {
+            float length = fabs(v.x) + fabs(v.y) + fabs(v.z);
+            if (length == 0.0f)
+            {
+                // degenerate tangents from Assimp; any valid encoding will do
+                value[0] = value[1] = 0;
+                return;
+            }
+            glm::vec2 e(v.x / length, v.y / length);
+            if (v.z < 0.0f)
+            {
+                float x = e.x;
+                e.x = (1.0f - fabs(e.y)) * (x >= 0.0f ? 1.0f : -1.0f);
+                e.y = (1.0f - fabs(x)) * (e.y >= 0.0f ? 1.0f : -1.0f);
+            }
+
+            // plain rounding isn't always the closest representable direction; try all 4 neighbours
+            glm::vec3 n = glm::normalize(v);
+            float best = -2.0f;
+            for (int i = 0; i < 4; i++)
+            {
+                float x = (i & 1) ? ceil(e.x * 32767.0f) : floor(e.x * 32767.0f);
+                float y = (i & 2) ? ceil(e.y * 32767.0f) : floor(e.y * 32767.0f);
+                x = glm::clamp(x, -32767.0f, 32767.0f);
+                y = glm::clamp(y, -32767.0f, 32767.0f);
+                float similarity = glm::dot(decode(glm::vec2(x, y) / 32767.0f), n);
+                if (similarity > best)
+                {
+                    best = similarity;
+                    value[0] = (int16_t)x;
+                    value[1] = (int16_t)y;
+                }
+            }
+        }
+        glm::vec3 Decode(const VertexQuantization &) const
+        {
+            return decode(glm::vec2(value[0], value[1]) / 32767.0f);
+        }
+    };
+
+    // 2 x 16 bit unorm over the mesh's texture coordinate range (4 bytes); see VertexQuantization.
+    struct UNorm16 {
+        static const GLint components = 2;
+        static const GLenum type = GL_UNSIGNED_SHORT;
+        static const GLboolean normalized = GL_TRUE;
+        uint16_t value[2];
+
+        void Encode(const glm::vec2 &v, const VertexQuantization &quantization)
+        {
+            glm::vec2 t = (v - quantization.texCoordMin) / quantization.texCoordScale;
+            value[0] = glm::packUnorm1x16(t.x);
+            value[1] = glm::packUnorm1x16(t.y);
+        }
+        glm::vec2 Decode(const VertexQuantization &quantization) const
+        {
+            glm::vec2 t(glm::unpackUnorm1x16(value[0]), glm::unpackUnorm1x16(value[1]));
+            return t * quantization.texCoordScale + quantization.texCoordMin;
+        }
+    };
+}
+
+// a semantic stored with an encoding; the source attribute is picked from Vertex by the semantic.
+template<VertexSemantic S, typename E>
+struct VertexAttribute {
+    typedef E Encoding;
+    static const VertexSemantic semantic = S;
+};
+
+template<VertexSemantic S> struct VertexSource;
+template<> struct VertexSource<VERTEX_POSITION>  { static const glm::vec3& Get(const Vertex &v) { return v.Position; } };
+template<> struct VertexSource<VERTEX_NORMAL>    { static const glm::vec3& Get(const Vertex &v) { return v.Normal; } };
+template<> struct VertexSource<VERTEX_TEXCOORD>  { static const glm::vec2& Get(const Vertex &v) { return v.TexCoords; } };
+template<> struct VertexSource<VERTEX_TANGENT>   { static const glm::vec3& Get(const Vertex &v) { return v.Tangent; } };
+template<> struct VertexSource<VERTEX_BITANGENT> { static const glm::vec3& Get(const Vertex &v) { return v.Bitangent; } };
+
+// The packed vertex. Attributes are stored in declaration order without padding between them as long as the
+// encodings are 4 byte multiples, which all of the above are.
+template<typename... Attributes> struct VertexFormat;
+
+template<typename A>
+struct VertexFormat<A> {
+    typename A::Encoding attribute;
+
+    void Encode(const Vertex &v, const VertexQuantization &quantization)
+    {
+        attribute.Encode(VertexSource<A::semantic>::Get(v), quantization);
+    }
+
+    // declares the attribute pointers for the currently bound VAO/VBO; baseOffset is the byte offset of the first
+    // vertex in the buffer.
+    static void SetupAttributes(size_t baseOffset = 0)
+    {
+        setupAttributes(sizeof(VertexFormat), baseOffset);
+    }
+
+    // byte offset of a semantic within the vertex, or -1 if the format doesn't contain it
+    static int OffsetOf(VertexSemantic semantic)
+    {
+        return semantic == A::semantic ? (int)offsetof(VertexFormat, attribute) : -1;
+    }
+
+    static void setupAttributes(GLsizei stride, size_t offset)
+    {
+        typedef typename A::Encoding E;
+        glEnableVertexAttribArray(A::semantic);
+        glVertexAttribPointer(A::semantic, E::components, E::type, E::normalized, stride, (void*)(offset + offsetof(VertexFormat, attribute)));
+    }
+};
+
+template<typename A, typename... Rest>
+struct VertexFormat<A, Rest...> {
+    typename A::Encoding attribute;
+    VertexFormat<Rest...> rest;
+
+    void Encode(const Vertex &v, const VertexQuantization &quantization)
+    {
+        attribute.Encode(VertexSource<A::semantic>::Get(v), quantization);
+        rest.Encode(v, quantization);
+    }
+
+    static void SetupAttributes(size_t baseOffset = 0)
+    {
+        setupAttributes(sizeof(VertexFormat), baseOffset);
+    }
+
+    static int OffsetOf(VertexSemantic semantic)
+    {
+        if (semantic == A::semantic)
+            return (int)offsetof(VertexFormat, attribute);
+        int offset = VertexFormat<Rest...>::OffsetOf(semantic);
+        return offset < 0 ? -1 : (int)offsetof(VertexFormat, rest) + offset;
+    }
+
+    static void setupAttributes(GLsizei stride, size_t offset)
+    {
+        typedef typename A::Encoding E;
+        glEnableVertexAttribArray(A::semantic);
+        glVertexAttribPointer(A::semantic, E::components, E::type, E::normalized, stride, (void*)(offset + offsetof(VertexFormat, attribute)));
+        VertexFormat<Rest...>::setupAttributes(stride, offset + offsetof(VertexFormat, rest));
+    }
+};
+
+// encodes a whole vertex array into the given format
+template<typename Format>
+vector<Format> EncodeVertices(const vector<Vertex> &vertices, const VertexQuantization &quantization = VertexQuantization())
+{
+    vector<Format> packed(vertices.size());
+    for (unsigned int i = 0; i < vertices.size(); i++)
+        packed[i].Encode(vertices[i], quantization);
+    return packed;
+}
+
+// encodes 'count' vertices into 'storage' and returns the bytes for the vertex buffer
+template<typename Format>
+const void* EncodeVertices(const Vertex *vertices, size_t count, const VertexQuantization &quantization, vector<Format> &storage)
+{
+    storage.resize(count);
+    for (size_t i = 0; i < count; i++)
+        storage[i].Encode(vertices[i], quantization);
+    return storage.data();
+}
+
+// the original layout: 56 bytes, binary identical to Vertex.
+typedef VertexFormat<
+    VertexAttribute<VERTEX_POSITION,  VertexEncoding::Float3>,
+    VertexAttribute<VERTEX_NORMAL,    VertexEncoding::Float3>,
+    VertexAttribute<VERTEX_TEXCOORD,  VertexEncoding::Float2>,
+    VertexAttribute<VERTEX_TANGENT,   VertexEncoding::Float3>,
+    VertexAttribute<VERTEX_BITANGENT, VertexEncoding::Float3>> FullVertex;
+
+// the quantized layout for imported models: 24 bytes.
+typedef VertexFormat<
+    VertexAttribute<VERTEX_POSITION,  VertexEncoding::Half4>,
+    VertexAttribute<VERTEX_NORMAL,    VertexEncoding::Oct16>,
+    VertexAttribute<VERTEX_TEXCOORD,  VertexEncoding::UNorm16>,
+    VertexAttribute<VERTEX_TANGENT,   VertexEncoding::Oct16>,
+    VertexAttribute<VERTEX_BITANGENT, VertexEncoding::Oct16>> CompactVertex;
+
+static_assert(sizeof(FullVertex) == sizeof(Vertex), "FullVertex must match the layout of Vertex");
+static_assert(sizeof(CompactVertex) == 24, "CompactVertex is expected to pack into 24 bytes");
+
+// FullVertex is Vertex as it is, so its vertex buffer is filled straight from the source array
+template<>
+inline const void* EncodeVertices<FullVertex>(const Vertex *vertices, size_t, const VertexQuantization&, vector<FullVertex>&)
+{
+    return vertices;
+}
+
+#endif
@@ -8,9 +8,10 @@ out vec2 TexCoords;
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
+uniform vec4 texCoordTransform; // the model uses compact vertices: texture coordinates are 16 bit unorm over the mesh's range
 
 void main()
 {
-    TexCoords = aTexCoords;    
+    TexCoords = aTexCoords * texCoordTransform.xy + texCoordTransform.zw;
     gl_Position = projection * view * model * vec4(aPos, 1.0);
 }
\ No newline at end of file
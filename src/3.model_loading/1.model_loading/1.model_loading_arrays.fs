@@ -0,0 +1,12 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2DArray texture_diffuse1;
+uniform vec3 textureLayers[4]; // per texture type: the layer of the mesh's texture and the scale of its texture coordinates
+
+void main()
+{    
+    FragColor = texture(texture_diffuse1, vec3(TexCoords * textureLayers[0].yz, textureLayers[0].x));
+}
\ No newline at end of file
@@ -11,6 +11,8 @@
 #include <learnopengl/model.h>
 
 #include <iostream>
+#include <cstdlib>
+#include <string>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
@@ -20,6 +22,8 @@ void processInput(GLFWwindow *window);
 // settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
+bool useLods = true;
+bool lodKeyPressed = false;
 
 // camera
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
@@ -31,7 +35,7 @@ bool firstMouse = true;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
-int main()
+int main(int argc, char *argv[])
 {
     // glfw: initialize and configure
     // ------------------------------
@@ -68,18 +72,51 @@ int main()
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
-
     // configure global opengl state
     // -----------------------------
     glEnable(GL_DEPTH_TEST);
 
+    // load models
+    // -----------
+    ModelOptions modelOptions;
+    modelOptions.optimizeMeshes = true; // prints the vertex cache statistics of every mesh when the model is imported
+    modelOptions.compactVertices = true; // 24 instead of 56 bytes per vertex, see 1.model_loading.vs for the texture coordinates
+    modelOptions.generateLods = true;    // simplified versions of every mesh for when the model is far away; press L to toggle
+    modelOptions.pooledGeometry = true;  // all meshes share one vertex/index buffer and VAO
+    modelOptions.streamTextures = true;  // only the texture mips the current distance needs are resident
+    // textures cooked by the texture_cooker tool are used when present; run with --uncooked to compare.
+    // --cyborg loads the cyborg instead of the nanosuit, --budget <MB> sets the texture streaming budget, --arrays packs
+    // the textures into texture arrays (instead of streaming them) so the whole model draws without texture binds.
+    std::string modelPath = "resources/objects/nanosuit/nanosuit.obj";
+    float modelScale = 0.2f;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--uncooked")
+            UseCookedTextures() = false;
+        else if (arg == "--cyborg")
+        {
+            modelPath = "resources/objects/cyborg/cyborg.obj";
+            modelScale = 0.8f;
+        }
+        else if (arg == "--budget" && i + 1 < argc)
+            TextureStreamer::Get().SetBudget((size_t)atoi(argv[++i]) << 20);
+        else if (arg == "--arrays")
+            modelOptions.packTextureArrays = true;
+    }
+
     // build and compile shaders
     // -------------------------
-    Shader ourShader("1.model_loading.vs", "1.model_loading.fs");
+    Shader ourShader("1.model_loading.vs", modelOptions.packTextureArrays ? "1.model_loading_arrays.fs" : "1.model_loading.fs");
 
-    // load models
-    // -----------
-    Model ourModel(FileSystem::getPath("resources/objects/nanosuit/nanosuit.obj"));
+    Model ourModel(FileSystem::getPath(modelPath), false, modelOptions);
+    std::cout << "STARTUP:: " << glfwGetTime() * 1000.0 << " ms to the first frame, " << (UseCookedTextures() ? "cooked" : "decoded") << " textures" << std::endl;
+    TextureCache::Get().PrintStats();
+    TextureUploadQueue::Get().PrintStats();
+    TextureStreamer::Get().PrintStats();
+    Mesh::Pool(MESH_VERTEX_COMPACT).PrintStats("COMPACT");
+    LodSelection lodSelection(glm::radians(45.0f), (float)SCR_HEIGHT);
+    double lastStatsTime = 0.0;
 
     
     // draw in wireframe
@@ -116,9 +153,27 @@ int main()
         // render the loaded model
         glm::mat4 model;
         model = glm::translate(model, glm::vec3(0.0f, -1.75f, 0.0f)); // translate it down so it's at the center of the scene
-        model = glm::scale(model, glm::vec3(0.2f, 0.2f, 0.2f));	// it's a bit too big for our scene, so scale it down
+        model = glm::scale(model, glm::vec3(modelScale));	// it's a bit too big for our scene, so scale it down
         ourShader.setMat4("model", model);
-        ourModel.Draw(ourShader);
+        float distance = glm::length(camera.Position - glm::vec3(0.0f, -1.75f, 0.0f)) / modelScale; // distance in model units
+        unsigned int triangles = ourModel.TriangleCount();
+        if (useLods)
+            triangles = ourModel.Draw(ourShader, distance, lodSelection);
+        else
+            ourModel.Draw(ourShader);
+        // ask for the texture detail this distance needs; the streamer loads and drops mip levels within its budget
+        ourModel.RequestTextureDetail(distance, lodSelection);
+        TextureStreamer::Get().Update();
+
+        // triangle statistics, once a second
+        if (currentFrame - lastStatsTime > 1.0)
+        {
+            lastStatsTime = currentFrame;
+            std::cout << "LOD " << (useLods ? "on: " : "off: ") << triangles << " of " << ourModel.TriangleCount() << " triangles" << std::endl;
+            GeometryPool::PrintBindStats();
+            Material::PrintStats();
+            TextureStreamer::Get().PrintStats();
+        }
 
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
@@ -148,6 +203,16 @@ void processInput(GLFWwindow *window)
         camera.ProcessKeyboard(LEFT, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
         camera.ProcessKeyboard(RIGHT, deltaTime);
+
+    if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS && !lodKeyPressed)
+    {
+        useLods = !useLods;
+        lodKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_L) == GLFW_RELEASE)
+    {
+        lodKeyPressed = false;
+    }
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
@@ -7,9 +7,10 @@ out vec2 TexCoords;
 
 uniform mat4 projection;
 uniform mat4 view;
+uniform vec4 texCoordTransform; // the rock uses compact vertices: texture coordinates are 16 bit unorm over the mesh's range
 
 void main()
 {
-    TexCoords = aTexCoords;
+    TexCoords = aTexCoords * texCoordTransform.xy + texCoordTransform.zw;
     gl_Position = projection * view * aInstanceMatrix * vec4(aPos, 1.0f); 
 }
\ No newline at end of file
@@ -10,17 +10,23 @@
 #include <learnopengl/shader.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
+#include <learnopengl/model_loader.h>
 
 #include <iostream>
+#include <vector>
+#include <algorithm>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow *window);
+void setInstanceAttributes(unsigned int VAO, unsigned int firstInstance);
 
 // settings
 const unsigned int SCR_WIDTH = 1280;
 const unsigned int SCR_HEIGHT = 720;
+bool useLods = true;
+bool lodKeyPressed = false;
 
 // camera
 Camera camera(glm::vec3(0.0f, 0.0f, 155.0f));
@@ -32,6 +38,76 @@ bool firstMouse = true;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
+// the instances grouped into one contiguous range of slots in the instance buffer per LOD level. An instance changing
+// its level is swapped across the bucket boundaries in between, so a move only rewrites a few slots of the buffer.
+struct InstanceBuckets
+{
+    std::vector<unsigned int> start;    // bucket l holds the slots [start[l], start[l + 1])
+    std::vector<unsigned int> lod;      // per instance: its level
+    std::vector<unsigned int> slot;     // per instance: where it is in the buffer
+    std::vector<unsigned int> instance; // per slot: the instance stored there
+    std::vector<unsigned int> dirty;    // slots that got another instance since the last Upload
+
+    // every instance at level 0, in its own slot
+    void Reset(unsigned int instances, unsigned int levels)
+    {
+        start.assign(levels + 1, instances);
+        start[0] = 0;
+        lod.assign(instances, 0);
+        slot.resize(instances);
+        instance.resize(instances);
+        for (unsigned int i = 0; i < instances; i++)
+            slot[i] = instance[i] = i;
+        dirty.clear();
+    }
+
+    void Move(unsigned int i, unsigned int level)
+    {
+        // the last slot of a bucket becomes the first of the next one, and the other way around
+        while (lod[i] < level)
+        {
+            swapSlots(slot[i], start[lod[i] + 1] - 1);
+            start[++lod[i]]--;
+        }
+        while (lod[i] > level)
+        {
+            swapSlots(slot[i], start[lod[i]]);
+            start[lod[i]--]++;
+        }
+    }
+
+    // writes the matrices of the dirty slots to the bound GL_ARRAY_BUFFER, one glBufferSubData per run of consecutive slots
+    void Upload(const glm::mat4 *matrices)
+    {
+        std::sort(dirty.begin(), dirty.end());
+        dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+        std::vector<glm::mat4> run;
+        for (unsigned int i = 0; i < dirty.size(); i++)
+        {
+            run.push_back(matrices[instance[dirty[i]]]);
+            if (i + 1 == dirty.size() || dirty[i + 1] != dirty[i] + 1)
+            {
+                unsigned int first = dirty[i] + 1 - (unsigned int)run.size();
+                glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(glm::mat4), run.size() * sizeof(glm::mat4), &run[0]);
+                run.clear();
+            }
+        }
+        dirty.clear();
+    }
+
+private:
+    void swapSlots(unsigned int a, unsigned int b)
+    {
+        if (a == b)
+            return;
+        std::swap(instance[a], instance[b]);
+        slot[instance[a]] = a;
+        slot[instance[b]] = b;
+        dirty.push_back(a);
+        dirty.push_back(b);
+    }
+};
+
 int main()
 {
     // glfw: initialize and configure
@@ -79,16 +155,25 @@ int main()
     Shader asteroidShader("10.3.asteroids.vs", "10.3.asteroids.fs");
     Shader planetShader("10.3.planet.vs", "10.3.planet.fs");
 
-    // load models
-    // -----------
-    Model rock(FileSystem::getPath("resources/objects/rock/rock.obj"));
-    Model planet(FileSystem::getPath("resources/objects/planet/planet.obj"));
+    // load models: both are imported on worker threads at the same time, the render loop uploads them as they finish
+    // ------------------------------------------------------------------------------------------------------------
+    ModelLoader loader;
+    ModelOptions modelOptions;
+    modelOptions.optimizeMeshes = true; // every rock instance is transformed in full, so cache efficiency matters here
+    modelOptions.compactVertices = true; // and every instance fetches the whole vertex buffer again
+    modelOptions.generateLods = true;    // distant rocks are drawn with simplified meshes; press L to toggle
+    modelOptions.keepGeometry = true;    // the rock's vertices give the bounding radius for the culling below
+    std::shared_ptr<ModelLoader::Handle> rockHandle = loader.Load(FileSystem::getPath("resources/objects/rock/rock.obj"), false, modelOptions);
+    ModelOptions planetOptions;
+    planetOptions.generateLods = true;
+    std::shared_ptr<ModelLoader::Handle> planetHandle = loader.Load(FileSystem::getPath("resources/objects/planet/planet.obj"), false, planetOptions);
 
     // generate a large list of semi-random model transformation matrices
     // ------------------------------------------------------------------
     unsigned int amount = 100000;
     glm::mat4* modelMatrices;
     modelMatrices = new glm::mat4[amount];
+    std::vector<float> modelScales(amount);
     srand(glfwGetTime()); // initialize random seed	
     float radius = 150.0;
     float offset = 25.0f;
@@ -108,6 +193,7 @@ int main()
         // 2. scale: Scale between 0.05 and 0.25f
         float scale = (rand() % 20) / 100.0f + 0.05;
         model = glm::scale(model, glm::vec3(scale));
+        modelScales[i] = scale;
 
         // 3. rotation: add random rotation around a (semi)randomly picked rotation axis vector
         float rotAngle = (rand() % 360);
@@ -122,33 +208,24 @@ int main()
     unsigned int buffer;
     glGenBuffers(1, &buffer);
     glBindBuffer(GL_ARRAY_BUFFER, buffer);
-    glBufferData(GL_ARRAY_BUFFER, amount * sizeof(glm::mat4), &modelMatrices[0], GL_STATIC_DRAW);
-
-    // set transformation matrices as an instance vertex attribute (with divisor 1)
-    // note: we're cheating a little by taking the, now publicly declared, VAO of the model's mesh(es) and adding new vertexAttribPointers
-    // normally you'd want to do this in a more organized fashion, but for learning purposes this will do.
-    // -----------------------------------------------------------------------------------------------------------------------------------
-    for (unsigned int i = 0; i < rock.meshes.size(); i++)
-    {
-        unsigned int VAO = rock.meshes[i].VAO;
-        glBindVertexArray(VAO);
-        // set attribute pointers for matrix (4 times vec4)
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)0);
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(sizeof(glm::vec4)));
-        glEnableVertexAttribArray(5);
-        glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(2 * sizeof(glm::vec4)));
-        glEnableVertexAttribArray(6);
-        glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(3 * sizeof(glm::vec4)));
-
-        glVertexAttribDivisor(3, 1);
-        glVertexAttribDivisor(4, 1);
-        glVertexAttribDivisor(5, 1);
-        glVertexAttribDivisor(6, 1);
-
-        glBindVertexArray(0);
-    }
+    glBufferData(GL_ARRAY_BUFFER, amount * sizeof(glm::mat4), &modelMatrices[0], GL_STATIC_DRAW); // only rewritten where instances change LOD
+
+    // level of detail: the instance buffer holds one bucket of instances per LOD level (see InstanceBuckets), each
+    // drawn with its own instanced draw call. The levels are only picked again once the camera moved a bit, and only
+    // the instances whose level changed are moved. The rock is a single mesh, so its first mesh decides the level.
+    // ---------------------------------------------------------------------------------------------------------------
+    const Mesh *rockMesh = NULL; // set up once the rock is loaded
+    float rockRadius = 0.0f;
+    LodSelection lodSelection(glm::radians(45.0f), (float)SCR_HEIGHT);
+    const float lodUpdateDistance = 0.5f; // how far the camera moves before the levels are picked again
+    InstanceBuckets buckets;
+    bool bucketsValid = false;
+    bool bucketsUseLods = useLods;
+    glm::vec3 bucketsCameraPosition;
+    // with base instances (GL 4.2) the instance attributes point at the start of the buffer once; without them they're
+    // pointed at each bucket before it is drawn
+    bool baseInstance = GLAD_GL_VERSION_4_2 != 0;
+    double lastStatsTime = 0.0;
 
     // render loop
     // -----------
@@ -164,6 +241,40 @@ int main()
         // -----
         processInput(window);
 
+        // loading: upload what the workers finished, for a few milliseconds per frame
+        // ---------------------------------------------------------------------------
+        if (loader.Pending() > 0)
+        {
+            loader.Update(4.0);
+            std::string title = loader.Pending() > 0 ? "LearnOpenGL - loading " + std::to_string((int)(loader.Progress() * 100.0f)) + "%" : "LearnOpenGL";
+            glfwSetWindowTitle(window, title.c_str());
+        }
+        Model *rock = rockHandle->Get();
+        Model *planet = planetHandle->Get();
+        if (rock && !rockMesh)
+        {
+            // set transformation matrices as an instance vertex attribute (with divisor 1)
+            // note: we're cheating a little by taking the, now publicly declared, VAO of the model's mesh(es) and adding new vertexAttribPointers
+            // normally you'd want to do this in a more organized fashion, but for learning purposes this will do.
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+            for (unsigned int i = 0; i < rock->meshes.size(); i++)
+                setInstanceAttributes(rock->meshes[i].VAO, 0);
+
+            rockMesh = &rock->meshes[0];
+            buckets.Reset(amount, (unsigned int)rockMesh->lods.size());
+            for (unsigned int i = 0; i < rockMesh->vertices.size(); i++)
+                rockRadius = std::max(rockRadius, glm::length(rockMesh->vertices[i].Position));
+            size_t rockVertices = 0;
+            for (unsigned int i = 0; i < rock->meshes.size(); i++)
+                rockVertices += rock->meshes[i].vertices.size();
+            std::cout << "vertex fetch per frame for " << amount << " rocks: " << (double)rockVertices * amount * sizeof(CompactVertex) / (1024.0 * 1024.0)
+                      << " MB compact, " << (double)rockVertices * amount * sizeof(FullVertex) / (1024.0 * 1024.0) << " MB with full float vertices" << std::endl;
+            std::cout << "rock LOD chain:";
+            for (unsigned int l = 0; l < rockMesh->lods.size(); l++)
+                std::cout << " " << rockMesh->lods[l].indexCount / 3;
+            std::cout << " triangles" << std::endl;
+        }
+
         // render
         // ------
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
@@ -184,18 +295,82 @@ int main()
         model = glm::translate(model, glm::vec3(0.0f, -3.0f, 0.0f));
         model = glm::scale(model, glm::vec3(4.0f, 4.0f, 4.0f));
         planetShader.setMat4("model", model);
-        planet.Draw(planetShader);
+        float planetDistance = glm::length(camera.Position - glm::vec3(0.0f, -3.0f, 0.0f)) / 4.0f;
+        unsigned int planetTriangles = 0;
+        if (planet && useLods)
+            planetTriangles = planet->Draw(planetShader, planetDistance, lodSelection);
+        else if (planet)
+        {
+            planet->Draw(planetShader);
+            planetTriangles = planet->TriangleCount();
+        }
 
-        // draw meteorites
-        asteroidShader.use();
-        asteroidShader.setInt("texture_diffuse1", 0);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, rock.textures_loaded[0].id); // note: we also made the textures_loaded vector public (instead of private) from the model class.
-        for (unsigned int i = 0; i < rock.meshes.size(); i++)
+        // move the meteorites (once loaded) between the LOD buckets: each level is used as long as its error stays below a pixel on screen
+        unsigned int lodCount = rockMesh ? (unsigned int)buckets.start.size() - 1 : 1;
+        std::vector<unsigned int> &bucketStart = buckets.start;
+        unsigned int rockTriangles = 0;
+        if (rockMesh)
+        {
+            if (!bucketsValid || useLods != bucketsUseLods || glm::length(camera.Position - bucketsCameraPosition) > lodUpdateDistance)
+            {
+                for (unsigned int i = 0; i < amount; i++)
+                {
+                    unsigned int lod = 0;
+                    if (useLods)
+                    {
+                        // distance to the rock's bounding sphere, in the rock's own units
+                        float distance = glm::length(glm::vec3(modelMatrices[i][3]) - camera.Position) - rockRadius * modelScales[i];
+                        lod = rockMesh->SelectLod(distance / modelScales[i], lodSelection);
+                    }
+                    buckets.Move(i, lod);
+                }
+                glBindBuffer(GL_ARRAY_BUFFER, buffer);
+                buckets.Upload(modelMatrices);
+                bucketsValid = true;
+                bucketsUseLods = useLods;
+                bucketsCameraPosition = camera.Position;
+            }
+
+            // draw meteorites
+            asteroidShader.use();
+            asteroidShader.setInt("texture_diffuse1", 0);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, rock->textures_loaded[0].id); // note: we also made the textures_loaded vector public (instead of private) from the model class.
+            for (unsigned int l = 0; l < lodCount; l++)
+            {
+                unsigned int instances = bucketStart[l + 1] - bucketStart[l];
+                if (instances == 0)
+                    continue;
+                for (unsigned int i = 0; i < rock->meshes.size(); i++)
+                {
+                    unsigned int level = std::min(l, (unsigned int)rock->meshes[i].lods.size() - 1);
+                    const MeshLod &lod = rock->meshes[i].lods[level];
+                    asteroidShader.setVec4("texCoordTransform", rock->meshes[i].texCoordTransform);
+                    if (!baseInstance)
+                    {
+                        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+                        setInstanceAttributes(rock->meshes[i].VAO, bucketStart[l]);
+                    }
+                    glBindVertexArray(rock->meshes[i].VAO);
+                    if (baseInstance)
+                        glDrawElementsInstancedBaseInstance(GL_TRIANGLES, lod.indexCount, rock->meshes[i].indexType, rock->meshes[i].IndexOffset(level),
+                                                            instances, bucketStart[l]);
+                    else
+                        glDrawElementsInstanced(GL_TRIANGLES, lod.indexCount, rock->meshes[i].indexType, rock->meshes[i].IndexOffset(level), instances);
+                    glBindVertexArray(0);
+                    rockTriangles += instances * (lod.indexCount / 3);
+                }
+            }
+        }
+
+        // triangle statistics, once a second
+        if (rock && planet && currentFrame - lastStatsTime > 1.0)
         {
-            glBindVertexArray(rock.meshes[i].VAO);
-            glDrawElementsInstanced(GL_TRIANGLES, rock.meshes[i].indices.size(), GL_UNSIGNED_INT, 0, amount);
-            glBindVertexArray(0);
+            lastStatsTime = currentFrame;
+            std::cout << "LOD " << (useLods ? "on: " : "off: ") << (rockTriangles + planetTriangles) / 1.0e6 << " million triangles per frame (rocks";
+            for (unsigned int l = 0; l < lodCount; l++)
+                std::cout << " LOD" << l << " x" << bucketStart[l + 1] - bucketStart[l];
+            std::cout << ", full detail would be " << ((double)rock->TriangleCount() * amount + planet->TriangleCount()) / 1.0e6 << " million)" << std::endl;
         }
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
@@ -223,6 +398,33 @@ void processInput(GLFWwindow *window)
         camera.ProcessKeyboard(LEFT, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
         camera.ProcessKeyboard(RIGHT, deltaTime);
+
+    if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS && !lodKeyPressed)
+    {
+        useLods = !useLods;
+        lodKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_L) == GLFW_RELEASE)
+    {
+        lodKeyPressed = false;
+    }
+}
+
+// points the instance matrix attributes (locations 3-6) of a VAO at the instance buffer, starting at firstInstance;
+// expects the instance buffer to be bound to GL_ARRAY_BUFFER
+// ---------------------------------------------------------------------------------------------------------------
+void setInstanceAttributes(unsigned int VAO, unsigned int firstInstance)
+{
+    size_t offset = firstInstance * sizeof(glm::mat4);
+    glBindVertexArray(VAO);
+    // set attribute pointers for matrix (4 times vec4)
+    for (unsigned int column = 0; column < 4; column++)
+    {
+        glEnableVertexAttribArray(3 + column);
+        glVertexAttribPointer(3 + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(offset + column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(3 + column, 1);
+    }
+    glBindVertexArray(0);
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
@@ -79,47 +79,28 @@ public:
 	}
 };
 
-class VertexAttribute {
-private:
-	const int argSize;
-	const int argOffset;
-	const GLboolean normalized;
-public:
-	void EnableAndDeclare(const GLuint index, const int strideSize) {
-		glEnableVertexAttribArray(index);
-		glVertexAttribPointer(index, argSize, GL_FLOAT, normalized, strideSize * sizeof(float), (void*)(argOffset * sizeof(float)));
-	}
-	VertexAttribute() = delete;
-	//VertexAttribute(VertexAttribute&) = delete;
-	VertexAttribute(const int argSize, const int argOffset, const GLboolean normalized) : argSize(argSize), argOffset(argOffset), normalized(normalized) {};
-
-	const int GetArgSize() const { return argSize; }
-	const int GetArgOffset() const { return argOffset; }
-};
-
 class ModelObject {
 private:
 	const std::vector<float> attributeArray;
-	std::vector<VertexAttribute> attributeProperties;
 	const int strideSize;
+	const int positionOffset;
 	GLuint vao;
 	GLuint vbo;
 public:
 	ModelObject() = delete;
-	ModelObject(const std::vector<float>& attributeArray, std::vector<VertexAttribute>& attributeProperties, const int strideSize) :
-		attributeArray(attributeArray), attributeProperties(attributeProperties), strideSize(strideSize)
+	// attributeArray holds interleaved float vertices laid out as described by the (all float) vertex format
+	template<typename Format>
+	ModelObject(const std::vector<float>& attributeArray, Format) :
+		attributeArray(attributeArray), strideSize(sizeof(Format) / sizeof(float)), positionOffset(Format::OffsetOf(VERTEX_POSITION) / sizeof(float))
 	{
+		static_assert(sizeof(Format) % sizeof(float) == 0, "ModelObject expects vertex formats made of float attributes");
 		glGenVertexArrays(1, &vao);
 		glGenBuffers(1, &vbo);
 		glBindVertexArray(vao);
 		glBindBuffer(GL_ARRAY_BUFFER, vbo);
 		glBufferData(GL_ARRAY_BUFFER, sizeof(float) * attributeArray.size(), &attributeArray[0], GL_STATIC_DRAW);
 
-		GLuint attrId = 0;
-		for (auto& ap : attributeProperties) {
-			ap.EnableAndDeclare(attrId, strideSize);
-			++attrId;
-		}
+		Format::SetupAttributes();
 
 		glBindVertexArray(0);
 	}
@@ -129,6 +110,7 @@ public:
 	}
 	const std::vector<float>&  GetAttributeArray() const { return attributeArray; }
 	const int GetStrideSize() const { return strideSize; }
+	const int GetPositionOffset() const { return positionOffset; }
 	const GLuint GetVAO() const { return vao; }
 	const GLuint GetVBO() const { return vbo; }
 	void Render() const {
@@ -143,9 +125,9 @@ private:
 	const BoundingSphere boundingSphere;
 	glm::mat4 sceneMatrix;
 public:
-	SceneObject(const ModelObject& modelObject, const VertexAttribute& positionAttribute, glm::mat4 sceneMatrix) : modelObject(modelObject), sceneMatrix(std::move(sceneMatrix)),
-		boundingSphere(BoundingSphere(modelObject.GetAttributeArray(), modelObject.GetStrideSize(), positionAttribute.GetArgOffset(), sceneMatrix)) {};
-	SceneObject(ModelObject& modelObject, const VertexAttribute& positionAttribute) : SceneObject(modelObject, positionAttribute, glm::mat4()) {};
+	SceneObject(const ModelObject& modelObject, glm::mat4 sceneMatrix) : modelObject(modelObject), sceneMatrix(std::move(sceneMatrix)),
+		boundingSphere(BoundingSphere(modelObject.GetAttributeArray(), modelObject.GetStrideSize(), modelObject.GetPositionOffset(), sceneMatrix)) {};
+	SceneObject(ModelObject& modelObject) : SceneObject(modelObject, glm::mat4()) {};
 	const BoundingSphere& GetBoundingSphere() const { return boundingSphere; }
 	const glm::mat4& GetSceneMatrix() const { return sceneMatrix; }
 	void Render() const {
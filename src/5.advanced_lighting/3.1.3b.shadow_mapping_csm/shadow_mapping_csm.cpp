@@ -181,10 +181,10 @@ static Scene scene;
 
 void createSceneObjects() {
 
-	const VertexAttribute position(3, 0, GL_FALSE);
-	const VertexAttribute normal(3, 3, GL_FALSE);
-	const VertexAttribute texCoord(2, 6, GL_FALSE);
-	std::vector<VertexAttribute> sceneVA({ position, normal, texCoord });
+	typedef VertexFormat<
+		VertexAttribute<VERTEX_POSITION, VertexEncoding::Float3>,
+		VertexAttribute<VERTEX_NORMAL, VertexEncoding::Float3>,
+		VertexAttribute<VERTEX_TEXCOORD, VertexEncoding::Float2>> SceneVertex;
 
 	const std::vector<float> planeVertices({
 		// positions            // normals         // texcoords
@@ -197,8 +197,8 @@ void createSceneObjects() {
 		 25.0f, -0.5f, -25.0f,  0.0f, 1.0f, 0.0f,  25.0f, 25.0f
 		});
 
-	static ModelObject modelPlane(planeVertices, sceneVA, 8);
-	static SceneObject scenePlane(modelPlane, position);
+	static ModelObject modelPlane(planeVertices, SceneVertex());
+	static SceneObject scenePlane(modelPlane);
 	scene.Add(0, scenePlane, false);
 
 	const std::vector<float> cubeVertices({
@@ -247,12 +247,12 @@ void createSceneObjects() {
 		-1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 0.0f  // bottom-left        
 		});
 
-	static ModelObject modelCube(cubeVertices, sceneVA, 8);
+	static ModelObject modelCube(cubeVertices, SceneVertex());
 	{
 		glm::mat4 modelMat = glm::mat4();
 		modelMat = glm::translate(modelMat, glm::vec3(0.0f, 1.5f, 0.0));
 		modelMat = glm::scale(modelMat, glm::vec3(0.5f));
-		static SceneObject sceneCube1(modelCube, position, modelMat);
+		static SceneObject sceneCube1(modelCube, modelMat);
 		scene.Add(1, sceneCube1);
 	}
 
@@ -260,7 +260,7 @@ void createSceneObjects() {
 		glm::mat4 modelMat = glm::mat4();
 		modelMat = glm::translate(modelMat, glm::vec3(2.0f, 0.0f, 1.0));
 		modelMat = glm::scale(modelMat, glm::vec3(0.5f));
-		static SceneObject sceneCube2(modelCube, position, modelMat);
+		static SceneObject sceneCube2(modelCube, modelMat);
 		scene.Add(2, sceneCube2);
 	}
 
@@ -269,7 +269,7 @@ void createSceneObjects() {
 		modelMat = glm::translate(modelMat, glm::vec3(-1.0f, 0.0f, 2.0));
 		modelMat = glm::rotate(modelMat, glm::radians(60.0f), glm::normalize(glm::vec3(1.0, 0.0, 1.0)));
 		modelMat = glm::scale(modelMat, glm::vec3(0.25));
-		static SceneObject sceneCube3(modelCube, position, modelMat);
+		static SceneObject sceneCube3(modelCube, modelMat);
 		scene.Add(3, sceneCube3);
 	}
 }
@@ -335,6 +335,7 @@ int main()
     // load textures
     // -------------
     unsigned int woodTexture = loadTexture(FileSystem::getPath("resources/textures/wood.png").c_str());
+    TextureUploadQueue::Get().Flush(); // the textures only queued their pixels, send them over before the first frame
 
     // configure depth map FBO
     // -----------------------
@@ -659,37 +660,6 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 // ---------------------------------------------------
 unsigned int loadTexture(char const * path)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT); // for this tutorial: use GL_CLAMP_TO_EDGE to prevent semi-transparent borders. Due to interpolation it takes texels from next repeat 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
+    // for this tutorial: use GL_CLAMP_TO_EDGE on textures with alpha to prevent semi-transparent borders. Due to interpolation it takes texels from next repeat
+    return TextureCache::Get().Acquire(path, TextureOptions(false, GL_REPEAT, GL_CLAMP_TO_EDGE));
 }
@@ -15,12 +15,12 @@ uniform sampler2D normalMap;
 uniform vec3 lightPos;
 uniform vec3 viewPos;
 
+#include "decode_normal.glsl"
+
 void main()
 {           
-     // obtain normal from normal map in range [0,1]
-    vec3 normal = texture(normalMap, fs_in.TexCoords).rgb;
-    // transform normal vector to range [-1,1]
-    normal = normalize(normal * 2.0 - 1.0);  // this normal is in tangent space
+     // obtain normal from normal map in range [0,1] and transform it to range [-1,1]
+    vec3 normal = DecodeNormal(normalMap, fs_in.TexCoords);  // this normal is in tangent space
    
     // get diffuse color
     vec3 color = texture(diffuseMap, fs_in.TexCoords).rgb;
@@ -15,6 +15,8 @@ uniform sampler2D depthMap;
 
 uniform float heightScale;
 
+#include "decode_normal.glsl"
+
 vec2 ParallaxMapping(vec2 texCoords, vec3 viewDir)
 { 
 	// number of depth layers
@@ -124,8 +126,7 @@ void main()
 	//texCoords = clamp(texCoords, vec2(0.0), vec2(1.0));
 
     // obtain normal from normal map
-    vec3 normal = texture(normalMap, texCoords).rgb;
-    normal = normalize(normal * 2.0 - 1.0);   
+    vec3 normal = DecodeNormal(normalMap, texCoords);
    
     // get diffuse color
     vec3 color = texture(diffuseMap, texCoords).rgb;
@@ -0,0 +1,16 @@
+// Percentage-closer filtering of a 2D shadow map: the share of the 3x3 texels around projCoords.xy (in [0,1] range)
+// that are closer to the light than the biased depth projCoords.z.
+float ShadowPCF(sampler2D shadowMap, vec3 projCoords, float bias)
+{
+    float shadow = 0.0;
+    vec2 texelSize = 1.0 / textureSize(shadowMap, 0);
+    for(int x = -1; x <= 1; ++x)
+    {
+        for(int y = -1; y <= 1; ++y)
+        {
+            float pcfDepth = texture(shadowMap, projCoords.xy + vec2(x, y) * texelSize).r; 
+            shadow += projCoords.z - bias > pcfDepth  ? 1.0 : 0.0;        
+        }    
+    }
+    return shadow / 9.0;
+}
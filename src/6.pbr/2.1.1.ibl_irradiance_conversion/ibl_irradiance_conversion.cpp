@@ -127,7 +127,7 @@ int main()
     // ---------------------------------
     stbi_set_flip_vertically_on_load(true);
     int width, height, nrComponents;
-    float *data = stbi_loadf(FileSystem::getPath("resources/textures/hdr/newport_loft.hdr").c_str(), &width, &height, &nrComponents, 0);
+    float *data = LoadHDRImage(FileSystem::getPath("resources/textures/hdr/newport_loft.hdr"), &width, &height, &nrComponents);
     unsigned int hdrTexture;
     if (data)
     {
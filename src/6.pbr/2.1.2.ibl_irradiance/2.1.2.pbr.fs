@@ -10,8 +10,16 @@ uniform float metallic;
 uniform float roughness;
 uniform float ao;
 
-// IBL
+// IBL: the convolved irradiance map if IRRADIANCE_MAP is defined, otherwise the irradiance of the environment as L2
+// spherical harmonics, with the cosine lobe and the basis constants folded in (see spherical_harmonics.h)
+#ifdef IRRADIANCE_MAP
 uniform samplerCube irradianceMap;
+#else
+layout (std140) uniform IrradianceSHBlock
+{
+    vec4 shCoefficients[9];
+};
+#endif
 
 // lights
 uniform vec3 lightPositions[4];
@@ -21,45 +29,24 @@ uniform vec3 camPos;
 
 const float PI = 3.14159265359;
 // ----------------------------------------------------------------------------
-float DistributionGGX(vec3 N, vec3 H, float roughness)
-{
-    float a = roughness*roughness;
-    float a2 = a*a;
-    float NdotH = max(dot(N, H), 0.0);
-    float NdotH2 = NdotH*NdotH;
-
-    float nom   = a2;
-    float denom = (NdotH2 * (a2 - 1.0) + 1.0);
-    denom = PI * denom * denom;
-
-    return nom / denom;
-}
-// ----------------------------------------------------------------------------
-float GeometrySchlickGGX(float NdotV, float roughness)
-{
-    float r = (roughness + 1.0);
-    float k = (r*r) / 8.0;
-
-    float nom   = NdotV;
-    float denom = NdotV * (1.0 - k) + k;
-
-    return nom / denom;
-}
-// ----------------------------------------------------------------------------
-float GeometrySmith(vec3 N, vec3 V, vec3 L, float roughness)
+#ifndef IRRADIANCE_MAP
+vec3 IrradianceSH(vec3 n)
 {
-    float NdotV = max(dot(N, V), 0.0);
-    float NdotL = max(dot(N, L), 0.0);
-    float ggx2 = GeometrySchlickGGX(NdotV, roughness);
-    float ggx1 = GeometrySchlickGGX(NdotL, roughness);
-
-    return ggx1 * ggx2;
+    vec3 irradiance = shCoefficients[0].rgb
+                    + shCoefficients[1].rgb * n.y
+                    + shCoefficients[2].rgb * n.z
+                    + shCoefficients[3].rgb * n.x
+                    + shCoefficients[4].rgb * (n.x * n.y)
+                    + shCoefficients[5].rgb * (n.y * n.z)
+                    + shCoefficients[6].rgb * (3.0 * n.z * n.z - 1.0)
+                    + shCoefficients[7].rgb * (n.x * n.z)
+                    + shCoefficients[8].rgb * (n.x * n.x - n.y * n.y);
+    // the truncated series can ring slightly below zero opposite very bright lights
+    return max(irradiance, vec3(0.0));
 }
+#endif
 // ----------------------------------------------------------------------------
-vec3 fresnelSchlick(float cosTheta, vec3 F0)
-{
-    return F0 + (1.0 - F0) * pow(1.0 - cosTheta, 5.0);
-}
+#include "pbr_brdf.glsl"
 // ----------------------------------------------------------------------------
 void main()
 {		
@@ -114,7 +101,11 @@ void main()
     vec3 kS = fresnelSchlick(max(dot(N, V), 0.0), F0);
     vec3 kD = 1.0 - kS;
     kD *= 1.0 - metallic;	  
+#ifdef IRRADIANCE_MAP
     vec3 irradiance = texture(irradianceMap, N).rgb;
+#else
+    vec3 irradiance = IrradianceSH(normalize(N));
+#endif
     vec3 diffuse      = irradiance * albedo;
     vec3 ambient = (kD * diffuse) * ao;
     // vec3 ambient = vec3(0.002);
@@ -10,8 +10,11 @@
 #include <learnopengl/shader.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
+#include <learnopengl/spherical_harmonics.h>
 
 #include <iostream>
+#include <chrono>
+#include <string>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
@@ -19,6 +22,7 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow *window);
 void renderSphere();
 void renderCube();
+void printIrradianceDifference(const IrradianceSH &sh, unsigned int irradianceMap, int size);
 
 // settings
 const unsigned int SCR_WIDTH = 1280;
@@ -34,8 +38,24 @@ bool firstMouse = true;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
-int main()
+// irradiance lookup: spherical harmonics, or the convolved irradiance map (--irradiance-map); with --compare-irradiance
+// both are built and I switches between them
+bool useIrradianceMap = false;
+bool irradianceMapAvailable = false;
+bool switchKeyPressed = false;
+
+int main(int argc, char *argv[])
 {
+    bool compareIrradiance = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::string(argv[i]) == "--irradiance-map")
+            useIrradianceMap = true;
+        else if (std::string(argv[i]) == "--compare-irradiance")
+            compareIrradiance = true;
+    }
+    irradianceMapAvailable = useIrradianceMap || compareIrradiance;
+
     // glfw: initialize and configure
     // ------------------------------
     glfwInit();
@@ -72,6 +92,8 @@ int main()
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    // shaders built in a batch below are compiled by the driver on as many threads as it likes, where it can
+    ShaderCompiler::Get().EnableParallelCompile((GLADloadproc)glfwGetProcAddress);
 
     // configure global opengl state
     // -----------------------------
@@ -80,20 +102,16 @@ int main()
 
     // build and compile shaders
     // -------------------------
-    Shader pbrShader("2.1.2.pbr.vs", "2.1.2.pbr.fs");
+    // submitted together; each program is only checked when it's first used (see ShaderCompiler)
+    ShaderCompiler::Get().BeginBatch();
+    Shader pbrSHShader("2.1.2.pbr.vs", "2.1.2.pbr.fs");
+    Shader pbrMapShader("2.1.2.pbr.vs", "2.1.2.pbr.fs", nullptr, { "#define IRRADIANCE_MAP" });
     Shader equirectangularToCubemapShader("2.1.2.cubemap.vs", "2.1.2.equirectangular_to_cubemap.fs");
-    Shader irradianceShader("2.1.2.cubemap.vs", "2.1.2.irradiance_convolution.fs");
     Shader backgroundShader("2.1.2.background.vs", "2.1.2.background.fs");
-
-
-    pbrShader.use();
-    pbrShader.setInt("irradianceMap", 0);
-    pbrShader.setVec3("albedo", 0.5f, 0.0f, 0.0f);
-    pbrShader.setFloat("ao", 1.0f);
-
-    backgroundShader.use();
-    backgroundShader.setInt("environmentMap", 0);
-
+    ShaderCompiler::Get().EndBatch();
+    // the programs of the batch are first used once the HDR environment map is loaded, so the driver compiles them
+    // meanwhile
+    ShaderPermutations::Get().PrintStats();
 
     // lights
     // ------
@@ -129,7 +147,7 @@ int main()
     // ---------------------------------
     stbi_set_flip_vertically_on_load(true);
     int width, height, nrComponents;
-    float *data = stbi_loadf(FileSystem::getPath("resources/textures/hdr/newport_loft.hdr").c_str(), &width, &height, &nrComponents, 0);
+    float *data = LoadHDRImage(FileSystem::getPath("resources/textures/hdr/newport_loft.hdr"), &width, &height, &nrComponents);
     unsigned int hdrTexture;
     if (data)
     {
@@ -148,6 +166,8 @@ int main()
     {
         std::cout << "Failed to load HDR image." << std::endl;
     }
+    // check the programs the driver has finished meanwhile, without waiting for the others
+    ShaderCompiler::Get().Poll();
 
     // pbr: setup cubemap to render to and attach to framebuffer
     // ---------------------------------------------------------
@@ -197,51 +217,95 @@ int main()
     }
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-    // pbr: create an irradiance cubemap, and re-scale capture FBO to irradiance scale.
-    // --------------------------------------------------------------------------------
-    unsigned int irradianceMap;
-    glGenTextures(1, &irradianceMap);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
-    for (unsigned int i = 0; i < 6; ++i)
+    // pbr: project the environment onto 9 spherical harmonic coefficients, which give the diffuse irradiance in a
+    // handful of multiply-adds per pixel and replace the irradiance map. L2 harmonics only keep the lowest frequencies,
+    // so a 128x128 mip level of the environment is all the projection needs.
+    // ----------------------------------------------------------------------------------------------------------------
+    const int SH_LEVEL = 2;
+    glFinish();
+    auto projectionStart = std::chrono::high_resolution_clock::now();
+    glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+    std::vector<float> envTexels;
+    int shSize = SphericalHarmonics::ReadCubemap(envCubemap, 512, SH_LEVEL, envTexels);
+    auto readBackEnd = std::chrono::high_resolution_clock::now();
+    IrradianceSH irradianceSH = SphericalHarmonics::ProjectCubemap(envTexels.data(), shSize);
+    auto projectionEnd = std::chrono::high_resolution_clock::now();
+    unsigned int irradianceUBO = SphericalHarmonics::CreateUniformBuffer(irradianceSH);
+    glBindBufferBase(GL_UNIFORM_BUFFER, 0, irradianceUBO);
+    std::cout << "IRRADIANCE:: SH projection of the " << shSize << "x" << shSize << " environment took "
+              << std::chrono::duration<double, std::milli>(projectionEnd - projectionStart).count() << " ms ("
+              << std::chrono::duration<double, std::milli>(readBackEnd - projectionStart).count() << " ms mipmaps and readback, "
+              << WorkerThreadCount() << " threads)" << std::endl;
+
+    unsigned int irradianceMap = 0;
+    if (irradianceMapAvailable)
     {
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 32, 32, 0, GL_RGB, GL_FLOAT, nullptr);
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        Shader irradianceShader("2.1.2.cubemap.vs", "2.1.2.irradiance_convolution.fs");
+        glFinish();
+        auto convolutionStart = std::chrono::high_resolution_clock::now();
 
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-    glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 32, 32);
+        // pbr: create an irradiance cubemap, and re-scale capture FBO to irradiance scale.
+        // --------------------------------------------------------------------------------
+        glGenTextures(1, &irradianceMap);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
+        for (unsigned int i = 0; i < 6; ++i)
+        {
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 32, 32, 0, GL_RGB, GL_FLOAT, nullptr);
+        }
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+        glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 32, 32);
+
+        // pbr: solve diffuse integral by convolution to create an irradiance (cube)map.
+        // -----------------------------------------------------------------------------
+        irradianceShader.use();
+        irradianceShader.setInt("environmentMap", 0);
+        irradianceShader.setMat4("projection", captureProjection);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
 
-    // pbr: solve diffuse integral by convolution to create an irradiance (cube)map.
-    // -----------------------------------------------------------------------------
-    irradianceShader.use();
-    irradianceShader.setInt("environmentMap", 0);
-    irradianceShader.setMat4("projection", captureProjection);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+        glViewport(0, 0, 32, 32); // don't forget to configure the viewport to the capture dimensions.
+        glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+        for (unsigned int i = 0; i < 6; ++i)
+        {
+            irradianceShader.setMat4("view", captureViews[i]);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, irradianceMap, 0);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    glViewport(0, 0, 32, 32); // don't forget to configure the viewport to the capture dimensions.
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-    for (unsigned int i = 0; i < 6; ++i)
-    {
-        irradianceShader.setMat4("view", captureViews[i]);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, irradianceMap, 0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            renderCube();
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-        renderCube();
+        glFinish();
+        std::cout << "IRRADIANCE:: irradiance map convolution took "
+                  << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - convolutionStart).count() << " ms" << std::endl;
+        if (compareIrradiance)
+            printIrradianceDifference(irradianceSH, irradianceMap, 32);
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
     // initialize static shader uniforms before rendering
     // --------------------------------------------------
     glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-    pbrShader.use();
-    pbrShader.setMat4("projection", projection);
+    pbrSHShader.use();
+    pbrSHShader.setVec3("albedo", 0.5f, 0.0f, 0.0f);
+    pbrSHShader.setFloat("ao", 1.0f);
+    // the SH coefficients come from the uniform buffer bound to binding point 0
+    glUniformBlockBinding(pbrSHShader.ID, glGetUniformBlockIndex(pbrSHShader.ID, "IrradianceSHBlock"), 0);
+    pbrSHShader.setMat4("projection", projection);
+    pbrMapShader.use();
+    pbrMapShader.setInt("irradianceMap", 0);
+    pbrMapShader.setVec3("albedo", 0.5f, 0.0f, 0.0f);
+    pbrMapShader.setFloat("ao", 1.0f);
+    pbrMapShader.setMat4("projection", projection);
     backgroundShader.use();
+    backgroundShader.setInt("environmentMap", 0);
     backgroundShader.setMat4("projection", projection);
 
     // then before rendering, configure the viewport to the original framebuffer's screen dimensions
@@ -249,6 +313,17 @@ int main()
     glfwGetFramebufferSize(window, &scrWidth, &scrHeight);
     glViewport(0, 0, scrWidth, scrHeight);
 
+    // the sphere grid is timed on the GPU to compare the per-pixel cost of the two irradiance lookups. Each query is
+    // read back a few frames after it was issued, so waiting for it doesn't stall the pipeline.
+    const unsigned int TIMER_QUERIES = 4;
+    unsigned int timerQueries[TIMER_QUERIES];
+    bool timedIrradianceMap[TIMER_QUERIES];
+    glGenQueries(TIMER_QUERIES, timerQueries);
+    unsigned int frameIndex = 0;
+    GLuint64 gridTime[2] = { 0, 0 };
+    unsigned int gridFrames[2] = { 0, 0 };
+    double lastReport = glfwGetTime();
+
     // render loop
     // -----------
     while (!glfwWindowShouldClose(window))
@@ -268,16 +343,31 @@ int main()
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // render scene, supplying the convoluted irradiance map to the final shader.
+        // render scene, supplying the irradiance SH coefficients (or the convoluted irradiance map) to the final shader.
         // ------------------------------------------------------------------------------------------
+        Shader &pbrShader = useIrradianceMap ? pbrMapShader : pbrSHShader;
         pbrShader.use();
         glm::mat4 view = camera.GetViewMatrix();
         pbrShader.setMat4("view", view);
         pbrShader.setVec3("camPos", camera.Position);
 
-        // bind pre-computed IBL data
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
+        // bind pre-computed IBL data; the SH coefficients stay bound to their uniform buffer binding point
+        if (useIrradianceMap)
+        {
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
+        }
+
+        unsigned int query = frameIndex % TIMER_QUERIES;
+        if (frameIndex >= TIMER_QUERIES)
+        {
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(timerQueries[query], GL_QUERY_RESULT, &elapsed);
+            gridTime[timedIrradianceMap[query]] += elapsed;
+            gridFrames[timedIrradianceMap[query]]++;
+        }
+        timedIrradianceMap[query] = useIrradianceMap;
+        glBeginQuery(GL_TIME_ELAPSED, timerQueries[query]);
 
         // render rows*column number of spheres with material properties defined by textures (they all have the same material properties)
         glm::mat4 model;
@@ -300,6 +390,22 @@ int main()
                 renderSphere();
             }
         }
+        glEndQuery(GL_TIME_ELAPSED);
+        frameIndex++;
+
+        if (glfwGetTime() - lastReport > 2.0)
+        {
+            const char *lookups[2] = { "SH", "irradiance map" };
+            for (unsigned int i = 0; i < 2; i++)
+            {
+                if (gridFrames[i] > 0)
+                    std::cout << "IRRADIANCE:: sphere grid with the " << lookups[i] << " lookup: " << gridTime[i] / (gridFrames[i] * 1e6)
+                              << " ms per frame on the GPU (" << gridFrames[i] << " frames)" << std::endl;
+                gridTime[i] = 0;
+                gridFrames[i] = 0;
+            }
+            lastReport = glfwGetTime();
+        }
 
 
         // render light source (simply re-render sphere at light positions)
@@ -356,6 +462,47 @@ void processInput(GLFWwindow *window)
         camera.ProcessKeyboard(LEFT, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
         camera.ProcessKeyboard(RIGHT, deltaTime);
+
+    if (glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS && !switchKeyPressed && irradianceMapAvailable)
+    {
+        useIrradianceMap = !useIrradianceMap;
+        std::cout << "IRRADIANCE:: using the " << (useIrradianceMap ? "irradiance map" : "SH") << " lookup" << std::endl;
+    }
+    switchKeyPressed = glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS;
+}
+
+// prints how far the SH irradiance is from the convolved irradiance map over all its texels, relative to the map's
+// average irradiance
+// ---------------------------------------------------------------------------------------------------------------
+void printIrradianceDifference(const IrradianceSH &sh, unsigned int irradianceMap, int size)
+{
+    std::vector<float> texels;
+    SphericalHarmonics::ReadCubemap(irradianceMap, size, 0, texels);
+    double squaredSum = 0.0, largest = 0.0, average = 0.0;
+    for (int face = 0; face < 6; face++)
+    {
+        for (int y = 0; y < size; y++)
+        {
+            for (int x = 0; x < size; x++)
+            {
+                float direction[3], irradiance[3];
+                SphericalHarmonics::TexelDirection(face, x, y, size, direction);
+                SphericalHarmonics::Evaluate(sh, direction, irradiance);
+                const float *texel = &texels[(((size_t)face * size + y) * size + x) * 3];
+                for (int c = 0; c < 3; c++)
+                {
+                    double difference = std::abs(irradiance[c] - texel[c]);
+                    squaredSum += difference * difference;
+                    largest = std::max(largest, difference);
+                    average += texel[c];
+                }
+            }
+        }
+    }
+    double count = 6.0 * size * size * 3;
+    average /= count;
+    std::cout << "IRRADIANCE:: SH vs irradiance map: rms difference " << 100.0 * std::sqrt(squaredSum / count) / average
+              << "%, largest " << 100.0 * largest / average << "% of the average irradiance" << std::endl;
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
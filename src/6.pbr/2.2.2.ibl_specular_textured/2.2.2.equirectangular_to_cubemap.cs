@@ -0,0 +1,27 @@
+// writes all six faces of the environment cubemap in one dispatch, one invocation per texel and face (z)
+layout(local_size_x = GROUP_SIZE, local_size_y = GROUP_SIZE) in;
+
+layout(binding = 0) uniform sampler2D equirectangularMap;
+layout(binding = 0, rgba16f) uniform writeonly imageCube cubemap;
+
+const vec2 invAtan = vec2(0.1591, 0.3183);
+vec2 SampleSphericalMap(vec3 v)
+{
+    vec2 uv = vec2(atan(v.z, v.x), asin(v.y));
+    uv *= invAtan;
+    uv += 0.5;
+    return uv;
+}
+
+#include "cubemap_direction.glsl"
+
+void main()
+{
+    ivec3 texel = ivec3(gl_GlobalInvocationID);
+    int size = imageSize(cubemap).x;
+    if (texel.x >= size || texel.y >= size)
+        return;
+
+    vec2 uv = SampleSphericalMap(CubemapDirection(texel, size));
+    imageStore(cubemap, texel, vec4(textureLod(equirectangularMap, uv, 0.0).rgb, 1.0));
+}
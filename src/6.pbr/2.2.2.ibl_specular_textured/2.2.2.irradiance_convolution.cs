@@ -0,0 +1,48 @@
+// the irradiance convolution of 2.2.2.irradiance_convolution.fs, all six faces in one dispatch
+layout(local_size_x = GROUP_SIZE, local_size_y = GROUP_SIZE) in;
+
+layout(binding = 0) uniform samplerCube environmentMap;
+layout(binding = 0, rgba16f) uniform writeonly imageCube irradianceMap;
+
+// the environment level the fragment shader's derivatives pick: the one whose texels are as large as the output's
+uniform float sourceLevel;
+
+const float PI = 3.14159265359;
+
+#include "cubemap_direction.glsl"
+
+void main()
+{
+    ivec3 texel = ivec3(gl_GlobalInvocationID);
+    int size = imageSize(irradianceMap).x;
+    if (texel.x >= size || texel.y >= size)
+        return;
+
+    vec3 N = CubemapDirection(texel, size);
+
+    vec3 irradiance = vec3(0.0);
+
+    // tangent space calculation from origin point
+    vec3 up    = vec3(0.0, 1.0, 0.0);
+    vec3 right = cross(up, N);
+    up         = cross(N, right);
+
+    float sampleDelta = 0.025;
+    float nrSamples = 0.0;
+    for(float phi = 0.0; phi < 2.0 * PI; phi += sampleDelta)
+    {
+        for(float theta = 0.0; theta < 0.5 * PI; theta += sampleDelta)
+        {
+            // spherical to cartesian (in tangent space)
+            vec3 tangentSample = vec3(sin(theta) * cos(phi),  sin(theta) * sin(phi), cos(theta));
+            // tangent space to world
+            vec3 sampleVec = tangentSample.x * right + tangentSample.y * up + tangentSample.z * N;
+
+            irradiance += textureLod(environmentMap, sampleVec, sourceLevel).rgb * cos(theta) * sin(theta);
+            nrSamples++;
+        }
+    }
+    irradiance = PI * irradiance * (1.0 / float(nrSamples));
+
+    imageStore(irradianceMap, texel, vec4(irradiance, 1.0));
+}
@@ -0,0 +1,68 @@
+// prefilters one level of the specular map, all six faces in one dispatch. Like 2.2.2.prefilter.fs every sample reads
+// the environment level whose texels cover the solid angle the sample stands for (its share of the GGX lobe, from the
+// pdf), but the sample count is a uniform: that filtering is what keeps a few dozen samples free of noise, where the
+// fragment pass spends 1024 on every level.
+layout(local_size_x = GROUP_SIZE, local_size_y = GROUP_SIZE) in;
+
+layout(binding = 0) uniform samplerCube environmentMap;
+layout(binding = 0, rgba16f) uniform writeonly imageCube prefilterMap;
+
+uniform float roughness;
+uniform int sampleCount;
+uniform float sourceResolution; // per face, of environmentMap's first level
+
+const float PI = 3.14159265359;
+// ----------------------------------------------------------------------------
+#include "pbr_brdf.glsl"
+// ----------------------------------------------------------------------------
+#include "importance_sampling.glsl"
+// ----------------------------------------------------------------------------
+#include "cubemap_direction.glsl"
+// ----------------------------------------------------------------------------
+void main()
+{
+    ivec3 texel = ivec3(gl_GlobalInvocationID);
+    int size = imageSize(prefilterMap).x;
+    if (texel.x >= size || texel.y >= size)
+        return;
+
+    vec3 N = CubemapDirection(texel, size);
+
+    // make the simplyfying assumption that V equals R equals the normal
+    vec3 R = N;
+    vec3 V = R;
+
+    vec3 prefilteredColor = vec3(0.0);
+    float totalWeight = 0.0;
+
+    float saTexel = 4.0 * PI / (6.0 * sourceResolution * sourceResolution);
+    for(uint i = 0u; i < uint(sampleCount); ++i)
+    {
+        // generates a sample vector that's biased towards the preferred alignment direction (importance sampling).
+        vec2 Xi = Hammersley(i, uint(sampleCount));
+        vec3 H = ImportanceSampleGGX(Xi, N, roughness);
+        vec3 L  = normalize(2.0 * dot(V, H) * H - V);
+
+        float NdotL = max(dot(N, L), 0.0);
+        if(NdotL > 0.0)
+        {
+            // sample from the environment's mip level based on roughness/pdf
+            float D   = DistributionGGX(N, H, roughness);
+            float NdotH = max(dot(N, H), 0.0);
+            float HdotV = max(dot(H, V), 0.0);
+            float pdf = D * NdotH / (4.0 * HdotV) + 0.0001;
+
+            float saSample = 1.0 / (float(sampleCount) * pdf + 0.0001);
+
+            // one level above the footprint of the sample (GPU Gems 3, ch. 20) smooths over the gaps between the few samples
+            float mipLevel = roughness == 0.0 ? 0.0 : 0.5 * log2(saSample / saTexel) + 1.0;
+
+            prefilteredColor += textureLod(environmentMap, L, mipLevel).rgb * NdotL;
+            totalWeight      += NdotL;
+        }
+    }
+
+    prefilteredColor = prefilteredColor / totalWeight;
+
+    imageStore(prefilterMap, texel, vec4(prefilteredColor, 1.0));
+}
@@ -10,6 +10,8 @@
 #include <learnopengl/shader.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
+#include <learnopengl/bc6h.h>
+#include <learnopengl/ibl_cache.h>
 
 #include <iostream>
 
@@ -21,6 +23,13 @@ unsigned int loadTexture(const char *path);
 void renderSphere();
 void renderCube();
 void renderQuad();
+unsigned int loadHDRTexture(const std::string &path);
+IBLMaps precomputeIBLFragment(unsigned int hdrTexture, const IBLParameters &parameters, double *stageTimes);
+IBLMaps precomputeIBLCompute(unsigned int hdrTexture, const IBLParameters &parameters, double *stageTimes);
+void compareIBLMaps(const IBLMaps &fragment, const IBLMaps &compute, const IBLParameters &parameters);
+void printIBLStages(const char *name, double total, const double stageTimes[4]);
+void deleteIBLMaps(IBLMaps &maps);
+void stageDone(double *stageTimes, int stage, double &last);
 
 // settings
 const unsigned int SCR_WIDTH = 1280;
@@ -36,8 +45,27 @@ bool firstMouse = true;
 float deltaTime = 0.0f;	
 float lastFrame = 0.0f;
 
-int main()
+int main(int argc, char *argv[])
 {
+    // --bc6h stores the IBL cubemaps block compressed, --no-ibl-cache precomputes the IBL maps even if they're cached,
+    // --fragment-ibl precomputes them with the fragment passes instead of compute shaders and --compare-ibl runs both
+    // (never from the cache), times them and prints how far apart their maps are
+    bool bc6h = false;
+    bool useIBLCache = true;
+    bool computeIBL = true;
+    bool compareIBL = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::string(argv[i]) == "--bc6h")
+            bc6h = true;
+        else if (std::string(argv[i]) == "--no-ibl-cache")
+            useIBLCache = false;
+        else if (std::string(argv[i]) == "--fragment-ibl")
+            computeIBL = false;
+        else if (std::string(argv[i]) == "--compare-ibl")
+            compareIBL = true;
+    }
+
     // glfw: initialize and configure
     // ------------------------------
     glfwInit();
@@ -74,6 +102,8 @@ int main()
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    // shaders built in a batch below are compiled by the driver on as many threads as it likes, where it can
+    ShaderCompiler::Get().EnableParallelCompile((GLADloadproc)glfwGetProcAddress);
 
     // configure global opengl state
     // -----------------------------
@@ -85,25 +115,13 @@ int main()
 
     // build and compile shaders
     // -------------------------
+    // submitted together; each program is only checked when it's first used (see ShaderCompiler)
+    ShaderCompiler::Get().BeginBatch();
     Shader pbrShader("2.2.2.pbr.vs", "2.2.2.pbr.fs");
-    Shader equirectangularToCubemapShader("2.2.2.cubemap.vs", "2.2.2.equirectangular_to_cubemap.fs");
-    Shader irradianceShader("2.2.2.cubemap.vs", "2.2.2.irradiance_convolution.fs");
-    Shader prefilterShader("2.2.2.cubemap.vs", "2.2.2.prefilter.fs");
-    Shader brdfShader("2.2.2.brdf.vs", "2.2.2.brdf.fs");
     Shader backgroundShader("2.2.2.background.vs", "2.2.2.background.fs");
-
-    pbrShader.use();
-    pbrShader.setInt("irradianceMap", 0);
-    pbrShader.setInt("prefilterMap", 1);
-    pbrShader.setInt("brdfLUT", 2);
-    pbrShader.setInt("albedoMap", 3);
-    pbrShader.setInt("normalMap", 4);
-    pbrShader.setInt("metallicMap", 5);
-    pbrShader.setInt("roughnessMap", 6);
-    pbrShader.setInt("aoMap", 7);
-
-    backgroundShader.use();
-    backgroundShader.setInt("environmentMap", 0);
+    ShaderCompiler::Get().EndBatch();
+    // the programs of the batch are first used down in "initialize static shader uniforms", so the driver compiles
+    // them while the textures are loaded
 
     // load PBR material textures
     // --------------------------
@@ -141,6 +159,9 @@ int main()
     unsigned int wallMetallicMap = loadTexture(FileSystem::getPath("resources/textures/pbr/wall/metallic.png").c_str());
     unsigned int wallRoughnessMap = loadTexture(FileSystem::getPath("resources/textures/pbr/wall/roughness.png").c_str());
     unsigned int wallAOMap = loadTexture(FileSystem::getPath("resources/textures/pbr/wall/ao.png").c_str());
+    TextureUploadQueue::Get().Flush(); // the textures only queued their pixels, send them over before the first frame
+    // check the programs the driver has finished meanwhile, without waiting for the others
+    ShaderCompiler::Get().Poll();
 
     // lights
     // ------
@@ -160,216 +181,114 @@ int main()
     int nrColumns = 7;
     float spacing = 2.5;
 
-    // pbr: setup framebuffer
-    // ----------------------
-    unsigned int captureFBO;
-    unsigned int captureRBO;
-    glGenFramebuffers(1, &captureFBO);
-    glGenRenderbuffers(1, &captureRBO);
-
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-    glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 512, 512);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, captureRBO);
-
-    // pbr: load the HDR environment map
-    // ---------------------------------
-    stbi_set_flip_vertically_on_load(true);
-    int width, height, nrComponents;
-    float *data = stbi_loadf(FileSystem::getPath("resources/textures/hdr/newport_loft.hdr").c_str(), &width, &height, &nrComponents, 0);
-    unsigned int hdrTexture;
-    if (data)
-    {
-        glGenTextures(1, &hdrTexture);
-        glBindTexture(GL_TEXTURE_2D, hdrTexture);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_FLOAT, data); // note how we specify the texture's data value to be float
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Failed to load HDR image." << std::endl;
-    }
-
-    // pbr: setup cubemap to render to and attach to framebuffer
-    // ---------------------------------------------------------
-    unsigned int envCubemap;
-    glGenTextures(1, &envCubemap);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
-    for (unsigned int i = 0; i < 6; ++i)
-    {
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 512, 512, 0, GL_RGB, GL_FLOAT, nullptr);
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR); // enable pre-filter mipmap sampling (combatting visible dots artifact)
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    // pbr: set up projection and view matrices for capturing data onto the 6 cubemap face directions
-    // ----------------------------------------------------------------------------------------------
-    glm::mat4 captureProjection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
-    glm::mat4 captureViews[] =
-    {
-        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3( 1.0f,  0.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
-        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(-1.0f,  0.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
-        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3( 0.0f,  1.0f,  0.0f), glm::vec3(0.0f,  0.0f,  1.0f)),
-        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3( 0.0f, -1.0f,  0.0f), glm::vec3(0.0f,  0.0f, -1.0f)),
-        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3( 0.0f,  0.0f,  1.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
-        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3( 0.0f,  0.0f, -1.0f), glm::vec3(0.0f, -1.0f,  0.0f))
+    // pbr: the IBL maps below are precomputed from the HDR environment map once and then reloaded from a cache file next
+    // to it (see IBLCache). The cache is keyed on the HDR file, the map sizes and the precompute shaders, so changing
+    // any of them precomputes the maps again. They're precomputed with compute shaders where there are any (GL 4.3).
+    // ----------------------------------------------------------------------------------------------------------------
+    std::string hdrPath = FileSystem::getPath("resources/textures/hdr/newport_loft.hdr");
+    const std::string fragmentShaders[] = {
+        "2.2.2.cubemap.vs", "2.2.2.equirectangular_to_cubemap.fs", "2.2.2.irradiance_convolution.fs", "2.2.2.prefilter.fs", "2.2.2.brdf.vs", "2.2.2.brdf.fs"
     };
-
-    // pbr: convert HDR equirectangular environment map to cubemap equivalent
-    // ----------------------------------------------------------------------
-    equirectangularToCubemapShader.use();
-    equirectangularToCubemapShader.setInt("equirectangularMap", 0);
-    equirectangularToCubemapShader.setMat4("projection", captureProjection);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, hdrTexture);
-
-    glViewport(0, 0, 512, 512); // don't forget to configure the viewport to the capture dimensions.
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-    for (unsigned int i = 0; i < 6; ++i)
-    {
-        equirectangularToCubemapShader.setMat4("view", captureViews[i]);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, envCubemap, 0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        renderCube();
-    }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    // then let OpenGL generate mipmaps from first mip face (combatting visible dots artifact)
-    glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
-    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
-
-    // pbr: create an irradiance cubemap, and re-scale capture FBO to irradiance scale.
-    // --------------------------------------------------------------------------------
-    unsigned int irradianceMap;
-    glGenTextures(1, &irradianceMap);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
-    for (unsigned int i = 0; i < 6; ++i)
-    {
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 32, 32, 0, GL_RGB, GL_FLOAT, nullptr);
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-    glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 32, 32);
-
-    // pbr: solve diffuse integral by convolution to create an irradiance (cube)map.
-    // -----------------------------------------------------------------------------
-    irradianceShader.use();
-    irradianceShader.setInt("environmentMap", 0);
-    irradianceShader.setMat4("projection", captureProjection);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
-
-    glViewport(0, 0, 32, 32); // don't forget to configure the viewport to the capture dimensions.
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-    for (unsigned int i = 0; i < 6; ++i)
+    const std::string computeShaders[] = {
+        "2.2.2.equirectangular_to_cubemap.cs", "2.2.2.irradiance_convolution.cs", "2.2.2.prefilter.cs", "2.2.2.brdf.cs"
+    };
+    if ((computeIBL || compareIBL) && !GLAD_GL_VERSION_4_3)
     {
-        irradianceShader.setMat4("view", captureViews[i]);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, irradianceMap, 0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        renderCube();
+        std::cout << "WARNING::IBL:: compute shaders need OpenGL 4.3, precomputing the IBL maps with fragment passes" << std::endl;
+        computeIBL = compareIBL = false;
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    // pbr: create a pre-filter cubemap, and re-scale capture FBO to pre-filter scale.
-    // --------------------------------------------------------------------------------
-    unsigned int prefilterMap;
-    glGenTextures(1, &prefilterMap);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap);
-    for (unsigned int i = 0; i < 6; ++i)
+    std::vector<std::string> precomputeShaders = computeIBL ? std::vector<std::string>(computeShaders, computeShaders + 4)
+                                                            : std::vector<std::string>(fragmentShaders, fragmentShaders + 6);
+    std::string iblCachePath = IBLCache::CachePath(hdrPath, precomputeShaders);
+    IBLParameters iblParameters;
+    uint64_t iblKey = useIBLCache && !compareIBL ? IBLCache::Key(hdrPath, iblParameters, precomputeShaders) : 0;
+    double iblStart = glfwGetTime();
+    IBLMaps iblMaps;
+    bool iblCached = IBLCache::Load(iblCachePath, iblKey, iblParameters, iblMaps);
+    double iblPrecomputed = glfwGetTime();
+    if (!iblCached)
     {
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 128, 128, 0, GL_RGB, GL_FLOAT, nullptr);
+        unsigned int hdrTexture = loadHDRTexture(hdrPath);
+        if (compareIBL)
+        {
+            // pbr: time both ways of precomputing the maps against each other and check how far apart their maps are;
+            // the compute shaders' maps are the ones that are kept
+            // -----------------------------------------------------------------------------------------------------------
+            double fragmentStages[4], computeStages[4];
+            double start = glfwGetTime();
+            IBLMaps fragmentMaps = precomputeIBLFragment(hdrTexture, iblParameters, fragmentStages);
+            double fragmentDone = glfwGetTime();
+            iblMaps = precomputeIBLCompute(hdrTexture, iblParameters, computeStages);
+            double computeDone = glfwGetTime();
+            printIBLStages("fragment passes", 1000.0 * (fragmentDone - start), fragmentStages);
+            printIBLStages("compute shaders", 1000.0 * (computeDone - fragmentDone), computeStages);
+            compareIBLMaps(fragmentMaps, iblMaps, iblParameters);
+            deleteIBLMaps(fragmentMaps);
+        }
+        else if (computeIBL)
+            iblMaps = precomputeIBLCompute(hdrTexture, iblParameters, nullptr);
+        else
+            iblMaps = precomputeIBLFragment(hdrTexture, iblParameters, nullptr);
+        glDeleteTextures(1, &hdrTexture);
+
+        // pbr: read the maps back and store them for the next run. The read back waits for the precompute to finish.
+        // -----------------------------------------------------------------------------------------------------------
+        glFinish();
+        iblPrecomputed = glfwGetTime();
+        IBLCache::Store(iblCachePath, iblKey, iblParameters, iblMaps);
     }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR); // be sure to set minifcation filter to mip_linear 
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    // generate mipmaps for the cubemap so OpenGL automatically allocates the required memory.
-    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
-
-    // pbr: run a quasi monte-carlo simulation on the environment lighting to create a prefilter (cube)map.
-    // ----------------------------------------------------------------------------------------------------
-    prefilterShader.use();
-    prefilterShader.setInt("environmentMap", 0);
-    prefilterShader.setMat4("projection", captureProjection);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
-
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-    unsigned int maxMipLevels = 5;
-    for (unsigned int mip = 0; mip < maxMipLevels; ++mip)
+    double iblDone = glfwGetTime();
+    if (iblCached)
+        std::cout << "IBL:: maps loaded from " << iblCachePath << " in " << 1000.0 * (iblDone - iblStart) << " ms" << std::endl;
+    else
+        std::cout << "IBL:: maps precomputed with " << (compareIBL ? "both fragment passes and compute shaders" : computeIBL ? "compute shaders" : "fragment passes") << " in " << 1000.0 * (iblPrecomputed - iblStart) << " ms, "
+                  << (iblKey ? "read back and stored in " + std::to_string(1000.0 * (iblDone - iblPrecomputed)) + " ms" : "not cached") << std::endl;
+    unsigned int envCubemap = iblMaps.environment;
+    unsigned int irradianceMap = iblMaps.irradiance;
+    unsigned int prefilterMap = iblMaps.prefilter;
+    unsigned int brdfLUTTexture = iblMaps.brdfLUT;
+    unsigned int maxMipLevels = iblParameters.prefilterLevels;
+
+    // pbr: optionally store the environment and the IBL cubemaps as BC6H (--bc6h). They're compressed on the CPU
+    // after all the precomputation ran on the float versions, which are then released.
+    // ------------------------------------------------------------------------------------------------------------
+    if (bc6h)
     {
-        // reisze framebuffer according to mip-level size.
-        unsigned int mipWidth = 128 * std::pow(0.5, mip);
-        unsigned int mipHeight = 128 * std::pow(0.5, mip);
-        glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, mipWidth, mipHeight);
-        glViewport(0, 0, mipWidth, mipHeight);
-
-        float roughness = (float)mip / (float)(maxMipLevels - 1);
-        prefilterShader.setFloat("roughness", roughness);
-        for (unsigned int i = 0; i < 6; ++i)
+        if (BC6HSupported())
         {
-            prefilterShader.setMat4("view", captureViews[i]);
-            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, prefilterMap, mip);
-
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-            renderCube();
+            unsigned int envLevels = iblParameters.environmentLevels();
+            unsigned int compressed[3] = {
+                CompressCubemapBC6H(envCubemap, iblParameters.environmentSize, envLevels, "environment"),
+                CompressCubemapBC6H(irradianceMap, iblParameters.irradianceSize, 1, "irradiance"),
+                CompressCubemapBC6H(prefilterMap, iblParameters.prefilterSize, maxMipLevels, "prefilter")
+            };
+            glDeleteTextures(1, &envCubemap);
+            glDeleteTextures(1, &irradianceMap);
+            glDeleteTextures(1, &prefilterMap);
+            envCubemap = compressed[0];
+            irradianceMap = compressed[1];
+            prefilterMap = compressed[2];
         }
+        else
+            std::cout << "ERROR::IBL:: BC6H needs OpenGL 4.2 or ARB_texture_compression_bptc, keeping the float cubemaps" << std::endl;
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    // pbr: generate a 2D LUT from the BRDF equations used.
-    // ----------------------------------------------------
-    unsigned int brdfLUTTexture;
-    glGenTextures(1, &brdfLUTTexture);
-
-    // pre-allocate enough memory for the LUT texture.
-    glBindTexture(GL_TEXTURE_2D, brdfLUTTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, 512, 512, 0, GL_RG, GL_FLOAT, 0);
-    // be sure to set wrapping mode to GL_CLAMP_TO_EDGE
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    // then re-configure capture framebuffer object and render screen-space quad with BRDF shader.
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-    glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 512, 512);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, brdfLUTTexture, 0);
-
-    glViewport(0, 0, 512, 512);
-    brdfShader.use();
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    renderQuad();
-
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
 
     // initialize static shader uniforms before rendering
     // --------------------------------------------------
     glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
     pbrShader.use();
+    pbrShader.setInt("irradianceMap", 0);
+    pbrShader.setInt("prefilterMap", 1);
+    pbrShader.setInt("brdfLUT", 2);
+    pbrShader.setInt("albedoMap", 3);
+    pbrShader.setInt("normalMap", 4);
+    pbrShader.setInt("metallicMap", 5);
+    pbrShader.setInt("roughnessMap", 6);
+    pbrShader.setInt("aoMap", 7);
     pbrShader.setMat4("projection", projection);
     backgroundShader.use();
+    backgroundShader.setInt("environmentMap", 0);
     backgroundShader.setMat4("projection", projection);
 
     // then before rendering, configure the viewport to the original framebuffer's screen dimensions
@@ -379,6 +298,7 @@ int main()
 
     // render loop
     // -----------
+    bool firstFrame = true;
     while (!glfwWindowShouldClose(window))
     {
         // per-frame time logic
@@ -533,6 +453,15 @@ int main()
         // -------------------------------------------------------------------------------
         glfwSwapBuffers(window);
         glfwPollEvents();
+
+        // time from start up until the first frame is done, with and without the IBL maps coming from the cache
+        if (firstFrame)
+        {
+            glFinish();
+            std::cout << "STARTUP:: first frame after " << 1000.0 * glfwGetTime() << " ms (IBL maps "
+                      << (iblCached ? "loaded from cache" : "precomputed") << ")" << std::endl;
+            firstFrame = false;
+        }
     }
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
@@ -803,37 +732,440 @@ void renderQuad()
 // ---------------------------------------------------
 unsigned int loadTexture(char const * path)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
+    return TextureCache::Get().Acquire(path);
+}
 
+// loads the HDR environment map the IBL maps are precomputed from
+// -----------------------------------------------------------------
+unsigned int loadHDRTexture(const std::string &path)
+{
+    stbi_set_flip_vertically_on_load(true);
+    unsigned int hdrTexture = 0;
     int width, height, nrComponents;
-    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
+    float *data = LoadHDRImage(path, &width, &height, &nrComponents);
     if (data)
     {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glGenTextures(1, &hdrTexture);
+        glBindTexture(GL_TEXTURE_2D, hdrTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_FLOAT, data); // note how we specify the texture's data value to be float
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
         stbi_image_free(data);
     }
     else
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        std::cout << "Failed to load HDR image." << std::endl;
     }
+    return hdrTexture;
+}
+
+// pbr: precomputes the IBL maps with fragment passes, six renders of a cube per cubemap level. With 'stageTimes', the
+// environment, irradiance, prefilter and BRDF stages are each finished and timed, in ms.
+// --------------------------------------------------------------------------------------------------------------------
+IBLMaps precomputeIBLFragment(unsigned int hdrTexture, const IBLParameters &parameters, double *stageTimes)
+{
+    // submitted together, see above
+    ShaderCompiler::Get().BeginBatch();
+    Shader equirectangularToCubemapShader("2.2.2.cubemap.vs", "2.2.2.equirectangular_to_cubemap.fs");
+    Shader irradianceShader("2.2.2.cubemap.vs", "2.2.2.irradiance_convolution.fs");
+    Shader prefilterShader("2.2.2.cubemap.vs", "2.2.2.prefilter.fs");
+    Shader brdfShader("2.2.2.brdf.vs", "2.2.2.brdf.fs");
+    ShaderCompiler::Get().EndBatch();
+    // timed stages shouldn't include waiting for their shaders
+    if (stageTimes)
+        ShaderCompiler::Get().Finish();
+
+    unsigned int envCubemap, irradianceMap, prefilterMap, brdfLUTTexture;
+    unsigned int maxMipLevels = parameters.prefilterLevels;
+    double last = glfwGetTime();
+
+    // pbr: setup framebuffer
+    // ----------------------
+    unsigned int captureFBO;
+    unsigned int captureRBO;
+    glGenFramebuffers(1, &captureFBO);
+    glGenRenderbuffers(1, &captureRBO);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+    glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, parameters.environmentSize, parameters.environmentSize);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, captureRBO);
+
+    // pbr: setup cubemap to render to and attach to framebuffer
+    // ---------------------------------------------------------
+    glGenTextures(1, &envCubemap);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+    for (unsigned int i = 0; i < 6; ++i)
+    {
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, parameters.environmentSize, parameters.environmentSize, 0, GL_RGB, GL_FLOAT, nullptr);
+    }
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR); // enable pre-filter mipmap sampling (combatting visible dots artifact)
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    // pbr: set up projection and view matrices for capturing data onto the 6 cubemap face directions
+    // ----------------------------------------------------------------------------------------------
+    glm::mat4 captureProjection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
+    glm::mat4 captureViews[] =
+    {
+        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3( 1.0f,  0.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
+        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(-1.0f,  0.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
+        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3( 0.0f,  1.0f,  0.0f), glm::vec3(0.0f,  0.0f,  1.0f)),
+        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3( 0.0f, -1.0f,  0.0f), glm::vec3(0.0f,  0.0f, -1.0f)),
+        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3( 0.0f,  0.0f,  1.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
+        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3( 0.0f,  0.0f, -1.0f), glm::vec3(0.0f, -1.0f,  0.0f))
+    };
+
+    // pbr: convert HDR equirectangular environment map to cubemap equivalent
+    // ----------------------------------------------------------------------
+    equirectangularToCubemapShader.use();
+    equirectangularToCubemapShader.setInt("equirectangularMap", 0);
+    equirectangularToCubemapShader.setMat4("projection", captureProjection);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, hdrTexture);
+
+    glViewport(0, 0, parameters.environmentSize, parameters.environmentSize); // don't forget to configure the viewport to the capture dimensions.
+    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+    for (unsigned int i = 0; i < 6; ++i)
+    {
+        equirectangularToCubemapShader.setMat4("view", captureViews[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, envCubemap, 0);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        renderCube();
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // then let OpenGL generate mipmaps from first mip face (combatting visible dots artifact)
+    glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+    stageDone(stageTimes, 0, last);
+
+    // pbr: create an irradiance cubemap, and re-scale capture FBO to irradiance scale.
+    // --------------------------------------------------------------------------------
+    glGenTextures(1, &irradianceMap);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
+    for (unsigned int i = 0; i < 6; ++i)
+    {
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, parameters.irradianceSize, parameters.irradianceSize, 0, GL_RGB, GL_FLOAT, nullptr);
+    }
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    return textureID;
+    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+    glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, parameters.irradianceSize, parameters.irradianceSize);
+
+    // pbr: solve diffuse integral by convolution to create an irradiance (cube)map.
+    // -----------------------------------------------------------------------------
+    irradianceShader.use();
+    irradianceShader.setInt("environmentMap", 0);
+    irradianceShader.setMat4("projection", captureProjection);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+
+    glViewport(0, 0, parameters.irradianceSize, parameters.irradianceSize); // don't forget to configure the viewport to the capture dimensions.
+    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+    for (unsigned int i = 0; i < 6; ++i)
+    {
+        irradianceShader.setMat4("view", captureViews[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, irradianceMap, 0);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        renderCube();
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    stageDone(stageTimes, 1, last);
+
+    // pbr: create a pre-filter cubemap, and re-scale capture FBO to pre-filter scale.
+    // --------------------------------------------------------------------------------
+    glGenTextures(1, &prefilterMap);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap);
+    for (unsigned int i = 0; i < 6; ++i)
+    {
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, parameters.prefilterSize, parameters.prefilterSize, 0, GL_RGB, GL_FLOAT, nullptr);
+    }
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR); // be sure to set minifcation filter to mip_linear 
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // generate mipmaps for the cubemap so OpenGL automatically allocates the required memory.
+    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+
+    // pbr: run a quasi monte-carlo simulation on the environment lighting to create a prefilter (cube)map.
+    // ----------------------------------------------------------------------------------------------------
+    prefilterShader.use();
+    prefilterShader.setInt("environmentMap", 0);
+    prefilterShader.setMat4("projection", captureProjection);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+    for (unsigned int mip = 0; mip < maxMipLevels; ++mip)
+    {
+        // reisze framebuffer according to mip-level size.
+        unsigned int mipWidth = parameters.prefilterSize * std::pow(0.5, mip);
+        unsigned int mipHeight = parameters.prefilterSize * std::pow(0.5, mip);
+        glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, mipWidth, mipHeight);
+        glViewport(0, 0, mipWidth, mipHeight);
+
+        float roughness = (float)mip / (float)(maxMipLevels - 1);
+        prefilterShader.setFloat("roughness", roughness);
+        for (unsigned int i = 0; i < 6; ++i)
+        {
+            prefilterShader.setMat4("view", captureViews[i]);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, prefilterMap, mip);
+
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            renderCube();
+        }
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    stageDone(stageTimes, 2, last);
+
+    // pbr: generate a 2D LUT from the BRDF equations used.
+    // ----------------------------------------------------
+    glGenTextures(1, &brdfLUTTexture);
+
+    // pre-allocate enough memory for the LUT texture.
+    glBindTexture(GL_TEXTURE_2D, brdfLUTTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, parameters.brdfSize, parameters.brdfSize, 0, GL_RG, GL_FLOAT, 0);
+    // be sure to set wrapping mode to GL_CLAMP_TO_EDGE
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    // then re-configure capture framebuffer object and render screen-space quad with BRDF shader.
+    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+    glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, parameters.brdfSize, parameters.brdfSize);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, brdfLUTTexture, 0);
+
+    glViewport(0, 0, parameters.brdfSize, parameters.brdfSize);
+    brdfShader.use();
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    renderQuad();
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    stageDone(stageTimes, 3, last);
+
+    glDeleteFramebuffers(1, &captureFBO);
+    glDeleteRenderbuffers(1, &captureRBO);
+    ShaderPermutations::Get().Release(equirectangularToCubemapShader.ID);
+    ShaderPermutations::Get().Release(irradianceShader.ID);
+    ShaderPermutations::Get().Release(prefilterShader.ID);
+    ShaderPermutations::Get().Release(brdfShader.ID);
+
+    IBLMaps maps;
+    maps.environment = envCubemap;
+    maps.irradiance = irradianceMap;
+    maps.prefilter = prefilterMap;
+    maps.brdfLUT = brdfLUTTexture;
+    return maps;
+}
+
+// pbr: precomputes the IBL maps with compute shaders, each cubemap level in a single dispatch over all six faces. The
+// prefilter picks the environment level of every sample from its pdf and gets by with parameters.prefilterSamples
+// samples per texel. With 'stageTimes', the stages are each finished and timed like in precomputeIBLFragment.
+// --------------------------------------------------------------------------------------------------------------------
+IBLMaps precomputeIBLCompute(unsigned int hdrTexture, const IBLParameters &parameters, double *stageTimes)
+{
+    const int groupSize = 8;
+    std::vector<std::string> definitions;
+    definitions.push_back("#version 430 core");
+    definitions.push_back("#define GROUP_SIZE " + std::to_string(groupSize));
+    // submitted together, see above
+    ShaderCompiler::Get().BeginBatch();
+    Shader equirectangularToCubemapShader("2.2.2.equirectangular_to_cubemap.cs", definitions);
+    Shader irradianceShader("2.2.2.irradiance_convolution.cs", definitions);
+    Shader prefilterShader("2.2.2.prefilter.cs", definitions);
+    Shader brdfShader("2.2.2.brdf.cs", definitions);
+    ShaderCompiler::Get().EndBatch();
+    // timed stages shouldn't include waiting for their shaders
+    if (stageTimes)
+        ShaderCompiler::Get().Finish();
+    double last = glfwGetTime();
+
+    // image load/store has no three channel formats, so the cubemaps are RGBA16F here
+    IBLMaps maps;
+    unsigned int *cubemaps[3] = { &maps.environment, &maps.irradiance, &maps.prefilter };
+    int sizes[3] = { parameters.environmentSize, parameters.irradianceSize, parameters.prefilterSize };
+    int levels[3] = { parameters.environmentLevels(), 1, parameters.prefilterLevels };
+    for (unsigned int i = 0; i < 3; ++i)
+    {
+        glGenTextures(1, cubemaps[i]);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, *cubemaps[i]);
+        glTexStorage2D(GL_TEXTURE_CUBE_MAP, levels[i], GL_RGBA16F, sizes[i], sizes[i]);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, levels[i] > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+
+    // pbr: convert the equirectangular map to all faces of the cubemap at once, then build its mip chain
+    // ---------------------------------------------------------------------------------------------------
+    equirectangularToCubemapShader.use();
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, hdrTexture);
+    glBindImageTexture(0, maps.environment, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+    int groups = (parameters.environmentSize + groupSize - 1) / groupSize;
+    glDispatchCompute(groups, groups, 6);
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, maps.environment);
+    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+    stageDone(stageTimes, 0, last);
+
+    // pbr: irradiance convolution. The fragment pass samples the environment through its derivatives, which pick the
+    // level whose texels are as large as the irradiance map's; compute shaders have none, so that level is given.
+    // ---------------------------------------------------------------------------------------------------------------
+    irradianceShader.use();
+    irradianceShader.setFloat("sourceLevel", std::log2((float)parameters.environmentSize / parameters.irradianceSize));
+    glBindTexture(GL_TEXTURE_CUBE_MAP, maps.environment);
+    glBindImageTexture(0, maps.irradiance, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+    groups = (parameters.irradianceSize + groupSize - 1) / groupSize;
+    glDispatchCompute(groups, groups, 6);
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+    stageDone(stageTimes, 1, last);
+
+    // pbr: prefilter, one dispatch per roughness level
+    // ------------------------------------------------
+    prefilterShader.use();
+    prefilterShader.setFloat("sourceResolution", (float)parameters.environmentSize);
+    for (int mip = 0; mip < parameters.prefilterLevels; ++mip)
+    {
+        float roughness = (float)mip / (float)(parameters.prefilterLevels - 1);
+        prefilterShader.setFloat("roughness", roughness);
+        // without roughness every sample is the mirror direction, so one does
+        prefilterShader.setInt("sampleCount", mip == 0 ? 1 : parameters.prefilterSamples);
+        glBindImageTexture(0, maps.prefilter, mip, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+        int mipSize = std::max(1, parameters.prefilterSize >> mip);
+        groups = (mipSize + groupSize - 1) / groupSize;
+        glDispatchCompute(groups, groups, 6);
+    }
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+    stageDone(stageTimes, 2, last);
+
+    // pbr: BRDF lookup table
+    // ----------------------
+    glGenTextures(1, &maps.brdfLUT);
+    glBindTexture(GL_TEXTURE_2D, maps.brdfLUT);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RG16F, parameters.brdfSize, parameters.brdfSize);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    brdfShader.use();
+    glBindImageTexture(0, maps.brdfLUT, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG16F);
+    groups = (parameters.brdfSize + groupSize - 1) / groupSize;
+    glDispatchCompute(groups, groups, 1);
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+    stageDone(stageTimes, 3, last);
+
+    glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+    ShaderPermutations::Get().Release(equirectangularToCubemapShader.ID);
+    ShaderPermutations::Get().Release(irradianceShader.ID);
+    ShaderPermutations::Get().Release(prefilterShader.ID);
+    ShaderPermutations::Get().Release(brdfShader.ID);
+    return maps;
+}
+
+// finishes a precompute stage and stores the time it took since 'last', if the stages are timed
+// ----------------------------------------------------------------------------------------------
+void stageDone(double *stageTimes, int stage, double &last)
+{
+    if (!stageTimes)
+        return;
+    glFinish();
+    double now = glfwGetTime();
+    stageTimes[stage] = 1000.0 * (now - last);
+    last = now;
+}
+
+void printIBLStages(const char *name, double total, const double stageTimes[4])
+{
+    std::cout << "IBL::COMPARE:: " << name << ": " << total << " ms with compiling the shaders; environment " << stageTimes[0]
+              << " ms, irradiance " << stageTimes[1] << " ms, prefilter " << stageTimes[2] << " ms, BRDF LUT " << stageTimes[3] << " ms" << std::endl;
+}
+
+// the difference between two levels of a map read back as floats: the root mean square and the largest difference of
+// log2(b / a), in stops like the BC6H error (values below 1e-3 are clamped to it first, so near black noise doesn't
+// dominate), for the HDR cubemaps, or of b - a for the BRDF LUT
+// ---------------------------------------------------------------------------------------------------------------------
+void printLevelDifference(const std::string &name, const std::vector<float> &a, const std::vector<float> &b, bool stops)
+{
+    double sum = 0.0, largest = 0.0;
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        double difference = stops ? std::log2(std::max(b[i], 1e-3f) / std::max(a[i], 1e-3f)) : b[i] - a[i];
+        sum += difference * difference;
+        largest = std::max(largest, std::abs(difference));
+    }
+    std::cout << "IBL::COMPARE:: " << name << ": rms " << std::sqrt(sum / a.size()) << (stops ? " stops" : "") << ", largest "
+              << largest << (stops ? " stops" : "") << std::endl;
+}
+
+// pbr: reads back the maps of both precompute paths and prints how far apart they are, level by level
+// ---------------------------------------------------------------------------------------------------
+void compareIBLMaps(const IBLMaps &fragment, const IBLMaps &compute, const IBLParameters &parameters)
+{
+    const unsigned int cubemaps[3][2] = {
+        { fragment.environment, compute.environment }, { fragment.irradiance, compute.irradiance }, { fragment.prefilter, compute.prefilter }
+    };
+    const char *names[3] = { "environment", "irradiance", "prefilter" };
+    // the environment's smaller levels are generated from the first by the driver in both paths
+    int sizes[3] = { parameters.environmentSize, parameters.irradianceSize, parameters.prefilterSize };
+    int levels[3] = { 1, 1, parameters.prefilterLevels };
+    std::vector<float> pixels[2];
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    for (unsigned int i = 0; i < 3; ++i)
+    {
+        for (int level = 0; level < levels[i]; ++level)
+        {
+            int size = std::max(1, sizes[i] >> level);
+            size_t faceValues = (size_t)size * size * 3;
+            for (unsigned int j = 0; j < 2; ++j)
+            {
+                pixels[j].resize(faceValues * 6);
+                glBindTexture(GL_TEXTURE_CUBE_MAP, cubemaps[i][j]);
+                for (unsigned int face = 0; face < 6; ++face)
+                    glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, GL_RGB, GL_FLOAT, &pixels[j][face * faceValues]);
+            }
+            std::string name = names[i];
+            if (levels[i] > 1)
+                name += " level " + std::to_string(level) + " (roughness " + std::to_string((float)level / (levels[i] - 1)) + ")";
+            printLevelDifference(name, pixels[0], pixels[1], true);
+        }
+    }
+
+    const unsigned int luts[2] = { fragment.brdfLUT, compute.brdfLUT };
+    for (unsigned int j = 0; j < 2; ++j)
+    {
+        pixels[j].resize((size_t)parameters.brdfSize * parameters.brdfSize * 2);
+        glBindTexture(GL_TEXTURE_2D, luts[j]);
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RG, GL_FLOAT, pixels[j].data());
+    }
+    printLevelDifference("BRDF LUT", pixels[0], pixels[1], false);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+}
+
+void deleteIBLMaps(IBLMaps &maps)
+{
+    glDeleteTextures(1, &maps.environment);
+    glDeleteTextures(1, &maps.irradiance);
+    glDeleteTextures(1, &maps.prefilter);
+    glDeleteTextures(1, &maps.brdfLUT);
+    maps = IBLMaps();
 }
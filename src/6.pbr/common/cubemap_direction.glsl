@@ -0,0 +1,15 @@
+// The direction through the center of a texel of a cubemap face, following the face layout of the GL spec; texel.z is
+// the face. Shared by the compute shaders that write all six faces of a cubemap in one dispatch.
+vec3 CubemapDirection(ivec3 texel, int size)
+{
+    vec2 st = 2.0 * (vec2(texel.xy) + 0.5) / float(size) - 1.0;
+    vec3 directions[6] = vec3[](
+        vec3( 1.0, -st.y, -st.x),
+        vec3(-1.0, -st.y,  st.x),
+        vec3( st.x,  1.0,  st.y),
+        vec3( st.x, -1.0, -st.y),
+        vec3( st.x, -st.y,  1.0),
+        vec3(-st.x, -st.y, -1.0)
+    );
+    return normalize(directions[texel.z]);
+}
@@ -0,0 +1,7 @@
+// The tangent space normal of a normal map texel. Only x and y are read, as cooked (BC5) normal maps don't store z:
+// tangent space normals are unit length and point away from the surface, which gives z back.
+vec3 DecodeNormal(sampler2D normalMap, vec2 texCoords)
+{
+    vec2 normalXY = texture(normalMap, texCoords).rg * 2.0 - 1.0;
+    return normalize(vec3(normalXY, sqrt(max(1.0 - dot(normalXY, normalXY), 0.0))));
+}
@@ -0,0 +1,266 @@
+// load_benchmark: measures how fast the asset files of the resource tree are read and decoded, through the stdio and
+// stream paths the loaders used to take (stbi_load on a file name, ifstream into a stringstream) against the ones they
+// take now: images decoded straight out of a FileSystem::MappedFile with stbi_load_from_memory, text files read into
+// a string by FileSystem::readFile. Both with a cold and a warm page cache.
+//
+// usage: load_benchmark [--runs N] [directory...]
+// Without directories the resources/ tree and the shaders of src/ are measured. For a cold run every file is first
+// dropped from the page cache with posix_fadvise(POSIX_FADV_DONTNEED), which only works for files that aren't dirty;
+// the share of pages that were still resident afterwards (checked with mincore) is printed with the results. Warm runs
+// are repeated N times (3 by default) and the fastest one is kept. Cold runs aren't available on Windows.
+#include <stb_image.h>
+
+#include <learnopengl/filesystem.h>
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+#endif
+
+using namespace std;
+
+enum FileKind { FILE_IMAGE, FILE_HDR, FILE_TEXT, FILE_OTHER };
+
+struct File {
+    string path;
+    FileKind kind;
+    size_t size;
+};
+
+// one way of loading a file, returning the bytes it produced (decoded pixels or text) so nothing is optimized away
+struct Method {
+    const char *name;
+    size_t (*load)(const File &file);
+};
+
+FileKind fileKind(const string &path);
+size_t loadStdio(const File &file);
+size_t loadDirect(const File &file);
+size_t readStdio(const File &file);
+size_t readMapped(const File &file);
+bool dropFromPageCache(const vector<File> &files, double &residentAfter);
+double runMethod(const Method &method, const vector<File> &files, FileKind kind, size_t &bytes);
+
+int main(int argc, char *argv[])
+{
+    int runs = 3;
+    vector<string> directories;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc)
+            runs = max(1, atoi(argv[++i]));
+        else
+            directories.push_back(argv[i]);
+    }
+    if (directories.empty())
+    {
+        directories.push_back(FileSystem::getPath("resources"));
+        directories.push_back(FileSystem::getPath("src"));
+    }
+
+    vector<string> paths;
+    for (unsigned int i = 0; i < directories.size(); i++)
+        FileSystem::listFiles(directories[i], paths);
+    vector<File> files;
+    size_t totalBytes = 0;
+    for (unsigned int i = 0; i < paths.size(); i++)
+    {
+        File file;
+        file.path = paths[i];
+        file.kind = fileKind(paths[i]);
+        FileSystem::MappedFile mapping(paths[i], FileSystem::ACCESS_NORMAL, false);
+        file.size = mapping.size();
+        if (file.kind == FILE_OTHER || file.size == 0)
+            continue;
+        files.push_back(file);
+        totalBytes += file.size;
+    }
+    if (files.empty())
+    {
+        cout << "ERROR::LOAD_BENCHMARK:: no files to load" << endl;
+        return 1;
+    }
+    cout << "LOAD_BENCHMARK:: " << files.size() << " files, " << totalBytes / (1024.0 * 1024.0) << " MB" << endl;
+
+    // decoding hides much of the cost of reading, so every file is also just read: into a buffer through stdio, and
+    // out of a mapping the way a decoder reads it in place
+    const Method methods[] = { { "stdio", loadStdio }, { "direct", loadDirect } };
+    const Method readMethods[] = { { "stdio", readStdio }, { "mapped", readMapped } };
+    const char *kindNames[] = { "images", "hdr", "text", "all files, read only" };
+    for (int kind = FILE_IMAGE; kind <= FILE_OTHER; kind++)
+    {
+        size_t fileBytes = 0;
+        unsigned int count = 0;
+        for (unsigned int i = 0; i < files.size(); i++)
+        {
+            if (files[i].kind == kind || kind == FILE_OTHER)
+            {
+                fileBytes += files[i].size;
+                count++;
+            }
+        }
+        if (count == 0)
+            continue;
+        cout << "LOAD_BENCHMARK:: " << kindNames[kind] << ": " << count << " files, " << fileBytes / (1024.0 * 1024.0) << " MB" << endl;
+        for (unsigned int m = 0; m < sizeof(methods) / sizeof(methods[0]); m++)
+        {
+            const Method &method = kind == FILE_OTHER ? readMethods[m] : methods[m];
+            size_t bytes = 0;
+            double resident = 0.0;
+            if (dropFromPageCache(files, resident))
+            {
+                double cold = runMethod(method, files, (FileKind)kind, bytes);
+                cout << "LOAD_BENCHMARK::   " << method.name << ", cold: " << cold << " ms, " << fileBytes / 1e3 / cold << " MB/s read ("
+                     << 100.0 * resident << "% still cached after dropping)" << endl;
+            }
+            double warm = 0.0;
+            for (int run = 0; run < runs; run++)
+            {
+                double time = runMethod(method, files, (FileKind)kind, bytes);
+                warm = run == 0 ? time : min(warm, time);
+            }
+            cout << "LOAD_BENCHMARK::   " << method.name << ", warm: " << warm << " ms, " << fileBytes / 1e3 / warm << " MB/s read, "
+                 << bytes / (1024.0 * 1024.0) << " MB out" << endl;
+        }
+    }
+    return 0;
+}
+
+FileKind fileKind(const string &path)
+{
+    size_t dot = path.find_last_of('.');
+    if (dot == string::npos)
+        return FILE_OTHER;
+    string extension = path.substr(dot + 1);
+    transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    if (extension == "png" || extension == "jpg" || extension == "jpeg" || extension == "tga" || extension == "bmp")
+        return FILE_IMAGE;
+    if (extension == "hdr")
+        return FILE_HDR;
+    const char *text[] = { "obj", "mtl", "vs", "fs", "gs", "cs", "tcs", "tes", "vert", "frag", "geom", "comp", "tesc", "tese" };
+    for (unsigned int i = 0; i < sizeof(text) / sizeof(text[0]); i++)
+    {
+        if (extension == text[i])
+            return FILE_TEXT;
+    }
+    return FILE_OTHER;
+}
+
+// the old paths: stb_image's stdio callbacks, and the ifstream/stringstream copy the shader classes made
+size_t loadStdio(const File &file)
+{
+    int width = 0, height = 0, channels = 0;
+    if (file.kind == FILE_IMAGE || file.kind == FILE_HDR)
+    {
+        void *pixels = file.kind == FILE_HDR ? (void*)stbi_loadf(file.path.c_str(), &width, &height, &channels, 0)
+                                             : (void*)stbi_load(file.path.c_str(), &width, &height, &channels, 0);
+        stbi_image_free(pixels);
+        return pixels ? (size_t)width * height * channels * (file.kind == FILE_HDR ? sizeof(float) : 1) : 0;
+    }
+    ifstream stream(file.path.c_str());
+    stringstream contents;
+    contents << stream.rdbuf();
+    return contents.str().size();
+}
+
+// the new ones: images straight out of a mapping of the file, text with a single read
+size_t loadDirect(const File &file)
+{
+    int width = 0, height = 0, channels = 0;
+    if (file.kind == FILE_IMAGE || file.kind == FILE_HDR)
+    {
+        FileSystem::MappedFile mapping(file.path);
+        if (!mapping.data())
+            return 0;
+        void *pixels = file.kind == FILE_HDR ? (void*)stbi_loadf_from_memory(mapping.data(), (int)mapping.size(), &width, &height, &channels, 0)
+                                             : (void*)stbi_load_from_memory(mapping.data(), (int)mapping.size(), &width, &height, &channels, 0);
+        stbi_image_free(pixels);
+        return pixels ? (size_t)width * height * channels * (file.kind == FILE_HDR ? sizeof(float) : 1) : 0;
+    }
+    string contents;
+    FileSystem::readFile(file.path, contents);
+    return contents.size();
+}
+
+size_t readStdio(const File &file)
+{
+    FILE *stream = fopen(file.path.c_str(), "rb");
+    if (!stream)
+        return 0;
+    vector<unsigned char> contents(file.size);
+    size_t bytes = fread(contents.data(), 1, contents.size(), stream);
+    fclose(stream);
+    return bytes;
+}
+
+// sums one byte per page, which faults in the whole file like a decoder reading it does
+volatile size_t pageSum;
+size_t readMapped(const File &file)
+{
+    FileSystem::MappedFile mapping(file.path);
+    size_t sum = 0;
+    for (size_t i = 0; i < mapping.size(); i += 4096)
+        sum += mapping.data()[i];
+    pageSum = sum;
+    return mapping.size();
+}
+
+// evicts the files from the page cache; returns false where that isn't possible. 'residentAfter' is the fraction of
+// their pages that stayed cached anyway.
+bool dropFromPageCache(const vector<File> &files, double &residentAfter)
+{
+#ifdef _WIN32
+    (void)files;
+    residentAfter = 1.0;
+    return false;
+#else
+    size_t pages = 0, resident = 0;
+    long pageSize = sysconf(_SC_PAGESIZE);
+    for (unsigned int i = 0; i < files.size(); i++)
+    {
+        int fd = open(files[i].path.c_str(), O_RDONLY);
+        if (fd < 0)
+            continue;
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        void *view = mmap(nullptr, files[i].size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view != MAP_FAILED)
+        {
+            size_t count = (files[i].size + pageSize - 1) / pageSize;
+            vector<unsigned char> residency(count);
+            if (mincore(view, files[i].size, residency.data()) == 0)
+            {
+                pages += count;
+                for (size_t p = 0; p < count; p++)
+                    resident += residency[p] & 1;
+            }
+            munmap(view, files[i].size);
+        }
+        close(fd);
+    }
+    residentAfter = pages ? (double)resident / pages : 0.0;
+    return true;
+#endif
+}
+
+// loads every file of one kind, or all of them for FILE_OTHER; returns the time taken in milliseconds
+double runMethod(const Method &method, const vector<File> &files, FileKind kind, size_t &bytes)
+{
+    bytes = 0;
+    chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+    for (unsigned int i = 0; i < files.size(); i++)
+    {
+        if (files[i].kind == kind || kind == FILE_OTHER)
+            bytes += method.load(files[i]);
+    }
+    return chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+}
@@ -0,0 +1,489 @@
+// texture_cooker: converts the images of the resource tree into block compressed .dds files with a full mip chain,
+// stored next to each image as "<image>.dds" (see CookedTexturePath). DecodeTextureImage picks those up instead of
+// decoding the image, and their blocks are copied to the texture as they are.
+//
+// usage: texture_cooker [--force] [--benchmark] [--mip-filter box|kaiser|lanczos] [directory...]
+// Without directories the whole resources/ tree is cooked. Images whose .dds is newer than the image are skipped
+// unless --force is given. --benchmark cooks nothing; it measures the throughput of the DXT block encoders and of the
+// mip chain filters instead. The mip chains are built like DecodeTextureImage builds them for uncooked images loaded
+// with the default options (see TextureMipFlags and TextureMipFilter), Kaiser filtered unless --mip-filter picks
+// another filter; the flags are recorded in the .dds, so loads that ask for other mips decode the image instead.
+// The format is picked per image:
+// - tangent space normal maps (named *normal*, *_ddn* or *_nrm*) and two channel images become BC5, which stores two
+//   channels at 8 bits per pixel; the normal mapping shaders rebuild z from x and y;
+// - grayscale images become BC4, one channel at 4 bits per pixel: one channel ones, and data maps (see IsDataMap) with
+//   r = g = b everywhere. BC4 has no sRGB format, so gray color images stay DXT1, which can be sampled as sRGB;
+// - the others DXT1 (BC1), or DXT5 (BC3) if they have an alpha channel that's not fully opaque.
+// Every cooked image is decoded again and its PSNR against the source is printed.
+#include <glad/glad.h>
+#include <stb_image.h>
+#include <image_DXT.h>
+#include <image_helper.h>
+
+#include <learnopengl/filesystem.h>
+#include <learnopengl/texture.h>
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+#include <thread>
+
+using namespace std;
+
+struct CookStats {
+    unsigned int cooked, upToDate, failed;
+    size_t uncompressedBytes;  // GPU memory of the cooked images as uncompressed, mipmapped textures
+    size_t compressedBytes;    // the same block compressed, with mips
+    double decodeTime, cookTime;
+    double psnrSum;            // for the average PSNR of the cooked images
+
+    CookStats() : cooked(0), upToDate(0), failed(0), uncompressedBytes(0), compressedBytes(0), decodeTime(0.0), cookTime(0.0), psnrSum(0.0) {}
+};
+
+bool isImage(const string &path);
+bool cookImage(const string &path, bool force, CookStats &stats);
+bool writeDDS(const string &path, int width, int height, GLenum format, int levels, int mipFlags, int channels, const vector<unsigned char> &data);
+unsigned char* compressImage(GLenum format, const unsigned char *pixels, int width, int height, int channels, int &size);
+double measurePSNR(GLenum format, const unsigned char *blocks, const unsigned char *pixels, int width, int height, int channels,
+                   GLenum sourceFormat);
+bool benchmarkEncoders(const vector<string> &files);
+
+int main(int argc, char *argv[])
+{
+    bool force = false, benchmark = false;
+    vector<string> directories;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--force") == 0)
+            force = true;
+        else if (strcmp(argv[i], "--benchmark") == 0)
+            benchmark = true;
+        else if (strcmp(argv[i], "--mip-filter") == 0 && i + 1 < argc)
+        {
+            string filter = argv[++i];
+            if (filter == "box")
+                TextureMipFilter() = MIPMAP_FILTER_BOX;
+            else if (filter == "kaiser")
+                TextureMipFilter() = MIPMAP_FILTER_KAISER;
+            else if (filter == "lanczos")
+                TextureMipFilter() = MIPMAP_FILTER_LANCZOS;
+            else
+            {
+                cout << "ERROR::TEXTURE_COOKER:: unknown mip filter " << filter << endl;
+                return 1;
+            }
+        }
+        else
+            directories.push_back(argv[i]);
+    }
+    if (directories.empty())
+        directories.push_back(FileSystem::getPath("resources"));
+
+    vector<string> files;
+    for (unsigned int i = 0; i < directories.size(); i++)
+        FileSystem::listFiles(directories[i], files);
+    if (benchmark)
+        return benchmarkEncoders(files) ? 0 : 1;
+
+    CookStats stats;
+    for (unsigned int i = 0; i < files.size(); i++)
+    {
+        if (isImage(files[i]) && !cookImage(files[i], force, stats))
+            stats.failed++;
+    }
+
+    cout << "TEXTURE_COOKER:: " << stats.cooked << " cooked, " << stats.upToDate << " up to date, " << stats.failed << " failed" << endl;
+    if (stats.cooked > 0)
+        cout << "TEXTURE_COOKER:: GPU memory of the cooked textures: " << stats.uncompressedBytes / (1024.0 * 1024.0) << " MB uncompressed -> "
+             << stats.compressedBytes / (1024.0 * 1024.0) << " MB compressed (" << 100.0 * stats.compressedBytes / stats.uncompressedBytes
+             << "%); decoding took " << stats.decodeTime << " ms, which loading the .dds files no longer needs ("
+             << stats.cookTime << " ms to cook); average PSNR " << stats.psnrSum / stats.cooked << " dB" << endl;
+    return stats.failed > 0 ? 1 : 0;
+}
+
+bool isImage(const string &path)
+{
+    size_t dot = path.find_last_of('.');
+    if (dot == string::npos)
+        return false;
+    string extension = path.substr(dot + 1);
+    transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension == "png" || extension == "jpg" || extension == "jpeg" || extension == "tga" || extension == "bmp";
+}
+
+bool cookImage(const string &path, bool force, CookStats &stats)
+{
+    string cookedPath = CookedTexturePath(path);
+    // the same check DecodeTextureImage makes before it uses a cooked image
+    if (!force && CookedTextureIsCurrent(path))
+    {
+        stats.upToDate++;
+        return true;
+    }
+
+    chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+    int width, height, channels;
+    FileSystem::MappedFile file(path);
+    unsigned char *pixels = file.data() ? stbi_load_from_memory(file.data(), (int)file.size(), &width, &height, &channels, 0) : nullptr;
+    if (!pixels)
+    {
+        cout << "ERROR::TEXTURE_COOKER:: failed to decode " << path << ": " << stbi_failure_reason() << endl;
+        return false;
+    }
+    chrono::high_resolution_clock::time_point decoded = chrono::high_resolution_clock::now();
+
+    // DXT5 only where the alpha channel is actually used; opaque RGBA images are stored as DXT1 at half the size
+    size_t pixelCount = (size_t)width * height;
+    bool alpha = false, gray = channels != 2;
+    if (channels == 4)
+        for (size_t i = 0; i < pixelCount && !alpha; i++)
+            alpha = pixels[i * 4 + 3] != 255;
+    if (channels >= 3)
+        for (size_t i = 0; i < pixelCount && gray; i++)
+            gray = pixels[i * channels] == pixels[i * channels + 1] && pixels[i * channels] == pixels[i * channels + 2];
+    GLenum format = alpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    if (channels == 2 || (IsNormalMap(path) && !alpha))
+        format = GL_COMPRESSED_RG_RGTC2;
+    else if (gray && !alpha && (channels == 1 || IsDataMap(path)))
+        format = GL_COMPRESSED_RED_RGTC1;
+    const char *formatName = format == GL_COMPRESSED_RG_RGTC2 ? "BC5" : format == GL_COMPRESSED_RED_RGTC1 ? "BC4" : alpha ? "DXT5" : "DXT1";
+
+    // the mip chain down to 1x1, the same as DecodeTextureImage builds for the uncooked image, then every level compressed
+    int levels = 0, chainSize = 0;
+    // the flags the default options give (a loader asking for others, e.g. alpha tested mips, decodes the source)
+    int mipFlags = TextureMipFlags(path, TextureOptions(), channels);
+    unsigned char *chain = mipmap_image_chain(pixels, width, height, channels, TextureMipFilter(), mipFlags,
+                                              TEXTURE_ALPHA_REFERENCE, &levels, &chainSize);
+    stbi_image_free(pixels);
+    if (!chain)
+    {
+        cout << "ERROR::TEXTURE_COOKER:: failed to build the mip chain of " << path << endl;
+        return false;
+    }
+    vector<unsigned char> data;
+    double psnr = 0.0, dxt1Psnr = 0.0;
+    size_t offset = 0;
+    for (int level = 0; level < levels; level++)
+    {
+        int levelWidth = max(1, width >> level), levelHeight = max(1, height >> level);
+        const unsigned char *levelPixels = chain + offset;
+        offset += (size_t)levelWidth * levelHeight * channels;
+        int size = 0;
+        unsigned char *blocks = compressImage(format, levelPixels, levelWidth, levelHeight, channels, size);
+        if (!blocks)
+        {
+            cout << "ERROR::TEXTURE_COOKER:: failed to compress " << path << endl;
+            free(chain);
+            return false;
+        }
+        if (level == 0)
+        {
+            psnr = measurePSNR(format, blocks, levelPixels, width, height, channels, format);
+            // the same channels as DXT1 would have kept them, for comparison
+            if ((format == GL_COMPRESSED_RED_RGTC1 || format == GL_COMPRESSED_RG_RGTC2) && channels != 2)
+            {
+                int dxt1Size = 0;
+                unsigned char *dxt1 = convert_image_to_DXT1(levelPixels, width, height, channels, &dxt1Size);
+                dxt1Psnr = measurePSNR(GL_COMPRESSED_RGB_S3TC_DXT1_EXT, dxt1, levelPixels, width, height, channels, format);
+                free(dxt1);
+            }
+        }
+        data.insert(data.end(), blocks, blocks + size);
+        free(blocks);
+    }
+    free(chain);
+
+    if (!writeDDS(cookedPath, width, height, format, levels, mipFlags, channels, data))
+    {
+        cout << "ERROR::TEXTURE_COOKER:: could not write " << cookedPath << endl;
+        return false;
+    }
+
+    // counted the way TextureImageBytes counts an uncompressed texture with mips
+    size_t uncompressedBytes = (size_t)width * height * channels * 4 / 3;
+    chrono::high_resolution_clock::time_point end = chrono::high_resolution_clock::now();
+    double decodeTime = chrono::duration<double, milli>(decoded - start).count();
+    stats.cooked++;
+    stats.uncompressedBytes += uncompressedBytes;
+    stats.compressedBytes += data.size();
+    stats.decodeTime += decodeTime;
+    stats.cookTime += chrono::duration<double, milli>(end - start).count();
+    stats.psnrSum += psnr;
+    cout << "TEXTURE_COOKER:: " << path << " " << width << "x" << height << " " << formatName << ", " << levels << " levels, "
+         << uncompressedBytes / 1024 << " KB -> " << data.size() / 1024 << " KB, PSNR " << psnr << " dB";
+    if (dxt1Psnr > 0.0)
+        cout << " (as DXT1: " << dxt1Psnr << " dB)";
+    cout << endl;
+    return true;
+}
+
+unsigned char* compressImage(GLenum format, const unsigned char *pixels, int width, int height, int channels, int &size)
+{
+    switch (format)
+    {
+    case GL_COMPRESSED_RED_RGTC1:          return convert_image_to_BC4(pixels, width, height, channels, &size);
+    case GL_COMPRESSED_RG_RGTC2:           return convert_image_to_BC5(pixels, width, height, channels, &size);
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: return convert_image_to_DXT5(pixels, width, height, channels, &size);
+    default:                               return convert_image_to_DXT1(pixels, width, height, channels, &size);
+    }
+}
+
+// decodes a BC4 block, or the alpha half of a DXT5 block, to 16 values 'stride' bytes apart
+void decodeAlphaBlock(const unsigned char *block, unsigned char *out, int stride)
+{
+    int a0 = block[0], a1 = block[1];
+    int palette[8] = { a0, a1 };
+    for (int i = 2; i < 8; i++)
+    {
+        if (a0 > a1)
+            palette[i] = ((8 - i) * a0 + (i - 1) * a1) / 7;
+        else
+            palette[i] = i < 6 ? ((6 - i) * a0 + (i - 1) * a1) / 5 : (i == 6 ? 0 : 255);
+    }
+    unsigned long long bits = 0;
+    for (int i = 0; i < 6; i++)
+        bits |= (unsigned long long)block[2 + i] << (8 * i);
+    for (int i = 0; i < 16; i++)
+        out[i * stride] = (unsigned char)palette[(bits >> (3 * i)) & 7];
+}
+
+// decodes the color half of a DXT block to 16 RGBA pixels, leaving alpha alone
+void decodeColorBlock(const unsigned char *block, unsigned char *out)
+{
+    unsigned int c0 = block[0] | (block[1] << 8), c1 = block[2] | (block[3] << 8);
+    int palette[4][3];
+    for (int k = 0; k < 2; k++)
+    {
+        unsigned int c = k == 0 ? c0 : c1;
+        int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+        palette[k][0] = (r << 3) | (r >> 2);
+        palette[k][1] = (g << 2) | (g >> 4);
+        palette[k][2] = (b << 3) | (b >> 2);
+    }
+    for (int j = 0; j < 3; j++)
+    {
+        palette[2][j] = c0 > c1 ? (2 * palette[0][j] + palette[1][j]) / 3 : (palette[0][j] + palette[1][j]) / 2;
+        palette[3][j] = c0 > c1 ? (palette[0][j] + 2 * palette[1][j]) / 3 : 0;
+    }
+    for (int i = 0; i < 16; i++)
+    {
+        int index = (block[4 + i / 4] >> (2 * (i % 4))) & 3;
+        for (int j = 0; j < 3; j++)
+            out[i * 4 + j] = (unsigned char)palette[index][j];
+    }
+}
+
+// PSNR of the top level of an image compressed as 'format' against its source pixels, over the channels that the
+// format picked for the source ('sourceFormat') keeps: r for BC4, r and g for BC5, rgb for DXT1 and rgba for DXT5.
+// The two differ to see how an image cooked as BC4/BC5 would have fared as DXT1.
+double measurePSNR(GLenum format, const unsigned char *blocks, const unsigned char *pixels, int width, int height, int channels,
+                   GLenum sourceFormat)
+{
+    int compared = sourceFormat == GL_COMPRESSED_RED_RGTC1 ? 1 : sourceFormat == GL_COMPRESSED_RG_RGTC2 ? 2
+                 : sourceFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? 3 : 4;
+    // the source channel behind each decoded one: the gray of one channel images stands for r, g and b, and the
+    // second channel of two channel images is stored in g
+    int sourceChannel[4] = { 0, channels == 1 ? 0 : 1, channels < 3 ? 0 : 2, channels - 1 };
+    double error = 0.0;
+    for (int by = 0; by < height; by += 4)
+    {
+        for (int bx = 0; bx < width; bx += 4)
+        {
+            unsigned char decoded[16 * 4];
+            memset(decoded, 0, sizeof(decoded));
+            if (format == GL_COMPRESSED_RED_RGTC1 || format == GL_COMPRESSED_RG_RGTC2)
+            {
+                decodeAlphaBlock(blocks, decoded, 4);
+                if (format == GL_COMPRESSED_RG_RGTC2)
+                    decodeAlphaBlock(blocks + 8, decoded + 1, 4);
+            }
+            else if (format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+            {
+                decodeAlphaBlock(blocks, decoded + 3, 4);
+                decodeColorBlock(blocks + 8, decoded);
+            }
+            else
+                decodeColorBlock(blocks, decoded);
+            blocks += CompressedLevelSize(format, 4, 4);
+
+            for (int y = by; y < min(by + 4, height); y++)
+            {
+                for (int x = bx; x < min(bx + 4, width); x++)
+                {
+                    const unsigned char *source = pixels + ((size_t)y * width + x) * channels;
+                    const unsigned char *result = decoded + ((y - by) * 4 + (x - bx)) * 4;
+                    for (int k = 0; k < compared; k++)
+                    {
+                        double difference = (double)source[sourceChannel[k]] - result[k];
+                        error += difference * difference;
+                    }
+                }
+            }
+        }
+    }
+    double mse = error / ((double)width * height * compared);
+    return mse > 0.0 ? 10.0 * log10(255.0 * 255.0 / mse) : 99.0;
+}
+
+bool writeDDS(const string &path, int width, int height, GLenum format, int levels, int mipFlags, int channels, const vector<unsigned char> &data)
+{
+    DDS_header header;
+    memset(&header, 0, sizeof(header));
+    header.dwMagic = ('D' << 0) | ('D' << 8) | ('S' << 16) | (' ' << 24);
+    header.dwSize = 124;
+    header.dwFlags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_LINEARSIZE | DDSD_MIPMAPCOUNT;
+    header.dwWidth = width;
+    header.dwHeight = height;
+    header.dwPitchOrLinearSize = (unsigned int)CompressedLevelSize(format, width, height);
+    header.dwMipMapCount = levels;
+    // read back by LoadDDSImage, see CookedTextureInfo
+    header.dwReserved1[0] = COOKED_TEXTURE_TAG;
+    header.dwReserved1[1] = mipFlags;
+    header.dwReserved1[2] = channels;
+    header.sPixelFormat.dwSize = 32;
+    header.sPixelFormat.dwFlags = DDPF_FOURCC;
+    header.sPixelFormat.dwFourCC = format == GL_COMPRESSED_RED_RGTC1         ? DDSFourCC('A', 'T', 'I', '1')
+                                 : format == GL_COMPRESSED_RG_RGTC2          ? DDSFourCC('A', 'T', 'I', '2')
+                                 : format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? DDSFourCC('D', 'X', 'T', '1')
+                                                                             : DDSFourCC('D', 'X', 'T', '5');
+    header.sCaps.dwCaps1 = DDSCAPS_TEXTURE | DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+
+    // written atomically, so a cancelled cook never leaves a truncated .dds behind
+    FileSystem::FileChunk chunks[] = { { &header, sizeof(header) }, { data.data(), data.size() } };
+    return FileSystem::writeFileAtomically(path, vector<FileSystem::FileChunk>(chunks, chunks + 2));
+}
+
+// compresses the top level of every image with each block encoder, on one thread and on all cores, and reports the
+// throughput in megapixels per second. The outputs are compared with the scalar encoder's, which they must match.
+bool benchmarkEncoders(const vector<string> &files)
+{
+    struct Image {
+        string path;
+        vector<unsigned char> pixels;
+        int width, height, channels;
+        bool alpha;
+        vector<unsigned char> reference; // scalar encoder output
+    };
+    vector<Image> images;
+    double pixels = 0.0;
+    for (unsigned int i = 0; i < files.size(); i++)
+    {
+        if (!isImage(files[i]))
+            continue;
+        Image image;
+        FileSystem::MappedFile file(files[i]);
+        unsigned char *data = file.data() ? stbi_load_from_memory(file.data(), (int)file.size(), &image.width, &image.height, &image.channels, 0) : nullptr;
+        if (!data || image.channels == 2)
+        {
+            stbi_image_free(data);
+            continue;
+        }
+        image.path = files[i];
+        image.pixels.assign(data, data + (size_t)image.width * image.height * image.channels);
+        stbi_image_free(data);
+        image.alpha = false;
+        if (image.channels == 4)
+            for (size_t j = 3; j < image.pixels.size() && !image.alpha; j += 4)
+                image.alpha = image.pixels[j] != 255;
+        pixels += (double)image.width * image.height;
+        images.push_back(image);
+    }
+    if (images.empty())
+    {
+        cout << "ERROR::TEXTURE_COOKER:: no images to benchmark" << endl;
+        return false;
+    }
+
+    struct Run {
+        const char *name;
+        int encoder, threads;
+    };
+    const Run runs[] = {
+        { "scalar", DXT_ENCODER_SCALAR, 1 }, { "scalar", DXT_ENCODER_SCALAR, 0 },
+        { "SSE2", DXT_ENCODER_SSE2, 1 },     { "SSE2", DXT_ENCODER_SSE2, 0 },
+        { "AVX", DXT_ENCODER_AVX, 1 },       { "AVX", DXT_ENCODER_AVX, 0 },
+    };
+    cout << "TEXTURE_COOKER::BENCHMARK " << images.size() << " images, " << pixels / 1e6 << " MPix, "
+         << thread::hardware_concurrency() << " cores" << endl;
+    bool identical = true;
+    double scalarTime = 0.0;
+    for (unsigned int r = 0; r < sizeof(runs) / sizeof(runs[0]); r++)
+    {
+        // encoders the CPU can't run fall back to another one, which was measured already
+        if (set_DXT_encoder(runs[r].encoder) != runs[r].encoder)
+            continue;
+        set_DXT_threads(runs[r].threads);
+        double time = 0.0;
+        unsigned int mismatches = 0;
+        for (unsigned int i = 0; i < images.size(); i++)
+        {
+            Image &image = images[i];
+            int size = 0;
+            chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+            unsigned char *blocks = image.alpha ? convert_image_to_DXT5(image.pixels.data(), image.width, image.height, image.channels, &size)
+                                                : convert_image_to_DXT1(image.pixels.data(), image.width, image.height, image.channels, &size);
+            time += chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+            if (image.reference.empty())
+                image.reference.assign(blocks, blocks + size);
+            else if (image.reference.size() != (size_t)size || memcmp(image.reference.data(), blocks, size) != 0)
+                mismatches++;
+            free(blocks);
+        }
+        if (r == 0)
+            scalarTime = time;
+        identical = identical && mismatches == 0;
+        cout << "TEXTURE_COOKER::BENCHMARK " << runs[r].name << (runs[r].threads == 1 ? ", 1 thread: " : ", all cores: ")
+             << pixels / 1e3 / time << " MPix/s (" << time << " ms, " << scalarTime / time << "x scalar)";
+        if (mismatches > 0)
+            cout << ", ERROR: " << mismatches << " images differ from the scalar encoder";
+        cout << endl;
+    }
+    set_DXT_encoder(DXT_ENCODER_AUTO);
+    set_DXT_threads(0);
+
+    // the mip chains, against the gamma space 2x2 box of mipmap_image level by level
+    double boxTime = 0.0;
+    for (unsigned int i = 0; i < images.size(); i++)
+    {
+        const Image &image = images[i];
+        vector<unsigned char> level(image.pixels), next;
+        chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+        for (int width = image.width, height = image.height; width > 1 || height > 1; width = max(1, width / 2), height = max(1, height / 2))
+        {
+            next.resize((size_t)max(1, width / 2) * max(1, height / 2) * image.channels);
+            mipmap_image(level.data(), width, height, image.channels, next.data(), width > 1 ? 2 : 1, height > 1 ? 2 : 1);
+            level.swap(next);
+        }
+        boxTime += chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+    }
+    cout << "TEXTURE_COOKER::BENCHMARK mip chains, mipmap_image (gamma space box), 1 thread: " << pixels / 1e3 / boxTime << " MPix/s ("
+         << boxTime << " ms)" << endl;
+    const char *filterNames[] = { "box", "Kaiser", "Lanczos" };
+    for (int filter = MIPMAP_FILTER_BOX; filter <= MIPMAP_FILTER_LANCZOS; filter++)
+    {
+        for (int threads = 1; threads >= 0; threads--)
+        {
+            set_mipmap_threads(threads);
+            double time = 0.0;
+            for (unsigned int i = 0; i < images.size(); i++)
+            {
+                const Image &image = images[i];
+                int levels = 0, size = 0;
+                chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+                unsigned char *chain = mipmap_image_chain(image.pixels.data(), image.width, image.height, image.channels, filter,
+                                                          TextureMipFlags(image.path, TextureOptions(), image.channels), TEXTURE_ALPHA_REFERENCE, &levels, &size);
+                time += chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+                free(chain);
+            }
+            cout << "TEXTURE_COOKER::BENCHMARK mip chains, " << filterNames[filter] << (threads == 1 ? ", 1 thread: " : ", all cores: ")
+                 << pixels / 1e3 / time << " MPix/s (" << time << " ms, " << boxTime / time << "x mipmap_image)" << endl;
+        }
+    }
+    set_mipmap_threads(0);
+    return identical;
+}